@@ -60,9 +60,15 @@
    __cl_disp_worker
 
    Description:
-   This function takes messages off the FIFO and calls Processmsg()
+   This function takes messages off the run queues and calls Processmsg()
    This function executes as passive level.
 
+   Messages are taken in priority order.  Within a priority class the
+   worker serves its own shard first and then steals from the others.
+   A thread is bound to its own shard with its first callback.
+   The previous message is returned to its pool while the lock of its
+   shard is held anyway for the next pop, when possible.
+
    Inputs:
    p_disp - Pointer to Dispatcher object
 
@@ -74,32 +80,78 @@
 ********************************************************************/
 void __cl_disp_worker(IN void *context)
 {
-	cl_disp_msg_t *p_msg;
+	cl_disp_msg_t *p_msg, *p_done = NULL;
 	cl_dispatcher_t *p_disp = (cl_dispatcher_t *) context;
+	cl_disp_shard_t *p_shard;
+	cl_disp_reg_info_t *p_reg;
+	uint64_t queue_time;
+	uintptr_t home;
+	uint32_t i;
+	int prio;
+
+	/* the key holds the home shard plus one, zero means unbound */
+	home = (uintptr_t) pthread_getspecific(p_disp->worker_key);
+	if (!home) {
+		home = (uint32_t) cl_atomic_inc(&p_disp->next_worker) %
+		    p_disp->num_shards + 1;
+		pthread_setspecific(p_disp->worker_key, (void *)home);
+	}
+	home--;
+
+	/* Process the run queues until we drain them dry. */
+	for (;;) {
+		p_msg = NULL;
+		for (prio = 0; !p_msg && prio < CL_DISP_PRIO_MAX; prio++)
+			for (i = 0; !p_msg && i < p_disp->num_shards; i++) {
+				p_shard = &p_disp->shards[(home + i) %
+							  p_disp->num_shards];
+				/* unlocked peek, posters signal after queuing */
+				if (cl_is_qlist_empty(&p_shard->fifo[prio]))
+					continue;
+
+				cl_spinlock_acquire(&p_shard->lock);
+				if (p_done && p_done->p_shard == p_shard) {
+					cl_qpool_put(&p_shard->msg_pool,
+						     &p_done->item);
+					p_done = NULL;
+				}
+				if (!cl_is_qlist_empty(&p_shard->fifo[prio])) {
+					p_msg = (cl_disp_msg_t *)
+					    cl_qlist_remove_head(&p_shard->
+								 fifo[prio]);
+					/* we track the time the last message spent in the queue */
+					p_disp->last_msg_queue_time_us =
+					    cl_get_time_stamp() - p_msg->in_time;
+				}
+				cl_spinlock_release(&p_shard->lock);
+			}
+
+		if (p_done) {
+			cl_spinlock_acquire(&p_done->p_shard->lock);
+			cl_qpool_put(&p_done->p_shard->msg_pool, &p_done->item);
+			cl_spinlock_release(&p_done->p_shard->lock);
+			p_done = NULL;
+		}
 
-	cl_spinlock_acquire(&p_disp->lock);
-
-	/* Process the FIFO until we drain it dry. */
-	while (cl_qlist_count(&p_disp->msg_fifo)) {
-		/* Pop the message at the head from the FIFO. */
-		p_msg =
-		    (cl_disp_msg_t *) cl_qlist_remove_head(&p_disp->msg_fifo);
+		if (!p_msg)
+			break;
 
-		/* we track the tim ethe last message spent in the queue */
-		p_disp->last_msg_queue_time_us =
-		    cl_get_time_stamp() - p_msg->in_time;
+		p_reg = p_msg->p_dest_reg;
+		queue_time = cl_get_time_stamp() - p_msg->in_time;
+		cl_atomic_dec(&p_reg->num_queued);
+		p_reg->num_msgs++;
+		p_reg->last_queue_time_us = queue_time;
+		if (queue_time > p_reg->max_queue_time_us)
+			p_reg->max_queue_time_us = queue_time;
 
 		/*
-		 * Release the spinlock while the message is processed.
 		 * The user's callback may reenter the dispatcher
-		 * and cause the lock to be reaquired.
+		 * and cause the locks to be reaquired.
 		 */
-		cl_spinlock_release(&p_disp->lock);
-		p_msg->p_dest_reg->pfn_rcv_callback((void *)p_msg->p_dest_reg->
-						    context,
-						    (void *)p_msg->p_data);
+		p_reg->pfn_rcv_callback((void *)p_reg->context,
+					(void *)p_msg->p_data);
 
-		cl_atomic_dec(&p_msg->p_dest_reg->ref_cnt);
+		cl_atomic_dec(&p_reg->ref_cnt);
 
 		/* The client has seen the data.  Notify the sender as appropriate. */
 		if (p_msg->pfn_xmt_callback) {
@@ -108,14 +160,9 @@ void __cl_disp_worker(IN void *context)
 			cl_atomic_dec(&p_msg->p_src_reg->ref_cnt);
 		}
 
-		/* Grab the lock for the next iteration through the list. */
-		cl_spinlock_acquire(&p_disp->lock);
-
-		/* Return this message to the pool. */
-		cl_qpool_put(&p_disp->msg_pool, (cl_pool_item_t *) p_msg);
+		/* Return this message to the pool with the next pop. */
+		p_done = p_msg;
 	}
-
-	cl_spinlock_release(&p_disp->lock);
 }
 
 void cl_disp_construct(IN cl_dispatcher_t * const p_disp)
@@ -123,10 +170,13 @@ void cl_disp_construct(IN cl_dispatcher_t * const p_disp)
 	CL_ASSERT(p_disp);
 
 	cl_qlist_init(&p_disp->reg_list);
-	cl_ptr_vector_construct(&p_disp->reg_vec);
-	cl_qlist_init(&p_disp->msg_fifo);
+	p_disp->reg_tbl = NULL;
 	cl_spinlock_construct(&p_disp->lock);
-	cl_qpool_construct(&p_disp->msg_pool);
+	p_disp->shards = NULL;
+	p_disp->num_shards = 0;
+	p_disp->next_shard = 0;
+	p_disp->next_worker = 0;
+	p_disp->worker_key_created = FALSE;
 }
 
 void cl_disp_shutdown(IN cl_dispatcher_t * const p_disp)
@@ -146,13 +196,100 @@ void cl_disp_shutdown(IN cl_dispatcher_t * const p_disp)
 
 void cl_disp_destroy(IN cl_dispatcher_t * const p_disp)
 {
+	cl_disp_reg_tbl_t *p_tbl;
+	uint32_t i;
+
 	CL_ASSERT(p_disp);
 
 	cl_spinlock_destroy(&p_disp->lock);
-	/* Destroy the message pool */
-	cl_qpool_destroy(&p_disp->msg_pool);
-	/* Destroy the pointer vector of registrants. */
-	cl_ptr_vector_destroy(&p_disp->reg_vec);
+	/* Destroy the run queues and their message pools */
+	for (i = 0; i < p_disp->num_shards; i++) {
+		cl_spinlock_destroy(&p_disp->shards[i].lock);
+		cl_qpool_destroy(&p_disp->shards[i].msg_pool);
+	}
+	free(p_disp->shards);
+	p_disp->shards = NULL;
+	p_disp->num_shards = 0;
+	if (p_disp->worker_key_created) {
+		pthread_key_delete(p_disp->worker_key);
+		p_disp->worker_key_created = FALSE;
+	}
+	/* Free the registration table and those it replaced. */
+	while (p_disp->reg_tbl) {
+		p_tbl = p_disp->reg_tbl;
+		p_disp->reg_tbl = p_tbl->p_prev;
+		free(p_tbl);
+	}
+}
+
+static cl_status_t disp_init_shards(IN cl_dispatcher_t * const p_disp,
+				    IN uint32_t count)
+{
+	cl_disp_shard_t *p_shard;
+	cl_status_t status;
+	uint32_t i;
+	int prio;
+
+	p_disp->shards = calloc(count, sizeof(*p_disp->shards));
+	if (!p_disp->shards)
+		return CL_INSUFFICIENT_MEMORY;
+
+	for (i = 0; i < count; i++) {
+		p_shard = &p_disp->shards[i];
+		cl_spinlock_construct(&p_shard->lock);
+		for (prio = 0; prio < CL_DISP_PRIO_MAX; prio++)
+			cl_qlist_init(&p_shard->fifo[prio]);
+		cl_qpool_construct(&p_shard->msg_pool);
+	}
+	p_disp->num_shards = count;
+
+	for (i = 0; i < count; i++) {
+		p_shard = &p_disp->shards[i];
+		status = cl_spinlock_init(&p_shard->lock);
+		if (status != CL_SUCCESS)
+			return status;
+
+		/* Specify no upper limit to the number of messages in the pool */
+		status = cl_qpool_init(&p_shard->msg_pool,
+				       CL_DISP_INITIAL_MSG_COUNT / count + 1,
+				       0, CL_DISP_MSG_GROW_SIZE,
+				       sizeof(cl_disp_msg_t), NULL, NULL, NULL);
+		if (status != CL_SUCCESS)
+			return status;
+	}
+
+	return CL_SUCCESS;
+}
+
+/*
+ * Replaces the registration table with a copy of at least size entries.
+ * Called with the dispatcher lock held or before the dispatcher is used.
+ */
+static cl_status_t disp_grow_reg_tbl(IN cl_dispatcher_t * const p_disp,
+				     IN uint32_t size)
+{
+	cl_disp_reg_tbl_t *p_old = p_disp->reg_tbl, *p_tbl;
+	uint32_t i;
+
+	if (p_old)
+		size = (size + CL_DISP_REG_GROW_SIZE) -
+		    (size % CL_DISP_REG_GROW_SIZE);
+	p_tbl = malloc(sizeof(*p_tbl) + size * sizeof(*p_tbl->regs));
+	if (!p_tbl)
+		return CL_INSUFFICIENT_MEMORY;
+
+	p_tbl->p_prev = p_old;
+	p_tbl->size = size;
+	p_tbl->regs = (cl_disp_reg_info_t **) (p_tbl + 1);
+	for (i = 0; i < size; i++)
+		p_tbl->regs[i] = p_old && i < p_old->size ?
+		    p_old->regs[i] : NULL;
+
+	/* the entries must be visible before the table, the atomic
+	   operation is a full barrier */
+	cl_atomic_inc(&p_disp->next_shard);
+	p_disp->reg_tbl = p_tbl;
+	return CL_SUCCESS;
 }
 
 cl_status_t cl_disp_init(IN cl_dispatcher_t * const p_disp,
@@ -171,17 +308,22 @@ cl_status_t cl_disp_init(IN cl_dispatcher_t * const p_disp,
 		return (status);
 	}
 
-	/* Specify no upper limit to the number of messages in the pool */
-	status = cl_qpool_init(&p_disp->msg_pool, CL_DISP_INITIAL_MSG_COUNT,
-			       0, CL_DISP_MSG_GROW_SIZE, sizeof(cl_disp_msg_t),
-			       NULL, NULL, NULL);
+	/* One run queue per worker thread */
+	status = disp_init_shards(p_disp,
+				  thread_count ? thread_count : cl_proc_count());
 	if (status != CL_SUCCESS) {
 		cl_disp_destroy(p_disp);
 		return (status);
 	}
 
-	status = cl_ptr_vector_init(&p_disp->reg_vec, CL_DISP_INITIAL_REG_COUNT,
-				    CL_DISP_REG_GROW_SIZE);
+	/* Binds each worker thread to its own run queue */
+	if (pthread_key_create(&p_disp->worker_key, NULL)) {
+		cl_disp_destroy(p_disp);
+		return CL_INSUFFICIENT_RESOURCES;
+	}
+	p_disp->worker_key_created = TRUE;
+
+	status = disp_grow_reg_tbl(p_disp, CL_DISP_INITIAL_REG_COUNT);
 	if (status != CL_SUCCESS) {
 		cl_disp_destroy(p_disp);
 		return (status);
@@ -202,15 +344,21 @@ cl_disp_reg_handle_t cl_disp_register(IN cl_dispatcher_t * const p_disp,
 				      IN const void *const context OPTIONAL)
 {
 	cl_disp_reg_info_t *p_reg;
-	cl_status_t status;
 
 	CL_ASSERT(p_disp);
 
 	/* Check that the requested registrant ID is available. */
 	cl_spinlock_acquire(&p_disp->lock);
 	if ((msg_id != CL_DISP_MSGID_NONE) &&
-	    (msg_id < cl_ptr_vector_get_size(&p_disp->reg_vec)) &&
-	    (cl_ptr_vector_get(&p_disp->reg_vec, msg_id))) {
+	    (msg_id < p_disp->reg_tbl->size) &&
+	    (p_disp->reg_tbl->regs[msg_id])) {
+		cl_spinlock_release(&p_disp->lock);
+		return (NULL);
+	}
+
+	/* Make room in the registration table. */
+	if (msg_id != CL_DISP_MSGID_NONE && msg_id >= p_disp->reg_tbl->size &&
+	    disp_grow_reg_tbl(p_disp, msg_id + 1) != CL_SUCCESS) {
 		cl_spinlock_release(&p_disp->lock);
 		return (NULL);
 	}
@@ -229,26 +377,32 @@ cl_disp_reg_handle_t cl_disp_register(IN cl_dispatcher_t * const p_disp,
 	p_reg->pfn_rcv_callback = pfn_callback;
 	p_reg->context = context;
 	p_reg->msg_id = msg_id;
+	p_reg->prio = CL_DISP_PRIO_NORMAL;
 
 	/* Insert the registration in the list. */
 	cl_qlist_insert_tail(&p_disp->reg_list, (cl_list_item_t *) p_reg);
 
-	/* Set the array entry to the registrant. */
-	/* The ptr_vector grow automatically as necessary. */
-	if (msg_id != CL_DISP_MSGID_NONE) {
-		status = cl_ptr_vector_set(&p_disp->reg_vec, msg_id, p_reg);
-		if (status != CL_SUCCESS) {
-			free(p_reg);
-			cl_spinlock_release(&p_disp->lock);
-			return (NULL);
-		}
-	}
+	/* Set the table entry to the registrant. */
+	if (msg_id != CL_DISP_MSGID_NONE)
+		p_disp->reg_tbl->regs[msg_id] = p_reg;
 
 	cl_spinlock_release(&p_disp->lock);
 
 	return (p_reg);
 }
 
+void cl_disp_set_priority(IN const cl_disp_reg_handle_t handle,
+			  IN const cl_disp_prio_t prio)
+{
+	cl_disp_reg_info_t *p_reg = (cl_disp_reg_info_t *) handle;
+
+	CL_ASSERT(prio < CL_DISP_PRIO_MAX);
+
+	cl_spinlock_acquire(&p_reg->p_disp->lock);
+	p_reg->prio = prio;
+	cl_spinlock_release(&p_reg->p_disp->lock);
+}
+
 void cl_disp_unregister(IN const cl_disp_reg_handle_t handle)
 {
 	cl_disp_reg_info_t *p_reg;
@@ -263,26 +417,23 @@ void cl_disp_unregister(IN const cl_disp_reg_handle_t handle)
 
 	cl_spinlock_acquire(&p_disp->lock);
 	/*
-	 * Clear the registrant vector entry.  This will cause any further
+	 * Clear the registrant table entry.  This will cause any further
 	 * post calls to fail.
 	 */
 	if (p_reg->msg_id != CL_DISP_MSGID_NONE) {
-		CL_ASSERT(p_reg->msg_id <
-			  cl_ptr_vector_get_size(&p_disp->reg_vec));
-		cl_ptr_vector_set(&p_disp->reg_vec, p_reg->msg_id, NULL);
+		CL_ASSERT(p_reg->msg_id < p_disp->reg_tbl->size);
+		p_disp->reg_tbl->regs[p_reg->msg_id] = NULL;
 	}
 	cl_spinlock_release(&p_disp->lock);
 
-	while (p_reg->ref_cnt > 0)
+	/*
+	 * A poster that took a reference before the entry was cleared is
+	 * waited for; the atomic read orders it after the clearing.  The
+	 * registration itself stays allocated until cl_disp_shutdown since
+	 * a poster may still be about to look at it.
+	 */
+	while (cl_atomic_add(&p_reg->ref_cnt, 0) > 0)
 		cl_thread_suspend(1);
-
-	cl_spinlock_acquire(&p_disp->lock);
-	/* Remove the registrant from the list. */
-	cl_qlist_remove_item(&p_disp->reg_list, (cl_list_item_t *) p_reg);
-	/* Return the registration info to the pool */
-	free(p_reg);
-
-	cl_spinlock_release(&p_disp->lock);
 }
 
 cl_status_t cl_disp_post(IN const cl_disp_reg_handle_t handle,
@@ -293,25 +444,57 @@ cl_status_t cl_disp_post(IN const cl_disp_reg_handle_t handle,
 {
 	cl_disp_reg_info_t *p_src_reg = (cl_disp_reg_info_t *) handle;
 	cl_disp_reg_info_t *p_dest_reg;
+	cl_disp_reg_tbl_t *p_tbl;
 	cl_dispatcher_t *p_disp;
+	cl_disp_shard_t *p_shard;
 	cl_disp_msg_t *p_msg;
+	cl_disp_prio_t prio;
 
 	p_disp = handle->p_disp;
 	CL_ASSERT(p_disp);
 	CL_ASSERT(msg_id != CL_DISP_MSGID_NONE);
 
-	cl_spinlock_acquire(&p_disp->lock);
-	/* Check that the recipient exists. */
-	p_dest_reg = cl_ptr_vector_get(&p_disp->reg_vec, msg_id);
-	if (!p_dest_reg) {
-		cl_spinlock_release(&p_disp->lock);
+	/*
+	 * Check that the recipient exists.  The registration table is read
+	 * without a lock: take a reference and check that the recipient
+	 * was not unregistered meanwhile, cl_disp_unregister waits for the
+	 * references taken before it cleared the entry.
+	 */
+	p_tbl = p_disp->reg_tbl;
+	if (msg_id >= p_tbl->size || !(p_dest_reg = p_tbl->regs[msg_id]))
+		return (CL_NOT_FOUND);
+
+	/* Increment the recipient's reference count. */
+	cl_atomic_inc(&p_dest_reg->ref_cnt);
+	p_tbl = p_disp->reg_tbl;
+	if (msg_id >= p_tbl->size || p_tbl->regs[msg_id] != p_dest_reg) {
+		cl_atomic_dec(&p_dest_reg->ref_cnt);
 		return (CL_NOT_FOUND);
 	}
 
+	/*
+	 * Increment the sender's reference count if they request a completion
+	 * notification.
+	 */
+	if (pfn_callback)
+		cl_atomic_inc(&p_src_reg->ref_cnt);
+
+	cl_atomic_inc(&p_dest_reg->num_queued);
+	prio = p_dest_reg->prio;
+
+	/* Spread the messages over the run queues. */
+	p_shard = &p_disp->shards[(uint32_t) cl_atomic_inc(&p_disp->next_shard) %
+				  p_disp->num_shards];
+
+	cl_spinlock_acquire(&p_shard->lock);
 	/* Get a free message from the pool. */
-	p_msg = (cl_disp_msg_t *) cl_qpool_get(&p_disp->msg_pool);
+	p_msg = (cl_disp_msg_t *) cl_qpool_get(&p_shard->msg_pool);
 	if (!p_msg) {
-		cl_spinlock_release(&p_disp->lock);
+		cl_spinlock_release(&p_shard->lock);
+		cl_atomic_dec(&p_dest_reg->num_queued);
+		cl_atomic_dec(&p_dest_reg->ref_cnt);
+		if (pfn_callback)
+			cl_atomic_dec(&p_src_reg->ref_cnt);
 		return (CL_INSUFFICIENT_MEMORY);
 	}
 
@@ -322,20 +505,11 @@ cl_status_t cl_disp_post(IN const cl_disp_reg_handle_t handle,
 	p_msg->pfn_xmt_callback = pfn_callback;
 	p_msg->context = context;
 	p_msg->in_time = cl_get_time_stamp();
+	p_msg->p_shard = p_shard;
 
-	/*
-	 * Increment the sender's reference count if they request a completion
-	 * notification.
-	 */
-	if (pfn_callback)
-		cl_atomic_inc(&p_src_reg->ref_cnt);
-
-	/* Increment the recipient's reference count. */
-	cl_atomic_inc(&p_dest_reg->ref_cnt);
-
-	/* Queue the message in the FIFO. */
-	cl_qlist_insert_tail(&p_disp->msg_fifo, (cl_list_item_t *) p_msg);
-	cl_spinlock_release(&p_disp->lock);
+	/* Queue the message in the FIFO of its priority class. */
+	cl_qlist_insert_tail(&p_shard->fifo[prio], (cl_list_item_t *) p_msg);
+	cl_spinlock_release(&p_shard->lock);
 
 	/* Signal the thread pool that there is work to be done. */
 	cl_thread_pool_signal(&p_disp->worker_threads);
@@ -347,15 +521,43 @@ void cl_disp_get_queue_status(IN const cl_disp_reg_handle_t handle,
 			      OUT uint64_t * p_last_msg_queue_time_ms)
 {
 	cl_dispatcher_t *p_disp = ((cl_disp_reg_info_t *) handle)->p_disp;
-
-	cl_spinlock_acquire(&p_disp->lock);
+	cl_disp_shard_t *p_shard;
+	uint32_t i, count = 0;
+	int prio;
+
+	if (handle->msg_id != CL_DISP_MSGID_NONE) {
+		if (p_last_msg_queue_time_ms)
+			*p_last_msg_queue_time_ms =
+			    handle->last_queue_time_us / 1000;
+		if (p_num_queued_msgs)
+			*p_num_queued_msgs = handle->num_queued;
+		return;
+	}
 
 	if (p_last_msg_queue_time_ms)
 		*p_last_msg_queue_time_ms =
 		    p_disp->last_msg_queue_time_us / 1000;
 
-	if (p_num_queued_msgs)
-		*p_num_queued_msgs = cl_qlist_count(&p_disp->msg_fifo);
+	if (!p_num_queued_msgs)
+		return;
 
-	cl_spinlock_release(&p_disp->lock);
+	for (i = 0; i < p_disp->num_shards; i++) {
+		p_shard = &p_disp->shards[i];
+		cl_spinlock_acquire(&p_shard->lock);
+		for (prio = 0; prio < CL_DISP_PRIO_MAX; prio++)
+			count += cl_qlist_count(&p_shard->fifo[prio]);
+		cl_spinlock_release(&p_shard->lock);
+	}
+	*p_num_queued_msgs = count;
+}
+
+void cl_disp_get_reg_stats(IN const cl_disp_reg_handle_t handle,
+			   OUT cl_disp_reg_stats_t * p_stats)
+{
+	CL_ASSERT(p_stats);
+
+	p_stats->num_queued = handle->num_queued;
+	p_stats->num_msgs = handle->num_msgs;
+	p_stats->last_queue_time_us = handle->last_queue_time_us;
+	p_stats->max_queue_time_us = handle->max_queue_time_us;
 }
@@ -44,38 +44,281 @@
 
 #define CL_DBG(fmt, ...)
 
-static cl_status_t __event_will_age_before(IN const cl_list_item_t *
-					   const p_list_item, IN void *context)
+#define CL_EVENT_WHEEL_SLOT_MASK	(CL_EVENT_WHEEL_SLOTS - 1)
+#define CL_EVENT_WHEEL_MAX_DELTA \
+	((1ULL << (CL_EVENT_WHEEL_LEVEL_BITS * CL_EVENT_WHEEL_LEVELS)) - 1)
+
+static inline uint32_t __key_hash(IN uint64_t key, IN uint32_t hash_size)
+{
+	return (uint32_t) ((key * 0x9E3779B97F4A7C15ULL) >> 32) &
+	    (hash_size - 1);
+}
+
+static cl_event_wheel_reg_info_t *__event_find(IN const cl_event_wheel_t *
+					       p_event_wheel, IN uint64_t key)
 {
-	uint64_t aging_time = *((uint64_t *) context);
 	cl_event_wheel_reg_info_t *p_event;
 
-	p_event =
-	    PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t, list_item);
+	p_event = p_event_wheel->hash[__key_hash(key, p_event_wheel->hash_size)];
+	while (p_event && p_event->key != key)
+		p_event = p_event->p_hash_next;
+	return p_event;
+}
+
+static void __event_hash_remove(IN cl_event_wheel_t * p_event_wheel,
+				IN cl_event_wheel_reg_info_t * p_event)
+{
+	cl_event_wheel_reg_info_t **pp_event;
+
+	pp_event = &p_event_wheel->hash[__key_hash(p_event->key,
+						   p_event_wheel->hash_size)];
+	while (*pp_event != p_event)
+		pp_event = &(*pp_event)->p_hash_next;
+	*pp_event = p_event->p_hash_next;
+	p_event_wheel->count--;
+}
 
-	if (p_event->aging_time < aging_time)
-		return CL_SUCCESS;
-	else
-		return CL_NOT_FOUND;
+static void __event_hash_insert(IN cl_event_wheel_t * p_event_wheel,
+				IN cl_event_wheel_reg_info_t * p_event)
+{
+	cl_event_wheel_reg_info_t **new_hash, *p_next, *p;
+	uint32_t i, h, new_size;
+
+	/* grow the table - a failure to do so only costs longer chains */
+	if (p_event_wheel->count >= p_event_wheel->hash_size) {
+		new_size = p_event_wheel->hash_size * 2;
+		new_hash = calloc(new_size, sizeof(*new_hash));
+		if (new_hash) {
+			for (i = 0; i < p_event_wheel->hash_size; i++) {
+				p_next = p_event_wheel->hash[i];
+				while (p_next) {
+					p = p_next;
+					p_next = p->p_hash_next;
+					h = __key_hash(p->key, new_size);
+					p->p_hash_next = new_hash[h];
+					new_hash[h] = p;
+				}
+			}
+			free(p_event_wheel->hash);
+			p_event_wheel->hash = new_hash;
+			p_event_wheel->hash_size = new_size;
+		}
+	}
+
+	h = __key_hash(p_event->key, p_event_wheel->hash_size);
+	p_event->p_hash_next = p_event_wheel->hash[h];
+	p_event_wheel->hash[h] = p_event;
+	p_event_wheel->count++;
+}
+
+static inline uint32_t __slot_level(IN const cl_event_wheel_t * p_event_wheel,
+				    IN const cl_qlist_t * p_slot)
+{
+	return (uint32_t) (p_slot - &p_event_wheel->slots[0][0]) /
+	    CL_EVENT_WHEEL_SLOTS;
+}
+
+static inline uint64_t __time_to_tick(IN uint64_t time_usec)
+{
+	/* round up so an event never ages before its time */
+	return (time_usec + CL_EVENT_WHEEL_TICK_USEC - 1) /
+	    CL_EVENT_WHEEL_TICK_USEC;
+}
+
+static void __event_slot_remove(IN cl_event_wheel_t * p_event_wheel,
+				IN cl_event_wheel_reg_info_t * p_event)
+{
+	p_event_wheel->level_count[__slot_level(p_event_wheel,
+						p_event->p_slot)]--;
+	cl_qlist_remove_item(p_event->p_slot, &p_event->list_item);
+	p_event->p_slot = NULL;
+}
+
+/*
+ * Put the event into the wheel slot matching its aging time, relative
+ * to cur_tick.  Events already due go into the cur_tick slot, events
+ * beyond the wheel span go into the last slot of the top level and are
+ * cascaded again when reached.  Returns the tick at which the wheel
+ * needs to run for the event: its own tick in level 0, or the cascade
+ * of its slot in the higher levels.
+ */
+static uint64_t __event_slot_insert(IN cl_event_wheel_t * p_event_wheel,
+				    IN cl_event_wheel_reg_info_t * p_event)
+{
+	uint64_t tick = __time_to_tick(p_event->aging_time);
+	uint64_t delta;
+	uint32_t level;
+
+	if (tick < p_event_wheel->cur_tick)
+		tick = p_event_wheel->cur_tick;
+	delta = tick - p_event_wheel->cur_tick;
+	if (delta > CL_EVENT_WHEEL_MAX_DELTA) {
+		delta = CL_EVENT_WHEEL_MAX_DELTA;
+		tick = p_event_wheel->cur_tick + delta;
+	}
+
+	for (level = 0; level < CL_EVENT_WHEEL_LEVELS - 1; level++)
+		if (delta < 1ULL << (CL_EVENT_WHEEL_LEVEL_BITS * (level + 1)))
+			break;
+
+	p_event->p_slot = &p_event_wheel->slots[level]
+	    [(tick >> (CL_EVENT_WHEEL_LEVEL_BITS * level)) &
+	     CL_EVENT_WHEEL_SLOT_MASK];
+	cl_qlist_insert_tail(p_event->p_slot, &p_event->list_item);
+	p_event_wheel->level_count[level]++;
+
+	return tick >> (CL_EVENT_WHEEL_LEVEL_BITS * level) <<
+	    (CL_EVENT_WHEEL_LEVEL_BITS * level);
+}
+
+/*
+ * Redistribute the events of the current slot of the given level to
+ * the lower levels.  Returns the index of that slot.
+ */
+static uint32_t __cascade(IN cl_event_wheel_t * p_event_wheel,
+			  IN uint32_t level)
+{
+	uint32_t index = (uint32_t) (p_event_wheel->cur_tick >>
+				     (CL_EVENT_WHEEL_LEVEL_BITS * level)) &
+	    CL_EVENT_WHEEL_SLOT_MASK;
+	cl_qlist_t list;
+	cl_event_wheel_reg_info_t *p_event;
+
+	if (!p_event_wheel->level_count[level])
+		return index;
+
+	cl_qlist_init(&list);
+	cl_qlist_insert_list_tail(&list, &p_event_wheel->slots[level][index]);
+	p_event_wheel->level_count[level] -= (uint32_t) cl_qlist_count(&list);
+
+	while (!cl_is_qlist_empty(&list)) {
+		p_event = PARENT_STRUCT(cl_qlist_remove_head(&list),
+					cl_event_wheel_reg_info_t, list_item);
+		__event_slot_insert(p_event_wheel, p_event);
+	}
+
+	return index;
+}
+
+/*
+ * Round the tick up to the next cascade boundary of the level.
+ */
+static inline uint64_t __level_boundary(IN uint64_t tick, IN uint32_t level)
+{
+	uint32_t shift = CL_EVENT_WHEEL_LEVEL_BITS * level;
+
+	return ((tick + (1ULL << shift) - 1) >> shift) << shift;
+}
+
+/*
+ * Skip cur_tick over ticks that cannot hold events: when the lowest
+ * levels are empty nothing can happen before the next boundary of the
+ * first non empty level.
+ */
+static void __skip_empty(IN cl_event_wheel_t * p_event_wheel,
+			 IN uint64_t limit)
+{
+	uint32_t level = 0;
+	uint64_t next;
+
+	while (level < CL_EVENT_WHEEL_LEVELS &&
+	       !p_event_wheel->level_count[level])
+		level++;
+	if (level == 0)
+		return;
+
+	if (level == CL_EVENT_WHEEL_LEVELS)
+		next = limit;
+	else {
+		next = __level_boundary(p_event_wheel->cur_tick, level);
+		if (next > limit)
+			next = limit;
+	}
+	if (next > p_event_wheel->cur_tick)
+		p_event_wheel->cur_tick = next;
+}
+
+/*
+ * Returns the next tick at which there is work to do: the first non
+ * empty level 0 slot or the first cascade of a non empty higher level
+ * slot, whichever comes first.
+ */
+static uint64_t __next_tick(IN const cl_event_wheel_t * p_event_wheel)
+{
+	uint64_t next = (uint64_t) - 1;
+	uint64_t base, tick;
+	uint32_t level, shift, i;
+
+	for (level = 0; level < CL_EVENT_WHEEL_LEVELS; level++) {
+		if (!p_event_wheel->level_count[level])
+			continue;
+		shift = CL_EVENT_WHEEL_LEVEL_BITS * level;
+		base = __level_boundary(p_event_wheel->cur_tick, level) >> shift;
+		for (i = 0; i < CL_EVENT_WHEEL_SLOTS; i++) {
+			tick = (base + i) << shift;
+			if (tick >= next)
+				break;
+			if (!cl_is_qlist_empty(&p_event_wheel->slots[level]
+					       [(base + i) &
+						CL_EVENT_WHEEL_SLOT_MASK])) {
+				next = tick;
+				break;
+			}
+		}
+	}
+	return next;
+}
+
+/*
+ * Make sure the timer fires no later than the given tick.
+ */
+static void __arm_timer(IN cl_event_wheel_t * p_event_wheel, IN uint64_t tick,
+			IN uint64_t current_time)
+{
+	uint64_t timeout;
+	uint32_t to;
+	cl_status_t cl_status;
+
+	if (p_event_wheel->timer_tick && p_event_wheel->timer_tick <= tick)
+		return;
+
+	timeout = tick * CL_EVENT_WHEEL_TICK_USEC;
+	timeout = timeout > current_time ? (timeout - current_time + 999) /
+	    1000 : 0;
+
+	/* The timeout for the cl_timer_start should be given as uint32_t.
+	   if there is an overflow - warn about it. */
+	to = (uint32_t) timeout;
+	if (timeout > (uint32_t) timeout) {
+		to = 0xffffffff;	/* max 32 bit timer */
+		CL_DBG("cl_event_wheel: timeout requested is "
+		       "too large. Using timeout: %u\n", to);
+	}
+
+	/* Don't call cl_timer_stop() - cl_timer_start() will re-queue the
+	 * timer by itself, while cl_timer_stop() would block forever when
+	 * __cl_event_wheel_callback() is waiting on our lock. */
+	cl_status = cl_timer_start(&p_event_wheel->timer, to);
+	if (cl_status != CL_SUCCESS) {
+		CL_DBG("cl_event_wheel: ERR 6100: Failed to start timer\n");
+		return;
+	}
+	p_event_wheel->timer_tick = tick;
 }
 
 static void __cl_event_wheel_callback(IN void *context)
 {
 	cl_event_wheel_t *p_event_wheel = (cl_event_wheel_t *) context;
-	cl_list_item_t *p_list_item, *p_prev_event_list_item;
-	cl_list_item_t *p_list_next_item;
 	cl_event_wheel_reg_info_t *p_event;
-	uint64_t current_time;
+	cl_qlist_t list;
+	uint64_t current_time, now_tick;
 	uint64_t next_aging_time;
-	uint32_t new_timeout;
-	cl_status_t cl_status;
+	uint32_t index, level;
 
 	/* might be during closing ...  */
 	if (p_event_wheel->closing)
 		return;
 
-	current_time = cl_get_time_stamp();
-
 	if (NULL != p_event_wheel->p_external_lock)
 
 		/* Take care of the order of acquiring locks to avoid the deadlock!
@@ -85,101 +328,75 @@ static void __cl_event_wheel_callback(IN void *context)
 
 	cl_spinlock_acquire(&p_event_wheel->lock);
 
-	p_list_item = cl_qlist_head(&p_event_wheel->events_wheel);
-	if (p_list_item == cl_qlist_end(&p_event_wheel->events_wheel))
-		/* the list is empty - nothing to do */
-		goto Exit;
-
-	/* we found such an item.  get the p_event */
-	p_event =
-	    PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t, list_item);
-
-	while (p_event->aging_time <= current_time) {
-		/* this object has aged - invoke it's callback */
-		if (p_event->pfn_aged_callback)
-			next_aging_time =
-			    p_event->pfn_aged_callback(p_event->key,
-						       p_event->num_regs,
-						       p_event->context);
-		else
-			next_aging_time = 0;
-
-		/* point to the next object in the wheel */
-		p_list_next_item = cl_qlist_next(p_list_item);
-
-		/* We need to retire the event if the next aging time passed */
-		if (next_aging_time < current_time) {
-			/* remove it from the map */
-			cl_qmap_remove_item(&p_event_wheel->events_map,
-					    &(p_event->map_item));
-
-			/* pop p_event from the wheel */
-			cl_qlist_remove_head(&p_event_wheel->events_wheel);
-
-			/* delete the event info object - allocated by cl_event_wheel_reg */
-			free(p_event);
-		} else {
-			/* update the required aging time */
-			p_event->aging_time = next_aging_time;
-			p_event->num_regs++;
-
-			/* do not remove from the map  - but remove from the list head and
-			   place in the correct position */
-
-			/* pop p_event from the wheel */
-			cl_qlist_remove_head(&p_event_wheel->events_wheel);
-
-			/* find the event that ages just before */
-			p_prev_event_list_item =
-			    cl_qlist_find_from_tail(&p_event_wheel->
-						    events_wheel,
-						    __event_will_age_before,
-						    &p_event->aging_time);
-
-			/* insert just after */
-			cl_qlist_insert_next(&p_event_wheel->events_wheel,
-					     p_prev_event_list_item,
-					     &p_event->list_item);
-
-			/* as we have modified the list - restart from first item: */
-			p_list_next_item =
-			    cl_qlist_head(&p_event_wheel->events_wheel);
-		}
+	current_time = cl_get_time_stamp();
+	now_tick = current_time / CL_EVENT_WHEEL_TICK_USEC;
+	p_event_wheel->timer_tick = 0;
 
-		/* advance to next event */
-		p_list_item = p_list_next_item;
-		if (p_list_item == cl_qlist_end(&p_event_wheel->events_wheel))
-			/* the list is empty - nothing to do */
-			break;
+	cl_qlist_init(&list);
 
-		/* get the p_event */
-		p_event =
-		    PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t,
-				  list_item);
-	}
+	while (p_event_wheel->count && p_event_wheel->cur_tick <= now_tick) {
+		__skip_empty(p_event_wheel, now_tick + 1);
+		if (p_event_wheel->cur_tick > now_tick)
+			break;
 
-	/* We need to restart the timer only if the list is not empty now */
-	if (p_list_item != cl_qlist_end(&p_event_wheel->events_wheel)) {
-		/* get the p_event */
-		p_event =
-		    PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t,
-				  list_item);
-
-		/* start the timer to the timeout [msec] */
-		new_timeout =
-		    (uint32_t) (((p_event->aging_time - current_time) / 1000) +
-				0.5);
-		CL_DBG("__cl_event_wheel_callback: Restart timer in: "
-		       "%u [msec]\n", new_timeout);
-		cl_status = cl_timer_start(&p_event_wheel->timer, new_timeout);
-		if (cl_status != CL_SUCCESS) {
-			CL_DBG("__cl_event_wheel_callback : ERR 6100: "
-			       "Failed to start timer\n");
+		index = (uint32_t) p_event_wheel->cur_tick &
+		    CL_EVENT_WHEEL_SLOT_MASK;
+		for (level = 1; !index && level < CL_EVENT_WHEEL_LEVELS;
+		     level++)
+			index = __cascade(p_event_wheel, level);
+
+		index = (uint32_t) p_event_wheel->cur_tick &
+		    CL_EVENT_WHEEL_SLOT_MASK;
+		cl_qlist_insert_list_tail(&list,
+					  &p_event_wheel->slots[0][index]);
+		p_event_wheel->level_count[0] -=
+		    (uint32_t) cl_qlist_count(&list);
+
+		/* anything re-inserted below must not land in this slot */
+		p_event_wheel->cur_tick++;
+
+		while (!cl_is_qlist_empty(&list)) {
+			p_event = PARENT_STRUCT(cl_qlist_remove_head(&list),
+						cl_event_wheel_reg_info_t,
+						list_item);
+			p_event->p_slot = NULL;
+
+			/* parked in a far slot because of the wheel span */
+			if (p_event->aging_time > current_time) {
+				__event_slot_insert(p_event_wheel, p_event);
+				continue;
+			}
+
+			/* this object has aged - invoke it's callback */
+			if (p_event->pfn_aged_callback)
+				next_aging_time =
+				    p_event->pfn_aged_callback(p_event->key,
+							       p_event->num_regs,
+							       p_event->context);
+			else
+				next_aging_time = 0;
+
+			/* We need to retire the event if the next aging time passed */
+			if (next_aging_time < current_time) {
+				__event_hash_remove(p_event_wheel, p_event);
+				/* delete the event info object - allocated by cl_event_wheel_reg */
+				free(p_event);
+			} else {
+				/* update the required aging time */
+				p_event->aging_time = next_aging_time;
+				p_event->num_regs++;
+				__event_slot_insert(p_event_wheel, p_event);
+			}
 		}
 	}
 
-	/* release the lock */
-Exit:
+	if (p_event_wheel->count == 0)
+		p_event_wheel->cur_tick = now_tick + 1;
+	else
+		/* We need to restart the timer only if the wheel is not empty now */
+		__arm_timer(p_event_wheel, __next_tick(p_event_wheel),
+			    current_time);
+
 	cl_spinlock_release(&p_event_wheel->lock);
 	if (NULL != p_event_wheel->p_external_lock)
 		cl_spinlock_release(p_event_wheel->p_external_lock);
@@ -190,6 +407,7 @@ Exit:
  */
 void cl_event_wheel_construct(IN cl_event_wheel_t * const p_event_wheel)
 {
+	p_event_wheel->hash = NULL;
 	cl_spinlock_construct(&(p_event_wheel->lock));
 	cl_timer_construct(&(p_event_wheel->timer));
 }
@@ -197,6 +415,7 @@ void cl_event_wheel_construct(IN cl_event_wheel_t * const p_event_wheel)
 cl_status_t cl_event_wheel_init(IN cl_event_wheel_t * const p_event_wheel)
 {
 	cl_status_t cl_status = CL_SUCCESS;
+	uint32_t level, i;
 
 	/* initialize */
 	p_event_wheel->p_external_lock = NULL;
@@ -204,8 +423,22 @@ cl_status_t cl_event_wheel_init(IN cl_event_wheel_t * const p_event_wheel)
 	cl_status = cl_spinlock_init(&(p_event_wheel->lock));
 	if (cl_status != CL_SUCCESS)
 		return cl_status;
-	cl_qlist_init(&p_event_wheel->events_wheel);
-	cl_qmap_init(&p_event_wheel->events_map);
+
+	p_event_wheel->hash_size = CL_EVENT_WHEEL_MIN_HASH_SIZE;
+	p_event_wheel->hash = calloc(p_event_wheel->hash_size,
+				     sizeof(*p_event_wheel->hash));
+	if (!p_event_wheel->hash)
+		return CL_INSUFFICIENT_MEMORY;
+	p_event_wheel->count = 0;
+
+	for (level = 0; level < CL_EVENT_WHEEL_LEVELS; level++) {
+		p_event_wheel->level_count[level] = 0;
+		for (i = 0; i < CL_EVENT_WHEEL_SLOTS; i++)
+			cl_qlist_init(&p_event_wheel->slots[level][i]);
+	}
+	p_event_wheel->cur_tick = cl_get_time_stamp() /
+	    CL_EVENT_WHEEL_TICK_USEC;
+	p_event_wheel->timer_tick = 0;
 
 	/* init the timer with timeout */
 	cl_status = cl_timer_init(&p_event_wheel->timer, __cl_event_wheel_callback, p_event_wheel);	/* cb context */
@@ -228,50 +461,47 @@ cl_status_t cl_event_wheel_init_ex(IN cl_event_wheel_t * const p_event_wheel,
 
 void cl_event_wheel_dump(IN cl_event_wheel_t * const p_event_wheel)
 {
-	cl_list_item_t *p_list_item;
 	cl_event_wheel_reg_info_t __attribute__((__unused__)) *p_event;
+	uint32_t i;
 
-	p_list_item = cl_qlist_head(&p_event_wheel->events_wheel);
+	if (!p_event_wheel->hash)
+		return;
 
-	while (p_list_item != cl_qlist_end(&p_event_wheel->events_wheel)) {
-		p_event =
-		    PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t,
-				  list_item);
-		CL_DBG("cl_event_wheel_dump: Found event key:<0x%"
-		       PRIx64 ">, aging time:%" PRIu64 "\n",
-		       p_event->key, p_event->aging_time);
-		p_list_item = cl_qlist_next(p_list_item);
-	}
+	for (i = 0; i < p_event_wheel->hash_size; i++)
+		for (p_event = p_event_wheel->hash[i]; p_event;
+		     p_event = p_event->p_hash_next)
+			CL_DBG("cl_event_wheel_dump: Found event key:<0x%"
+			       PRIx64 ">, aging time:%" PRIu64 "\n",
+			       p_event->key, p_event->aging_time);
 }
 
 void cl_event_wheel_destroy(IN cl_event_wheel_t * const p_event_wheel)
 {
-	cl_list_item_t *p_list_item;
-	cl_map_item_t *p_map_item;
-	cl_event_wheel_reg_info_t *p_event;
+	cl_event_wheel_reg_info_t *p_event, *p_next;
+	uint32_t i;
 
 	/* we need to get a lock */
 	cl_spinlock_acquire(&p_event_wheel->lock);
 
 	cl_event_wheel_dump(p_event_wheel);
 
-	/* go over all the items in the list and remove them */
-	p_list_item = cl_qlist_remove_head(&p_event_wheel->events_wheel);
-	while (p_list_item != cl_qlist_end(&p_event_wheel->events_wheel)) {
-		p_event =
-		    PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t,
-				  list_item);
-
-		CL_DBG("cl_event_wheel_destroy: Found outstanding event"
-		       " key:<0x%" PRIx64 ">\n", p_event->key);
-
-		/* remove it from the map */
-		p_map_item = &(p_event->map_item);
-		cl_qmap_remove_item(&p_event_wheel->events_map, p_map_item);
-		free(p_event);	/* allocated by cl_event_wheel_reg */
-		p_list_item =
-		    cl_qlist_remove_head(&p_event_wheel->events_wheel);
+	/* go over all the registered events and remove them */
+	for (i = 0; p_event_wheel->hash && i < p_event_wheel->hash_size; i++) {
+		p_next = p_event_wheel->hash[i];
+		while (p_next) {
+			p_event = p_next;
+			p_next = p_event->p_hash_next;
+
+			CL_DBG("cl_event_wheel_destroy: Found outstanding event"
+			       " key:<0x%" PRIx64 ">\n", p_event->key);
+
+			__event_slot_remove(p_event_wheel, p_event);
+			free(p_event);	/* allocated by cl_event_wheel_reg */
+		}
 	}
+	free(p_event_wheel->hash);
+	p_event_wheel->hash = NULL;
+	p_event_wheel->count = 0;
 
 	/* destroy the timer */
 	cl_timer_destroy(&p_event_wheel->timer);
@@ -289,42 +519,39 @@ cl_status_t cl_event_wheel_reg(IN cl_event_wheel_t * const p_event_wheel,
 			       IN void *const context)
 {
 	cl_event_wheel_reg_info_t *p_event;
-	uint64_t timeout;
-	uint32_t to;
-	cl_status_t cl_status = CL_SUCCESS;
-	cl_list_item_t *prev_event_list_item;
-	cl_map_item_t *p_map_item;
+	uint64_t current_time, tick;
 
 	/* Get the lock on the manager */
 	cl_spinlock_acquire(&(p_event_wheel->lock));
 
-	cl_event_wheel_dump(p_event_wheel);
+	current_time = cl_get_time_stamp();
+
+	/* An empty wheel has nothing pending - move it to the present */
+	if (p_event_wheel->count == 0)
+		p_event_wheel->cur_tick = current_time /
+		    CL_EVENT_WHEEL_TICK_USEC;
 
 	/* Make sure such a key does not exists */
-	p_map_item = cl_qmap_get(&p_event_wheel->events_map, key);
-	if (p_map_item != cl_qmap_end(&p_event_wheel->events_map)) {
+	p_event = __event_find(p_event_wheel, key);
+	if (p_event) {
 		CL_DBG("cl_event_wheel_reg: Already exists key:0x%"
 		       PRIx64 "\n", key);
 
-		/* already there - remove it from the list as it is getting a new time */
-		p_event =
-		    PARENT_STRUCT(p_map_item, cl_event_wheel_reg_info_t,
-				  map_item);
-
-		/* remove the item from the qlist */
-		cl_qlist_remove_item(&p_event_wheel->events_wheel,
-				     &p_event->list_item);
-		/* and the qmap */
-		cl_qmap_remove_item(&p_event_wheel->events_map,
-				    &p_event->map_item);
+		/* already there - remove it from the wheel as it is getting a new time */
+		__event_slot_remove(p_event_wheel, p_event);
 	} else {
 		/* make a new one */
 		p_event = (cl_event_wheel_reg_info_t *)
 		    malloc(sizeof(cl_event_wheel_reg_info_t));
+		if (!p_event) {
+			cl_spinlock_release(&p_event_wheel->lock);
+			return CL_INSUFFICIENT_MEMORY;
+		}
+		p_event->key = key;
 		p_event->num_regs = 0;
+		__event_hash_insert(p_event_wheel, p_event);
 	}
 
-	p_event->key = key;
 	p_event->aging_time = aging_time_usec;
 	p_event->pfn_aged_callback = pfn_callback;
 	p_event->context = context;
@@ -332,92 +559,29 @@ cl_status_t cl_event_wheel_reg(IN cl_event_wheel_t * const p_event_wheel,
 
 	CL_DBG("cl_event_wheel_reg: Registering event key:0x%" PRIx64
 	       " aging in %u [msec]\n", p_event->key,
-	       (uint32_t) ((p_event->aging_time - cl_get_time_stamp()) / 1000));
+	       (uint32_t) ((p_event->aging_time - current_time) / 1000));
 
-	/* If the list is empty - need to start the timer */
-	if (cl_is_qlist_empty(&p_event_wheel->events_wheel)) {
-		/* Edward Bortnikov 03/29/2003
-		 * ++TBD Consider moving the timer manipulation behind the list manipulation.
-		 */
-
-		/* calculate the new timeout */
-		timeout =
-		    (p_event->aging_time - cl_get_time_stamp() + 500) / 1000;
-
-		/* stop the timer if it is running */
-
-		/* Edward Bortnikov 03/29/2003
-		 * Don't call cl_timer_stop() because it spins forever.
-		 * cl_timer_start() will invoke cl_timer_stop() by itself.
-		 *
-		 * The problematic scenario is when __cl_event_wheel_callback()
-		 * is in race condition with this code. It sets timer.in_timer_cb
-		 * to TRUE and then blocks on p_event_wheel->lock. Following this,
-		 * the call to cl_timer_stop() hangs. Following this, the whole system
-		 * enters into a deadlock.
-		 *
-		 * cl_timer_stop(&p_event_wheel->timer);
-		 */
+	tick = __event_slot_insert(p_event_wheel, p_event);
+	__arm_timer(p_event_wheel, tick, current_time);
 
-		/* The timeout for the cl_timer_start should be given as uint32_t.
-		   if there is an overflow - warn about it. */
-		to = (uint32_t) timeout;
-		if (timeout > (uint32_t) timeout) {
-			to = 0xffffffff;	/* max 32 bit timer */
-			CL_DBG("cl_event_wheel_reg: timeout requested is "
-			       "too large. Using timeout: %u\n", to);
-		}
-
-		/* start the timer to the timeout [msec] */
-		cl_status = cl_timer_start(&p_event_wheel->timer, to);
-		if (cl_status != CL_SUCCESS) {
-			CL_DBG("cl_event_wheel_reg : ERR 6103: "
-			       "Failed to start timer\n");
-			goto Exit;
-		}
-	}
-
-	/* insert the object to the qlist and the qmap */
-
-	/* BUT WE MUST INSERT IT IN A SORTED MANNER */
-	prev_event_list_item =
-	    cl_qlist_find_from_tail(&p_event_wheel->events_wheel,
-				    __event_will_age_before,
-				    &p_event->aging_time);
-
-	cl_qlist_insert_next(&p_event_wheel->events_wheel,
-			     prev_event_list_item, &p_event->list_item);
-
-	cl_qmap_insert(&p_event_wheel->events_map, key, &(p_event->map_item));
-
-Exit:
 	cl_spinlock_release(&p_event_wheel->lock);
 
-	return cl_status;
+	return CL_SUCCESS;
 }
 
 void cl_event_wheel_unreg(IN cl_event_wheel_t * const p_event_wheel,
 			  IN uint64_t key)
 {
 	cl_event_wheel_reg_info_t *p_event;
-	cl_map_item_t *p_map_item;
 
 	CL_DBG("cl_event_wheel_unreg: " "Removing key:0x%" PRIx64 "\n", key);
 
 	cl_spinlock_acquire(&p_event_wheel->lock);
-	p_map_item = cl_qmap_get(&p_event_wheel->events_map, key);
-	if (p_map_item != cl_qmap_end(&p_event_wheel->events_map)) {
-		/* we found such an item. */
-		p_event =
-		    PARENT_STRUCT(p_map_item, cl_event_wheel_reg_info_t,
-				  map_item);
-
-		/* remove the item from the qlist */
-		cl_qlist_remove_item(&p_event_wheel->events_wheel,
-				     &(p_event->list_item));
-		/* remove the item from the qmap */
-		cl_qmap_remove_item(&p_event_wheel->events_map,
-				    &(p_event->map_item));
+	p_event = __event_find(p_event_wheel, key);
+	if (p_event) {
+		/* we found such an item - remove it from the wheel and hash */
+		__event_slot_remove(p_event_wheel, p_event);
+		__event_hash_remove(p_event_wheel, p_event);
 
 		CL_DBG("cl_event_wheel_unreg: Removed key:0x%" PRIx64 "\n",
 		       key);
@@ -437,21 +601,16 @@ uint32_t cl_event_wheel_num_regs(IN cl_event_wheel_t * const p_event_wheel,
 {
 
 	cl_event_wheel_reg_info_t *p_event;
-	cl_map_item_t *p_map_item;
 	uint32_t num_regs = 0;
 
-	/* try to find the key in the map */
+	/* try to find the key in the hash */
 	CL_DBG("cl_event_wheel_num_regs: Looking for key:0x%" PRIx64 "\n", key);
 
 	cl_spinlock_acquire(&p_event_wheel->lock);
-	p_map_item = cl_qmap_get(&p_event_wheel->events_map, key);
-	if (p_map_item != cl_qmap_end(&p_event_wheel->events_map)) {
+	p_event = __event_find(p_event_wheel, key);
+	if (p_event)
 		/* ok so we can simply return it's num_regs */
-		p_event =
-		    PARENT_STRUCT(p_map_item, cl_event_wheel_reg_info_t,
-				  map_item);
 		num_regs = p_event->num_regs;
-	}
 
 	cl_spinlock_release(&p_event_wheel->lock);
 	return (num_regs);
@@ -459,54 +618,93 @@ uint32_t cl_event_wheel_num_regs(IN cl_event_wheel_t * const p_event_wheel,
 
 #ifdef __CL_EVENT_WHEEL_TEST__
 
+#include <stdio.h>
+#include <unistd.h>
+
 /* Dump out the complete state of the event wheel */
 void __cl_event_wheel_dump(IN cl_event_wheel_t * const p_event_wheel)
 {
 	cl_list_item_t *p_list_item;
-	cl_map_item_t *p_map_item;
 	cl_event_wheel_reg_info_t *p_event;
+	uint32_t level, i;
 
 	printf("************** Event Wheel Dump ***********************\n");
-	printf("Event Wheel List has %u items:\n",
-	       cl_qlist_count(&p_event_wheel->events_wheel));
-
-	p_list_item = cl_qlist_head(&p_event_wheel->events_wheel);
-	while (p_list_item != cl_qlist_end(&p_event_wheel->events_wheel)) {
-		p_event =
-		    PARENT_STRUCT(p_list_item, cl_event_wheel_reg_info_t,
-				  list_item);
-		printf("Event key:0x%" PRIx64 " Context:%s NumRegs:%u\n",
-		       p_event->key, (char *)p_event->context,
-		       p_event->num_regs);
-
-		/* next */
-		p_list_item = cl_qlist_next(p_list_item);
-	}
-
-	printf("Event Map has %u items:\n",
-	       cl_qmap_count(&p_event_wheel->events_map));
-
-	p_map_item = cl_qmap_head(&p_event_wheel->events_map);
-	while (p_map_item != cl_qmap_end(&p_event_wheel->events_map)) {
-		p_event =
-		    PARENT_STRUCT(p_map_item, cl_event_wheel_reg_info_t,
-				  map_item);
-		printf("Event key:0x%" PRIx64 " Context:%s NumRegs:%u\n",
-		       p_event->key, (char *)p_event->context,
-		       p_event->num_regs);
-
-		/* next */
-		p_map_item = cl_qmap_next(p_map_item);
-	}
-
+	printf("Event Wheel has %u items, current tick %" PRIu64 ":\n",
+	       p_event_wheel->count, p_event_wheel->cur_tick);
+
+	for (level = 0; level < CL_EVENT_WHEEL_LEVELS; level++)
+		for (i = 0; i < CL_EVENT_WHEEL_SLOTS; i++) {
+			p_list_item =
+			    cl_qlist_head(&p_event_wheel->slots[level][i]);
+			while (p_list_item !=
+			       cl_qlist_end(&p_event_wheel->slots[level][i])) {
+				p_event =
+				    PARENT_STRUCT(p_list_item,
+						  cl_event_wheel_reg_info_t,
+						  list_item);
+				printf("Level %u slot %u: Event key:0x%" PRIx64
+				       " Context:%s NumRegs:%u\n", level, i,
+				       p_event->key, (char *)p_event->context,
+				       p_event->num_regs);
+
+				/* next */
+				p_list_item = cl_qlist_next(p_list_item);
+			}
+		}
 }
 
 /* The callback for aging event */
 /* We assume we pass a text context */
-void __test_event_aging(uint64_t key, void *context)
+uint64_t __test_event_aging(uint64_t key, uint32_t num_regs, void *context)
 {
 	printf("*****************************************************\n");
 	printf("Aged key: 0x%" PRIx64 " Context:%s\n", key, (char *)context);
+	return 0;
+}
+
+/* Stress benchmark: a trap storm re-registering many keys */
+static uint32_t __bench_aged;
+
+uint64_t __bench_event_aging(uint64_t key, uint32_t num_regs, void *context)
+{
+	__bench_aged++;
+	return 0;
+}
+
+void __cl_event_wheel_bench(IN uint32_t num_keys, IN uint32_t rounds)
+{
+	cl_event_wheel_t event_wheel;
+	uint64_t start, now, elapsed;
+	uint32_t i, r;
+
+	cl_event_wheel_construct(&event_wheel);
+	cl_event_wheel_init(&event_wheel);
+	__bench_aged = 0;
+
+	/* register, re-register with new aging times, then unregister half */
+	start = cl_get_time_stamp();
+	for (r = 0; r < rounds; r++) {
+		now = cl_get_time_stamp();
+		for (i = 0; i < num_keys; i++)
+			cl_event_wheel_reg(&event_wheel, i,
+					   now + 1000 * (1 + (i * 7919) % 2000)
+					   + r * 100, __bench_event_aging,
+					   NULL);
+	}
+	for (i = 0; i < num_keys; i += 2)
+		cl_event_wheel_unreg(&event_wheel, i);
+	elapsed = cl_get_time_stamp() - start;
+
+	printf("%u keys x %u rounds: %" PRIu64 " usec, %.3f usec per op\n",
+	       num_keys, rounds, elapsed,
+	       (double)elapsed / ((double)num_keys * rounds + num_keys / 2));
+
+	/* let the rest age, everything must be gone within ~2 sec */
+	sleep(3);
+	printf("%u events aged, %u left registered\n", __bench_aged,
+	       event_wheel.count);
+
+	cl_event_wheel_destroy(&event_wheel);
 }
 
 int main()
@@ -514,6 +712,8 @@ int main()
 	cl_event_wheel_t event_wheel;
 	/*  uint64_t key; */
 
+	complib_init();
+
 	/* construct */
 	cl_event_wheel_construct(&event_wheel);
 
@@ -560,6 +760,9 @@ int main()
 	/* destroy */
 	cl_event_wheel_destroy(&event_wheel);
 
+	__cl_event_wheel_bench(1000, 100);
+	__cl_event_wheel_bench(100000, 10);
+
 	return (0);
 }
 
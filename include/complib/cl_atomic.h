@@ -192,5 +192,43 @@ cl_atomic_sub(IN atomic32_t * const p_value, IN const int32_t decrement);
 *	cl_atomic_xchg, cl_atomic_comp_xchg
 *********/
 
+/****f* Component Library: Atomic Operations/cl_atomic_comp_xchg
+* NAME
+*	cl_atomic_comp_xchg
+*
+* DESCRIPTION
+*	The cl_atomic_comp_xchg function atomically compares a 32-bit signed
+*	integer to a value and replaces it with a new value if they are equal.
+*
+* SYNOPSIS
+*/
+int32_t
+cl_atomic_comp_xchg(IN atomic32_t * const p_value,
+		    IN const int32_t compare, IN const int32_t new_value);
+/*
+* PARAMETERS
+*	p_value
+*		[in] Pointer to a 32-bit integer to exchange with new_value.
+*
+*	compare
+*		[in] Value to compare to the value pointed to by p_value.
+*
+*	new_value
+*		[in] Value to assign if the value pointed to by p_value is
+*		equal to compare.
+*
+* RETURN VALUE
+*	Returns the value pointed to by p_value before the exchange.  The
+*	exchange took place if it is equal to compare.
+*
+* NOTES
+*	The value pointed to by p_value is compared and, if equal to compare,
+*	replaced by new_value in one atomic operation.
+*
+* SEE ALSO
+*	Atomic Operations, cl_atomic_inc, cl_atomic_dec, cl_atomic_add,
+*	cl_atomic_sub, cl_atomic_xchg
+*********/
+
 END_C_DECLS
 #endif				/* _CL_ATOMIC_H_ */
@@ -54,6 +54,42 @@
 
 BEGIN_C_DECLS extern cl_spinlock_t cl_atomic_spinlock;
 
+#ifdef __GNUC__
+/*
+ * The compiler builtins are lock free and full barriers, the global
+ * spinlock is only used with other compilers.
+ */
+static inline int32_t cl_atomic_inc(IN atomic32_t * const p_value)
+{
+	return __sync_add_and_fetch(p_value, 1);
+}
+
+static inline int32_t cl_atomic_dec(IN atomic32_t * const p_value)
+{
+	return __sync_sub_and_fetch(p_value, 1);
+}
+
+static inline int32_t
+cl_atomic_add(IN atomic32_t * const p_value, IN const int32_t increment)
+{
+	return __sync_add_and_fetch(p_value, increment);
+}
+
+static inline int32_t
+cl_atomic_sub(IN atomic32_t * const p_value, IN const int32_t decrement)
+{
+	return __sync_sub_and_fetch(p_value, decrement);
+}
+
+static inline int32_t
+cl_atomic_comp_xchg(IN atomic32_t * const p_value,
+		    IN const int32_t compare, IN const int32_t new_value)
+{
+	return __sync_val_compare_and_swap(p_value, compare, new_value);
+}
+
+#else				/* !__GNUC__ */
+
 static inline int32_t cl_atomic_inc(IN atomic32_t * const p_value)
 {
 	int32_t new_val;
@@ -94,11 +130,26 @@ cl_atomic_sub(IN atomic32_t * const p_value, IN const int32_t decrement)
 	int32_t new_val;
 
 	cl_spinlock_acquire(&cl_atomic_spinlock);
-	new_val = *p_value + decrement;
+	new_val = *p_value - decrement;
 	*p_value = new_val;
 	cl_spinlock_release(&cl_atomic_spinlock);
 	return (new_val);
 }
 
+static inline int32_t
+cl_atomic_comp_xchg(IN atomic32_t * const p_value,
+		    IN const int32_t compare, IN const int32_t new_value)
+{
+	int32_t old_val;
+
+	cl_spinlock_acquire(&cl_atomic_spinlock);
+	old_val = *p_value;
+	if (old_val == compare)
+		*p_value = new_value;
+	cl_spinlock_release(&cl_atomic_spinlock);
+	return (old_val);
+}
+#endif				/* __GNUC__ */
+
 END_C_DECLS
 #endif				/* _CL_ATOMIC_OSD_H_ */
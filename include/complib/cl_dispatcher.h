@@ -195,6 +195,102 @@ typedef void
 *	Dispatcher, cl_disp_post
 *********/
 
+/****d* Component Library: Dispatcher/cl_disp_prio_t
+* NAME
+*	cl_disp_prio_t
+*
+* DESCRIPTION
+*	Priority class of the messages delivered to a registration.
+*	Queued messages of a higher class are always dispatched before
+*	those of a lower one.
+*
+*	Classes reorder messages posted to different registrations even
+*	with a single worker thread: a message of a lower class waits
+*	behind all queued ones of a higher class, regardless of when they
+*	were posted.  Only the messages of one registration, which share a
+*	class, keep their order, and only with a single worker thread.
+*
+* SYNOPSIS
+*/
+typedef enum _cl_disp_prio {
+	CL_DISP_PRIO_HIGH = 0,
+	CL_DISP_PRIO_NORMAL,
+	CL_DISP_PRIO_LOW,
+	CL_DISP_PRIO_MAX
+} cl_disp_prio_t;
+/**********/
+
+/****s* Component Library: Dispatcher/cl_disp_shard_t
+* NAME
+*	cl_disp_shard_t
+*
+* DESCRIPTION
+*	Run queue of the Dispatcher. There is one per worker thread;
+*	each worker is bound to its own shard with its first callback,
+*	serves it first and takes work from the others when it is empty.
+*
+*	The cl_disp_shard_t structure is for internal use by the
+*	Dispatcher only.
+*
+* SYNOPSIS
+*/
+typedef struct _cl_disp_shard {
+	cl_spinlock_t lock;
+	cl_qlist_t fifo[CL_DISP_PRIO_MAX];
+	cl_qpool_t msg_pool;
+} cl_disp_shard_t;
+/*
+* FIELDS
+*	lock
+*		Spinlock guarding the FIFOs and the message pool.
+*
+*	fifo
+*		FIFO of queued messages per priority class.
+*
+*	msg_pool
+*		Pool of message objects queued on this shard.
+*
+* SEE ALSO
+*	Dispatcher
+*********/
+
+/****s* Component Library: Dispatcher/cl_disp_reg_tbl_t
+* NAME
+*	cl_disp_reg_tbl_t
+*
+* DESCRIPTION
+*	Table of the registrations of a Dispatcher, indexed by message id.
+*
+*	Posters read the table without a lock.  A registration beyond the
+*	end of the table replaces it with a larger copy, and the old
+*	table is kept until the Dispatcher is destroyed since posters may
+*	still be reading it.
+*
+*	The cl_disp_reg_tbl_t structure is for internal use by the
+*	Dispatcher only.
+*
+* SYNOPSIS
+*/
+typedef struct _cl_disp_reg_tbl {
+	struct _cl_disp_reg_tbl *p_prev;
+	uint32_t size;
+	struct _cl_disp_reg_info **regs;
+} cl_disp_reg_tbl_t;
+/*
+* FIELDS
+*	p_prev
+*		Table replaced by this one, NULL for the first table.
+*
+*	size
+*		Number of entries in regs.
+*
+*	regs
+*		Registrations indexed by message id, NULL if none.
+*
+* SEE ALSO
+*	Dispatcher
+*********/
+
 /****s* Component Library: Dispatcher/cl_dispatcher_t
 * NAME
 *	cl_dispatcher_t
@@ -211,31 +307,53 @@ typedef void
 */
 typedef struct _cl_dispatcher {
 	cl_spinlock_t lock;
-	cl_ptr_vector_t reg_vec;
+	cl_disp_reg_tbl_t *volatile reg_tbl;
 	cl_qlist_t reg_list;
 	cl_thread_pool_t worker_threads;
-	cl_qlist_t msg_fifo;
-	cl_qpool_t msg_pool;
+	cl_disp_shard_t *shards;
+	uint32_t num_shards;
+	atomic32_t next_shard;
+	atomic32_t next_worker;
+	pthread_key_t worker_key;
+	boolean_t worker_key_created;
 	uint64_t last_msg_queue_time_us;
 } cl_dispatcher_t;
 /*
 * FIELDS
-*	reg_vec
-*		Vector of registration info objects.  Indexed by message msg_id.
+*	reg_tbl
+*		Current table of the registrations, indexed by message msg_id.
 *
 *	lock
-*		Spinlock to guard internal structures.
+*		Spinlock to serialize the changes of the registrations.
+*		Posting does not take it.
 *
-*	msg_fifo
-*		FIFO of messages being processed by the Dispatcher.  New
-*		messages are posted to the tail of the FIFO.  Worker threads
-*		pull messages from the front.
+*	reg_list
+*		All registrations.  Unregistered ones stay on the list
+*		until cl_disp_shutdown since posters may still hold them.
 *
 *	worker_threads
 *		Thread pool of worker threads to dispose of posted messages.
 *
-*	msg_pool
-*		Pool of message objects to be processed through the FIFO.
+*	shards
+*		Run queues, one per worker thread.  New messages are spread
+*		over the shards round robin.
+*
+*	num_shards
+*		Number of run queues.
+*
+*	next_shard
+*		Atomic count of the posts, picks the shard receiving the
+*		next posted message.
+*
+*	next_worker
+*		Used to pick the shard a worker thread is bound to.
+*
+*	worker_key
+*		Thread specific key holding the shard a worker thread is
+*		bound to.
+*
+*	worker_key_created
+*		Indicates whether worker_key was created.
 *
 *	reg_count
 *		Count of the number of registrants.
@@ -269,6 +387,11 @@ typedef struct _cl_disp_reg_info {
 	atomic32_t ref_cnt;
 	cl_disp_msgid_t msg_id;
 	cl_dispatcher_t *p_disp;
+	cl_disp_prio_t prio;
+	atomic32_t num_queued;
+	uint64_t num_msgs;
+	uint64_t last_queue_time_us;
+	uint64_t max_queue_time_us;
 } cl_disp_reg_info_t;
 /*
 * FIELDS
@@ -296,6 +419,21 @@ typedef struct _cl_disp_reg_info {
 *	p_disp
 *		Pointer to parent Dispatcher.
 *
+*	prio
+*		Priority class of the messages delivered to this registrant.
+*
+*	num_queued
+*		Number of messages queued for this registrant.
+*
+*	num_msgs
+*		Number of messages delivered to this registrant.
+*
+*	last_queue_time_us
+*		Time the last delivered message spent in the queue, in usec.
+*
+*	max_queue_time_us
+*		Longest time a delivered message spent in the queue, in usec.
+*
 * SEE ALSO
 *********/
 
@@ -319,6 +457,7 @@ typedef struct _cl_disp_msg {
 	cl_pfn_msgdone_cb_t pfn_xmt_callback;
 	uint64_t in_time;
 	const void *context;
+	cl_disp_shard_t *p_shard;
 } cl_disp_msg_t;
 /*
 * FIELDS
@@ -344,6 +483,9 @@ typedef struct _cl_disp_msg {
 *	context
 *		Client's message done callback context.
 *
+*	p_shard
+*		Run queue the message was queued on.
+*
 * SEE ALSO
 *********/
 
@@ -407,8 +549,10 @@ cl_disp_init(IN cl_dispatcher_t * const p_disp,
 *		A value of 0 causes the Dispatcher to create one worker thread
 *		per CPU in the system.  When the Dispatcher is created with
 *		only one thread, the Dispatcher guarantees to deliver posted
-*		messages in order.  When the Dispatcher is created with more
-*		than one thread, messages may be delivered out of order.
+*		messages of the same registration in order; see
+*		cl_disp_prio_t for messages of different classes.  When the
+*		Dispatcher is created with more than one thread, messages
+*		may be delivered out of order.
 *
 *	name
 *		[in] Name to associate with the threads.  The name may be up to 16
@@ -517,6 +661,34 @@ cl_disp_register(IN cl_dispatcher_t * const p_disp,
 *	Dispatcher, cl_disp_unregister, cl_disp_post
 *********/
 
+/****f* Component Library: Dispatcher/cl_disp_set_priority
+* NAME
+*	cl_disp_set_priority
+*
+* DESCRIPTION
+*	This function sets the priority class of the messages delivered
+*	to a registrant.
+*
+* SYNOPSIS
+*/
+void cl_disp_set_priority(IN const cl_disp_reg_handle_t handle,
+			  IN const cl_disp_prio_t prio);
+/*
+* PARAMETERS
+*	handle
+*		[in] cl_disp_reg_handle_t value return by cl_disp_register.
+*
+*	prio
+*		[in] Priority class of the messages posted to this registrant
+*		from now on.  Registrants start with CL_DISP_PRIO_NORMAL.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* SEE ALSO
+*	Dispatcher, cl_disp_register, cl_disp_prio_t
+*********/
+
 /****f* Component Library: Dispatcher/cl_disp_unregister
 * NAME
 *	cl_disp_unregister
@@ -540,6 +712,9 @@ void cl_disp_unregister(IN const cl_disp_reg_handle_t handle);
 *	the callback functions for this client.  Do not invoke this
 *	function from a callback.
 *
+*	The handle must not be used afterwards.  Its memory is released
+*	by cl_disp_shutdown.
+*
 * SEE ALSO
 *	Dispatcher, cl_disp_register
 *********/
@@ -623,9 +798,72 @@ cl_disp_get_queue_status(IN const cl_disp_reg_handle_t handle,
 * NOTES
 *	Extarnel Locking is not required.
 *
+*	For a handle registered with a message id, both values refer to
+*	the messages of that registrant only.  For a handle registered
+*	with CL_DISP_MSGID_NONE they cover the whole Dispatcher.
+*
 * SEE ALSO
 *	Dispatcher
 *********/
 
+/****s* Component Library: Dispatcher/cl_disp_reg_stats_t
+* NAME
+*	cl_disp_reg_stats_t
+*
+* DESCRIPTION
+*	Queue statistics of a registrant.
+*
+* SYNOPSIS
+*/
+typedef struct _cl_disp_reg_stats {
+	uint32_t num_queued;
+	uint64_t num_msgs;
+	uint64_t last_queue_time_us;
+	uint64_t max_queue_time_us;
+} cl_disp_reg_stats_t;
+/*
+* FIELDS
+*	num_queued
+*		Number of messages currently queued.
+*
+*	num_msgs
+*		Number of messages delivered.
+*
+*	last_queue_time_us
+*		Time the last delivered message spent in the queue, in usec.
+*
+*	max_queue_time_us
+*		Longest time a delivered message spent in the queue, in usec.
+*
+* SEE ALSO
+*	Dispatcher, cl_disp_get_reg_stats
+*********/
+
+/****f* Component Library: Dispatcher/cl_disp_get_reg_stats
+* NAME
+*	cl_disp_get_reg_stats
+*
+* DESCRIPTION
+*	This function returns the queue statistics of a registrant.
+*
+* SYNOPSIS
+*/
+void cl_disp_get_reg_stats(IN const cl_disp_reg_handle_t handle,
+			   OUT cl_disp_reg_stats_t * p_stats);
+/*
+* PARAMETERS
+*	handle
+*		[in] cl_disp_reg_handle_t value return by cl_disp_register.
+*
+*	p_stats
+*		[out] Statistics of the messages posted to this registrant.
+*
+* RETURN VALUE
+*	This function does not return a value.
+*
+* SEE ALSO
+*	Dispatcher, cl_disp_get_queue_status
+*********/
+
 END_C_DECLS
 #endif				/* !defined(_CL_DISPATCHER_H_) */
@@ -43,7 +43,6 @@
 
 #include <complib/cl_atomic.h>
 #include <complib/cl_qlist.h>
-#include <complib/cl_qmap.h>
 #include <complib/cl_timer.h>
 #include <complib/cl_spinlock.h>
 
@@ -68,6 +67,12 @@ BEGIN_C_DECLS
 *	which should be treated as opaque and should be manipulated
 *	only through the provided functions.
 *
+*	Events are kept in a hierarchical hashed timing wheel of
+*	CL_EVENT_WHEEL_LEVELS levels of CL_EVENT_WHEEL_SLOTS slots each,
+*	with a resolution of CL_EVENT_WHEEL_TICK_USEC.  Events are also
+*	hashed by key.  Registering, unregistering and aging an event
+*	take constant time regardless of the number of events.
+*
 * SEE ALSO
 *	Structures:
 *		cl_event_wheel_t
@@ -79,6 +84,11 @@ BEGIN_C_DECLS
 *		cl_event_wheel_reg, cl_event_wheel_unreg
 *
 *********/
+#define CL_EVENT_WHEEL_TICK_USEC	1000
+#define CL_EVENT_WHEEL_LEVEL_BITS	8
+#define CL_EVENT_WHEEL_SLOTS		(1 << CL_EVENT_WHEEL_LEVEL_BITS)
+#define CL_EVENT_WHEEL_LEVELS		4
+#define CL_EVENT_WHEEL_MIN_HASH_SIZE	64
 /****f* Component Library: Event_Wheel/cl_pfn_event_aged_cb_t
 * NAME
 *	cl_pfn_event_aged_cb_t
@@ -138,9 +148,14 @@ typedef struct _cl_event_wheel {
 	cl_spinlock_t lock;
 	cl_spinlock_t *p_external_lock;
 
-	cl_qmap_t events_map;
+	struct _cl_event_wheel_reg_info **hash;
+	uint32_t hash_size;
+	uint32_t count;
 	boolean_t closing;
-	cl_qlist_t events_wheel;
+	uint64_t cur_tick;
+	uint64_t timer_tick;
+	uint32_t level_count[CL_EVENT_WHEEL_LEVELS];
+	cl_qlist_t slots[CL_EVENT_WHEEL_LEVELS][CL_EVENT_WHEEL_SLOTS];
 	cl_timer_t timer;
 } cl_event_wheel_t;
 /*
@@ -152,15 +167,35 @@ typedef struct _cl_event_wheel {
 *               Reference to external spinlock to guard internal structures
 *               if the event wheel is part of a larger object protected by its own lock
 *
-*	events_map
-*		A Map holding all registered event items by their key.
+*	hash
+*		Buckets of the table holding all registered events by their
+*		key.  The table doubles when count exceeds hash_size.
+*
+*	hash_size
+*		Number of buckets in hash, a power of two.
+*
+*	count
+*		Number of registered events.
 *
 *  closing
 *     A flag indicating the event wheel is closing. This means that
 *     callbacks that are called when closing == TRUE should just be ignored.
 *
-*	events_wheel
-*		A list of the events sorted by expiration time.
+*	cur_tick
+*		The next tick to be processed.  All earlier ticks have aged.
+*
+*	timer_tick
+*		The tick at which the timer is set to expire, 0 if the timer
+*		is not running.
+*
+*	level_count
+*		Number of events in each level of the wheel.
+*
+*	slots
+*		The timing wheel.  Level 0 holds events expiring within
+*		CL_EVENT_WHEEL_SLOTS ticks of cur_tick, one slot per tick.
+*		Each higher level spans CL_EVENT_WHEEL_SLOTS times as much
+*		and is cascaded into the lower levels as cur_tick reaches it.
 *
 *	timer
 *		The timer scheduling event time propagation.
@@ -182,8 +217,9 @@ typedef struct _cl_event_wheel {
 * SYNOPSIS
 */
 typedef struct _cl_event_wheel_reg_info {
-	cl_map_item_t map_item;
 	cl_list_item_t list_item;
+	struct _cl_event_wheel_reg_info *p_hash_next;
+	cl_qlist_t *p_slot;
 	uint64_t key;
 	cl_pfn_event_aged_cb_t pfn_aged_callback;
 	uint64_t aging_time;
@@ -193,11 +229,14 @@ typedef struct _cl_event_wheel_reg_info {
 } cl_event_wheel_reg_info_t;
 /*
 * FIELDS
-*  map_item
-*     The map item of this event
-*
 *  list_item
-*     The sorted by aging time list item
+*     The item linking the event into its wheel slot
+*
+*  p_hash_next
+*     The next event in the same hash bucket
+*
+*  p_slot
+*     The wheel slot holding the event
 *
 *  key
 *     The key by which one can find the event
@@ -206,7 +245,7 @@ typedef struct _cl_event_wheel_reg_info {
 *		The clients Event-Aged callback
 *
 *  aging_time
-*     The delta time [msec] for which the event should age.
+*     The absolute time [usec] at which the event should age.
 *
 *  num_regs
 *     The number of times the same event (key) was registered
@@ -169,6 +169,30 @@ BEGIN_C_DECLS
 */
 #define OSM_DEFAULT_SCATTER_PORTS 0
 /********/
+/****s* OpenSM: Base/OSM_DEFAULT_ROUTING_THREADS
+* NAME
+*	OSM_DEFAULT_ROUTING_THREADS
+*
+* DESCRIPTION
+*	Default number of threads used to build the switches' min hop
+*	tables. A value of 1 keeps the computation serial.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_ROUTING_THREADS 1
+/********/
+/****s* OpenSM: Base/OSM_DEFAULT_SA_PR_CACHE_SIZE
+* NAME
+*	OSM_DEFAULT_SA_PR_CACHE_SIZE
+*
+* DESCRIPTION
+*	Default number of entries in the SA PathRecord path parameters
+*	cache. A value of 0 disables the cache.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_SA_PR_CACHE_SIZE 65536
+/********/
 /****s* OpenSM: Base/OSM_DEFAULT_SM_PRIORITY
 * NAME
 *	OSM_DEFAULT_SM_PRIORITY
@@ -469,6 +493,40 @@ BEGIN_C_DECLS
 */
 #define OSM_DEFAULT_SMP_MAX_ON_WIRE 4
 /***********/
+/****d* OpenSM: Base/OSM_DEFAULT_VL15_THREADS
+* NAME
+*	OSM_DEFAULT_VL15_THREADS
+*
+* DESCRIPTION
+*	Specifies the default number of VL15 sender threads.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_VL15_THREADS 1
+/***********/
+/****d* OpenSM: Base/OSM_DEFAULT_MAD_POOL_MAX_FREE
+* NAME
+*	OSM_DEFAULT_MAD_POOL_MAX_FREE
+*
+* DESCRIPTION
+*	Specifies the number of free MAD wrappers kept on the shared
+*	free list of the MAD pool.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_MAD_POOL_MAX_FREE 4096
+/***********/
+/****d* OpenSM: Base/OSM_DEFAULT_TRACE_SIZE
+* NAME
+*	OSM_DEFAULT_TRACE_SIZE
+*
+* DESCRIPTION
+*	Specifies the default number of records in the MAD trace file.
+*
+* SYNOPSIS
+*/
+#define OSM_DEFAULT_TRACE_SIZE 65536
+/***********/
 /****d* OpenSM: Base/OSM_SM_DEFAULT_QP0_RCV_SIZE
 * NAME
 *	OSM_SM_DEFAULT_QP0_RCV_SIZE
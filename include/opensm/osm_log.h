@@ -47,6 +47,8 @@
 #include <syslog.h>
 #endif
 #include <complib/cl_spinlock.h>
+#include <complib/cl_event.h>
+#include <complib/cl_thread.h>
 #include <opensm/osm_base.h>
 #include <iba/ib_types.h>
 #include <stdio.h>
@@ -68,6 +70,7 @@
 BEGIN_C_DECLS
 #define LOG_ENTRY_SIZE_MAX		4096
 #define BUF_SIZE			LOG_ENTRY_SIZE_MAX
+#define OSM_LOG_ASYNC_RING_SIZE		(1 << 20)
 #define __func__ __FUNCTION__
 #define OSM_LOG_ENTER( OSM_LOG_PTR ) \
 	osm_log( OSM_LOG_PTR, OSM_LOG_FUNCS, \
@@ -121,8 +124,40 @@ typedef struct osm_log {
 	boolean_t daemon;
 	char *log_file_name;
 	char *log_prefix;
+	boolean_t async;
+	boolean_t writer_exit;
+	cl_spinlock_t ring_lock;
+	cl_event_t ring_event;
+	cl_thread_t writer;
+	char *ring;
+	uint64_t ring_head;
+	uint64_t ring_tail;
+	unsigned long dropped;
+	unsigned long dropped_reported;
 } osm_log_t;
-/*********/
+/*
+* FIELDS
+*	async
+*		Messages are queued on the ring and written by the
+*		writer thread.
+*
+*	ring_lock
+*		Protects the ring offsets and the dropped counter.
+*
+*	ring
+*		Buffer of OSM_LOG_ASYNC_RING_SIZE bytes holding the
+*		formatted messages not written yet.
+*
+*	ring_head, ring_tail
+*		Running offsets of the next byte to be queued and of the
+*		oldest queued byte.
+*
+*	dropped
+*		Number of messages dropped because the ring was full.
+*
+*	dropped_reported
+*		Value of dropped last noted in the log file.
+*********/
 
 /****f* OpenSM: Log/osm_log_construct
 * NAME
@@ -167,15 +202,7 @@ static inline void osm_log_construct(IN osm_log_t * p_log)
 *
 * SYNOPSIS
 */
-static inline void osm_log_destroy(IN osm_log_t * p_log)
-{
-	cl_spinlock_destroy(&p_log->lock);
-	if (p_log->out_port != stdout) {
-		fclose(p_log->out_port);
-		p_log->out_port = stdout;
-	}
-	closelog();
-}
+void osm_log_destroy(IN osm_log_t * p_log);
 
 /*
 * PARAMETERS
@@ -259,6 +286,52 @@ int osm_log_reopen_file(osm_log_t * p_log);
 *	0 on success or nonzero value otherwise.
 *********/
 
+/****f* OpenSM: Log/osm_log_start_async
+* NAME
+*	osm_log_start_async
+*
+* DESCRIPTION
+*	Switches the log to asynchronous mode: logging threads queue
+*	formatted messages on a ring and a writer thread writes them
+*	to the log file in batches. Messages that do not fit on the
+*	ring are dropped and counted.
+*
+* SYNOPSIS
+*/
+ib_api_status_t osm_log_start_async(IN osm_log_t * p_log);
+/*
+* PARAMETERS
+*	p_log
+*		[in] Pointer to an initialized log object.
+*
+* RETURN VALUES
+*	IB_SUCCESS if the writer thread was started.
+*
+* SEE ALSO
+*	osm_log_stop_async
+*********/
+
+/****f* OpenSM: Log/osm_log_stop_async
+* NAME
+*	osm_log_stop_async
+*
+* DESCRIPTION
+*	Writes out all queued messages, stops the writer thread and
+*	returns the log to synchronous mode. Does nothing if the log
+*	is not in asynchronous mode.
+*
+* SYNOPSIS
+*/
+void osm_log_stop_async(IN osm_log_t * p_log);
+/*
+* PARAMETERS
+*	p_log
+*		[in] Pointer to the log object.
+*
+* SEE ALSO
+*	osm_log_start_async
+*********/
+
 /****f* OpenSM: Log/osm_log_init
 * NAME
 *	osm_log_init
@@ -43,8 +43,11 @@
 #ifndef _OSM_MAD_POOL_H_
 #define _OSM_MAD_POOL_H_
 
+#include <pthread.h>
 #include <iba/ib_types.h>
 #include <complib/cl_atomic.h>
+#include <complib/cl_qlist.h>
+#include <complib/cl_spinlock.h>
 #include <opensm/osm_base.h>
 #include <opensm/osm_madw.h>
 #include <vendor/osm_vendor.h>
@@ -69,6 +72,11 @@ BEGIN_C_DECLS
 *
 *	The MAD Pool is thread safe.
 *
+*	Released MAD wrappers are kept for reuse. Each thread has its
+*	own cache of free wrappers which is refilled from, and spilled
+*	to, a shared list in batches, so most gets and puts do not
+*	take any lock.
+*
 *	This object should be treated as opaque and should be
 *	manipulated only through the provided functions.
 *
@@ -90,12 +98,45 @@ BEGIN_C_DECLS
 */
 typedef struct osm_mad_pool {
 	atomic32_t mads_out;
+	atomic32_t hits;
+	atomic32_t misses;
+	uint32_t max_free;
+	cl_spinlock_t lock;
+	cl_qlist_t free_list;
+	cl_qlist_t caches;
+	pthread_key_t cache_key;
+	boolean_t key_created;
 } osm_mad_pool_t;
 /*
 * FIELDS
 *	mads_out
 *		Running total of the number of MADs outstanding.
 *
+*	hits
+*		Number of wrappers handed out from the free caches.
+*
+*	misses
+*		Number of wrappers that had to be allocated.
+*
+*	max_free
+*		High-water mark of the shared free list. Wrappers spilled
+*		beyond it are freed.
+*
+*	lock
+*		Protects free_list and caches.
+*
+*	free_list
+*		Shared list of free wrappers.
+*
+*	caches
+*		List of the per-thread caches.
+*
+*	cache_key
+*		Thread specific key of the per-thread cache.
+*
+*	key_created
+*		Indicates cache_key was created.
+*
 * SEE ALSO
 *	MAD Pool
 *********/
@@ -335,6 +376,52 @@ osm_madw_t *osm_mad_pool_get_wrapper_raw(IN osm_mad_pool_t * p_pool);
 *	MAD Pool, osm_mad_pool_put
 *********/
 
+/****f* OpenSM: MAD Pool/osm_mad_pool_get_hits
+* NAME
+*	osm_mad_pool_get_hits
+*
+* DESCRIPTION
+*	Returns the number of MAD wrappers reused from the pool.
+*
+* SYNOPSIS
+*/
+static inline uint32_t
+osm_mad_pool_get_hits(IN const osm_mad_pool_t * p_pool)
+{
+	return p_pool->hits;
+}
+/*
+* PARAMETERS
+*	p_pool
+*		[in] Pointer to an osm_mad_pool_t object.
+*
+* SEE ALSO
+*	MAD Pool, osm_mad_pool_get_misses
+*********/
+
+/****f* OpenSM: MAD Pool/osm_mad_pool_get_misses
+* NAME
+*	osm_mad_pool_get_misses
+*
+* DESCRIPTION
+*	Returns the number of MAD wrappers the pool had to allocate.
+*
+* SYNOPSIS
+*/
+static inline uint32_t
+osm_mad_pool_get_misses(IN const osm_mad_pool_t * p_pool)
+{
+	return p_pool->misses;
+}
+/*
+* PARAMETERS
+*	p_pool
+*		[in] Pointer to an osm_mad_pool_t object.
+*
+* SEE ALSO
+*	MAD Pool, osm_mad_pool_get_hits
+*********/
+
 /****f* OpenSM: MAD Pool/osm_mad_pool_get_outstanding
 * NAME
 *	osm_mad_pool_get_count
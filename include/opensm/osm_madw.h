@@ -439,6 +439,7 @@ typedef struct osm_madw {
 	cl_disp_msgid_t fail_msg;
 	boolean_t resp_expected;
 	const ib_mad_t *p_mad;
+	uint64_t send_time;
 } osm_madw_t;
 /*
 * FIELDS
@@ -483,6 +484,10 @@ typedef struct osm_madw {
 *		wrapper, since wire MADs typically reside in special memory
 *		registered with the local HCA.
 *
+*	send_time
+*		Time stamp in usec at which the VL15 interface handed the
+*		MAD to the vendor layer.
+*
 * SEE ALSO
 *********/
 
@@ -60,6 +60,7 @@
 #include <opensm/osm_subnet.h>
 #include <opensm/osm_mad_pool.h>
 #include <opensm/osm_vl15intf.h>
+#include <opensm/osm_trace.h>
 
 #ifdef __cplusplus
 #  define BEGIN_C_DECLS extern "C" {
@@ -207,6 +208,7 @@ typedef struct osm_opensm {
 	osm_vendor_t *p_vendor;
 	osm_vl15_t vl15;
 	osm_log_t log;
+	osm_trace_t trace;
 	cl_dispatcher_t disp;
 	cl_plock_t lock;
 	struct osm_routing_engine *routing_engine_list;
@@ -248,6 +250,10 @@ typedef struct osm_opensm {
 *	log
 *		Log facility used by all OpenSM components.
 *
+*	trace
+*		Binary MAD trace used by the VL15 interface and the
+*		SM and SA MAD controllers.
+*
 *	disp
 *		Central dispatcher containing the OpenSM worker threads.
 *
@@ -46,6 +46,8 @@
 #include <complib/cl_passivelock.h>
 #include <complib/cl_event.h>
 #include <complib/cl_timer.h>
+#include <complib/cl_event_wheel.h>
+#include <complib/cl_thread.h>
 #include <opensm/osm_subnet.h>
 #include <opensm/osm_log.h>
 #include <opensm/osm_perfmgr_db.h>
@@ -75,6 +77,9 @@ extern "C" {
 #define OSM_PERFMGR_DEFAULT_SWEEP_TIME_S 180
 #define OSM_PERFMGR_DEFAULT_DUMP_FILE "opensm_port_counters.log"
 #define OSM_PERFMGR_DEFAULT_MAX_OUTSTANDING_QUERIES 500
+#define OSM_PERFMGR_DEFAULT_ALL_PORT_FULL_SWEEPS 10
+#define OSM_PERFMGR_DEFAULT_HISTORY_RETENTION_S 86400
+#define OSM_PERFMGR_DEFAULT_HISTORY_PORTS 4096
 
 /****s* OpenSM: PerfMgr/osm_perfmgr_state_t */
 typedef enum {
@@ -92,6 +97,7 @@ typedef enum {
 
 typedef struct monitored_port {
 	uint16_t pkey_ix;
+	/* LID of the port as last reported by the SM */
 	ib_net16_t orig_lid;
 	boolean_t redirection;
 	boolean_t valid;
@@ -105,15 +111,27 @@ typedef struct monitored_port {
 	ib_net16_t cap_mask;
 } monitored_port_t;
 
+struct osm_perfmgr;
+
 /* Node to store information about nodes being monitored */
 typedef struct monitored_node {
 	cl_map_item_t map_item;
 	struct monitored_node *next;
+	/* pacing: entry on the poll list and time of the next poll */
+	struct osm_perfmgr *pm;
+	cl_list_item_t poll_item;
+	boolean_t poll_queued;
+	uint64_t next_poll;
 	uint64_t guid;
 	uint8_t node_type;
 	boolean_t esp0;
 	char *name;
 	uint32_t num_ports;
+	/* summed error counters read with AllPortSelect */
+	boolean_t aps_valid;
+	boolean_t aps_ports_due;	/* they changed, query the ports */
+	uint16_t aps_sweeps;
+	perfmgr_db_err_reading_t aps_err;
 	monitored_port_t port[1];
 } monitored_node_t;
 
@@ -143,10 +161,29 @@ typedef struct osm_perfmgr {
 	cl_event_t sig_query;	/* will throttle our queries */
 	uint32_t max_outstanding_queries;
 	boolean_t ignore_cas;
+	boolean_t all_port_select;
+	uint16_t all_port_full_sweeps;
+	cl_plock_t lock;	/* protects monitored_map and local_pkeys */
 	cl_qmap_t monitored_map;	/* map the nodes being tracked */
-	monitored_node_t *remove_list;
 	ib_net64_t port_guid;
 	int16_t local_port;
+	ib_net16_t *local_pkeys;	/* P_Key table of the PerfMgr port */
+	uint16_t num_local_pkeys;
+	/* pacing */
+	boolean_t pacing;
+	cl_event_wheel_t poll_wheel;	/* next poll of each node */
+	cl_thread_t poll_thread;
+	cl_event_t sig_poll;
+	boolean_t poll_exit;
+	cl_spinlock_t poll_lock;	/* protects poll_list and the window */
+	cl_qlist_t poll_list;	/* nodes due for polling */
+	uint32_t window;	/* outstanding queries allowed */
+	uint32_t acked;
+	uint32_t srtt;		/* usec, scaled by 8 */
+	uint32_t rttvar;	/* usec, scaled by 4 */
+	uint32_t min_rtt;	/* usec */
+	uint32_t rtt_samples;
+	uint64_t last_backoff;
 	int rm_nodes;
 } osm_perfmgr_t;
 /*
@@ -162,6 +199,12 @@ typedef struct osm_perfmgr {
 *
 *	mad_ctrl
 *	      Mad Controller
+*
+*	pacing
+*	      When TRUE each node is polled once per sweep time by
+*	      poll_thread when its poll_wheel event ages, and at most
+*	      window queries are outstanding.  The window follows the
+*	      round trip time of the queries.
 *********/
 
 /****f* OpenSM: Creation Functions */
@@ -244,12 +287,60 @@ void osm_perfmgr_dump_counters(osm_perfmgr_t * p_perfmgr,
 			       perfmgr_db_dump_t dump_type);
 void osm_perfmgr_print_counters(osm_perfmgr_t *pm, char *nodename, FILE *fp,
 				char *port, int err_only);
+void osm_perfmgr_print_history(osm_perfmgr_t *pm, char *nodename, FILE *fp,
+			       char *port, time_t since, int summary);
 
 ib_api_status_t osm_perfmgr_bind(osm_perfmgr_t * p_perfmgr,
 				 ib_net64_t port_guid);
 
 void osm_perfmgr_process(osm_perfmgr_t * pm);
 
+/****f* OpenSM: PerfMgr/osm_perfmgr_report_port
+* NAME
+*	osm_perfmgr_report_port
+*
+* DESCRIPTION
+*	Start monitoring the node of a port or refresh the LIDs cached
+*	for it.  Called by the state manager for the ports of the subnet
+*	once their LIDs are assigned.
+*
+* SYNOPSIS
+*/
+void osm_perfmgr_report_port(osm_perfmgr_t * pm, osm_port_t * p_port);
+/*
+* PARAMETERS
+*	pm
+*		[in] Pointer to the PerfMgr object.
+*
+*	p_port
+*		[in] Pointer to the port.
+*
+* NOTES
+*	The caller must hold the OpenSM lock.
+*********/
+
+/****f* OpenSM: PerfMgr/osm_perfmgr_drop_node
+* NAME
+*	osm_perfmgr_drop_node
+*
+* DESCRIPTION
+*	Stop monitoring a node removed from the subnet by the drop manager.
+*
+* SYNOPSIS
+*/
+void osm_perfmgr_drop_node(osm_perfmgr_t * pm, osm_node_t * p_node);
+/*
+* PARAMETERS
+*	pm
+*		[in] Pointer to the PerfMgr object.
+*
+*	p_node
+*		[in] Pointer to the node being removed.
+*
+* NOTES
+*	The caller must hold the OpenSM lock.
+*********/
+
 /****f* OpenSM: PerfMgr/osm_perfmgr_init */
 ib_api_status_t osm_perfmgr_init(osm_perfmgr_t * perfmgr,
 				 struct osm_opensm *osm,
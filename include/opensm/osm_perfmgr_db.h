@@ -41,8 +41,10 @@
 #include <stdio.h>
 #include <time.h>
 #include <iba/ib_types.h>
-#include <complib/cl_qmap.h>
+#include <complib/cl_qlist.h>
+#include <complib/cl_spinlock.h>
 #include <complib/cl_passivelock.h>
+#include <opensm/osm_perfmgr_hist.h>
 
 #ifdef __cplusplus
 #  define BEGIN_C_DECLS extern "C" {
@@ -117,37 +119,98 @@ typedef enum {
 } perfmgr_db_dump_t;
 
 /** =========================================================================
- * Port counter object.
- * Store all the port counters for a single port.
+ * Counter indexes, in PortCounters order.  The error counters follow the
+ * order of perfmgr_db_err_reading_t and perfmgr_hist_err_col_t, the data
+ * counters the order of perfmgr_db_data_cnt_reading_t.
  */
-typedef struct db_port {
-	perfmgr_db_err_reading_t err_total;
-	perfmgr_db_err_reading_t err_previous;
-	perfmgr_db_data_cnt_reading_t dc_total;
-	perfmgr_db_data_cnt_reading_t dc_previous;
-	time_t last_reset;
-} db_port_t;
+typedef enum {
+	PERFMGR_DB_SYMBOL_ERR_CNT = 0,
+	PERFMGR_DB_LINK_ERR_RECOVER,
+	PERFMGR_DB_LINK_DOWNED,
+	PERFMGR_DB_RCV_ERR,
+	PERFMGR_DB_RCV_REM_PHYS_ERR,
+	PERFMGR_DB_RCV_SWITCH_RELAY_ERR,
+	PERFMGR_DB_XMIT_DISCARDS,
+	PERFMGR_DB_XMIT_CONSTRAINT_ERR,
+	PERFMGR_DB_RCV_CONSTRAINT_ERR,
+	PERFMGR_DB_LINK_INTEGRITY,
+	PERFMGR_DB_BUFFER_OVERRUN,
+	PERFMGR_DB_VL15_DROPPED,
+	PERFMGR_DB_NUM_ERR_CNTRS
+} perfmgr_db_err_cntr_t;
+
+typedef enum {
+	PERFMGR_DB_XMIT_DATA = 0,
+	PERFMGR_DB_RCV_DATA,
+	PERFMGR_DB_XMIT_PKTS,
+	PERFMGR_DB_RCV_PKTS,
+	PERFMGR_DB_UNICAST_XMIT_PKTS,
+	PERFMGR_DB_UNICAST_RCV_PKTS,
+	PERFMGR_DB_MULTICAST_XMIT_PKTS,
+	PERFMGR_DB_MULTICAST_RCV_PKTS,
+	PERFMGR_DB_NUM_DC_CNTRS
+} perfmgr_db_dc_cntr_t;
+
+/** =========================================================================
+ * Port counters of all the nodes.
+ * Each counter is stored in its own array indexed by port index; the
+ * ports of a node use the indexes first_port to first_port + num_ports - 1.
+ * Ranges of removed nodes are reused by nodes with the same number of
+ * ports.
+ */
+#define PERFMGR_DB_NO_PORT 0xFFFFFFFF
+typedef struct perfmgr_db_ports {
+	uint64_t *err_total[PERFMGR_DB_NUM_ERR_CNTRS];
+	uint64_t *err_previous[PERFMGR_DB_NUM_ERR_CNTRS];
+	uint64_t *dc_total[PERFMGR_DB_NUM_DC_CNTRS];
+	uint64_t *dc_previous[PERFMGR_DB_NUM_DC_CNTRS];
+	time_t *err_previous_time;
+	time_t *dc_previous_time;
+	time_t *last_reset;
+	int32_t *hist_slot;	/* -1 when not kept in the history */
+	uint8_t *hist_flags;
+	perfmgr_hist_sample_t *hist_sample;	/* being assembled */
+	uint32_t *next_free;	/* next free range of the same size */
+	uint32_t free_head[256];	/* first free range by size */
+	uint32_t size;
+	uint32_t used;
+} perfmgr_db_ports_t;
 
 /** =========================================================================
  * group port counters for ports into the nodes
  */
 #define NODE_NAME_SIZE (IB_NODE_DESCRIPTION_SIZE + 1)
 typedef struct db_node {
-	cl_map_item_t map_item;	/* must be first */
+	cl_list_item_t list_item;
+	cl_spinlock_t lock;
 	uint64_t node_guid;
 	boolean_t esp0;
-	db_port_t *ports;
+	uint32_t first_port;
 	uint8_t num_ports;
 	char node_name[NODE_NAME_SIZE];
 } db_node_t;
 
 /** =========================================================================
  * all nodes in the subnet.
+ *
+ * Nodes are found through an open addressed hash table of node GUIDs
+ * and kept in insertion order on node_list for dumps.
+ *
+ * lock is held shared to read or update counters, together with the
+ * lock of the node; so readings of different nodes are recorded in
+ * parallel.  It is held exclusively to add or remove nodes, which may
+ * move the index and the counter arrays, and to clear all counters.
  */
 typedef struct perfmgr_db {
-	cl_qmap_t pc_data;	/* stores type (db_node_t *) */
+	db_node_t **index;
+	uint32_t index_size;	/* power of 2 */
+	uint32_t index_used;	/* nodes and deleted entries */
+	uint32_t num_nodes;
+	cl_qlist_t node_list;
+	perfmgr_db_ports_t ports;
 	cl_plock_t lock;
 	struct osm_perfmgr *perfmgr;
+	perfmgr_hist_t hist;
 } perfmgr_db_t;
 
 /**
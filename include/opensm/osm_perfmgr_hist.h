@@ -0,0 +1,600 @@
+/*
+ * Copyright (c) 2004-2009 Voltaire, Inc. All rights reserved.
+ * Copyright (c) 2002-2006 Mellanox Technologies LTD. All rights reserved.
+ * Copyright (c) 1996-2003 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ * 	Declaration of perfmgr_hist_t.
+ *	This object represents the PerfMgr counter history file.
+ *	This object is part of the OpenSM family of objects.
+ */
+
+#ifndef _OSM_PERFMGR_HIST_H_
+#define _OSM_PERFMGR_HIST_H_
+
+#include <stdio.h>
+#include <time.h>
+#include <complib/cl_fleximap.h>
+#include <iba/ib_types.h>
+#include <opensm/osm_base.h>
+#include <opensm/osm_log.h>
+
+#ifdef __cplusplus
+#  define BEGIN_C_DECLS extern "C" {
+#  define END_C_DECLS   }
+#else				/* !__cplusplus */
+#  define BEGIN_C_DECLS
+#  define END_C_DECLS
+#endif				/* __cplusplus */
+
+BEGIN_C_DECLS
+/****h* OpenSM/PerfMgr History
+* NAME
+*	PerfMgr History
+*
+* DESCRIPTION
+*	The PerfMgr History object keeps a fixed number of samples per
+*	port in a memory mapped file.  A sample holds the counter deltas
+*	of one polling interval, so rates over any window still held in
+*	the file can be computed after the PerfMgr DB moved on.
+*
+*	The file starts with a perfmgr_hist_hdr_t, followed by one
+*	perfmgr_hist_slot_t per port slot and then by the sample block of
+*	each slot.  A sample block is stored column wise: the time stamps
+*	of all the samples of the slot, then their intervals, then each
+*	counter in turn, so a query only touches the columns it prints.
+*	Everything is stored in host byte order.
+*
+*	Slots are assigned by the PerfMgr under the PerfMgr DB lock held
+*	exclusively; samples of a port are written under the lock of its
+*	node, so different slots are written in parallel.
+*	Readers, the console and osmperfhist, do not take any lock: each
+*	slot carries a sequence count which is odd while the slot is
+*	being written, and readers retry when it changed under them.
+*
+*********/
+#define PERFMGR_HIST_MAGIC	0x484d534f	/* "OSMH" */
+#define PERFMGR_HIST_VERSION	1
+#define PERFMGR_HIST_NAME_SIZE	72
+#define PERFMGR_HIST_MAX_DEPTH	(1 << 20)
+/****d* OpenSM: PerfMgr History/perfmgr_hist_err_col_t
+* NAME
+*	perfmgr_hist_err_col_t
+*
+* DESCRIPTION
+*	Error counter columns.  Deltas are stored in 32 bits and saturate.
+*
+* SYNOPSIS
+*/
+typedef enum _perfmgr_hist_err_col {
+	PERFMGR_HIST_SYMBOL_ERR = 0,
+	PERFMGR_HIST_LINK_ERR_RECOVER,
+	PERFMGR_HIST_LINK_DOWNED,
+	PERFMGR_HIST_RCV_ERR,
+	PERFMGR_HIST_RCV_REM_PHYS_ERR,
+	PERFMGR_HIST_RCV_SWITCH_RELAY_ERR,
+	PERFMGR_HIST_XMIT_DISCARDS,
+	PERFMGR_HIST_XMIT_CONSTRAINT_ERR,
+	PERFMGR_HIST_RCV_CONSTRAINT_ERR,
+	PERFMGR_HIST_LINK_INTEGRITY,
+	PERFMGR_HIST_BUFFER_OVERRUN,
+	PERFMGR_HIST_VL15_DROPPED,
+	PERFMGR_HIST_ERR_COLS
+} perfmgr_hist_err_col_t;
+/***********/
+
+/****d* OpenSM: PerfMgr History/perfmgr_hist_data_col_t
+* NAME
+*	perfmgr_hist_data_col_t
+*
+* DESCRIPTION
+*	Data counter columns.  Deltas are stored in 64 bits; data is
+*	counted in units of 4 bytes like on the wire.
+*
+* SYNOPSIS
+*/
+typedef enum _perfmgr_hist_data_col {
+	PERFMGR_HIST_XMIT_DATA = 0,
+	PERFMGR_HIST_RCV_DATA,
+	PERFMGR_HIST_XMIT_PKTS,
+	PERFMGR_HIST_RCV_PKTS,
+	PERFMGR_HIST_DATA_COLS
+} perfmgr_hist_data_col_t;
+/***********/
+
+#define PERFMGR_HIST_SAMPLE_SIZE \
+	((2 + PERFMGR_HIST_ERR_COLS) * sizeof(uint32_t) + \
+	 PERFMGR_HIST_DATA_COLS * sizeof(uint64_t))
+
+/****s* OpenSM: PerfMgr History/perfmgr_hist_hdr_t
+* NAME
+*	perfmgr_hist_hdr_t
+*
+* DESCRIPTION
+*	Header at the start of the history file.
+*
+* SYNOPSIS
+*/
+typedef struct perfmgr_hist_hdr {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t slot_hdr_size;
+	uint32_t num_slots;
+	uint32_t depth;
+	uint64_t sample_size;
+	uint64_t create_time;
+	uint8_t reserved[32];
+} perfmgr_hist_hdr_t;
+/*
+* FIELDS
+*	magic
+*		PERFMGR_HIST_MAGIC in host byte order.
+*
+*	version
+*		PERFMGR_HIST_VERSION.
+*
+*	slot_hdr_size
+*		Size in bytes of one perfmgr_hist_slot_t.
+*
+*	num_slots
+*		Number of ports the file holds samples for.
+*
+*	depth
+*		Number of samples kept per port.
+*
+*	sample_size
+*		Size in bytes of one sample over all columns.
+*
+*	create_time
+*		Time at which the file was created.
+*
+* SEE ALSO
+*	perfmgr_hist_slot_t
+*********/
+
+/****s* OpenSM: PerfMgr History/perfmgr_hist_slot_t
+* NAME
+*	perfmgr_hist_slot_t
+*
+* DESCRIPTION
+*	Directory entry describing the port a slot holds samples for.
+*
+* SYNOPSIS
+*/
+typedef struct perfmgr_hist_slot {
+	uint64_t guid;
+	volatile uint32_t seq;
+	uint32_t count;
+	uint32_t last_time;
+	uint8_t port;
+	uint8_t reserved[3];
+	char node_name[PERFMGR_HIST_NAME_SIZE];
+} perfmgr_hist_slot_t;
+/*
+* FIELDS
+*	guid
+*		Node GUID of the port.  Zero for an unused slot.
+*
+*	seq
+*		Sequence count, odd while the slot is being updated.
+*
+*	count
+*		Number of samples written since the slot was assigned.  The
+*		next sample goes into column index count % depth.
+*
+*	last_time
+*		Time of the newest sample.  Used to pick the slot to reuse
+*		when all of them are assigned.
+*
+*	port
+*		Port number.
+*
+*	node_name
+*		Node description at the time the slot was assigned.
+*
+* SEE ALSO
+*	perfmgr_hist_hdr_t
+*********/
+
+/****s* OpenSM: PerfMgr History/perfmgr_hist_sample_t
+* NAME
+*	perfmgr_hist_sample_t
+*
+* DESCRIPTION
+*	One sample as passed to and returned by the history functions.
+*
+* SYNOPSIS
+*/
+typedef struct perfmgr_hist_sample {
+	uint32_t time;
+	uint32_t interval;
+	uint32_t err[PERFMGR_HIST_ERR_COLS];
+	uint64_t data[PERFMGR_HIST_DATA_COLS];
+} perfmgr_hist_sample_t;
+/*
+* FIELDS
+*	time
+*		Time at which the counters were read.
+*
+*	interval
+*		Seconds covered by the deltas.  Zero for the first reading
+*		of a port, which only serves as a base.
+*
+*	err
+*		Error counter deltas indexed by perfmgr_hist_err_col_t.
+*
+*	data
+*		Data counter deltas indexed by perfmgr_hist_data_col_t.
+*
+*********/
+
+/****s* OpenSM: PerfMgr History/perfmgr_hist_t
+* NAME
+*	perfmgr_hist_t
+*
+* DESCRIPTION
+*	History writer object.
+*
+* SYNOPSIS
+*/
+typedef struct perfmgr_hist_index {
+	cl_fmap_item_t map_item;
+	uint64_t guid;
+	uint8_t port;
+	boolean_t referenced;
+} perfmgr_hist_index_t;
+
+typedef struct perfmgr_hist {
+	osm_log_t *log;
+	perfmgr_hist_hdr_t *p_hdr;
+	perfmgr_hist_slot_t *slots;
+	perfmgr_hist_index_t *index_items;
+	cl_fmap_t index;
+	uint32_t next_free;
+	uint32_t clock_hand;
+	uint32_t clock_credit;
+	size_t map_size;
+	int fd;
+} perfmgr_hist_t;
+/*
+* FIELDS
+*	log
+*		Pointer to the log object.
+*
+*	p_hdr
+*		Mapped file header.  NULL while the history is disabled.
+*
+*	slots
+*		Mapped slot directory.
+*
+*	index_items
+*		One index entry per slot, keyed by node GUID and port.  Its
+*		referenced flag is set when the port is looked up or
+*		sampled and cleared when the clock hand passes the slot.
+*
+*	index
+*		Map of the assigned slots.
+*
+*	next_free
+*		First slot never assigned.
+*
+*	clock_hand
+*		Next slot the clock looks at for reuse once all slots are
+*		assigned.
+*
+*	clock_credit
+*		Number of slots the clock hand may still advance; each
+*		sample adds one, up to the number of slots.
+*
+*	map_size
+*		Size of the mapping.
+*
+*	fd
+*		Descriptor of the history file.
+*
+* SEE ALSO
+*********/
+
+/****f* OpenSM: PerfMgr History/perfmgr_hist_construct
+* NAME
+*	perfmgr_hist_construct
+*
+* DESCRIPTION
+*	Constructs a history object in the disabled state.
+*
+* SYNOPSIS
+*/
+void perfmgr_hist_construct(IN perfmgr_hist_t * p_hist);
+/*
+* PARAMETERS
+*	p_hist
+*		[in] Pointer to the history object to construct.
+*
+* SEE ALSO
+*	perfmgr_hist_init, perfmgr_hist_destroy
+*********/
+
+/****f* OpenSM: PerfMgr History/perfmgr_hist_init
+* NAME
+*	perfmgr_hist_init
+*
+* DESCRIPTION
+*	Opens or creates the history file and maps it.
+*
+* SYNOPSIS
+*/
+ib_api_status_t perfmgr_hist_init(IN perfmgr_hist_t * p_hist,
+				  IN osm_log_t * p_log,
+				  IN const char *file_name,
+				  IN uint32_t num_slots, IN uint32_t depth);
+/*
+* PARAMETERS
+*	p_hist
+*		[in] Pointer to a constructed history object.
+*
+*	p_log
+*		[in] Pointer to the log object.
+*
+*	file_name
+*		[in] Path of the history file.
+*
+*	num_slots
+*		[in] Number of ports samples are kept for.
+*
+*	depth
+*		[in] Number of samples kept per port.
+*
+* RETURN VALUES
+*	IB_SUCCESS if the history file was opened and mapped.
+*
+* NOTES
+*	An existing file with the same geometry is kept, so the history
+*	survives a restart of OpenSM.  Otherwise it is recreated.
+*	On failure the object stays disabled.
+*
+* SEE ALSO
+*	perfmgr_hist_destroy
+*********/
+
+/****f* OpenSM: PerfMgr History/perfmgr_hist_destroy
+* NAME
+*	perfmgr_hist_destroy
+*
+* DESCRIPTION
+*	Unmaps and closes the history file.  The file is left on disk.
+*
+* SYNOPSIS
+*/
+void perfmgr_hist_destroy(IN perfmgr_hist_t * p_hist);
+/*
+* PARAMETERS
+*	p_hist
+*		[in] Pointer to the history object.
+*
+* SEE ALSO
+*	perfmgr_hist_init
+*********/
+
+/****f* OpenSM: PerfMgr History/perfmgr_hist_is_active
+* NAME
+*	perfmgr_hist_is_active
+*
+* DESCRIPTION
+*	Returns TRUE if samples are being recorded.
+*
+* SYNOPSIS
+*/
+static inline boolean_t perfmgr_hist_is_active(IN const perfmgr_hist_t *
+					       p_hist)
+{
+	return p_hist->p_hdr != NULL;
+}
+/*
+* PARAMETERS
+*	p_hist
+*		[in] Pointer to the history object.
+*
+*********/
+
+/****f* OpenSM: PerfMgr History/perfmgr_hist_get_slot
+* NAME
+*	perfmgr_hist_get_slot
+*
+* DESCRIPTION
+*	Returns the slot holding the samples of a port, assigning one if
+*	the port has none yet.  When all slots are assigned, a clock hand
+*	looks at a few slots for one whose port was neither looked up nor
+*	sampled since the hand last passed it, and reuses it.  If there
+*	is none, the port is not kept.
+*
+* SYNOPSIS
+*/
+int32_t perfmgr_hist_get_slot(IN perfmgr_hist_t * p_hist, IN uint64_t guid,
+			      IN uint8_t port, IN const char *node_name);
+/*
+* PARAMETERS
+*	p_hist
+*		[in] Pointer to an active history object.
+*
+*	guid
+*		[in] Node GUID.
+*
+*	port
+*		[in] Port number.
+*
+*	node_name
+*		[in] Node description stored with a newly assigned slot.
+*
+* RETURN VALUE
+*	Slot index, or -1 if the port is not kept in the history.
+*
+* NOTES
+*	Callers serialize perfmgr_hist_get_slot against all writers of
+*	the history object.
+*
+* SEE ALSO
+*	perfmgr_hist_add
+*********/
+
+/****f* OpenSM: PerfMgr History/perfmgr_hist_add
+* NAME
+*	perfmgr_hist_add
+*
+* DESCRIPTION
+*	Appends a sample to a slot, overwriting its oldest sample once
+*	the slot is full.
+*
+* SYNOPSIS
+*/
+boolean_t perfmgr_hist_add(IN perfmgr_hist_t * p_hist, IN int32_t slot,
+			   IN uint64_t guid, IN uint8_t port,
+			   IN const perfmgr_hist_sample_t * p_sample);
+/*
+* PARAMETERS
+*	p_hist
+*		[in] Pointer to an active history object.
+*
+*	slot
+*		[in] Slot returned by perfmgr_hist_get_slot.
+*
+*	guid
+*		[in] Node GUID the slot was assigned to.
+*
+*	port
+*		[in] Port number the slot was assigned to.
+*
+*	p_sample
+*		[in] Sample to append.
+*
+* RETURN VALUE
+*	FALSE if the slot has since been reused for another port; the
+*	sample is then dropped.
+*
+* NOTES
+*	Callers serialize the writers of a slot, and perfmgr_hist_get_slot
+*	against all writers.
+*
+* SEE ALSO
+*	perfmgr_hist_get_slot
+*********/
+
+/****f* OpenSM: PerfMgr History/perfmgr_hist_check
+* NAME
+*	perfmgr_hist_check
+*
+* DESCRIPTION
+*	Checks that a mapped file is a history file this code can read.
+*
+* SYNOPSIS
+*/
+const char *perfmgr_hist_check(IN const perfmgr_hist_hdr_t * p_hdr,
+			       IN size_t size);
+/*
+* PARAMETERS
+*	p_hdr
+*		[in] Start of the mapped file.
+*
+*	size
+*		[in] Size of the mapping.
+*
+* RETURN VALUE
+*	NULL if the file can be read, otherwise the reason it cannot.
+*
+*********/
+
+/****f* OpenSM: PerfMgr History/perfmgr_hist_list
+* NAME
+*	perfmgr_hist_list
+*
+* DESCRIPTION
+*	Prints the ports the history file holds samples for.
+*
+* SYNOPSIS
+*/
+void perfmgr_hist_list(IN const perfmgr_hist_hdr_t * p_hdr, IN FILE * fp);
+/*
+* PARAMETERS
+*	p_hdr
+*		[in] Start of a checked history file mapping.
+*
+*	fp
+*		[in] Output stream.
+*
+* SEE ALSO
+*	perfmgr_hist_print
+*********/
+
+/****f* OpenSM: PerfMgr History/perfmgr_hist_print
+* NAME
+*	perfmgr_hist_print
+*
+* DESCRIPTION
+*	Prints the rates and error counts of the samples of a node taken
+*	since a given time.
+*
+* SYNOPSIS
+*/
+int perfmgr_hist_print(IN const perfmgr_hist_hdr_t * p_hdr, IN FILE * fp,
+		       IN const char *node, IN const char *port,
+		       IN time_t since, IN boolean_t summary);
+/*
+* PARAMETERS
+*	p_hdr
+*		[in] Start of a checked history file mapping.
+*
+*	fp
+*		[in] Output stream.
+*
+*	node
+*		[in] Node description or node GUID.
+*
+*	port
+*		[in] Port number, or NULL for all the ports of the node.
+*
+*	since
+*		[in] Oldest sample time to print.
+*
+*	summary
+*		[in] Print only the average rates and the error totals
+*		instead of one line per sample.
+*
+* RETURN VALUE
+*	Number of ports printed.
+*
+* SEE ALSO
+*	perfmgr_hist_list
+*********/
+
+END_C_DECLS
+#endif				/* _OSM_PERFMGR_HIST_H_ */
@@ -49,6 +49,7 @@
 #include <complib/cl_thread.h>
 #include <complib/cl_timer.h>
 #include <complib/cl_dispatcher.h>
+#include <complib/cl_spinlock.h>
 #include <opensm/osm_stats.h>
 #include <opensm/osm_subnet.h>
 #include <vendor/osm_vendor_api.h>
@@ -101,6 +102,204 @@ typedef enum _osm_sa_state {
 } osm_sa_state_t;
 /***********/
 
+/****s* OpenSM: SA/osm_sa_pr_cache_t
+* NAME
+*	osm_sa_pr_cache_t
+*
+* DESCRIPTION
+*	Cache of the path parameters which PathRecord processing gets by
+*	walking the route from a source port to a destination LID hop by
+*	hop through the switch LFTs: the minimal MTU and rate along the
+*	path and, with QoS enabled, the mask of SLs not dropped on it.
+*
+*	The cache is a direct mapped table keyed by the source port base
+*	LID and the destination LID. Entries are tagged with the epoch
+*	they were stored in; bumping the epoch (osm_sa_pr_cache_invalidate)
+*	drops all of them at once.
+*
+* SYNOPSIS
+*/
+typedef struct osm_sa_pr_cache_entry {
+	uint32_t key;
+	uint32_t epoch;
+	uint16_t sl_mask;
+	uint8_t mtu;
+	uint8_t rate;
+} osm_sa_pr_cache_entry_t;
+
+typedef struct osm_sa_pr_cache {
+	cl_spinlock_t lock;
+	uint32_t epoch;
+	uint32_t size;
+	osm_sa_pr_cache_entry_t *entries;
+} osm_sa_pr_cache_t;
+/*
+* FIELDS
+*	lock
+*		Protects the entries and the epoch.
+*
+*	epoch
+*		Current epoch, entries stored in older epochs are invalid.
+*
+*	size
+*		Number of entries (power of 2), 0 when the cache is
+*		disabled.
+*
+*	entries
+*		The cache table.
+*
+* SEE ALSO
+*	SA object, osm_sa_pr_cache_invalidate
+*********/
+
+/****s* OpenSM: SA/osm_sa_path_table_t
+* NAME
+*	osm_sa_path_table_t
+*
+* DESCRIPTION
+*	Precomputed path parameters for every (switch, destination LID)
+*	pair: the minimal MTU and rate and the number of switches from
+*	the switch's egress port towards the LID up to the destination
+*	port and, with QoS, the mask of SLs not dropped on the way.
+*
+*	Together with the source port and the first switch on the path
+*	this gives the same result as walking the route through the
+*	LFTs, so PathRecord and MultiPathRecord queries are answered
+*	without a walk.
+*
+*	The table is valid only for the PathRecord cache epoch it was
+*	built in, so it is dropped implicitly by
+*	osm_sa_pr_cache_invalidate.
+*
+* SYNOPSIS
+*/
+typedef struct osm_sa_path_table {
+	uint32_t epoch;
+	uint16_t max_lid_ho;
+	unsigned num_sw;
+	uint16_t *sw_row;
+	uint16_t *entries;
+	uint16_t *sl_masks;
+} osm_sa_path_table_t;
+/*
+* FIELDS
+*	epoch
+*		PathRecord cache epoch the table was built in.
+*
+*	max_lid_ho
+*		Maximal destination LID covered by the table.
+*
+*	num_sw
+*		Number of switches (rows) in the table.
+*
+*	sw_row
+*		Maps a switch base LID to its row + 1 (0 if none).
+*
+*	entries
+*		num_sw rows of max_lid_ho + 1 packed entries.
+*
+*	sl_masks
+*		Valid SL masks, same layout as entries. Only allocated
+*		when QoS is enabled.
+*
+* SEE ALSO
+*	SA object, osm_sa_path_table_build, osm_sa_path_table_lookup
+*********/
+
+/****s* OpenSM: SA/osm_sa_snapshot_t
+* NAME
+*	osm_sa_snapshot_t
+*
+* DESCRIPTION
+*	Immutable copy of the subnet data needed by the NodeRecord,
+*	LFTRecord and PortInfoRecord handlers: nodes, their physical
+*	ports with PortInfo and PKeys, and the switch LFTs. It is
+*	published by the state manager at the end of each heavy sweep
+*	or reroute, so these handlers need not take the SA lock and are
+*	not stalled by a sweep holding it exclusively.
+*
+*	The partition table, the QoS policy and the routing engine
+*	data are not copied, so PathRecord and the other handlers keep
+*	using the subnet under the SA lock.
+*
+*	The snapshot is reference counted: handlers take a reference
+*	with osm_sa_snapshot_get and drop it with osm_sa_snapshot_put,
+*	and a replaced snapshot is freed when its last reader is done.
+*
+* SYNOPSIS
+*/
+typedef struct osm_sa_snapshot_port {
+	ib_port_info_t port_info;
+	ib_net64_t port_guid;
+	ib_net16_t base_lid;
+	uint8_t lmc;
+	uint8_t port_num;
+	boolean_t valid;
+	uint32_t node;
+	uint32_t pkeys;
+	uint16_t num_pkeys;
+} osm_sa_snapshot_port_t;
+
+typedef struct osm_sa_snapshot_node {
+	ib_node_info_t node_info;
+	ib_node_desc_t node_desc;
+	uint32_t ports;
+	uint8_t num_ports;
+	boolean_t sp0_lmc_capable;
+} osm_sa_snapshot_node_t;
+
+typedef struct osm_sa_snapshot_switch {
+	uint32_t node;
+	uint16_t max_block;
+	uint16_t max_lid_ho;
+	size_t lft;
+} osm_sa_snapshot_switch_t;
+
+typedef struct osm_sa_snapshot {
+	atomic32_t ref_cnt;
+	uint32_t num_nodes;
+	uint32_t num_ports;
+	uint32_t num_sws;
+	uint16_t max_lid_ho;
+	osm_sa_snapshot_node_t *nodes;
+	osm_sa_snapshot_port_t *ports;
+	osm_sa_snapshot_switch_t *sws;
+	uint32_t *lids;
+	ib_net16_t *pkeys;
+	uint8_t *lfts;
+} osm_sa_snapshot_t;
+/*
+* FIELDS
+*	ref_cnt
+*		Number of references, including the one of the SA while
+*		the snapshot is the published one.
+*
+*	nodes
+*		Nodes in node GUID table order. Physical ports
+*		ports .. ports + num_ports - 1 of the ports array are
+*		those of the node, indexed by port number.
+*
+*	nodes[].sp0_lmc_capable
+*		Whether LMC applies to port 0 of a switch node, as
+*		returned by osm_switch_sp0_is_lmc_capable.
+*
+*	ports
+*		Physical ports, with the index of their node. Entries
+*		of missing ports are not valid. The port PKeys are pkeys .. pkeys + num_pkeys - 1 of the
+*		pkeys array, sorted by PKey base.
+*
+*	sws
+*		Switches in switch GUID table order, with the index of
+*		their node and the offset of their LFT in lfts.
+*
+*	lids
+*		Maps a LID up to max_lid_ho to its physical port index
+*		+ 1 (0 if the LID is not assigned).
+*
+* SEE ALSO
+*	SA object, osm_sa_snapshot_publish, osm_sa_snapshot_get
+*********/
+
 /****s* OpenSM: SM/osm_sa_t
 * NAME
 *	osm_sa_t
@@ -146,6 +345,10 @@ typedef struct osm_sa {
 	cl_disp_reg_handle_t lft_disp_h;
 	cl_disp_reg_handle_t sir_disp_h;
 	cl_disp_reg_handle_t mft_disp_h;
+	osm_sa_pr_cache_t pr_cache;
+	osm_sa_path_table_t *path_table;
+	cl_spinlock_t snapshot_lock;
+	osm_sa_snapshot_t *snapshot;
 } osm_sa_t;
 /*
 * FIELDS
@@ -183,6 +386,18 @@ typedef struct osm_sa {
 *		A flag that denotes that SA DB is dirty and needs
 *		to be written to the dump file (if dumping is enabled)
 *
+*	pr_cache
+*		PathRecord path parameters cache
+*
+*	path_table
+*		Precomputed path parameters table (NULL if not built)
+*
+*	snapshot_lock
+*		Protects the snapshot pointer
+*
+*	snapshot
+*		Published subnet snapshot (NULL if none)
+*
 * SEE ALSO
 *	SM object
 *********/
@@ -280,6 +495,7 @@ ib_api_status_t osm_sa_init(IN osm_sm_t * p_sm, IN osm_sa_t * p_sa,
 			    IN osm_subn_t * p_subn, IN osm_vendor_t * p_vendor,
 			    IN osm_mad_pool_t * p_mad_pool,
 			    IN osm_log_t * p_log, IN osm_stats_t * p_stats,
+			    IN osm_trace_t * p_trace,
 			    IN cl_dispatcher_t * p_disp,
 			    IN cl_plock_t * p_lock);
 /*
@@ -302,6 +518,9 @@ ib_api_status_t osm_sa_init(IN osm_sm_t * p_sm, IN osm_sa_t * p_sa,
 *	p_stats
 *		[in] Pointer to the statistics object.
 *
+*	p_trace
+*		[in] Pointer to the MAD trace object.
+*
 *	p_disp
 *		[in] Pointer to the OpenSM central Dispatcher.
 *
@@ -318,6 +537,270 @@ ib_api_status_t osm_sa_init(IN osm_sm_t * p_sm, IN osm_sa_t * p_sa,
 *	SA object, osm_sa_construct, osm_sa_destroy
 *********/
 
+/****f* OpenSM: SA/osm_sa_pr_cache_invalidate
+* NAME
+*	osm_sa_pr_cache_invalidate
+*
+* DESCRIPTION
+*	Invalidates all the cached PathRecord path parameters and the
+*	precomputed path table until it is rebuilt. Should be called whenever routing, port attributes or SL2VL
+*	tables may have changed (i.e. when a reroute or heavy sweep
+*	completes).
+*
+* SYNOPSIS
+*/
+void osm_sa_pr_cache_invalidate(IN osm_sa_t * p_sa);
+/*
+* PARAMETERS
+*	p_sa
+*		[in] Pointer to an osm_sa_t object.
+*
+* RETURN VALUES
+*	None
+*
+* SEE ALSO
+*	osm_sa_pr_cache_t, osm_sa_path_table_build
+*********/
+
+/****f* OpenSM: SA/osm_sa_path_table_build
+* NAME
+*	osm_sa_path_table_build
+*
+* DESCRIPTION
+*	(Re)builds the precomputed path parameters table from the
+*	current LFTs, port attributes and SL2VL tables. Does nothing
+*	but drop the current table when sa_path_table is disabled.
+*
+* SYNOPSIS
+*/
+void osm_sa_path_table_build(IN osm_sa_t * p_sa);
+/*
+* PARAMETERS
+*	p_sa
+*		[in] Pointer to an osm_sa_t object.
+*
+* RETURN VALUES
+*	None
+*
+* NOTES
+*	Should be called when routing and QoS setup are complete.
+*	Takes the SA lock.
+*
+* SEE ALSO
+*	osm_sa_path_table_t, osm_sa_path_table_lookup
+*********/
+
+/****f* OpenSM: SA/osm_sa_path_table_destroy
+* NAME
+*	osm_sa_path_table_destroy
+*
+* DESCRIPTION
+*	Frees the precomputed path parameters table.
+*
+* SYNOPSIS
+*/
+void osm_sa_path_table_destroy(IN osm_sa_t * p_sa);
+/*
+* PARAMETERS
+*	p_sa
+*		[in] Pointer to an osm_sa_t object.
+*
+* RETURN VALUES
+*	None
+*
+* SEE ALSO
+*	osm_sa_path_table_build
+*********/
+
+/****f* OpenSM: SA/osm_sa_path_table_lookup
+* NAME
+*	osm_sa_path_table_lookup
+*
+* DESCRIPTION
+*	Looks up the path parameters from a source port to a
+*	destination LID in the precomputed path table.
+*
+* SYNOPSIS
+*/
+boolean_t osm_sa_path_table_lookup(IN osm_sa_t * p_sa,
+				   IN const osm_port_t * p_src_port,
+				   IN const osm_physp_t * p_dest_physp,
+				   IN uint16_t dest_lid_ho,
+				   OUT uint8_t * p_mtu, OUT uint8_t * p_rate,
+				   OUT uint16_t * p_sl_mask,
+				   OUT int *p_hops);
+/*
+* PARAMETERS
+*	p_sa
+*		[in] Pointer to an osm_sa_t object.
+*
+*	p_src_port
+*		[in] Source port.
+*
+*	p_dest_physp
+*		[in] Destination physical port (port 0 for switches).
+*
+*	dest_lid_ho
+*		[in] Destination LID in host order.
+*
+*	p_mtu, p_rate
+*		[out] Minimal MTU and rate on the path.
+*
+*	p_sl_mask
+*		[out] Mask of SLs not dropped on the path (all SLs set
+*		when QoS is disabled).
+*
+*	p_hops
+*		[out] Number of switches traversed after the source node,
+*		may be NULL.
+*
+* RETURN VALUES
+*	TRUE if the table has a valid entry for the path, FALSE when the
+*	route has to be walked instead (no or stale table, path not
+*	covered, routing errors).
+*
+* NOTES
+*	The caller must hold the SA lock.
+*
+* SEE ALSO
+*	osm_sa_path_table_t, osm_sa_path_table_build
+*********/
+
+/****f* OpenSM: SA/osm_sa_snapshot_publish
+* NAME
+*	osm_sa_snapshot_publish
+*
+* DESCRIPTION
+*	Takes a new snapshot of the subnet and makes it the one returned
+*	by osm_sa_snapshot_get. When sa_snapshot is disabled, only drops
+*	the current snapshot.
+*
+* SYNOPSIS
+*/
+void osm_sa_snapshot_publish(IN osm_sa_t * p_sa);
+/*
+* PARAMETERS
+*	p_sa
+*		[in] Pointer to an osm_sa_t object.
+*
+* RETURN VALUES
+*	None
+*
+* NOTES
+*	Takes the SA lock shared while copying the subnet.
+*
+* SEE ALSO
+*	osm_sa_snapshot_t, osm_sa_snapshot_get, osm_sa_snapshot_put
+*********/
+
+/****f* OpenSM: SA/osm_sa_snapshot_get
+* NAME
+*	osm_sa_snapshot_get
+*
+* DESCRIPTION
+*	Returns a reference to the current subnet snapshot.
+*
+* SYNOPSIS
+*/
+osm_sa_snapshot_t *osm_sa_snapshot_get(IN osm_sa_t * p_sa);
+/*
+* PARAMETERS
+*	p_sa
+*		[in] Pointer to an osm_sa_t object.
+*
+* RETURN VALUES
+*	The snapshot, or NULL if none is published. A returned snapshot
+*	must be released with osm_sa_snapshot_put.
+*
+* SEE ALSO
+*	osm_sa_snapshot_t, osm_sa_snapshot_put
+*********/
+
+/****f* OpenSM: SA/osm_sa_snapshot_put
+* NAME
+*	osm_sa_snapshot_put
+*
+* DESCRIPTION
+*	Releases a reference to a subnet snapshot, freeing it when it
+*	was the last one.
+*
+* SYNOPSIS
+*/
+void osm_sa_snapshot_put(IN osm_sa_snapshot_t * p_snap);
+/*
+* PARAMETERS
+*	p_snap
+*		[in] Snapshot returned by osm_sa_snapshot_get.
+*
+* RETURN VALUES
+*	None
+*
+* SEE ALSO
+*	osm_sa_snapshot_t, osm_sa_snapshot_get
+*********/
+
+/****f* OpenSM: SA/osm_sa_snapshot_get_port_by_lid
+* NAME
+*	osm_sa_snapshot_get_port_by_lid
+*
+* DESCRIPTION
+*	Returns the physical port a LID is assigned to in the snapshot.
+*
+* SYNOPSIS
+*/
+static inline const osm_sa_snapshot_port_t *
+osm_sa_snapshot_get_port_by_lid(IN const osm_sa_snapshot_t * p_snap,
+				IN ib_net16_t lid)
+{
+	uint16_t lid_ho = cl_ntoh16(lid);
+
+	if (!lid_ho || lid_ho > p_snap->max_lid_ho || !p_snap->lids[lid_ho])
+		return NULL;
+	return &p_snap->ports[p_snap->lids[lid_ho] - 1];
+}
+/*
+* PARAMETERS
+*	p_snap
+*		[in] Pointer to a snapshot.
+*
+*	lid
+*		[in] LID in network order.
+*
+* RETURN VALUES
+*	The physical port, or NULL if the LID is not assigned.
+*
+* SEE ALSO
+*	osm_sa_snapshot_t
+*********/
+
+/****f* OpenSM: SA/osm_sa_snapshot_share_pkey
+* NAME
+*	osm_sa_snapshot_share_pkey
+*
+* DESCRIPTION
+*	Snapshot counterpart of osm_physp_share_pkey: checks whether two
+*	physical ports of a snapshot share a PKey.
+*
+* SYNOPSIS
+*/
+boolean_t osm_sa_snapshot_share_pkey(IN const osm_sa_snapshot_t * p_snap,
+				     IN const osm_sa_snapshot_port_t * p_port1,
+				     IN const osm_sa_snapshot_port_t * p_port2);
+/*
+* PARAMETERS
+*	p_snap
+*		[in] Pointer to a snapshot.
+*
+*	p_port1, p_port2
+*		[in] Physical ports of the snapshot.
+*
+* RETURN VALUES
+*	TRUE if the ports share a PKey (or either has no PKey table).
+*
+* SEE ALSO
+*	osm_sa_snapshot_t, osm_physp_share_pkey
+*********/
+
 /****f* OpenSM: SA/osm_sa_bind
 * NAME
 *	osm_sa_bind
@@ -419,6 +902,126 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 *	SA object
 *********/
 
+/****s* OpenSM: SA/osm_sa_recs_t
+* NAME
+*	osm_sa_recs_t
+*
+* DESCRIPTION
+*	Growable contiguous array of SA records collected by a query
+*	handler. Records are appended in place and copied into the
+*	response MAD with a single memcpy by osm_sa_respond_recs.
+*
+* SYNOPSIS
+*/
+typedef struct osm_sa_recs {
+	uint8_t *buf;
+	size_t attr_size;
+	unsigned num_rec;
+	unsigned max_rec;
+} osm_sa_recs_t;
+/*
+* FIELDS
+*	buf
+*		Record storage, max_rec * attr_size bytes.
+*
+*	attr_size
+*		Size of a single SA attribute.
+*
+*	num_rec
+*		Number of records added so far.
+*
+*	max_rec
+*		Number of records buf has room for.
+*
+* SEE ALSO
+*	osm_sa_recs_init, osm_sa_recs_add, osm_sa_respond_recs
+*********/
+
+/****f* OpenSM: SA/osm_sa_recs_init
+* NAME
+*	osm_sa_recs_init
+*
+* DESCRIPTION
+*	Initializes an empty record array for attributes of attr_size bytes.
+*	No memory is allocated until the first record is added.
+*
+* SYNOPSIS
+*/
+void osm_sa_recs_init(osm_sa_recs_t * recs, size_t attr_size);
+/*********/
+
+/****f* OpenSM: SA/osm_sa_recs_add
+* NAME
+*	osm_sa_recs_add
+*
+* DESCRIPTION
+*	Appends a zeroed record to the array and returns a pointer to it,
+*	or NULL if the array could not be grown. The pointer is only valid
+*	until the next call to osm_sa_recs_add.
+*
+* SYNOPSIS
+*/
+void *osm_sa_recs_add(osm_sa_recs_t * recs);
+/*********/
+
+/****f* OpenSM: SA/osm_sa_recs_count
+* NAME
+*	osm_sa_recs_count
+*
+* DESCRIPTION
+*	Returns the number of records in the array.
+*
+* SYNOPSIS
+*/
+static inline unsigned osm_sa_recs_count(IN const osm_sa_recs_t * recs)
+{
+	return recs->num_rec;
+}
+/*********/
+
+/****f* OpenSM: SA/osm_sa_recs_destroy
+* NAME
+*	osm_sa_recs_destroy
+*
+* DESCRIPTION
+*	Frees the record storage and leaves the array empty.
+*
+* SYNOPSIS
+*/
+void osm_sa_recs_destroy(osm_sa_recs_t * recs);
+/*********/
+
+/****f* OpenSM: SA/osm_sa_respond_recs
+* NAME
+*	osm_sa_respond_recs
+*
+* DESCRIPTION
+*	Sends SA MAD response built from a record array. Same semantics
+*	as osm_sa_respond.
+*
+* SYNOPSIS
+*/
+void osm_sa_respond_recs(osm_sa_t * sa, osm_madw_t * madw,
+			 osm_sa_recs_t * recs);
+/*
+* PARAMETERS
+*	sa
+*		[in] Pointer to an osm_sa_t object.
+*
+*	madw
+*		[in] Original MAD to which the response must be sent.
+*
+*	recs
+*		[in] Records to respond - the array is destroyed after
+*		sending.
+*
+* RETURN VALUES
+*	None.
+*
+* SEE ALSO
+*	osm_sa_respond
+*********/
+
 struct osm_opensm;
 /****f* OpenSM: SA/osm_sa_db_file_dump
 * NAME
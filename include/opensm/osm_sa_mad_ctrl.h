@@ -50,6 +50,7 @@
 #include <opensm/osm_madw.h>
 #include <opensm/osm_mad_pool.h>
 #include <opensm/osm_log.h>
+#include <opensm/osm_trace.h>
 
 #ifdef __cplusplus
 #  define BEGIN_C_DECLS extern "C" {
@@ -100,6 +101,7 @@ typedef struct osm_sa_mad_ctrl {
 	cl_dispatcher_t *p_disp;
 	cl_disp_reg_handle_t h_disp;
 	osm_stats_t *p_stats;
+	osm_trace_t *p_trace;
 	osm_subn_t *p_subn;
 } osm_sa_mad_ctrl_t;
 /*
@@ -128,6 +130,9 @@ typedef struct osm_sa_mad_ctrl {
 *	p_stats
 *		Pointer to the OpenSM statistics block.
 *
+*	p_trace
+*		Pointer to the MAD trace object.
+*
 * SEE ALSO
 *	SA MAD Controller object
 *	SA MADr object
@@ -211,6 +216,7 @@ ib_api_status_t osm_sa_mad_ctrl_init(IN osm_sa_mad_ctrl_t * p_ctrl,
 				     IN osm_subn_t * p_subn,
 				     IN osm_log_t * p_log,
 				     IN osm_stats_t * p_stats,
+				     IN osm_trace_t * p_trace,
 				     IN cl_dispatcher_t * p_disp);
 /*
 * PARAMETERS
@@ -232,6 +238,9 @@ ib_api_status_t osm_sa_mad_ctrl_init(IN osm_sa_mad_ctrl_t * p_ctrl,
 *	p_stats
 *		[in] Pointer to the OpenSM stastics block.
 *
+*	p_trace
+*		[in] Pointer to the MAD trace object.
+*
 *	p_disp
 *		[in] Pointer to the OpenSM central Dispatcher.
 *
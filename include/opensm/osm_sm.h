@@ -277,7 +277,7 @@ ib_api_status_t osm_sm_init(IN osm_sm_t * p_sm, IN osm_subn_t * p_subn,
 			    IN osm_db_t * p_db, IN osm_vendor_t * p_vendor,
 			    IN osm_mad_pool_t * p_mad_pool,
 			    IN osm_vl15_t * p_vl15, IN osm_log_t * p_log,
-			    IN osm_stats_t * p_stats,
+			    IN osm_stats_t * p_stats, IN osm_trace_t * p_trace,
 			    IN cl_dispatcher_t * p_disp, IN cl_plock_t * p_lock);
 /*
 * PARAMETERS
@@ -302,6 +302,9 @@ ib_api_status_t osm_sm_init(IN osm_sm_t * p_sm, IN osm_subn_t * p_subn,
 *	p_stats
 *		[in] Pointer to the statistics object.
 *
+*	p_trace
+*		[in] Pointer to the MAD trace object.
+*
 *	p_disp
 *		[in] Pointer to the OpenSM central Dispatcher.
 *
@@ -103,6 +103,7 @@ typedef struct osm_sm_mad_ctrl {
 	cl_dispatcher_t *p_disp;
 	cl_disp_reg_handle_t h_disp;
 	osm_stats_t *p_stats;
+	osm_trace_t *p_trace;
 } osm_sm_mad_ctrl_t;
 /*
 * FIELDS
@@ -133,6 +134,9 @@ typedef struct osm_sm_mad_ctrl {
 *	p_stats
 *		Pointer to the OpenSM statistics block.
 *
+*	p_trace
+*		Pointer to the MAD trace object.
+*
 * SEE ALSO
 *	SM MAD Controller object
 *	SM MADr object
@@ -216,6 +220,7 @@ ib_api_status_t osm_sm_mad_ctrl_init(IN osm_sm_mad_ctrl_t * p_ctrl,
 				     IN osm_vendor_t * p_vendor,
 				     IN osm_log_t * p_log,
 				     IN osm_stats_t * p_stats,
+				     IN osm_trace_t * p_trace,
 				     IN cl_plock_t * p_lock,
 				     IN cl_dispatcher_t * p_disp);
 /*
@@ -238,6 +243,9 @@ ib_api_status_t osm_sm_mad_ctrl_init(IN osm_sm_mad_ctrl_t * p_ctrl,
 *	p_stats
 *		[in] Pointer to the OpenSM stastics block.
 *
+*	p_trace
+*		[in] Pointer to the MAD trace object.
+*
 *	p_lock
 *		[in] Pointer to the OpenSM serializing lock.
 *
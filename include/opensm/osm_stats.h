@@ -93,6 +93,8 @@ typedef struct osm_stats {
 	atomic32_t sa_mads_sent;
 	atomic32_t sa_mads_rcvd_unknown;
 	atomic32_t sa_mads_ignored;
+	atomic32_t sa_pr_cache_hits;
+	atomic32_t sa_pr_cache_misses;
 #ifdef HAVE_LIBPTHREAD
 	pthread_mutex_t mutex;
 	pthread_cond_t cond;
@@ -143,6 +145,15 @@ typedef struct osm_stats {
 *		Total number of SA MADs received because SM is not
 *		master or SM is in first time sweep.
 *
+*	sa_pr_cache_hits
+*		Number of PathRecord path parameter lookups served from
+*		the SA PathRecord cache.
+*
+*	sa_pr_cache_misses
+*		Number of PathRecord path parameter lookups which had to
+*		walk the route because the SA PathRecord cache had no
+*		valid entry.
+*
 * SEE ALSO
 ***************/
 
@@ -152,6 +152,8 @@ typedef struct osm_subn_opt {
 	uint32_t max_wire_smps;
 	uint32_t max_wire_smps2;
 	uint32_t max_smps_timeout;
+	boolean_t adaptive_wire_smps;
+	uint32_t vl15_threads;
 	uint32_t transaction_timeout;
 	uint32_t transaction_retries;
 	uint8_t sm_priority;
@@ -191,6 +193,9 @@ typedef struct osm_subn_opt {
 	boolean_t qos;
 	char *qos_policy_file;
 	boolean_t accum_log_file;
+	boolean_t log_async;
+	char *trace_file;
+	uint32_t trace_size;
 	char *console;
 	uint16_t console_port;
 	char *port_prof_ignore_file;
@@ -209,11 +214,16 @@ typedef struct osm_subn_opt {
 	boolean_t port_shifting;
 	boolean_t remote_guid_sorting;
 	uint32_t scatter_ports;
+	uint32_t routing_threads;
+	char *bfs_lid_matrices;
 	uint16_t max_reverse_hops;
 	char *ids_guid_file;
 	char *guid_routing_order_file;
 	char *sa_db_file;
 	boolean_t sa_db_dump;
+	uint32_t sa_pr_cache_size;
+	boolean_t sa_path_table;
+	boolean_t sa_snapshot;
 	char *torus_conf_file;
 	boolean_t do_mesh_analysis;
 	boolean_t exit_on_fatal;
@@ -238,6 +248,12 @@ typedef struct osm_subn_opt {
 	boolean_t perfmgr_ignore_cas;
 	char *event_db_dump_file;
 	int perfmgr_rm_nodes;
+	boolean_t perfmgr_all_port_select;
+	uint16_t perfmgr_all_port_full_sweeps;
+	boolean_t perfmgr_pacing;
+	char *perfmgr_history_file;
+	uint32_t perfmgr_history_retention_s;
+	uint32_t perfmgr_history_ports;
 #endif				/* ENABLE_OSM_PERF_MGR */
 	char *event_plugin_name;
 	char *event_plugin_options;
@@ -289,6 +305,16 @@ typedef struct osm_subn_opt {
 *		The wait time in usec for timeout based SMPs.  Default is
 *		timeout * retries.
 *
+*	adaptive_wire_smps
+*		If TRUE the number of SMPs sent in parallel is adapted per
+*		local port to the observed response times, starting at
+*		max_wire_smps and bounded by max_wire_smps2.  Default is
+*		FALSE.
+*
+*	vl15_threads
+*		The number of threads sending SMPs.  SMPs are assigned to
+*		a thread by destination.  Default is 1.
+*
 *	transaction_timeout
 *		The maximum time in milliseconds allowed for a transaction
 *		to complete.  Default is 200.
@@ -395,6 +421,20 @@ typedef struct osm_subn_opt {
 *		If FALSE - the log file will be erased before starting
 *		current opensm run.
 *
+*	log_async
+*		If TRUE log messages are queued in memory and written to
+*		the log file by a separate thread. Messages that do not
+*		fit in the queue are dropped and counted.
+*
+*	trace_file
+*		Name of the memory mapped file into which a binary record
+*		of every SMP sent or received and every SA MAD received
+*		is written.  NULL disables MAD tracing.
+*
+*	trace_size
+*		Number of records held in the MAD trace file before the
+*		oldest ones are overwritten.
+*
 *	port_prof_ignore_file
 *		Name of file with port guids to be ignored by port profiling.
 *
@@ -457,6 +497,24 @@ typedef struct osm_subn_opt {
 *		When TRUE causes OpenSM to dump SA DB at the end of every
 *		light sweep regardless the current verbosity level.
 *
+*	sa_pr_cache_size
+*		Number of entries (rounded up to a power of 2) in the SA
+*		cache of path parameters computed by walking the route
+*		between a source port and a destination LID. 0 disables
+*		the cache.
+*
+*	sa_path_table
+*		When TRUE the path parameters of every (switch, LID) pair
+*		are precomputed at the end of each heavy sweep or reroute
+*		and used to answer PathRecord and MultiPathRecord queries.
+*
+*	sa_snapshot
+*		When TRUE a snapshot of the subnet is taken at the end of
+*		each heavy sweep or reroute and NodeRecord, LFTRecord and
+*		PortInfoRecord queries are answered from it without taking
+*		the SA lock. All other SA queries, PathRecord included,
+*		still take the SA lock.
+*
 *	torus_conf_file
 *		Name of the file with extra configuration info for torus-2QoS
 *		routing engine.
@@ -496,6 +554,38 @@ typedef struct osm_subn_opt {
 *	perfmgr_sweep_time_s
 *		Define the period (in seconds) of PerfMgr sweeps
 *
+*	perfmgr_all_port_select
+*		On switches advertising AllPortSelect, read the summed
+*		PortCounters of all ports each sweep and only query the
+*		individual ports when the summed error counters change.
+*		Not used with perfmgr_pacing.
+*
+*	perfmgr_all_port_full_sweeps
+*		With perfmgr_all_port_select, query the individual ports of
+*		such switches at least every this many sweeps
+*
+*	perfmgr_pacing
+*		Poll each node once per perfmgr_sweep_time_s at a fixed
+*		offset in the period instead of polling all nodes at
+*		the start of each sweep, and adapt the number of
+*		outstanding queries to the measured MAD latency.  Every
+*		port is then read on each poll, so perfmgr_all_port_select
+*		is turned off.
+*
+*	perfmgr_history_file
+*		Name of the memory mapped file into which the counter
+*		deltas of every port reading are kept.  NULL disables
+*		the PerfMgr history.
+*
+*	perfmgr_history_retention_s
+*		Seconds of samples kept per port, at one sample per
+*		perfmgr_sweep_time_s as set at startup
+*
+*	perfmgr_history_ports
+*		Number of ports the history file holds samples for.  Once
+*		all are assigned, a new port only gets the slot of a port
+*		that stopped being read, otherwise it is not kept.
+*
 *       event_db_dump_file
 *               File to dump the event database to
 *
@@ -531,6 +621,19 @@ typedef struct osm_subn_opt {
 *		When not zero, randomize best possible ports chosen
 *		for a route. The value is used as a random key seed.
 *
+*	routing_threads
+*		Number of threads used to build the switches' min hop
+*		tables and LFTs. 1 (default) keeps the computation serial,
+*		0 uses one thread per processor. LFTs are calculated
+*		serially when LMC > 0.
+*
+*	bfs_lid_matrices
+*		Comma separated list of the routing engines (minhop, dor,
+*		updn, ...) whose min hop tables are built by one BFS per
+*		destination switch instead of iterative neighbor relaxation.
+*		Engines which build their own constrained hop tables, like
+*		dnup, ftree, lash and torus-2QoS, are not affected.
+*
 * SEE ALSO
 *	Subnet object
 *********/
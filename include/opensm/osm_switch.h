@@ -99,7 +99,11 @@ typedef struct osm_switch {
 	uint16_t max_lid_ho;
 	uint8_t num_ports;
 	uint16_t num_hops;
-	uint8_t **hops;
+	uint16_t num_hops_rows;
+	uint16_t max_hops_rows;
+	uint16_t *hops_row;
+	uint8_t *least_hops;
+	uint8_t *hops;
 	osm_port_profile_t *p_prof;
 	uint8_t *search_ordering_ports;
 	uint8_t *lft;
@@ -136,9 +140,25 @@ typedef struct osm_switch {
 *	num_hops
 *		Size of hops table for this switch.
 *
+*	num_hops_rows
+*		Number of rows used in the hops slab.
+*
+*	max_hops_rows
+*		Number of rows allocated in the hops slab.
+*
+*	hops_row
+*		Index (plus one) of the hops slab row for every LID,
+*		0 when the LID has no row.
+*
+*	least_hops
+*		Least hop count to every LID from any port, kept dense
+*		and indexed by LID.
+*
 *	hops
 *		LID Matrix for this switch containing the hop count
-*		to every LID from every port.
+*		to every LID from every port. Rows of num_ports entries
+*		are allocated in one contiguous slab, only for the LIDs
+*		a hop count was set for.
 *
 *	p_prof
 *		Pointer to array of Port Profile objects for this switch.
@@ -272,8 +292,11 @@ static inline uint8_t osm_switch_get_hop_count(IN const osm_switch_t * p_sw,
 					       IN uint16_t lid_ho,
 					       IN uint8_t port_num)
 {
-	return (lid_ho > p_sw->max_lid_ho || !p_sw->hops[lid_ho]) ?
-	    OSM_NO_PATH : p_sw->hops[lid_ho][port_num];
+	uint16_t row;
+
+	if (lid_ho > p_sw->max_lid_ho || !(row = p_sw->hops_row[lid_ho]))
+		return OSM_NO_PATH;
+	return p_sw->hops[(row - 1) * p_sw->num_ports + port_num];
 }
 /*
 * PARAMETERS
@@ -347,6 +370,53 @@ void osm_switch_clear_hops(IN osm_switch_t * p_sw);
 * SEE ALSO
 *********/
 
+/****f* OpenSM: Switch/osm_switch_clear_lid_hops
+* NAME
+*	osm_switch_clear_lid_hops
+*
+* DESCRIPTION
+*	Cleanup the hops tables (lid matrix) entries of a single LID.
+*
+* SYNOPSIS
+*/
+void osm_switch_clear_lid_hops(IN osm_switch_t * p_sw, IN uint16_t lid_ho);
+/*
+* PARAMETERS
+*	p_sw
+*		[in] Pointer to a Switch object.
+*
+*	lid_ho
+*		[in] LID value (host order) for which to clear the counts.
+*
+* NOTES
+*
+* SEE ALSO
+*********/
+
+/****f* OpenSM: Switch/osm_switch_get_hops_mem_size
+* NAME
+*	osm_switch_get_hops_mem_size
+*
+* DESCRIPTION
+*	Returns the number of bytes allocated for the hops tables
+*	(lid matrix) of the switch.
+*
+* SYNOPSIS
+*/
+size_t osm_switch_get_hops_mem_size(IN const osm_switch_t * p_sw);
+/*
+* PARAMETERS
+*	p_sw
+*		[in] Pointer to a Switch object.
+*
+* RETURN VALUES
+*	Size in bytes of the hops slab, row index and least hops arrays.
+*
+* NOTES
+*
+* SEE ALSO
+*********/
+
 /****f* OpenSM: Switch/osm_switch_get_least_hops
 * NAME
 *	osm_switch_get_least_hops
@@ -360,8 +430,8 @@ void osm_switch_clear_hops(IN osm_switch_t * p_sw);
 static inline uint8_t osm_switch_get_least_hops(IN const osm_switch_t * p_sw,
 						IN uint16_t lid_ho)
 {
-	return (lid_ho > p_sw->max_lid_ho || !p_sw->hops[lid_ho]) ?
-	    OSM_NO_PATH : p_sw->hops[lid_ho][0];
+	return lid_ho > p_sw->max_lid_ho ?
+	    OSM_NO_PATH : p_sw->least_hops[lid_ho];
 }
 /*
 * PARAMETERS
@@ -976,6 +1046,11 @@ uint8_t osm_switch_recommend_path(IN const osm_switch_t * p_sw,
 *	Returns the recommended port on which to route this LID.
 *
 * NOTES
+*	When none of routing_for_lmc, dor, port_shifting,
+*	remote_guid_sorting and scatter_ports is set and there is no
+*	port search ordering, the selection is done by a SIMD fast
+*	path over the packed hop row and port path counts.  It returns
+*	the same port as the generic selection loop.
 *
 * SEE ALSO
 *********/
@@ -0,0 +1,380 @@
+/*
+ * Copyright (c) 2004-2009 Voltaire, Inc. All rights reserved.
+ * Copyright (c) 2002-2006 Mellanox Technologies LTD. All rights reserved.
+ * Copyright (c) 1996-2003 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ * 	Declaration of osm_trace_t.
+ *	This object represents the binary MAD trace ring file.
+ *	This object is part of the OpenSM family of objects.
+ */
+
+#ifndef _OSM_TRACE_H_
+#define _OSM_TRACE_H_
+
+#include <complib/cl_spinlock.h>
+#include <iba/ib_types.h>
+#include <opensm/osm_base.h>
+#include <opensm/osm_madw.h>
+#include <opensm/osm_log.h>
+
+#ifdef __cplusplus
+#  define BEGIN_C_DECLS extern "C" {
+#  define END_C_DECLS   }
+#else				/* !__cplusplus */
+#  define BEGIN_C_DECLS
+#  define END_C_DECLS
+#endif				/* __cplusplus */
+
+BEGIN_C_DECLS
+/****h* OpenSM/MAD Trace
+* NAME
+*	MAD Trace
+*
+* DESCRIPTION
+*	The MAD Trace object records one fixed size binary record per
+*	MAD sent on or received from the SM and SA QPs into a ring held
+*	in a memory mapped file.  Recording a MAD costs a timestamp and
+*	a 64 byte copy, so the trace may stay enabled in production.
+*	The file is decoded offline by osmtracedump.
+*
+*	The file starts with an osm_trace_hdr_t, followed by num_recs
+*	osm_trace_rec_t records.  Records are stored in host byte order
+*	except for the fields that are copied verbatim from the MAD.
+*
+*********/
+#define OSM_TRACE_MAGIC		0x544d534f	/* "OSMT" */
+#define OSM_TRACE_VERSION	1
+#define OSM_TRACE_MAX_HOPS	30
+/****d* OpenSM: MAD Trace/osm_trace_event_t
+* NAME
+*	osm_trace_event_t
+*
+* DESCRIPTION
+*	Enumerates the points at which MADs are recorded.
+*
+* SYNOPSIS
+*/
+typedef enum _osm_trace_event {
+	OSM_TRACE_EVENT_NONE = 0,
+	OSM_TRACE_EVENT_SMP_SEND,
+	OSM_TRACE_EVENT_SMP_RCV,
+	OSM_TRACE_EVENT_SA_RCV,
+	OSM_TRACE_EVENT_MAX
+} osm_trace_event_t;
+/***********/
+
+/****s* OpenSM: MAD Trace/osm_trace_hdr_t
+* NAME
+*	osm_trace_hdr_t
+*
+* DESCRIPTION
+*	Header at the start of the trace file.
+*
+* SYNOPSIS
+*/
+typedef struct osm_trace_hdr {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t rec_size;
+	uint32_t num_recs;
+	uint32_t reserved;
+	uint64_t head;
+	uint64_t start_time;
+	uint8_t reserved2[32];
+} osm_trace_hdr_t;
+/*
+* FIELDS
+*	magic
+*		OSM_TRACE_MAGIC in host byte order.  A decoder running on a
+*		host of different endianness sees it swapped.
+*
+*	version
+*		OSM_TRACE_VERSION.
+*
+*	rec_size
+*		Size in bytes of one osm_trace_rec_t.
+*
+*	num_recs
+*		Number of record slots in the ring.
+*
+*	head
+*		Total number of records written since the file was created.
+*		The next record goes into slot head % num_recs.
+*
+*	start_time
+*		Time stamp in usec at which the trace was started.
+*
+* SEE ALSO
+*	osm_trace_rec_t
+*********/
+
+/****s* OpenSM: MAD Trace/osm_trace_rec_t
+* NAME
+*	osm_trace_rec_t
+*
+* DESCRIPTION
+*	One 64 byte trace record.
+*
+* SYNOPSIS
+*/
+typedef struct osm_trace_rec {
+	uint64_t time;
+	ib_net64_t trans_id;
+	ib_net32_t attr_mod;
+	uint32_t latency;
+	ib_net16_t attr_id;
+	ib_net16_t status;
+	ib_net16_t lid;
+	uint8_t event;
+	uint8_t mgmt_class;
+	uint8_t method;
+	uint8_t hop_count;
+	uint8_t path[OSM_TRACE_MAX_HOPS];
+} osm_trace_rec_t;
+/*
+* FIELDS
+*	time
+*		Time stamp in usec at which the MAD was recorded.
+*
+*	trans_id
+*		Transaction ID of the MAD.
+*
+*	attr_mod
+*		Attribute modifier of the MAD.
+*
+*	latency
+*		For responses, usec elapsed since the matching request was
+*		sent.  Zero when unknown.
+*
+*	attr_id
+*		Attribute ID of the MAD.
+*
+*	status
+*		MAD status.  For directed route SMPs the D bit is masked off.
+*
+*	lid
+*		Destination LID of sent MADs, source LID of received ones.
+*		Permissive for directed route MADs.
+*
+*	event
+*		One of osm_trace_event_t.
+*
+*	mgmt_class
+*		Management class of the MAD.
+*
+*	method
+*		Method of the MAD.
+*
+*	hop_count
+*		Hop count of directed route SMPs.  Zero otherwise.
+*
+*	path
+*		Initial path of directed route SMPs.  Paths longer than
+*		OSM_TRACE_MAX_HOPS are truncated, hop_count is not.
+*
+* SEE ALSO
+*	osm_trace_hdr_t
+*********/
+
+/****s* OpenSM: MAD Trace/osm_trace_t
+* NAME
+*	osm_trace_t
+*
+* DESCRIPTION
+*	MAD trace object.
+*
+* SYNOPSIS
+*/
+typedef struct osm_trace {
+	osm_log_t *p_log;
+	cl_spinlock_t lock;
+	osm_trace_hdr_t *p_hdr;
+	osm_trace_rec_t *recs;
+	size_t map_size;
+	int fd;
+} osm_trace_t;
+/*
+* FIELDS
+*	p_log
+*		Pointer to the log object.
+*
+*	lock
+*		Serializes slot allocation and the record copy.
+*
+*	p_hdr
+*		Mapped file header.  NULL while tracing is disabled.
+*
+*	recs
+*		Mapped record ring.
+*
+*	map_size
+*		Size of the mapping.
+*
+*	fd
+*		Descriptor of the trace file.
+*
+* SEE ALSO
+*********/
+
+/****f* OpenSM: MAD Trace/osm_trace_construct
+* NAME
+*	osm_trace_construct
+*
+* DESCRIPTION
+*	Constructs a trace object in the disabled state.
+*
+* SYNOPSIS
+*/
+void osm_trace_construct(IN osm_trace_t * p_trace);
+/*
+* PARAMETERS
+*	p_trace
+*		[in] Pointer to the trace object to construct.
+*
+* SEE ALSO
+*	osm_trace_init, osm_trace_destroy
+*********/
+
+/****f* OpenSM: MAD Trace/osm_trace_init
+* NAME
+*	osm_trace_init
+*
+* DESCRIPTION
+*	Creates the trace file and maps it.
+*
+* SYNOPSIS
+*/
+ib_api_status_t osm_trace_init(IN osm_trace_t * p_trace,
+			       IN osm_log_t * p_log,
+			       IN const char *file_name,
+			       IN uint32_t num_recs);
+/*
+* PARAMETERS
+*	p_trace
+*		[in] Pointer to a constructed trace object.
+*
+*	p_log
+*		[in] Pointer to the log object.
+*
+*	file_name
+*		[in] Path of the trace file.  An existing file is truncated.
+*
+*	num_recs
+*		[in] Number of records held in the ring.
+*
+* RETURN VALUES
+*	IB_SUCCESS if the trace file was created and mapped.
+*
+* NOTES
+*	On failure the object stays disabled and osm_trace_mad is a no-op.
+*
+* SEE ALSO
+*	osm_trace_destroy
+*********/
+
+/****f* OpenSM: MAD Trace/osm_trace_destroy
+* NAME
+*	osm_trace_destroy
+*
+* DESCRIPTION
+*	Unmaps and closes the trace file.  The file is left on disk.
+*
+* SYNOPSIS
+*/
+void osm_trace_destroy(IN osm_trace_t * p_trace);
+/*
+* PARAMETERS
+*	p_trace
+*		[in] Pointer to the trace object.
+*
+* SEE ALSO
+*	osm_trace_init
+*********/
+
+/****f* OpenSM: MAD Trace/osm_trace_is_active
+* NAME
+*	osm_trace_is_active
+*
+* DESCRIPTION
+*	Returns TRUE if MADs are being recorded.
+*
+* SYNOPSIS
+*/
+static inline boolean_t osm_trace_is_active(IN const osm_trace_t * p_trace)
+{
+	return p_trace->p_hdr != NULL;
+}
+/*
+* PARAMETERS
+*	p_trace
+*		[in] Pointer to the trace object.
+*
+*********/
+
+/****f* OpenSM: MAD Trace/osm_trace_mad
+* NAME
+*	osm_trace_mad
+*
+* DESCRIPTION
+*	Appends a record describing the MAD to the ring.
+*
+* SYNOPSIS
+*/
+uint64_t osm_trace_mad(IN osm_trace_t * p_trace, IN osm_trace_event_t event,
+		       IN const osm_madw_t * p_madw,
+		       IN const osm_madw_t * p_req_madw);
+/*
+* PARAMETERS
+*	p_trace
+*		[in] Pointer to an active trace object.
+*
+*	event
+*		[in] Point at which the MAD is recorded.
+*
+*	p_madw
+*		[in] MAD wrapper of the MAD to record.
+*
+*	p_req_madw
+*		[in] Request this MAD answers, or NULL.  Used to compute
+*		the latency from its send_time.
+*
+* RETURN VALUE
+*	The time stamp stored in the record.
+*
+* SEE ALSO
+*********/
+
+END_C_DECLS
+#endif				/* _OSM_TRACE_H_ */
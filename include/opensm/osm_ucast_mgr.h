@@ -98,6 +98,7 @@ typedef struct osm_ucast_mgr {
 	uint16_t max_lid;
 	cl_qlist_t port_order_list;
 	boolean_t is_dor;
+	boolean_t bfs_lid_matrices;
 	boolean_t some_hop_count_set;
 	cl_qmap_t cache_sw_tbl;
 	boolean_t cache_valid;
@@ -119,6 +120,10 @@ typedef struct osm_ucast_mgr {
 *	is_dor
 *		Dimension Order Routing (DOR) will be done
 *
+*	bfs_lid_matrices
+*		The routing engine being run builds its min hop tables by
+*		BFS (it is listed in the bfs_lid_matrices option)
+*
 *	port_order_list
 *		List of ports ordered for routing.
 *
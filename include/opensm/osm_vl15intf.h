@@ -52,6 +52,7 @@
 #include <opensm/osm_log.h>
 #include <opensm/osm_madw.h>
 #include <opensm/osm_mad_pool.h>
+#include <opensm/osm_trace.h>
 #include <vendor/osm_vendor_api.h>
 
 #ifdef __cplusplus
@@ -77,6 +78,11 @@ BEGIN_C_DECLS
 *	OpenSM modules may post VL15 MADs to the VL15 interface as fast
 *	as possible.
 *
+*	MADs are spread over one or more sender threads by destination,
+*	so MADs to the same destination are sent in order.  Each sender
+*	keeps one FIFO per priority class and always serves the higher
+*	classes first.
+*
 *	The VL15 object is thread safe.
 *
 *	This object should be treated as opaque and should
@@ -101,6 +107,167 @@ typedef enum _osm_vl15_state {
 } osm_vl15_state_t;
 /***********/
 
+#define OSM_VL15_MAX_PORTS	4
+#define OSM_VL15_RTT_BUCKETS	9
+#define OSM_VL15_MAX_SENDERS	16
+
+/****d* OpenSM: VL15/osm_vl15_prio_t
+* NAME
+*	osm_vl15_prio_t
+*
+* DESCRIPTION
+*	Enumerates the VL15 priority classes, highest first.
+*
+* SYNOPSIS
+*/
+typedef enum _osm_vl15_prio {
+	OSM_VL15_PRIO_TRAP_REPRESS = 0,
+	OSM_VL15_PRIO_SMINFO,
+	OSM_VL15_PRIO_FWD_TBL,
+	OSM_VL15_PRIO_DISCOVERY,
+	OSM_VL15_PRIO_MAX
+} osm_vl15_prio_t;
+/*
+* VALUES
+*	OSM_VL15_PRIO_TRAP_REPRESS
+*		MADs for which no response is expected, trap represses and
+*		responses.  These are not throttled.
+*
+*	OSM_VL15_PRIO_SMINFO
+*		SMInfo requests used for SM polling and handover.
+*
+*	OSM_VL15_PRIO_FWD_TBL
+*		Set(LinearForwardingTable) and Set(MulticastForwardingTable)
+*		requests.
+*
+*	OSM_VL15_PRIO_DISCOVERY
+*		Discovery Gets and all other requests.
+*********/
+
+/****s* OpenSM: VL15/osm_vl15_rtt_t
+* NAME
+*	osm_vl15_rtt_t
+*
+* DESCRIPTION
+*	Round trip time estimator for SMPs of one hop distance bucket.
+*
+* SYNOPSIS
+*/
+typedef struct osm_vl15_rtt {
+	uint32_t srtt;
+	uint32_t rttvar;
+	uint32_t samples;
+} osm_vl15_rtt_t;
+/*
+* FIELDS
+*	srtt
+*		Smoothed round trip time in usec, scaled by 8.
+*
+*	rttvar
+*		Smoothed mean deviation of the round trip time in usec,
+*		scaled by 4.
+*
+*	samples
+*		Number of responses measured.
+*
+* SEE ALSO
+*	osm_vl15_window_t
+*********/
+
+/****s* OpenSM: VL15/osm_vl15_window_t
+* NAME
+*	osm_vl15_window_t
+*
+* DESCRIPTION
+*	Adaptive send window of one local port.
+*
+*	The window grows by one SMP for every window's worth of
+*	responses received within the expected round trip time, and
+*	is halved at most once per window when a request times out.
+*
+* SYNOPSIS
+*/
+typedef struct osm_vl15_window {
+	osm_bind_handle_t h_bind;
+	uint32_t cwnd;
+	uint32_t acked;
+	int32_t on_wire;
+	uint64_t last_backoff;
+	uint32_t timeouts;
+	uint32_t late;
+	osm_vl15_rtt_t rtt[OSM_VL15_RTT_BUCKETS];
+} osm_vl15_window_t;
+/*
+* FIELDS
+*	h_bind
+*		Bind handle of the port the SMPs are sent from.
+*
+*	cwnd
+*		Number of SMPs allowed on the wire.
+*
+*	acked
+*		Responses received on time since cwnd last grew.
+*
+*	on_wire
+*		Number of SMPs currently on the wire.
+*
+*	last_backoff
+*		Time stamp in usec of the last window reduction.
+*
+*	timeouts
+*		Number of requests that timed out.
+*
+*	late
+*		Number of responses received later than expected.
+*
+*	rtt
+*		Round trip time estimators.  Directed route SMPs are
+*		bucketed by hop count, IB_SUBNET_PATH_HOPS_MAX hops per
+*		OSM_VL15_RTT_BUCKETS - 1 buckets; LID routed SMPs use the
+*		last bucket.
+*
+* SEE ALSO
+*	osm_vl15_t
+*********/
+
+/****s* OpenSM: VL15/osm_vl15_sender_t
+* NAME
+*	osm_vl15_sender_t
+*
+* DESCRIPTION
+*	VL15 sender thread and its FIFOs.
+*
+* SYNOPSIS
+*/
+typedef struct osm_vl15_sender {
+	struct osm_vl15 *p_vl;
+	cl_event_t signal;
+	cl_thread_t thread;
+	cl_spinlock_t lock;
+	cl_qlist_t fifo[OSM_VL15_PRIO_MAX];
+} osm_vl15_sender_t;
+/*
+* FIELDS
+*	p_vl
+*		Pointer to the VL15 object.
+*
+*	signal
+*		Event on which the sender sleeps.
+*
+*	thread
+*		Thread transmitting the MADs of the FIFOs.
+*
+*	lock
+*		Spinlock guarding the FIFOs.
+*
+*	fifo
+*		First-in First-out queue of outbound VL15 MADs per
+*		priority class.
+*
+* SEE ALSO
+*	osm_vl15_t, osm_vl15_prio_t
+*********/
+
 /****s* OpenSM: VL15/osm_vl15_t
 * NAME
 *	osm_vl15_t
@@ -119,19 +286,22 @@ typedef struct osm_vl15 {
 	uint32_t max_wire_smps;
 	uint32_t max_wire_smps2;
 	uint32_t max_smps_timeout;
-	cl_event_t signal;
-	cl_thread_t poller;
-	cl_qlist_t rfifo;
-	cl_qlist_t ufifo;
+	atomic32_t max_smps;
+	uint32_t num_senders;
+	osm_vl15_sender_t senders[OSM_VL15_MAX_SENDERS];
 	cl_spinlock_t lock;
 	osm_vendor_t *p_vend;
 	osm_log_t *p_log;
 	osm_stats_t *p_stats;
+	osm_trace_t *p_trace;
+	boolean_t adaptive;
+	uint32_t num_windows;
+	osm_vl15_window_t windows[OSM_VL15_MAX_PORTS];
 } osm_vl15_t;
 /*
 * FIELDS
 *	thread_state
-*		Tracks the thread state of the poller thread.
+*		Tracks the thread state of the sender threads.
 *
 *	state
 *		Tracks the state of the VL15 interface itself.
@@ -145,22 +315,20 @@ typedef struct osm_vl15 {
 *	max_smps_timeout
 *		Wait time in usec for timeout based SMPs.
 *
-*	signal
-*		Event on which the poller sleeps.
-*
-*	rfifo
-*		First-in First-out queue for outbound VL15 MADs for which
-*		a response is expected, aka the "response fifo"
+*	max_smps
+*		Current limit of VL15 MADs on the wire shared by the sender
+*		threads.  Raised by one up to max_wire_smps2 each time the
+*		senders time out waiting for the wire to drain.
 *
-*	ufifo
-*		First-in First-out queue for outbound VL15 MADs for which
-*		no response is expected, aka the "unicast fifo".
+*	num_senders
+*		Number of sender threads.
 *
-*	poller
-*		Worker thread pool that services the fifo to transmit VL15 MADs
+*	senders
+*		Sender threads.  MADs are assigned to a sender by a hash
+*		of their destination.
 *
 *	lock
-*		Spinlock guarding the FIFO.
+*		Spinlock guarding the adaptive windows.
 *
 *	p_vend
 *		Pointer to the vendor transport object.
@@ -171,6 +339,20 @@ typedef struct osm_vl15 {
 *	p_stats
 *		Pointer to the OpenSM statistics block.
 *
+*	p_trace
+*		Pointer to the MAD trace object.
+*
+*	adaptive
+*		If TRUE requests are throttled by the per port adaptive
+*		windows instead of max_wire_smps and max_wire_smps2.
+*
+*	num_windows
+*		Number of windows in use.
+*
+*	windows
+*		Adaptive send window per local port.  Ports beyond
+*		OSM_VL15_MAX_PORTS share the first window.
+*
 * SEE ALSO
 *	VL15 object
 *********/
@@ -251,9 +433,12 @@ void osm_vl15_destroy(IN osm_vl15_t * p_vl15, IN struct osm_mad_pool *p_pool);
 */
 ib_api_status_t osm_vl15_init(IN osm_vl15_t * p_vl15, IN osm_vendor_t * p_vend,
 			      IN osm_log_t * p_log, IN osm_stats_t * p_stats,
+			      IN osm_trace_t * p_trace,
 			      IN int32_t max_wire_smps,
 			      IN int32_t max_wire_smps2,
-			      IN uint32_t max_smps_timeout);
+			      IN uint32_t max_smps_timeout,
+			      IN boolean_t adaptive,
+			      IN uint32_t num_senders);
 /*
 * PARAMETERS
 *	p_vl15
@@ -268,6 +453,9 @@ ib_api_status_t osm_vl15_init(IN osm_vl15_t * p_vl15, IN osm_vendor_t * p_vend,
 *	p_stats
 *		[in] Pointer to the OpenSM stastics block.
 *
+*	p_trace
+*		[in] Pointer to the MAD trace object.
+*
 *	max_wire_smps
 *		[in] Maximum number of SMPs allowed on the wire at one time.
 *
@@ -278,6 +466,13 @@ ib_api_status_t osm_vl15_init(IN osm_vl15_t * p_vl15, IN osm_vendor_t * p_vend,
 *	max_smps_timeout
 *		[in] Wait time in usec for timeout based SMPs.
 *
+*	adaptive
+*		[in] If TRUE use an adaptive send window per port, starting
+*		     at max_wire_smps and bounded by the larger of
+*		     max_wire_smps and max_wire_smps2.
+*
+*	num_senders
+*		[in] Number of sender threads, at most OSM_VL15_MAX_SENDERS.
 *
 * RETURN VALUES
 *	IB_SUCCESS if the VL15 object was initialized successfully.
@@ -337,16 +532,48 @@ void osm_vl15_poll(IN osm_vl15_t * p_vl);
 *	None.
 *
 * NOTES
-*	This function signals the VL15 that it may be possible to send
-*	a SMP.  This function checks three criteria before sending a SMP:
-*	1) The VL15 worker is IDLE
-*	2) There are no QP0 SMPs currently outstanding
-*	3) There is something on the VL15 FIFO to send
+*	This function signals the VL15 senders that it may be possible
+*	to send a SMP, when fewer than max_wire_smps SMPs are on the wire
+*	or the adaptive windows are in use.
 *
 * SEE ALSO
 *	VL15 object, osm_vl15_construct, osm_vl15_init
 *********/
 
+/****f* OpenSM: VL15/osm_vl15_complete
+* NAME
+*	osm_vl15_complete
+*
+* DESCRIPTION
+*	Reports the end of a request sent by the VL15 interface, either
+*	by a response or by a timeout, to the adaptive send window.
+*
+* SYNOPSIS
+*/
+void osm_vl15_complete(IN osm_vl15_t * p_vl, IN const osm_madw_t * p_madw,
+		       IN boolean_t timed_out);
+/*
+* PARAMETERS
+*	p_vl
+*		[in] Pointer to an osm_vl15_t object.
+*
+*	p_madw
+*		[in] The request MAD wrapper.
+*
+*	timed_out
+*		[in] TRUE if no response was received.
+*
+* RETURN VALUES
+*	None.
+*
+* NOTES
+*	Does nothing unless the adaptive window is enabled.  Callers
+*	should call osm_vl15_poll afterwards.
+*
+* SEE ALSO
+*	VL15 object, osm_vl15_poll
+*********/
+
 /****f* OpenSM: VL15/osm_vl15_shutdown
 * NAME
 *	osm_vl15_shutdown
@@ -0,0 +1,836 @@
+/*
+ * Copyright (c) 2004-2008 Voltaire, Inc. All rights reserved.
+ * Copyright (c) 2002-2005 Mellanox Technologies LTD. All rights reserved.
+ * Copyright (c) 1996-2003 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *    Vendor transport of the in-process simulated fabric.  Requests
+ *    are answered by the fabric model when sent and the responses and
+ *    timeouts are delivered by a thread at their simulated time.
+ *
+ * Environment:
+ *    Linux User Mode
+ *
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#ifdef OSM_VENDOR_INTF_FABSIM
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <inttypes.h>
+#include <iba/ib_types.h>
+#include <complib/cl_timer.h>
+#include <opensm/osm_madw.h>
+#include <opensm/osm_log.h>
+#include <opensm/osm_mad_pool.h>
+#include <opensm/osm_helper.h>
+#include <vendor/osm_vendor_api.h>
+
+#define FABSIM_MAX_CACHED	1024
+
+typedef enum _fabsim_event_type {
+	FABSIM_EV_RECV,
+	FABSIM_EV_TIMEOUT,
+	FABSIM_EV_SA_QUERY
+} fabsim_event_type_t;
+
+typedef struct _fabsim_bind {
+	osm_vendor_t *p_vend;
+	void *client_context;
+	osm_mad_pool_t *p_mad_pool;
+	osm_vend_mad_recv_callback_t mad_recv_callback;
+	osm_vend_mad_send_err_callback_t send_err_callback;
+	ib_net64_t port_guid;
+	uint8_t mad_class;
+	boolean_t is_responder;
+	uint32_t timeout;
+	uint32_t max_retries;
+} fabsim_bind_t;
+
+struct osm_fabsim_event {
+	uint64_t time;
+	fabsim_event_type_t type;
+	fabsim_bind_t *p_bind;
+	osm_madw_t *p_madw;
+	osm_madw_t *p_req_madw;
+};
+
+/**********************************************************************
+ Event heap, ordered by delivery time.  Called with the vendor lock.
+**********************************************************************/
+static void heap_swap(osm_vendor_t * p_vend, uint32_t a, uint32_t b)
+{
+	struct osm_fabsim_event *tmp = p_vend->heap[a];
+
+	p_vend->heap[a] = p_vend->heap[b];
+	p_vend->heap[b] = tmp;
+}
+
+static int heap_push(osm_vendor_t * p_vend, struct osm_fabsim_event *p_ev)
+{
+	struct osm_fabsim_event **heap;
+	uint32_t i, parent;
+
+	if (p_vend->heap_size == p_vend->heap_max) {
+		i = p_vend->heap_max ? 2 * p_vend->heap_max : 1024;
+		if (!(heap = realloc(p_vend->heap, i * sizeof(*heap))))
+			return -1;
+		p_vend->heap = heap;
+		p_vend->heap_max = i;
+	}
+
+	i = p_vend->heap_size++;
+	p_vend->heap[i] = p_ev;
+	for (; i; i = parent) {
+		parent = (i - 1) / 2;
+		if (p_vend->heap[parent]->time <= p_vend->heap[i]->time)
+			break;
+		heap_swap(p_vend, i, parent);
+	}
+	return 0;
+}
+
+static struct osm_fabsim_event *heap_pop(osm_vendor_t * p_vend)
+{
+	struct osm_fabsim_event *p_ev = p_vend->heap[0];
+	uint32_t i = 0, child;
+
+	p_vend->heap[0] = p_vend->heap[--p_vend->heap_size];
+	for (;;) {
+		child = 2 * i + 1;
+		if (child >= p_vend->heap_size)
+			break;
+		if (child + 1 < p_vend->heap_size &&
+		    p_vend->heap[child + 1]->time < p_vend->heap[child]->time)
+			child++;
+		if (p_vend->heap[i]->time <= p_vend->heap[child]->time)
+			break;
+		heap_swap(p_vend, i, child);
+		i = child;
+	}
+	return p_ev;
+}
+
+static int schedule(osm_vendor_t * p_vend, fabsim_event_type_t type,
+		    uint64_t time, fabsim_bind_t * p_bind,
+		    osm_madw_t * p_madw, osm_madw_t * p_req_madw)
+{
+	struct osm_fabsim_event *p_ev;
+	int ret;
+
+	if (!(p_ev = malloc(sizeof(*p_ev))))
+		return -1;
+	p_ev->time = time;
+	p_ev->type = type;
+	p_ev->p_bind = p_bind;
+	p_ev->p_madw = p_madw;
+	p_ev->p_req_madw = p_req_madw;
+
+	pthread_mutex_lock(&p_vend->lock);
+	if ((ret = heap_push(p_vend, p_ev)) == 0 && p_vend->heap[0] == p_ev)
+		pthread_cond_signal(&p_vend->cond);
+	pthread_mutex_unlock(&p_vend->lock);
+
+	if (ret)
+		free(p_ev);
+	return ret;
+}
+
+/**********************************************************************
+ MAD sized buffers are recycled through a free list linked through
+ their first bytes.
+**********************************************************************/
+static void *buf_get(osm_vendor_t * p_vend, uint32_t size)
+{
+	void *buf = NULL;
+
+	if (size == MAD_BLOCK_SIZE) {
+		pthread_mutex_lock(&p_vend->lock);
+		if ((buf = p_vend->buf_cache) != NULL) {
+			p_vend->buf_cache = *(void **)buf;
+			p_vend->buf_cached--;
+		}
+		pthread_mutex_unlock(&p_vend->lock);
+	}
+
+	if (buf)
+		memset(buf, 0, size);
+	else
+		buf = calloc(1, size);
+	return buf;
+}
+
+static void buf_put(osm_vendor_t * p_vend, void *buf, uint32_t size)
+{
+	if (size == MAD_BLOCK_SIZE) {
+		pthread_mutex_lock(&p_vend->lock);
+		if (p_vend->buf_cached < FABSIM_MAX_CACHED) {
+			*(void **)buf = p_vend->buf_cache;
+			p_vend->buf_cache = buf;
+			p_vend->buf_cached++;
+			buf = NULL;
+		}
+		pthread_mutex_unlock(&p_vend->lock);
+	}
+	free(buf);
+}
+
+static fabsim_bind_t *find_bind(osm_vendor_t * p_vend, uint8_t mad_class)
+{
+	fabsim_bind_t *p_bind;
+	uint32_t i;
+
+	for (i = 0; i < p_vend->num_binds; i++) {
+		p_bind = p_vend->binds[i];
+		if (p_bind->mad_class == mad_class && p_bind->is_responder)
+			return p_bind;
+	}
+	return NULL;
+}
+
+/* Hands a PathRecord query of a simulated host to the SA */
+static void generate_sa_query(osm_vendor_t * p_vend, uint64_t now)
+{
+	fabsim_bind_t *p_bind = find_bind(p_vend, IB_MCLASS_SUBN_ADM);
+	osm_mad_addr_t mad_addr;
+	osm_madw_t *p_madw;
+	ib_net16_t slid;
+	ib_net64_t tid;
+
+	if (schedule(p_vend, FABSIM_EV_SA_QUERY,
+		     now + 1000000 / p_vend->sa_rate, NULL, NULL, NULL))
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5706: "
+			"failed to schedule the SA load generator\n");
+
+	if (!p_bind)
+		return;
+
+	memset(&mad_addr, 0, sizeof(mad_addr));
+	mad_addr.addr_type.gsi.remote_qp = CL_HTON32(1);
+	mad_addr.addr_type.gsi.remote_qkey = IB_QP1_WELL_KNOWN_Q_KEY;
+
+	if (!(p_madw = osm_mad_pool_get(p_bind->p_mad_pool,
+					(osm_bind_handle_t) p_bind,
+					MAD_BLOCK_SIZE, &mad_addr)))
+		return;
+
+	pthread_mutex_lock(&p_vend->lock);
+	tid = cl_hton64(((uint64_t) rand_r(&p_vend->seed) << 32) |
+			p_vend->stats.sa_queries);
+	if (!osm_fabsim_sa_query(p_vend->p_fabric, &p_vend->seed, tid,
+				 osm_madw_get_mad_ptr(p_madw), &slid)) {
+		pthread_mutex_unlock(&p_vend->lock);
+		osm_mad_pool_put(p_bind->p_mad_pool, p_madw);
+		return;
+	}
+	p_vend->stats.sa_queries++;
+	pthread_mutex_unlock(&p_vend->lock);
+	p_madw->mad_addr.dest_lid = slid;
+
+	pthread_mutex_lock(&p_vend->cb_mutex);
+	(*p_bind->mad_recv_callback) (p_madw, p_bind->client_context, NULL);
+	pthread_mutex_unlock(&p_vend->cb_mutex);
+}
+
+static void dispatch(osm_vendor_t * p_vend, struct osm_fabsim_event *p_ev)
+{
+	fabsim_bind_t *p_bind = p_ev->p_bind;
+	osm_madw_t *p_req_madw = p_ev->p_req_madw;
+	ib_mad_t *p_mad;
+
+	switch (p_ev->type) {
+	case FABSIM_EV_RECV:
+		pthread_mutex_lock(&p_vend->cb_mutex);
+		(*p_bind->mad_recv_callback) (p_ev->p_madw,
+					      p_bind->client_context,
+					      p_req_madw);
+		pthread_mutex_unlock(&p_vend->cb_mutex);
+		break;
+	case FABSIM_EV_TIMEOUT:
+		p_mad = osm_madw_get_mad_ptr(p_req_madw);
+		if (p_mad->mgmt_class != IB_MCLASS_SUBN_DIR)
+			OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5707: "
+				"Send completed with error (timeout) -- "
+				"dropping\n\t\t\tClass 0x%x, Method 0x%X, "
+				"Attr 0x%X, TID 0x%" PRIx64 ", LID %u\n",
+				p_mad->mgmt_class, p_mad->method,
+				cl_ntoh16(p_mad->attr_id),
+				cl_ntoh64(p_mad->trans_id),
+				cl_ntoh16(p_req_madw->mad_addr.dest_lid));
+		else {
+			OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5708: "
+				"DR SMP Send completed with error (timeout) "
+				"-- dropping\n\t\t\tMethod 0x%X, Attr 0x%X, "
+				"TID 0x%" PRIx64 "\n", p_mad->method,
+				cl_ntoh16(p_mad->attr_id),
+				cl_ntoh64(p_mad->trans_id));
+			osm_dump_smp_dr_path(p_vend->p_log,
+					     (ib_smp_t *) p_mad, OSM_LOG_ERROR);
+		}
+		p_req_madw->status = IB_TIMEOUT;
+		/* cb frees req_madw */
+		pthread_mutex_lock(&p_vend->cb_mutex);
+		(*p_bind->send_err_callback) (p_bind->client_context,
+					      p_req_madw);
+		pthread_mutex_unlock(&p_vend->cb_mutex);
+		break;
+	case FABSIM_EV_SA_QUERY:
+		generate_sa_query(p_vend, p_ev->time);
+		break;
+	}
+}
+
+static void *fabsim_deliver(void *context)
+{
+	osm_vendor_t *p_vend = context;
+	struct osm_fabsim_event *p_ev;
+	struct timespec ts;
+	uint64_t now;
+
+	pthread_mutex_lock(&p_vend->lock);
+	while (!p_vend->exit) {
+		if (!p_vend->heap_size) {
+			pthread_cond_wait(&p_vend->cond, &p_vend->lock);
+			continue;
+		}
+		now = cl_get_time_stamp();
+		if (p_vend->heap[0]->time > now) {
+			ts.tv_sec = p_vend->heap[0]->time / 1000000;
+			ts.tv_nsec = (p_vend->heap[0]->time % 1000000) * 1000;
+			pthread_cond_timedwait(&p_vend->cond, &p_vend->lock,
+					       &ts);
+			continue;
+		}
+		p_ev = heap_pop(p_vend);
+		pthread_mutex_unlock(&p_vend->lock);
+
+		dispatch(p_vend, p_ev);
+		free(p_ev);
+
+		pthread_mutex_lock(&p_vend->lock);
+	}
+	pthread_mutex_unlock(&p_vend->lock);
+
+	return NULL;
+}
+
+static uint32_t env_uint(osm_log_t * p_log, const char *name, uint32_t def)
+{
+	char *val, *end;
+	unsigned long v;
+
+	if (!(val = getenv(name)))
+		return def;
+	v = strtoul(val, &end, 0);
+	if (*end || v > UINT32_MAX) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "Error:"
+			"%s=%s is invalid\n", name, val);
+		return def;
+	}
+	return (uint32_t) v;
+}
+
+ib_api_status_t
+osm_vendor_init(IN osm_vendor_t * const p_vend,
+		IN osm_log_t * const p_log, IN const uint32_t timeout)
+{
+	const char *topo;
+	char *val;
+	double loss;
+	ib_net64_t port_guid;
+	ib_api_status_t status = IB_ERROR;
+
+	OSM_LOG_ENTER(p_log);
+
+	p_vend->p_log = p_log;
+	p_vend->timeout = timeout;
+	p_vend->max_retries = OSM_DEFAULT_RETRY_COUNT;
+	pthread_mutex_init(&p_vend->cb_mutex, NULL);
+	pthread_mutex_init(&p_vend->lock, NULL);
+	pthread_cond_init(&p_vend->cond, NULL);
+
+	p_vend->latency = env_uint(p_log, "OSM_FABSIM_LATENCY", 1);
+	p_vend->sa_rate = env_uint(p_log, "OSM_FABSIM_SA_RATE", 0);
+	p_vend->seed = env_uint(p_log, "OSM_FABSIM_SEED", 1);
+	if ((val = getenv("OSM_FABSIM_LOSS")) != NULL) {
+		loss = strtod(val, NULL);
+		if (loss >= 0 && loss <= 100)
+			p_vend->loss_ppm = (uint32_t) (loss * 10000);
+		else
+			OSM_LOG(p_log, OSM_LOG_ERROR, "Error:"
+				"OSM_FABSIM_LOSS=%s is invalid\n", val);
+	}
+
+	if (!(topo = getenv("OSM_FABSIM_TOPOLOGY"))) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5709: "
+			"OSM_FABSIM_TOPOLOGY is not set\n");
+		goto Exit;
+	}
+	if (!(p_vend->p_fabric = osm_fabsim_fabric_load(p_log, topo)))
+		goto Exit;
+
+	port_guid = cl_hton64(strtoull(getenv("OSM_FABSIM_PORT_GUID") ?
+				       getenv("OSM_FABSIM_PORT_GUID") : "0",
+				       NULL, 0));
+	if (!(p_vend->p_fabric->p_local =
+	      osm_fabsim_find_port(p_vend->p_fabric, port_guid))) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 570A: "
+			"no port 0x%" PRIx64 " in the simulated fabric\n",
+			cl_ntoh64(port_guid));
+		goto Exit;
+	}
+
+	if (pthread_create(&p_vend->thread, NULL, fabsim_deliver, p_vend)) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 570B: "
+			"failed to start the delivery thread\n");
+		goto Exit;
+	}
+	p_vend->running = TRUE;
+
+	if (p_vend->sa_rate)
+		schedule(p_vend, FABSIM_EV_SA_QUERY, cl_get_time_stamp(),
+			 NULL, NULL, NULL);
+
+	OSM_LOG(p_log, OSM_LOG_INFO, "Simulating fabric from \'%s\': "
+		"latency %u usec/hop, loss %u ppm, %u SA queries/sec\n",
+		topo, p_vend->latency, p_vend->loss_ppm, p_vend->sa_rate);
+	status = IB_SUCCESS;
+
+Exit:
+	OSM_LOG_EXIT(p_log);
+	return status;
+}
+
+osm_vendor_t *osm_vendor_new(IN osm_log_t * const p_log,
+			     IN const uint32_t timeout)
+{
+	osm_vendor_t *p_vend = NULL;
+
+	OSM_LOG_ENTER(p_log);
+
+	if (!timeout) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 570C: "
+			"transaction timeout cannot be 0\n");
+		goto Exit;
+	}
+
+	p_vend = malloc(sizeof(*p_vend));
+	if (p_vend == NULL) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 570D: "
+			"Unable to allocate vendor object\n");
+		goto Exit;
+	}
+
+	memset(p_vend, 0, sizeof(*p_vend));
+
+	if (osm_vendor_init(p_vend, p_log, timeout) != IB_SUCCESS) {
+		osm_vendor_delete(&p_vend);
+		p_vend = NULL;
+	}
+
+Exit:
+	OSM_LOG_EXIT(p_log);
+	return (p_vend);
+}
+
+void osm_vendor_delete(IN osm_vendor_t ** const pp_vend)
+{
+	osm_vendor_t *p_vend = *pp_vend;
+	void *buf;
+	uint32_t i;
+
+	if (p_vend->running) {
+		pthread_mutex_lock(&p_vend->lock);
+		p_vend->exit = TRUE;
+		pthread_cond_signal(&p_vend->cond);
+		pthread_mutex_unlock(&p_vend->lock);
+		pthread_join(p_vend->thread, NULL);
+
+		OSM_LOG(p_vend->p_log, OSM_LOG_INFO, "Simulated fabric: "
+			"%" PRIu64 " MADs sent, %" PRIu64 " responses, %"
+			PRIu64 " undeliverable, %" PRIu64 " lost, %" PRIu64
+			" timeouts, %" PRIu64 " SA queries, %" PRIu64
+			" SA responses\n", p_vend->stats.sent,
+			p_vend->stats.responses, p_vend->stats.dropped,
+			p_vend->stats.lost, p_vend->stats.timeouts,
+			p_vend->stats.sa_queries, p_vend->stats.sa_responses);
+	}
+
+	/* the MADs still in flight belong to the already destroyed pool */
+	for (i = 0; i < p_vend->heap_size; i++)
+		free(p_vend->heap[i]);
+	free(p_vend->heap);
+	for (i = 0; i < p_vend->num_binds; i++)
+		free(p_vend->binds[i]);
+	while ((buf = p_vend->buf_cache) != NULL) {
+		p_vend->buf_cache = *(void **)buf;
+		free(buf);
+	}
+	if (p_vend->p_fabric)
+		osm_fabsim_fabric_destroy(p_vend->p_fabric);
+
+	pthread_cond_destroy(&p_vend->cond);
+	pthread_mutex_destroy(&p_vend->lock);
+	pthread_mutex_destroy(&p_vend->cb_mutex);
+	free(p_vend);
+	*pp_vend = NULL;
+}
+
+ib_api_status_t
+osm_vendor_get_all_port_attr(IN osm_vendor_t * const p_vend,
+			     IN ib_port_attr_t * const p_attr_array,
+			     IN uint32_t * const p_num_ports)
+{
+	osm_fabsim_fabric_t *p_fabric = p_vend->p_fabric;
+	osm_fabsim_node_t *p_node = p_fabric->p_local->p_node;
+	osm_fabsim_port_t *p_port;
+	ib_port_attr_t *attr = p_attr_array;
+	unsigned i, first, last, k;
+
+	OSM_LOG_ENTER(p_vend->p_log);
+
+	if (!*p_num_ports) {
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 570E: "
+			"Ports in should be > 0\n");
+		OSM_LOG_EXIT(p_vend->p_log);
+		return IB_INVALID_PARAMETER;
+	}
+
+	if (!p_attr_array) {
+		*p_num_ports = 0;
+		OSM_LOG_EXIT(p_vend->p_log);
+		return IB_INSUFFICIENT_MEMORY;
+	}
+
+	if (p_node->node_info.node_type == IB_NODE_TYPE_SWITCH)
+		first = last = 0;
+	else {
+		first = 1;
+		last = p_node->node_info.num_ports;
+	}
+
+	pthread_mutex_lock(&p_fabric->lock);
+	for (i = first; i <= last && attr - p_attr_array < *p_num_ports; i++) {
+		p_port = &p_node->ports[i];
+		attr->port_guid = p_port->port_guid;
+		attr->lid = cl_ntoh16(p_port->port_info.base_lid);
+		attr->port_num = (uint8_t) i;
+		attr->sm_lid = cl_ntoh16(p_port->port_info.master_sm_base_lid);
+		attr->link_state =
+		    ib_port_info_get_port_state(&p_port->port_info);
+		if (attr->num_pkeys && attr->p_pkey_table) {
+			if (attr->num_pkeys > OSM_FABSIM_PKEY_ENTRIES)
+				attr->num_pkeys = OSM_FABSIM_PKEY_ENTRIES;
+			for (k = 0; k < attr->num_pkeys; k++)
+				attr->p_pkey_table[k] = p_port->pkeys[k];
+		}
+		attr->num_pkeys = OSM_FABSIM_PKEY_ENTRIES;
+		attr++;
+	}
+	pthread_mutex_unlock(&p_fabric->lock);
+
+	*p_num_ports = attr - p_attr_array;
+
+	OSM_LOG_EXIT(p_vend->p_log);
+	return IB_SUCCESS;
+}
+
+osm_bind_handle_t
+osm_vendor_bind(IN osm_vendor_t * const p_vend,
+		IN osm_bind_info_t * const p_user_bind,
+		IN osm_mad_pool_t * const p_mad_pool,
+		IN osm_vend_mad_recv_callback_t mad_recv_callback,
+		IN osm_vend_mad_send_err_callback_t send_err_callback,
+		IN void *context)
+{
+	osm_fabsim_port_t *p_port;
+	fabsim_bind_t *p_bind = NULL;
+
+	OSM_LOG_ENTER(p_vend->p_log);
+
+	CL_ASSERT(p_user_bind);
+	CL_ASSERT(p_mad_pool);
+	CL_ASSERT(mad_recv_callback);
+	CL_ASSERT(send_err_callback);
+
+	OSM_LOG(p_vend->p_log, OSM_LOG_INFO,
+		"Binding to port 0x%" PRIx64 "\n",
+		cl_ntoh64(p_user_bind->port_guid));
+
+	p_port = osm_fabsim_find_port(p_vend->p_fabric,
+				      p_user_bind->port_guid);
+	if (!p_port) {
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 570F: "
+			"Unable to open port 0x%" PRIx64 "\n",
+			cl_ntoh64(p_user_bind->port_guid));
+		goto Exit;
+	}
+
+	if (p_vend->num_binds == OSM_FABSIM_MAX_BINDS) {
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5710: "
+			"too many agents, cannot bind class %u\n",
+			p_user_bind->mad_class);
+		goto Exit;
+	}
+
+	if (!(p_bind = malloc(sizeof(*p_bind)))) {
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5711: "
+			"Unable to allocate internal bind object\n");
+		goto Exit;
+	}
+
+	memset(p_bind, 0, sizeof(*p_bind));
+	p_bind->p_vend = p_vend;
+	p_bind->client_context = context;
+	p_bind->mad_recv_callback = mad_recv_callback;
+	p_bind->send_err_callback = send_err_callback;
+	p_bind->p_mad_pool = p_mad_pool;
+	p_bind->port_guid = p_port->port_guid;
+	p_bind->mad_class = p_user_bind->mad_class;
+	p_bind->is_responder = p_user_bind->is_responder;
+	p_bind->timeout = p_user_bind->timeout ? p_user_bind->timeout :
+			  p_vend->timeout;
+	p_bind->max_retries = p_user_bind->retries ? p_user_bind->retries :
+			      p_vend->max_retries;
+
+	pthread_mutex_lock(&p_vend->p_fabric->lock);
+	p_vend->p_fabric->p_local = p_port;
+	pthread_mutex_unlock(&p_vend->p_fabric->lock);
+
+	pthread_mutex_lock(&p_vend->lock);
+	p_vend->binds[p_vend->num_binds++] = p_bind;
+	pthread_mutex_unlock(&p_vend->lock);
+
+Exit:
+	OSM_LOG_EXIT(p_vend->p_log);
+	return ((osm_bind_handle_t) p_bind);
+}
+
+static void
+__osm_vendor_recv_dummy_cb(IN osm_madw_t * p_madw,
+			   IN void *bind_context, IN osm_madw_t * p_req_madw)
+{
+#ifdef _DEBUG_
+	fprintf(stderr,
+		"__osm_vendor_recv_dummy_cb: Ignoring received MAD after osm_vendor_unbind\n");
+#endif
+}
+
+static void
+__osm_vendor_send_err_dummy_cb(IN void *bind_context,
+			       IN osm_madw_t * p_req_madw)
+{
+#ifdef _DEBUG_
+	fprintf(stderr,
+		"__osm_vendor_send_err_dummy_cb: Ignoring send error after osm_vendor_unbind\n");
+#endif
+}
+
+void osm_vendor_unbind(IN osm_bind_handle_t h_bind)
+{
+	fabsim_bind_t *p_bind = (fabsim_bind_t *) h_bind;
+	osm_vendor_t *p_vend = p_bind->p_vend;
+
+	OSM_LOG_ENTER(p_vend->p_log);
+
+	pthread_mutex_lock(&p_vend->cb_mutex);
+	p_bind->mad_recv_callback = __osm_vendor_recv_dummy_cb;
+	p_bind->send_err_callback = __osm_vendor_send_err_dummy_cb;
+	p_bind->is_responder = FALSE;
+	pthread_mutex_unlock(&p_vend->cb_mutex);
+
+	OSM_LOG_EXIT(p_vend->p_log);
+}
+
+ib_mad_t *osm_vendor_get(IN osm_bind_handle_t h_bind,
+			 IN const uint32_t mad_size,
+			 IN osm_vend_wrap_t * const p_vw)
+{
+	fabsim_bind_t *p_bind = (fabsim_bind_t *) h_bind;
+
+	CL_ASSERT(p_vw);
+	p_vw->size = mad_size;
+	p_vw->p_buf = buf_get(p_bind->p_vend, mad_size);
+	p_vw->h_bind = h_bind;
+	return (ib_mad_t *) p_vw->p_buf;
+}
+
+void
+osm_vendor_put(IN osm_bind_handle_t h_bind, IN osm_vend_wrap_t * const p_vw)
+{
+	fabsim_bind_t *p_bind = (fabsim_bind_t *) h_bind;
+	osm_madw_t *p_madw;
+
+	CL_ASSERT(p_vw);
+
+	buf_put(p_bind->p_vend, p_vw->p_buf, p_vw->size);
+	p_vw->p_buf = NULL;
+	p_madw = PARENT_STRUCT(p_vw, osm_madw_t, vend_wrap);
+	p_madw->p_mad = NULL;
+}
+
+/* Number of transmissions lost before one gets through */
+static uint32_t lost_attempts(osm_vendor_t * p_vend, uint32_t max_retries)
+{
+	uint32_t lost = 0;
+
+	if (!p_vend->loss_ppm)
+		return 0;
+
+	pthread_mutex_lock(&p_vend->lock);
+	while (lost <= max_retries &&
+	       (uint32_t) rand_r(&p_vend->seed) % 1000000 < p_vend->loss_ppm)
+		lost++;
+	p_vend->stats.lost += lost;
+	pthread_mutex_unlock(&p_vend->lock);
+
+	return lost;
+}
+
+ib_api_status_t
+osm_vendor_send(IN osm_bind_handle_t h_bind,
+		IN osm_madw_t * const p_madw, IN boolean_t const resp_expected)
+{
+	fabsim_bind_t *const p_bind = h_bind;
+	osm_vendor_t *const p_vend = p_bind->p_vend;
+	ib_mad_t *const p_mad = osm_madw_get_mad_ptr(p_madw);
+	osm_mad_addr_t mad_addr;
+	osm_madw_t *p_resp_madw;
+	osm_fabsim_result_t result = OSM_FABSIM_DROP;
+	uint64_t now = cl_get_time_stamp();
+	uint32_t lost;
+	unsigned hops = 0;
+
+	OSM_LOG_ENTER(p_vend->p_log);
+
+	pthread_mutex_lock(&p_vend->lock);
+	p_vend->stats.sent++;
+	if (!resp_expected && p_mad->mgmt_class == IB_MCLASS_SUBN_ADM &&
+	    ib_mad_is_response(p_mad))
+		p_vend->stats.sa_responses++;
+	pthread_mutex_unlock(&p_vend->lock);
+
+	/* responses and unsolicited MADs leave the simulation here */
+	if (!resp_expected) {
+		osm_mad_pool_put(p_bind->p_mad_pool, p_madw);
+		goto Exit;
+	}
+
+	memset(&mad_addr, 0, sizeof(mad_addr));
+	if (p_mad->mgmt_class != IB_MCLASS_SUBN_DIR &&
+	    p_mad->mgmt_class != IB_MCLASS_SUBN_LID) {
+		mad_addr.addr_type.gsi.remote_qp = CL_HTON32(1);
+		mad_addr.addr_type.gsi.remote_qkey = IB_QP1_WELL_KNOWN_Q_KEY;
+	}
+	if (!(p_resp_madw = osm_mad_pool_get(p_bind->p_mad_pool, h_bind,
+					     MAD_BLOCK_SIZE, &mad_addr))) {
+		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5712: "
+			"request for a new madw failed\n");
+		p_madw->status = IB_INSUFFICIENT_RESOURCES;
+		pthread_mutex_lock(&p_vend->cb_mutex);
+		(*p_bind->send_err_callback) (p_bind->client_context, p_madw);	/* cb frees madw */
+		pthread_mutex_unlock(&p_vend->cb_mutex);
+		goto Exit;
+	}
+
+	/* a MAD lost on every attempt never reaches the target */
+	if ((lost = lost_attempts(p_vend, p_bind->max_retries)) <=
+	    p_bind->max_retries)
+		result = osm_fabsim_process(p_vend->p_fabric, p_mad,
+					    p_madw->mad_addr.dest_lid,
+					    osm_madw_get_mad_ptr(p_resp_madw),
+					    &p_resp_madw->mad_addr.dest_lid,
+					    &hops);
+
+	if (result != OSM_FABSIM_RESPOND) {
+		osm_mad_pool_put(p_bind->p_mad_pool, p_resp_madw);
+		pthread_mutex_lock(&p_vend->lock);
+		if (lost <= p_bind->max_retries)
+			p_vend->stats.dropped++;
+		p_vend->stats.timeouts++;
+		pthread_mutex_unlock(&p_vend->lock);
+		schedule(p_vend, FABSIM_EV_TIMEOUT,
+			 now + (uint64_t) p_bind->timeout * 1000 *
+			 (p_bind->max_retries + 1), p_bind, NULL, p_madw);
+		goto Exit;
+	}
+
+	if (p_mad->mgmt_class == IB_MCLASS_SUBN_DIR ||
+	    p_mad->mgmt_class == IB_MCLASS_SUBN_LID)
+		p_resp_madw->mad_addr.addr_type.smi.source_lid =
+		    p_resp_madw->mad_addr.dest_lid;
+
+	pthread_mutex_lock(&p_vend->lock);
+	p_vend->stats.responses++;
+	pthread_mutex_unlock(&p_vend->lock);
+
+	schedule(p_vend, FABSIM_EV_RECV,
+		 now + (uint64_t) lost * p_bind->timeout * 1000 +
+		 2 * hops * p_vend->latency, p_bind, p_resp_madw, p_madw);
+
+Exit:
+	OSM_LOG_EXIT(p_vend->p_log);
+	return IB_SUCCESS;
+}
+
+ib_api_status_t osm_vendor_local_lid_change(IN osm_bind_handle_t h_bind)
+{
+	return IB_SUCCESS;
+}
+
+void osm_vendor_set_sm(IN osm_bind_handle_t h_bind, IN boolean_t is_sm_val)
+{
+	fabsim_bind_t *p_bind = (fabsim_bind_t *) h_bind;
+	osm_fabsim_fabric_t *p_fabric = p_bind->p_vend->p_fabric;
+	ib_port_info_t *p_pi = &p_fabric->p_local->port_info;
+
+	pthread_mutex_lock(&p_fabric->lock);
+	if (is_sm_val)
+		p_pi->capability_mask |= IB_PORT_CAP_IS_SM;
+	else
+		p_pi->capability_mask &= ~IB_PORT_CAP_IS_SM;
+	pthread_mutex_unlock(&p_fabric->lock);
+}
+
+void osm_vendor_set_debug(IN osm_vendor_t * const p_vend, IN int32_t level)
+{
+}
+
+#endif				/* OSM_VENDOR_INTF_FABSIM */
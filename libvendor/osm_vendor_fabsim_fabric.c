@@ -0,0 +1,1145 @@
+/*
+ * Copyright (c) 2004-2008 Voltaire, Inc. All rights reserved.
+ * Copyright (c) 2002-2005 Mellanox Technologies LTD. All rights reserved.
+ * Copyright (c) 1996-2003 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *    Simulated fabric of the fabsim vendor: topology loader, routing
+ *    and the SMA and PMA of the simulated nodes.
+ *
+ * Environment:
+ *    Linux User Mode
+ *
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#ifdef OSM_VENDOR_INTF_FABSIM
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <iba/ib_types.h>
+#include <complib/cl_timer.h>
+#include <opensm/osm_log.h>
+#include <vendor/osm_vendor_api.h>
+
+#define FABSIM_LFT_CAP		0xC000
+#define FABSIM_MCAST_CAP	1024
+#define FABSIM_MFT_POSITIONS	16
+#define FABSIM_MAX_LID_HOPS	64
+#define FABSIM_CA_CAP_MASK	CL_HTON32(0x02510868)
+#define FABSIM_SW0_CAP_MASK	CL_HTON32(0x00000048)
+
+/* Link as parsed, resolved once all nodes are known */
+typedef struct fabsim_link {
+	uint32_t node;
+	uint8_t port;
+	uint8_t rport;
+	uint8_t width;
+	uint8_t speed;
+	char *rid;
+} fabsim_link_t;
+
+typedef struct fabsim_id {
+	const char *id;
+	uint32_t node;
+} fabsim_id_t;
+
+static uint64_t fabsim_mix(uint64_t x)
+{
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+static int fabsim_id_cmp(const void *a, const void *b)
+{
+	return strcmp(((const fabsim_id_t *)a)->id,
+		      ((const fabsim_id_t *)b)->id);
+}
+
+static boolean_t fabsim_is_switch(const osm_fabsim_node_t * p_node)
+{
+	return p_node->node_info.node_type == IB_NODE_TYPE_SWITCH;
+}
+
+static boolean_t fabsim_link_up(const osm_fabsim_port_t * p_port)
+{
+	return p_port->p_remote &&
+	    ib_port_info_get_port_phys_state(&p_port->port_info) ==
+	    IB_PORT_PHYS_STATE_LINKUP;
+}
+
+static uint8_t fabsim_state(const osm_fabsim_port_t * p_port)
+{
+	return ib_port_info_get_port_state(&p_port->port_info);
+}
+
+/* Returns the port holding the LIDs of the port's node */
+static osm_fabsim_port_t *fabsim_lid_port(osm_fabsim_port_t * p_port)
+{
+	return fabsim_is_switch(p_port->p_node) ?
+	    &p_port->p_node->ports[0] : p_port;
+}
+
+static void fabsim_set_lids(osm_fabsim_fabric_t * p_fabric,
+			    osm_fabsim_port_t * p_port, ib_net16_t base_lid,
+			    uint8_t lmc)
+{
+	ib_port_info_t *p_pi = &p_port->port_info;
+	unsigned lid, n;
+
+	lid = cl_ntoh16(p_pi->base_lid);
+	n = 1 << ib_port_info_get_lmc(p_pi);
+	for (; n && lid && lid <= IB_LID_UCAST_END_HO; n--, lid++)
+		if (p_fabric->lids[lid] == p_port)
+			p_fabric->lids[lid] = NULL;
+
+	p_pi->base_lid = base_lid;
+	ib_port_info_set_lmc(p_pi, lmc);
+
+	lid = cl_ntoh16(base_lid);
+	n = 1 << lmc;
+	for (; n && lid && lid <= IB_LID_UCAST_END_HO; n--, lid++)
+		p_fabric->lids[lid] = p_port;
+}
+
+static void fabsim_set_psc(osm_fabsim_port_t * p_port)
+{
+	if (fabsim_is_switch(p_port->p_node))
+		p_port->p_node->switch_info.life_state |= IB_SWITCH_PSC;
+}
+
+static void fabsim_port_init(osm_fabsim_port_t * p_port, uint8_t port_num,
+			     uint8_t width, uint8_t speed)
+{
+	ib_port_info_t *p_pi = &p_port->port_info;
+	osm_fabsim_node_t *p_node = p_port->p_node;
+	uint64_t hash = fabsim_mix(cl_ntoh64(p_port->port_guid) + port_num);
+	boolean_t up = p_port->p_remote != NULL ||
+	    (port_num == 0 && fabsim_is_switch(p_node));
+
+	memset(p_pi, 0, sizeof(*p_pi));
+	p_pi->subnet_prefix = IB_DEFAULT_SUBNET_PREFIX;
+	if (!fabsim_is_switch(p_node))
+		p_pi->capability_mask = FABSIM_CA_CAP_MASK;
+	else if (port_num == 0)
+		p_pi->capability_mask = FABSIM_SW0_CAP_MASK;
+	p_pi->local_port_num = port_num;
+	p_pi->link_width_enabled = width;
+	p_pi->link_width_supported = width;
+	p_pi->link_width_active = width;
+	ib_port_info_set_port_state(p_pi, up ? IB_LINK_INIT : IB_LINK_DOWN);
+	ib_port_info_set_link_speed_sup((speed << 1) - 1, p_pi);
+	ib_port_info_set_port_phys_state(up ? IB_PORT_PHYS_STATE_LINKUP :
+					 IB_PORT_PHYS_STATE_POLLING, p_pi);
+	ib_port_info_set_link_down_def_state(p_pi,
+					     IB_PORT_PHYS_STATE_POLLING);
+	p_pi->link_speed = (uint8_t) (speed << IB_PORT_LINK_SPEED_SHIFT |
+				      ((speed << 1) - 1));
+	ib_port_info_set_neighbor_mtu(p_pi, IB_MTU_LEN_2048);
+	p_pi->vl_cap = 3 << 4;
+	p_pi->vl_arb_high_cap = 8;
+	p_pi->vl_arb_low_cap = 8;
+	p_pi->mtu_cap = IB_MTU_LEN_2048;
+	ib_port_info_set_op_vls(p_pi, 1);
+	p_pi->guid_cap = 1;
+	p_pi->resp_time_value = 8;
+
+	memset(p_port->pkeys, 0, sizeof(p_port->pkeys));
+	p_port->pkeys[0] = IB_DEFAULT_PKEY;
+
+	p_port->data_rate = (uint32_t) (hash & 0xFFFFFF);
+	p_port->err_rate = ((hash >> 24) & 63) == 0 ?
+	    1 + (uint32_t) ((hash >> 32) % 100) : 0;
+}
+
+static char *fabsim_quoted(char *p, char **pp_end)
+{
+	char *s, *e;
+
+	if (!(s = strchr(p, '"')) || !(e = strchr(s + 1, '"')))
+		return NULL;
+	*e = '\0';
+	if (pp_end)
+		*pp_end = e + 1;
+	return s + 1;
+}
+
+/* Parses the last "<width>x<speed>" token of the comment at p, e.g. 4xQDR */
+static void fabsim_parse_link(const char *p, uint8_t * p_width,
+			      uint8_t * p_speed)
+{
+	unsigned w;
+	char s[4];
+
+	for (; *p; p++) {
+		if (!isdigit(*p) || !isspace(p[-1]))
+			continue;
+		if (sscanf(p, "%ux%3[A-Z]", &w, s) != 2)
+			continue;
+		switch (w) {
+		case 1:
+			*p_width = IB_LINK_WIDTH_ACTIVE_1X;
+			break;
+		case 8:
+			*p_width = IB_LINK_WIDTH_ACTIVE_8X;
+			break;
+		case 12:
+			*p_width = IB_LINK_WIDTH_ACTIVE_12X;
+			break;
+		default:
+			*p_width = IB_LINK_WIDTH_ACTIVE_4X;
+		}
+		if (!strcmp(s, "SDR"))
+			*p_speed = IB_LINK_SPEED_ACTIVE_2_5;
+		else if (!strcmp(s, "DDR"))
+			*p_speed = IB_LINK_SPEED_ACTIVE_5;
+		else
+			*p_speed = IB_LINK_SPEED_ACTIVE_10;
+	}
+}
+
+static osm_fabsim_node_t *fabsim_add_node(osm_fabsim_fabric_t * p_fabric,
+					  uint32_t * p_max)
+{
+	osm_fabsim_node_t *p_nodes;
+
+	if (p_fabric->num_nodes == *p_max) {
+		*p_max = *p_max ? 2 * *p_max : 1024;
+		p_nodes = realloc(p_fabric->nodes, *p_max * sizeof(*p_nodes));
+		if (!p_nodes)
+			return NULL;
+		p_fabric->nodes = p_nodes;
+	}
+	p_nodes = &p_fabric->nodes[p_fabric->num_nodes++];
+	memset(p_nodes, 0, sizeof(*p_nodes));
+	return p_nodes;
+}
+
+static int fabsim_parse(osm_fabsim_fabric_t * p_fabric, FILE * f,
+			fabsim_link_t ** pp_links, uint32_t * p_num_links)
+{
+	char line[1024], *p, *id, *end;
+	uint64_t node_guid = 0, sys_guid = 0, guid;
+	uint32_t vendid = 0, devid = 0, max_nodes = 0, max_links = 0;
+	osm_fabsim_node_t *p_node = NULL;
+	fabsim_link_t *p_link;
+	unsigned num_ports, port, rport, lineno = 0;
+	uint8_t type;
+
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		for (p = line; isspace(*p); p++) ;
+		if (!*p || *p == '#')
+			continue;
+
+		if (!strncmp(p, "vendid=", 7)) {
+			vendid = strtoul(p + 7, NULL, 0);
+			continue;
+		} else if (!strncmp(p, "devid=", 6)) {
+			devid = strtoul(p + 6, NULL, 0);
+			continue;
+		} else if (!strncmp(p, "sysimgguid=", 11)) {
+			sys_guid = strtoull(p + 11, NULL, 0);
+			continue;
+		} else if (!strncmp(p, "switchguid=", 11) ||
+			   !strncmp(p, "caguid=", 7) ||
+			   !strncmp(p, "rtguid=", 7)) {
+			node_guid = strtoull(strchr(p, '=') + 1, NULL, 0);
+			continue;
+		}
+
+		if (*p == '[') {
+			if (!p_node || sscanf(p, "[%u]", &port) != 1 ||
+			    port == 0 ||
+			    port > p_node->node_info.num_ports) {
+				OSM_LOG(p_fabric->p_log, OSM_LOG_ERROR,
+					"ERR 5701: line %u: bad port\n",
+					lineno);
+				return -1;
+			}
+			p = strchr(p, ']') + 1;
+			if (*p == '(') {
+				guid = strtoull(p + 1, NULL, 16);
+				p_node->ports[port].port_guid = cl_hton64(guid);
+			}
+			if (!(id = fabsim_quoted(p, &end)) ||
+			    sscanf(end, "[%u]", &rport) != 1)
+				continue;
+
+			if (*p_num_links == max_links) {
+				max_links = max_links ? 2 * max_links : 4096;
+				p_link = realloc(*pp_links,
+						 max_links * sizeof(*p_link));
+				if (!p_link)
+					return -1;
+				*pp_links = p_link;
+			}
+			p_link = &(*pp_links)[(*p_num_links)++];
+			p_link->node = p_node - p_fabric->nodes;
+			p_link->port = port;
+			p_link->rport = rport;
+			p_link->width = IB_LINK_WIDTH_ACTIVE_4X;
+			p_link->speed = IB_LINK_SPEED_ACTIVE_2_5;
+			if ((p = strchr(end, '#')))
+				fabsim_parse_link(p, &p_link->width,
+						  &p_link->speed);
+			if (!(p_link->rid = strdup(id)))
+				return -1;
+			continue;
+		}
+
+		if (!strncmp(p, "Switch", 6))
+			type = IB_NODE_TYPE_SWITCH;
+		else if (!strncmp(p, "Ca", 2))
+			type = IB_NODE_TYPE_CA;
+		else if (!strncmp(p, "Rt", 2))
+			type = IB_NODE_TYPE_ROUTER;
+		else
+			continue;
+
+		while (*p && !isspace(*p))
+			p++;
+		num_ports = strtoul(p, &p, 0);
+		if (!num_ports || num_ports >= 255 ||
+		    !(id = fabsim_quoted(p, &end))) {
+			OSM_LOG(p_fabric->p_log, OSM_LOG_ERROR,
+				"ERR 5702: line %u: bad node\n", lineno);
+			return -1;
+		}
+
+		if (!(p_node = fabsim_add_node(p_fabric, &max_nodes)) ||
+		    !(p_node->id = strdup(id)) ||
+		    !(p_node->ports = calloc(num_ports + 1,
+					     sizeof(*p_node->ports))))
+			return -1;
+
+		if ((p = strchr(end, '#')) && (id = fabsim_quoted(p, NULL)))
+			strncpy(p_node->desc, id, sizeof(p_node->desc) - 1);
+		else
+			strncpy(p_node->desc, p_node->id,
+				sizeof(p_node->desc) - 1);
+
+		if (!node_guid)
+			node_guid = 0x0002c90000000000ULL + p_fabric->num_nodes;
+
+		p_node->node_info.base_version = 1;
+		p_node->node_info.class_version = 1;
+		p_node->node_info.node_type = type;
+		p_node->node_info.num_ports = num_ports;
+		p_node->node_info.node_guid = cl_hton64(node_guid);
+		p_node->node_info.sys_guid = cl_hton64(sys_guid ? sys_guid :
+						       node_guid);
+		p_node->node_info.partition_cap =
+		    cl_hton16(OSM_FABSIM_PKEY_ENTRIES);
+		p_node->node_info.device_id = cl_hton16(devid);
+		p_node->node_info.port_num_vendor_id =
+		    cl_hton32(vendid & 0xFFFFFF);
+		for (port = 0; port <= num_ports; port++)
+			p_node->ports[port].port_guid =
+			    type == IB_NODE_TYPE_SWITCH ?
+			    cl_hton64(node_guid) : cl_hton64(node_guid + port);
+
+		node_guid = sys_guid = 0;
+		vendid = devid = 0;
+	}
+
+	return 0;
+}
+
+osm_fabsim_fabric_t *osm_fabsim_fabric_load(IN osm_log_t * p_log,
+					    IN const char *file_name)
+{
+	osm_fabsim_fabric_t *p_fabric;
+	osm_fabsim_node_t *p_node;
+	osm_fabsim_port_t *p_port, *p_rport;
+	fabsim_link_t *links = NULL, *p_link;
+	fabsim_id_t *ids = NULL, key, *p_id;
+	uint32_t num_links = 0, i, j, num_ca_ports = 0;
+	uint64_t now = cl_get_time_stamp();
+	FILE *f;
+	int ret = -1;
+
+	OSM_LOG_ENTER(p_log);
+
+	if (!(f = fopen(file_name, "r"))) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5703: "
+			"cannot open topology file \'%s\': %m\n", file_name);
+		OSM_LOG_EXIT(p_log);
+		return NULL;
+	}
+
+	if (!(p_fabric = calloc(1, sizeof(*p_fabric))))
+		goto Exit;
+	p_fabric->p_log = p_log;
+	pthread_mutex_init(&p_fabric->lock, NULL);
+
+	if (fabsim_parse(p_fabric, f, &links, &num_links) ||
+	    !p_fabric->num_nodes)
+		goto Exit;
+
+	/* resolve the links by node name */
+	if (!(ids = malloc(p_fabric->num_nodes * sizeof(*ids))))
+		goto Exit;
+	for (i = 0; i < p_fabric->num_nodes; i++) {
+		ids[i].id = p_fabric->nodes[i].id;
+		ids[i].node = i;
+	}
+	qsort(ids, p_fabric->num_nodes, sizeof(*ids), fabsim_id_cmp);
+
+	for (p_link = links; p_link < links + num_links; p_link++) {
+		key.id = p_link->rid;
+		p_id = bsearch(&key, ids, p_fabric->num_nodes, sizeof(*ids),
+			       fabsim_id_cmp);
+		p_node = &p_fabric->nodes[p_link->node];
+		if (!p_id ||
+		    p_link->rport == 0 ||
+		    p_link->rport >
+		    p_fabric->nodes[p_id->node].node_info.num_ports) {
+			OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5704: "
+				"bad link from \'%s\' port %u to \'%s\' "
+				"port %u\n", p_node->id, p_link->port,
+				p_link->rid, p_link->rport);
+			goto Exit;
+		}
+		p_port = &p_node->ports[p_link->port];
+		p_rport = &p_fabric->nodes[p_id->node].ports[p_link->rport];
+		p_port->p_remote = p_rport;
+		p_rport->p_remote = p_port;
+	}
+
+	for (i = 0; i < p_fabric->num_nodes; i++) {
+		p_node = &p_fabric->nodes[i];
+		if (fabsim_is_switch(p_node)) {
+			p_node->switch_info.lin_cap = cl_hton16(FABSIM_LFT_CAP);
+			p_node->switch_info.mcast_cap =
+			    cl_hton16(FABSIM_MCAST_CAP);
+			p_node->switch_info.enforce_cap =
+			    cl_hton16(OSM_FABSIM_PKEY_ENTRIES);
+			p_node->switch_info.life_state = 0x10 | IB_SWITCH_PSC;
+		}
+		for (j = 0; j <= p_node->node_info.num_ports; j++) {
+			p_port = &p_node->ports[j];
+			p_port->p_node = p_node;
+			p_port->data_epoch = p_port->ext_epoch =
+			    p_port->err_epoch = now;
+			fabsim_port_init(p_port, j, IB_LINK_WIDTH_ACTIVE_4X,
+					 IB_LINK_SPEED_ACTIVE_2_5);
+			if (j && p_port->p_remote &&
+			    !fabsim_is_switch(p_node))
+				num_ca_ports++;
+		}
+	}
+
+	for (p_link = links; p_link < links + num_links; p_link++)
+		fabsim_port_init(&p_fabric->nodes[p_link->node].
+				 ports[p_link->port], p_link->port,
+				 p_link->width, p_link->speed);
+
+	p_fabric->ca_ports = malloc((num_ca_ports + 1) *
+				    sizeof(*p_fabric->ca_ports));
+	if (!p_fabric->ca_ports)
+		goto Exit;
+	for (i = 0; i < p_fabric->num_nodes; i++) {
+		p_node = &p_fabric->nodes[i];
+		if (fabsim_is_switch(p_node))
+			continue;
+		for (j = 1; j <= p_node->node_info.num_ports; j++)
+			if (p_node->ports[j].p_remote)
+				p_fabric->ca_ports[p_fabric->num_ca_ports++] =
+				    &p_node->ports[j];
+	}
+
+	OSM_LOG(p_log, OSM_LOG_INFO, "Loaded %u nodes, %u links, "
+		"%u CA ports from \'%s\'\n", p_fabric->num_nodes,
+		num_links / 2, p_fabric->num_ca_ports, file_name);
+	ret = 0;
+
+Exit:
+	fclose(f);
+	for (p_link = links; p_link < links + num_links; p_link++)
+		free(p_link->rid);
+	free(links);
+	free(ids);
+	if (ret && p_fabric) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5705: "
+			"failed to load topology file \'%s\'\n", file_name);
+		osm_fabsim_fabric_destroy(p_fabric);
+		p_fabric = NULL;
+	}
+	OSM_LOG_EXIT(p_log);
+	return p_fabric;
+}
+
+void osm_fabsim_fabric_destroy(IN osm_fabsim_fabric_t * p_fabric)
+{
+	osm_fabsim_node_t *p_node;
+
+	for (p_node = p_fabric->nodes;
+	     p_node < p_fabric->nodes + p_fabric->num_nodes; p_node++) {
+		free(p_node->id);
+		free(p_node->lft);
+		free(p_node->mft);
+		free(p_node->ports);
+	}
+	free(p_fabric->nodes);
+	free(p_fabric->ca_ports);
+	pthread_mutex_destroy(&p_fabric->lock);
+	free(p_fabric);
+}
+
+osm_fabsim_port_t *osm_fabsim_find_port(IN osm_fabsim_fabric_t * p_fabric,
+					IN ib_net64_t port_guid)
+{
+	osm_fabsim_node_t *p_node;
+	unsigned i;
+
+	if (!port_guid)
+		return p_fabric->num_ca_ports ? p_fabric->ca_ports[0] : NULL;
+
+	for (p_node = p_fabric->nodes;
+	     p_node < p_fabric->nodes + p_fabric->num_nodes; p_node++)
+		for (i = 0; i <= p_node->node_info.num_ports; i++)
+			if (p_node->ports[i].port_guid == port_guid)
+				return &p_node->ports[i];
+	return NULL;
+}
+
+/**********************************************************************
+ Routing.  Both walks return the port through which the MAD enters
+ the target node.
+**********************************************************************/
+static osm_fabsim_port_t *fabsim_dr_route(IN osm_fabsim_fabric_t * p_fabric,
+					  IN const ib_smp_t * p_smp,
+					  OUT unsigned *p_hops)
+{
+	osm_fabsim_port_t *p_in = p_fabric->p_local, *p_out;
+	osm_fabsim_node_t *p_node;
+	uint8_t port;
+	unsigned i;
+
+	if (p_smp->hop_count >= IB_SUBNET_PATH_HOPS_MAX)
+		return NULL;
+
+	for (i = 1; i <= p_smp->hop_count; i++) {
+		p_node = p_in->p_node;
+		port = p_smp->initial_path[i];
+		/* only switches forward, a CA can only be left at the source */
+		if (port == 0 || port > p_node->node_info.num_ports ||
+		    (i > 1 && !fabsim_is_switch(p_node)))
+			return NULL;
+		p_out = &p_node->ports[port];
+		if (!fabsim_link_up(p_out))
+			return NULL;
+		p_in = p_out->p_remote;
+	}
+
+	*p_hops = p_smp->hop_count;
+	return p_in;
+}
+
+static osm_fabsim_port_t *fabsim_lid_route(IN osm_fabsim_fabric_t * p_fabric,
+					   IN ib_net16_t dest_lid,
+					   IN uint8_t min_state,
+					   OUT unsigned *p_hops)
+{
+	osm_fabsim_port_t *p_in = p_fabric->p_local, *p_out, *p_dest;
+	osm_fabsim_node_t *p_node = p_in->p_node;
+	unsigned lid = cl_ntoh16(dest_lid), hops = 0;
+	uint8_t port;
+
+	if (lid == 0 || lid > IB_LID_UCAST_END_HO ||
+	    !(p_dest = p_fabric->lids[lid]))
+		return NULL;
+
+	p_out = fabsim_is_switch(p_node) ? NULL : p_in;
+	while (fabsim_lid_port(p_in) != p_dest) {
+		if (!p_out) {
+			if (lid >= p_node->lft_size)
+				return NULL;
+			port = p_node->lft[lid];
+			if (port == 0 || port > p_node->node_info.num_ports)
+				return NULL;
+			p_out = &p_node->ports[port];
+		}
+		if (!fabsim_link_up(p_out) ||
+		    fabsim_state(p_out) < min_state ||
+		    fabsim_state(p_out->p_remote) < min_state ||
+		    ++hops > FABSIM_MAX_LID_HOPS)
+			return NULL;
+		p_in = p_out->p_remote;
+		p_node = p_in->p_node;
+		if (!fabsim_is_switch(p_node) && fabsim_lid_port(p_in) != p_dest)
+			return NULL;
+		p_out = NULL;
+	}
+
+	*p_hops = hops;
+	return p_in;
+}
+
+/**********************************************************************
+ Subnet Management Agent
+**********************************************************************/
+static void fabsim_set_port_state(osm_fabsim_port_t * p_port, uint8_t state)
+{
+	uint8_t old = fabsim_state(p_port);
+
+	if (old == state)
+		return;
+	ib_port_info_set_port_state(&p_port->port_info, state);
+	if (old == IB_LINK_DOWN || state == IB_LINK_DOWN ||
+	    state == IB_LINK_INIT)
+		fabsim_set_psc(p_port);
+}
+
+static void fabsim_set_phys_state(osm_fabsim_port_t * p_port, uint8_t phys)
+{
+	osm_fabsim_port_t *p_remote = p_port->p_remote;
+
+	if (phys == IB_PORT_PHYS_STATE_DISABLED) {
+		ib_port_info_set_port_phys_state(phys, &p_port->port_info);
+		fabsim_set_port_state(p_port, IB_LINK_DOWN);
+		if (p_remote && fabsim_link_up(p_remote)) {
+			ib_port_info_set_port_phys_state
+			    (IB_PORT_PHYS_STATE_POLLING, &p_remote->port_info);
+			fabsim_set_port_state(p_remote, IB_LINK_DOWN);
+		}
+	} else if (phys == IB_PORT_PHYS_STATE_POLLING &&
+		   ib_port_info_get_port_phys_state(&p_port->port_info) ==
+		   IB_PORT_PHYS_STATE_DISABLED) {
+		ib_port_info_set_port_phys_state(phys, &p_port->port_info);
+		if (p_remote &&
+		    ib_port_info_get_port_phys_state(&p_remote->port_info) ==
+		    IB_PORT_PHYS_STATE_POLLING) {
+			ib_port_info_set_port_phys_state
+			    (IB_PORT_PHYS_STATE_LINKUP, &p_port->port_info);
+			ib_port_info_set_port_phys_state
+			    (IB_PORT_PHYS_STATE_LINKUP, &p_remote->port_info);
+			fabsim_set_port_state(p_port, IB_LINK_INIT);
+			fabsim_set_port_state(p_remote, IB_LINK_INIT);
+		}
+	}
+}
+
+static void fabsim_port_info_set(osm_fabsim_fabric_t * p_fabric,
+				 osm_fabsim_port_t * p_port,
+				 const ib_port_info_t * p_req)
+{
+	ib_port_info_t *p_pi = &p_port->port_info;
+	osm_fabsim_port_t *p_remote = p_port->p_remote;
+	uint8_t state = ib_port_info_get_port_state(p_req);
+	uint8_t phys = ib_port_info_get_port_phys_state(p_req);
+
+	if (fabsim_lid_port(p_port) == p_port) {
+		p_pi->m_key = p_req->m_key;
+		p_pi->subnet_prefix = p_req->subnet_prefix;
+		p_pi->master_sm_base_lid = p_req->master_sm_base_lid;
+		p_pi->m_key_lease_period = p_req->m_key_lease_period;
+		p_pi->subnet_timeout = p_req->subnet_timeout;
+		ib_port_info_set_master_smsl(p_pi,
+					     ib_port_info_get_master_smsl
+					     (p_req));
+		if (p_pi->base_lid != p_req->base_lid ||
+		    ib_port_info_get_lmc(p_pi) != ib_port_info_get_lmc(p_req))
+			fabsim_set_lids(p_fabric, p_port, p_req->base_lid,
+					ib_port_info_get_lmc(p_req));
+	}
+
+	if (p_req->link_width_enabled)
+		p_pi->link_width_enabled = p_req->link_width_enabled;
+	if (ib_port_info_get_link_speed_enabled(p_req))
+		ib_port_info_set_link_speed_enabled(p_pi,
+						    ib_port_info_get_link_speed_enabled
+						    (p_req));
+	if (ib_port_info_get_link_down_def_state(p_req))
+		ib_port_info_set_link_down_def_state(p_pi,
+						     ib_port_info_get_link_down_def_state
+						     (p_req));
+	if (ib_port_info_get_neighbor_mtu(p_req))
+		ib_port_info_set_neighbor_mtu(p_pi,
+					      ib_port_info_get_neighbor_mtu
+					      (p_req));
+	if (ib_port_info_get_op_vls(p_req))
+		ib_port_info_set_op_vls(p_pi, ib_port_info_get_op_vls(p_req));
+	p_pi->vl_high_limit = p_req->vl_high_limit;
+	p_pi->vl_stall_life = p_req->vl_stall_life;
+	p_pi->error_threshold = p_req->error_threshold;
+
+	if (phys != IB_PORT_PHYS_STATE_NO_CHANGE)
+		fabsim_set_phys_state(p_port, phys);
+
+	switch (state) {
+	case IB_LINK_DOWN:
+		/* the link retrains and comes back in Init */
+		if (fabsim_link_up(p_port)) {
+			fabsim_set_port_state(p_port, IB_LINK_DOWN);
+			fabsim_set_port_state(p_remote, IB_LINK_DOWN);
+			fabsim_set_port_state(p_port, IB_LINK_INIT);
+			fabsim_set_port_state(p_remote, IB_LINK_INIT);
+		}
+		break;
+	case IB_LINK_ARMED:
+		if (fabsim_state(p_port) == IB_LINK_INIT)
+			fabsim_set_port_state(p_port, IB_LINK_ARMED);
+		break;
+	case IB_LINK_ACTIVE:
+		if (fabsim_state(p_port) == IB_LINK_ARMED &&
+		    (!p_remote || fabsim_state(p_remote) >= IB_LINK_ARMED))
+			fabsim_set_port_state(p_port, IB_LINK_ACTIVE);
+		break;
+	default:
+		break;
+	}
+}
+
+/* Reads a block of the LFT into p_data after applying p_set if given */
+static void fabsim_lft(osm_fabsim_node_t * p_node, uint32_t block,
+		       const uint8_t * p_set, uint8_t * p_data)
+{
+	uint32_t first = block * IB_SMP_DATA_SIZE, size;
+	uint8_t *p_lft;
+
+	if (p_set && first >= p_node->lft_size) {
+		size = first + IB_SMP_DATA_SIZE;
+		if (!(p_lft = realloc(p_node->lft, size)))
+			return;
+		memset(p_lft + p_node->lft_size, OSM_NO_PATH,
+		       size - p_node->lft_size);
+		p_node->lft = p_lft;
+		p_node->lft_size = size;
+	}
+
+	if (first >= p_node->lft_size) {
+		memset(p_data, OSM_NO_PATH, IB_SMP_DATA_SIZE);
+		return;
+	}
+	if (p_set)
+		memcpy(p_node->lft + first, p_set, IB_SMP_DATA_SIZE);
+	memcpy(p_data, p_node->lft + first, IB_SMP_DATA_SIZE);
+}
+
+static void fabsim_mft(osm_fabsim_node_t * p_node, uint32_t attr_mod,
+		       const uint8_t * p_set, uint8_t * p_data)
+{
+	unsigned entries = IB_SMP_DATA_SIZE / sizeof(ib_net16_t);
+	unsigned first = (attr_mod & 0x1FF) * entries;
+	unsigned position = attr_mod >> 28;
+	ib_net16_t *p_block;
+
+	if (p_set && !p_node->mft)
+		p_node->mft = calloc(FABSIM_MCAST_CAP * FABSIM_MFT_POSITIONS,
+				     sizeof(ib_net16_t));
+	if (first >= FABSIM_MCAST_CAP || !p_node->mft) {
+		memset(p_data, 0, IB_SMP_DATA_SIZE);
+		return;
+	}
+
+	p_block = p_node->mft + position * FABSIM_MCAST_CAP + first;
+	if (p_set)
+		memcpy(p_block, p_set, IB_SMP_DATA_SIZE);
+	memcpy(p_data, p_block, IB_SMP_DATA_SIZE);
+}
+
+static void fabsim_smp(IN osm_fabsim_fabric_t * p_fabric,
+		       IN osm_fabsim_port_t * p_in, IN const ib_smp_t * p_req,
+		       OUT ib_smp_t * p_resp)
+{
+	osm_fabsim_node_t *p_node = p_in->p_node;
+	osm_fabsim_port_t *p_port = p_in;
+	uint32_t attr_mod = cl_ntoh32(p_req->attr_mod);
+	boolean_t set = p_req->method == IB_MAD_METHOD_SET;
+	ib_node_info_t *p_ni;
+	ib_switch_info_t *p_si;
+	ib_port_info_t *p_pi;
+	uint8_t in_port = (uint8_t) (p_in - p_node->ports);
+	uint8_t port = in_port;
+
+	if (p_req->method != IB_MAD_METHOD_GET && !set) {
+		p_resp->status |= IB_MAD_STATUS_UNSUP_METHOD_ATTR;
+		return;
+	}
+
+	switch (p_req->attr_id) {
+	case IB_MAD_ATTR_PORT_INFO:
+	case IB_MAD_ATTR_P_KEY_TABLE:
+	case IB_MAD_ATTR_GUID_INFO:
+	case IB_MAD_ATTR_SLVL_TABLE:
+		/* switches address ports through the attribute modifier */
+		if (fabsim_is_switch(p_node)) {
+			port = p_req->attr_id == IB_MAD_ATTR_PORT_INFO ?
+			    (uint8_t) attr_mod :
+			    p_req->attr_id == IB_MAD_ATTR_P_KEY_TABLE ?
+			    (uint8_t) (attr_mod >> 16) :
+			    p_req->attr_id == IB_MAD_ATTR_SLVL_TABLE ?
+			    (uint8_t) (attr_mod >> 8) : 0;
+			if (port > p_node->node_info.num_ports) {
+				p_resp->status |= IB_MAD_STATUS_INVALID_FIELD;
+				return;
+			}
+			p_port = &p_node->ports[port];
+		}
+		break;
+	case IB_MAD_ATTR_SWITCH_INFO:
+	case IB_MAD_ATTR_LIN_FWD_TBL:
+	case IB_MAD_ATTR_MCAST_FWD_TBL:
+		if (!fabsim_is_switch(p_node)) {
+			p_resp->status |= IB_MAD_STATUS_UNSUP_METHOD_ATTR;
+			return;
+		}
+		break;
+	default:
+		break;
+	}
+
+	switch (p_req->attr_id) {
+	case IB_MAD_ATTR_NODE_DESC:
+		memcpy(p_resp->data, p_node->desc, sizeof(p_node->desc));
+		break;
+	case IB_MAD_ATTR_NODE_INFO:
+		p_ni = (ib_node_info_t *) p_resp->data;
+		*p_ni = p_node->node_info;
+		p_ni->port_guid = p_in->port_guid;
+		p_ni->port_num_vendor_id =
+		    (p_ni->port_num_vendor_id & CL_HTON32(0x00FFFFFF)) |
+		    cl_hton32((uint32_t) in_port << 24);
+		break;
+	case IB_MAD_ATTR_SWITCH_INFO:
+		p_si = (ib_switch_info_t *) p_req->data;
+		if (set) {
+			p_node->switch_info.lin_top = p_si->lin_top;
+			p_node->switch_info.def_port = p_si->def_port;
+			p_node->switch_info.def_mcast_pri_port =
+			    p_si->def_mcast_pri_port;
+			p_node->switch_info.def_mcast_not_port =
+			    p_si->def_mcast_not_port;
+			p_node->switch_info.mcast_top = p_si->mcast_top;
+			/* PortStateChange is cleared by writing one */
+			if (p_si->life_state & IB_SWITCH_PSC)
+				p_node->switch_info.life_state &=
+				    ~IB_SWITCH_PSC;
+			p_node->switch_info.life_state =
+			    (p_node->switch_info.life_state & IB_SWITCH_PSC) |
+			    (p_si->life_state & ~IB_SWITCH_PSC);
+		}
+		memcpy(p_resp->data, &p_node->switch_info,
+		       sizeof(p_node->switch_info));
+		break;
+	case IB_MAD_ATTR_PORT_INFO:
+		if (set)
+			fabsim_port_info_set(p_fabric, p_port,
+					     (const ib_port_info_t *)p_req->data);
+		p_pi = (ib_port_info_t *) p_resp->data;
+		*p_pi = p_port->port_info;
+		p_pi->local_port_num = in_port;
+		break;
+	case IB_MAD_ATTR_P_KEY_TABLE:
+		if ((attr_mod & 0xFFFF) != 0)
+			memset(p_resp->data, 0, IB_SMP_DATA_SIZE);
+		else {
+			if (set)
+				memcpy(p_port->pkeys, p_req->data,
+				       sizeof(p_port->pkeys));
+			memcpy(p_resp->data, p_port->pkeys,
+			       sizeof(p_port->pkeys));
+		}
+		break;
+	case IB_MAD_ATTR_GUID_INFO:
+		memset(p_resp->data, 0, IB_SMP_DATA_SIZE);
+		if (attr_mod == 0)
+			memcpy(p_resp->data, &p_port->port_guid,
+			       sizeof(p_port->port_guid));
+		break;
+	case IB_MAD_ATTR_SLVL_TABLE:
+	case IB_MAD_ATTR_VL_ARBITRATION:
+	case IB_MAD_ATTR_MLNX_EXTENDED_PORT_INFO:
+		/* not modelled: sets are acknowledged, gets return zeros */
+		if (!set)
+			memset(p_resp->data, 0, IB_SMP_DATA_SIZE);
+		break;
+	case IB_MAD_ATTR_LIN_FWD_TBL:
+		fabsim_lft(p_node, attr_mod, set ? p_req->data : NULL,
+			   p_resp->data);
+		break;
+	case IB_MAD_ATTR_MCAST_FWD_TBL:
+		fabsim_mft(p_node, attr_mod, set ? p_req->data : NULL,
+			   p_resp->data);
+		break;
+	default:
+		p_resp->status |= IB_MAD_STATUS_UNSUP_METHOD_ATTR;
+		break;
+	}
+}
+
+/**********************************************************************
+ Performance Management Agent.  Counters are synthesized from the time
+ elapsed since they were last cleared.
+**********************************************************************/
+static uint64_t fabsim_count(uint64_t epoch, uint64_t now, uint64_t rate,
+			     uint64_t per_usec)
+{
+	return now > epoch ? (now - epoch) * rate / per_usec : 0;
+}
+
+static void fabsim_port_counters(osm_fabsim_port_t * p_port, uint64_t now,
+				 uint64_t * p_data, uint64_t * p_rdata,
+				 uint64_t * p_errs, boolean_t ext)
+{
+	uint64_t epoch = ext ? p_port->ext_epoch : p_port->data_epoch;
+
+	*p_data = *p_rdata = *p_errs = 0;
+	if (!p_port->p_remote)
+		return;
+	*p_data = fabsim_count(epoch, now, p_port->data_rate, 1000000);
+	*p_rdata = fabsim_count(epoch, now, p_port->p_remote->data_rate,
+				1000000);
+	*p_errs = fabsim_count(p_port->err_epoch, now, p_port->err_rate,
+			       3600000000ULL);
+}
+
+static ib_net32_t fabsim_sat32(uint64_t v)
+{
+	return cl_hton32(v > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t) v);
+}
+
+static void fabsim_pma(IN osm_fabsim_port_t * p_in,
+		       IN const ib_perfmgt_mad_t * p_req,
+		       OUT ib_perfmgt_mad_t * p_resp)
+{
+	osm_fabsim_node_t *p_node = p_in->p_node;
+	const ib_port_counters_t *p_sel =
+	    (const ib_port_counters_t *)p_req->data;
+	ib_port_counters_t *p_pc = (ib_port_counters_t *) p_resp->data;
+	ib_port_counters_ext_t *p_ext = (ib_port_counters_ext_t *) p_resp->data;
+	ib_class_port_info_t *p_cpi = (ib_class_port_info_t *) p_resp->data;
+	boolean_t set = p_req->header.method == IB_MAD_METHOD_SET;
+	uint64_t now = cl_get_time_stamp(), data, rdata, errs;
+	uint64_t sum_data = 0, sum_rdata = 0, sum_errs = 0;
+	uint16_t select = cl_ntoh16(p_sel->counter_select);
+	unsigned first, last, i;
+
+	if (p_req->header.method != IB_MAD_METHOD_GET && !set) {
+		p_resp->header.status = IB_MAD_STATUS_UNSUP_METHOD_ATTR;
+		return;
+	}
+
+	if (p_req->header.attr_id == IB_MAD_ATTR_CLASS_PORT_INFO) {
+		memset(p_resp->data, 0, sizeof(p_resp->data));
+		p_cpi->base_ver = 1;
+		p_cpi->class_ver = 1;
+		p_cpi->cap_mask = IB_PM_ALL_PORT_SELECT |
+		    IB_PM_EXT_WIDTH_SUPPORTED;
+		p_cpi->cap_mask2_resp_time = cl_hton32(18);
+		return;
+	}
+
+	if (p_req->header.attr_id != IB_MAD_ATTR_PORT_CNTRS &&
+	    p_req->header.attr_id != IB_MAD_ATTR_PORT_CNTRS_EXT) {
+		p_resp->header.status = IB_MAD_STATUS_UNSUP_METHOD_ATTR;
+		return;
+	}
+
+	if (!fabsim_is_switch(p_node))
+		first = last = (unsigned)(p_in - p_node->ports);
+	else if (p_sel->port_select == 0xFF) {
+		first = 1;
+		last = p_node->node_info.num_ports;
+	} else if (p_sel->port_select > p_node->node_info.num_ports) {
+		p_resp->header.status = IB_MAD_STATUS_INVALID_FIELD;
+		return;
+	} else
+		first = last = p_sel->port_select;
+
+	for (i = first; i <= last; i++) {
+		osm_fabsim_port_t *p_port = &p_node->ports[i];
+
+		if (set && p_req->header.attr_id == IB_MAD_ATTR_PORT_CNTRS_EXT)
+			p_port->ext_epoch = now;
+		else if (set) {
+			if (select & 0x0FFF)
+				p_port->err_epoch = now;
+			if (select & 0xF000)
+				p_port->data_epoch = now;
+		}
+		fabsim_port_counters(p_port, now, &data, &rdata, &errs,
+				     p_req->header.attr_id ==
+				     IB_MAD_ATTR_PORT_CNTRS_EXT);
+		sum_data += data;
+		sum_rdata += rdata;
+		sum_errs += errs;
+	}
+
+	memset(p_resp->data, 0, sizeof(p_resp->data));
+	if (p_req->header.attr_id == IB_MAD_ATTR_PORT_CNTRS_EXT) {
+		p_ext->port_select = p_sel->port_select;
+		p_ext->counter_select = p_sel->counter_select;
+		p_ext->xmit_data = cl_hton64(sum_data);
+		p_ext->rcv_data = cl_hton64(sum_rdata);
+		p_ext->xmit_pkts = cl_hton64(sum_data / 64);
+		p_ext->rcv_pkts = cl_hton64(sum_rdata / 64);
+		p_ext->unicast_xmit_pkts = p_ext->xmit_pkts;
+		p_ext->unicast_rcv_pkts = p_ext->rcv_pkts;
+	} else {
+		p_pc->port_select = p_sel->port_select;
+		p_pc->counter_select = p_sel->counter_select;
+		p_pc->symbol_err_cnt = cl_hton16(sum_errs > 0xFFFF ? 0xFFFF :
+						 (uint16_t) sum_errs);
+		p_pc->rcv_err = cl_hton16(sum_errs / 4 > 0xFFFF ? 0xFFFF :
+					  (uint16_t) (sum_errs / 4));
+		p_pc->xmit_data = fabsim_sat32(sum_data);
+		p_pc->rcv_data = fabsim_sat32(sum_rdata);
+		p_pc->xmit_pkts = fabsim_sat32(sum_data / 64);
+		p_pc->rcv_pkts = fabsim_sat32(sum_rdata / 64);
+	}
+}
+
+osm_fabsim_result_t osm_fabsim_process(IN osm_fabsim_fabric_t * p_fabric,
+				       IN const ib_mad_t * p_req,
+				       IN ib_net16_t dest_lid,
+				       OUT ib_mad_t * p_resp,
+				       OUT ib_net16_t * p_resp_lid,
+				       OUT unsigned *p_hops)
+{
+	osm_fabsim_result_t result = OSM_FABSIM_RESPOND;
+	osm_fabsim_port_t *p_in;
+
+	pthread_mutex_lock(&p_fabric->lock);
+
+	switch (p_req->mgmt_class) {
+	case IB_MCLASS_SUBN_DIR:
+		p_in = fabsim_dr_route(p_fabric, (const ib_smp_t *)p_req,
+				       p_hops);
+		break;
+	case IB_MCLASS_SUBN_LID:
+		p_in = fabsim_lid_route(p_fabric, dest_lid, IB_LINK_ARMED,
+					p_hops);
+		break;
+	default:
+		p_in = fabsim_lid_route(p_fabric, dest_lid, IB_LINK_ACTIVE,
+					p_hops);
+		break;
+	}
+	if (!p_in) {
+		result = OSM_FABSIM_DROP;
+		goto Exit;
+	}
+
+	memcpy(p_resp, p_req, MAD_BLOCK_SIZE);
+	p_resp->status = 0;
+	*p_resp_lid = fabsim_lid_port(p_in)->port_info.base_lid;
+
+	switch (p_req->mgmt_class) {
+	case IB_MCLASS_SUBN_DIR:
+		p_resp->status = IB_SMP_DIRECTION;
+		((ib_smp_t *) p_resp)->hop_ptr =
+		    ((ib_smp_t *) p_resp)->hop_count;
+		/* fall through */
+	case IB_MCLASS_SUBN_LID:
+		fabsim_smp(p_fabric, p_in, (const ib_smp_t *)p_req,
+			   (ib_smp_t *) p_resp);
+		p_resp->method = IB_MAD_METHOD_GET_RESP;
+		break;
+	case IB_MCLASS_PERF:
+		fabsim_pma(p_in, (const ib_perfmgt_mad_t *)p_req,
+			   (ib_perfmgt_mad_t *) p_resp);
+		p_resp->method = IB_MAD_METHOD_GET_RESP;
+		break;
+	case IB_MCLASS_SUBN_ADM:
+		/* hosts acknowledge the reports they subscribed to */
+		if (p_req->method == IB_MAD_METHOD_REPORT)
+			p_resp->method = IB_MAD_METHOD_REPORT_RESP;
+		else
+			result = OSM_FABSIM_CONSUMED;
+		break;
+	default:
+		result = OSM_FABSIM_DROP;
+		break;
+	}
+
+Exit:
+	pthread_mutex_unlock(&p_fabric->lock);
+	return result;
+}
+
+boolean_t osm_fabsim_sa_query(IN osm_fabsim_fabric_t * p_fabric,
+			      IN unsigned *p_seed, IN ib_net64_t trans_id,
+			      OUT ib_mad_t * p_mad, OUT ib_net16_t * p_slid)
+{
+	ib_sa_mad_t *p_sa = (ib_sa_mad_t *) p_mad;
+	ib_path_rec_t *p_pr = (ib_path_rec_t *) p_sa->data;
+	osm_fabsim_port_t *p_src = NULL, *p_dst = NULL;
+	unsigned tries;
+
+	if (p_fabric->num_ca_ports < 2)
+		return FALSE;
+
+	pthread_mutex_lock(&p_fabric->lock);
+	for (tries = 0; tries < 16 && !(p_src && p_dst); tries++) {
+		p_src = p_fabric->ca_ports[rand_r(p_seed) %
+					   p_fabric->num_ca_ports];
+		p_dst = p_fabric->ca_ports[rand_r(p_seed) %
+					   p_fabric->num_ca_ports];
+		if (p_src == p_dst || !p_src->port_info.base_lid ||
+		    !p_dst->port_info.base_lid ||
+		    fabsim_state(p_src) != IB_LINK_ACTIVE)
+			p_src = p_dst = NULL;
+	}
+	if (p_src)
+		*p_slid = p_src->port_info.base_lid;
+	pthread_mutex_unlock(&p_fabric->lock);
+
+	if (!p_src)
+		return FALSE;
+
+	memset(p_sa, 0, MAD_BLOCK_SIZE);
+	p_sa->base_ver = 1;
+	p_sa->mgmt_class = IB_MCLASS_SUBN_ADM;
+	p_sa->class_ver = 2;
+	p_sa->method = IB_MAD_METHOD_GET;
+	p_sa->trans_id = trans_id;
+	p_sa->attr_id = IB_MAD_ATTR_PATH_RECORD;
+	p_sa->attr_offset = ib_get_attr_offset(sizeof(*p_pr));
+	p_sa->comp_mask = IB_PR_COMPMASK_SGID | IB_PR_COMPMASK_DGID;
+	ib_gid_set_default(&p_pr->sgid, p_src->port_guid);
+	ib_gid_set_default(&p_pr->dgid, p_dst->port_guid);
+	return TRUE;
+}
+
+#endif				/* OSM_VENDOR_INTF_FABSIM */
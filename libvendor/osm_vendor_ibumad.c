@@ -56,6 +56,7 @@
 #include <stdlib.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
 
 #include <iba/ib_types.h>
 #include <complib/cl_qlist.h>
@@ -98,29 +99,121 @@ typedef struct _umad_receiver {
 
 static void osm_vendor_close_port(osm_vendor_t * const p_vend);
 
+/*
+ * The low 32 bits of the TID are ours, the kernel uses the upper
+ * ones for the agent id.
+ */
+static umad_match_shard_t *match_shard(osm_vendor_t * p_vend,
+				       ib_net64_t tid, umad_match_t *** p_head)
+{
+	uint32_t key = (uint32_t) cl_ntoh64(tid);
+	umad_match_shard_t *p_shard;
+
+	p_shard = &p_vend->mtbl.shards[key & (p_vend->mtbl.num_shards - 1)];
+	key = (key / p_vend->mtbl.num_shards) * 0x9E3779B1;
+	*p_head = &p_shard->hash[key & p_shard->hash_mask];
+	return p_shard;
+}
+
+static void match_shard_lock(osm_vendor_t * p_vend,
+			     umad_match_shard_t * p_shard)
+{
+	if (pthread_mutex_trylock(&p_shard->lock)) {
+		cl_atomic_inc(&p_vend->mtbl.contended);
+		pthread_mutex_lock(&p_shard->lock);
+	}
+}
+
+static void match_unlink(umad_match_shard_t * p_shard, umad_match_t ** pp,
+			 umad_match_t * m)
+{
+	*pp = m->next;
+	cl_qlist_remove_item(&p_shard->lru, &m->lru_item);
+	m->tid = 0;
+	m->next = p_shard->free_list;
+	p_shard->free_list = m;
+}
+
+static void match_tbl_destroy(osm_vendor_t * p_vend)
+{
+	unsigned i;
+
+	for (i = 0; i < p_vend->mtbl.num_shards; i++) {
+		pthread_mutex_destroy(&p_vend->mtbl.shards[i].lock);
+		free(p_vend->mtbl.shards[i].hash);
+	}
+	free(p_vend->mtbl.tbl);
+}
+
+static int match_tbl_init(osm_vendor_t * p_vend)
+{
+	vendor_match_tbl_t *mtbl = &p_vend->mtbl;
+	umad_match_shard_t *p_shard;
+	unsigned i, per_shard, hash_size;
+	umad_match_t *m;
+
+	for (mtbl->num_shards = OSM_UMAD_MATCH_SHARDS;
+	     mtbl->num_shards > (unsigned)mtbl->max; mtbl->num_shards /= 2) ;
+	per_shard = (mtbl->max + mtbl->num_shards - 1) / mtbl->num_shards;
+	for (hash_size = 1; hash_size < 2 * per_shard; hash_size *= 2) ;
+
+	mtbl->tbl = calloc(per_shard * mtbl->num_shards, sizeof(*mtbl->tbl));
+	if (!mtbl->tbl)
+		return -1;
+
+	m = mtbl->tbl;
+	for (i = 0; i < mtbl->num_shards; i++) {
+		unsigned j;
+
+		p_shard = &mtbl->shards[i];
+		pthread_mutex_init(&p_shard->lock, NULL);
+		cl_qlist_init(&p_shard->lru);
+		p_shard->hash_mask = hash_size - 1;
+		p_shard->hash = calloc(hash_size, sizeof(*p_shard->hash));
+		if (!p_shard->hash) {
+			mtbl->num_shards = i + 1;
+			match_tbl_destroy(p_vend);
+			return -1;
+		}
+		for (j = 0; j < per_shard; j++, m++) {
+			m->next = p_shard->free_list;
+			p_shard->free_list = m;
+		}
+	}
+
+	return 0;
+}
+
 static void clear_madw(osm_vendor_t * p_vend)
 {
-	umad_match_t *m, *e, *old_m;
+	umad_match_shard_t *p_shard;
+	umad_match_t *m, **pp;
 	ib_net64_t old_tid;
+	osm_madw_t *p_madw;
+	unsigned i;
 
 	OSM_LOG_ENTER(p_vend->p_log);
-	pthread_mutex_lock(&p_vend->match_tbl_mutex);
-	for (m = p_vend->mtbl.tbl, e = m + p_vend->mtbl.max; m < e; m++) {
-		if (m->tid) {
-			old_m = m;
+	for (i = 0; i < p_vend->mtbl.num_shards; i++) {
+		p_shard = &p_vend->mtbl.shards[i];
+		pthread_mutex_lock(&p_shard->lock);
+		m = (umad_match_t *) cl_qlist_head(&p_shard->lru);
+		if (m != (umad_match_t *) cl_qlist_end(&p_shard->lru)) {
 			old_tid = m->tid;
-			m->tid = 0;
-			osm_mad_pool_put(((osm_umad_bind_info_t
-					   *) ((osm_madw_t *) m->v)->h_bind)->
-					 p_mad_pool, m->v);
-			pthread_mutex_unlock(&p_vend->match_tbl_mutex);
+			p_madw = m->v;
+			match_shard(p_vend, old_tid, &pp);
+			while (*pp != m)
+				pp = &(*pp)->next;
+			match_unlink(p_shard, pp, m);
+			osm_mad_pool_put(((osm_umad_bind_info_t *)
+					  p_madw->h_bind)->p_mad_pool, p_madw);
+			pthread_mutex_unlock(&p_shard->lock);
 			OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5401: "
 				"evicting entry %p (tid was 0x%" PRIx64 ")\n",
-				old_m, cl_ntoh64(old_tid));
+				m, cl_ntoh64(old_tid));
 			goto Exit;
 		}
+		pthread_mutex_unlock(&p_shard->lock);
 	}
-	pthread_mutex_unlock(&p_vend->match_tbl_mutex);
 
 Exit:
 	OSM_LOG_EXIT(p_vend->p_log);
@@ -128,7 +221,8 @@ Exit:
 
 static osm_madw_t *get_madw(osm_vendor_t * p_vend, ib_net64_t * tid)
 {
-	umad_match_t *m, *e;
+	umad_match_shard_t *p_shard;
+	umad_match_t *m, **pp;
 	ib_net64_t mtid = (*tid & CL_HTON64(0x00000000ffffffffULL));
 	osm_madw_t *res;
 
@@ -139,62 +233,68 @@ static osm_madw_t *get_madw(osm_vendor_t * p_vend, ib_net64_t * tid)
 	if (mtid == 0)
 		return 0;
 
-	pthread_mutex_lock(&p_vend->match_tbl_mutex);
-	for (m = p_vend->mtbl.tbl, e = m + p_vend->mtbl.max; m < e; m++) {
+	p_shard = match_shard(p_vend, mtid, &pp);
+	match_shard_lock(p_vend, p_shard);
+	for (; (m = *pp) != NULL; pp = &m->next) {
 		if (m->tid == mtid) {
-			m->tid = 0;
-			*tid = mtid;
 			res = m->v;
-			pthread_mutex_unlock(&p_vend->match_tbl_mutex);
+			match_unlink(p_shard, pp, m);
+			pthread_mutex_unlock(&p_shard->lock);
+			*tid = mtid;
 			return res;
 		}
 	}
 
-	pthread_mutex_unlock(&p_vend->match_tbl_mutex);
+	pthread_mutex_unlock(&p_shard->lock);
 	return 0;
 }
 
 static void
 put_madw(osm_vendor_t * p_vend, osm_madw_t * p_madw, ib_net64_t tid)
 {
-	umad_match_t *m, *e, *old_lru, *lru = 0;
+	umad_match_shard_t *p_shard;
+	umad_match_t *m, **pp, **head;
 	osm_madw_t *p_req_madw;
 	osm_umad_bind_info_t *p_bind;
 	ib_net64_t old_tid;
-	uint32_t oldest = ~0;
-
-	pthread_mutex_lock(&p_vend->match_tbl_mutex);
-	for (m = p_vend->mtbl.tbl, e = m + p_vend->mtbl.max; m < e; m++) {
-		if (m->tid == 0) {
-			m->tid = tid;
-			m->v = p_madw;
-			m->version =
-			    cl_atomic_inc((atomic32_t *) & p_vend->mtbl.
-					  last_version);
-			pthread_mutex_unlock(&p_vend->match_tbl_mutex);
-			return;
-		}
-		if (oldest >= m->version) {
-			oldest = m->version;
-			lru = m;
-		}
+
+	p_shard = match_shard(p_vend, tid, &head);
+	match_shard_lock(p_vend, p_shard);
+	if ((m = p_shard->free_list) != NULL) {
+		p_shard->free_list = m->next;
+		m->tid = tid;
+		m->v = p_madw;
+		m->next = *head;
+		*head = m;
+		cl_qlist_insert_tail(&p_shard->lru, &m->lru_item);
+		pthread_mutex_unlock(&p_shard->lock);
+		return;
 	}
 
-	old_lru = lru;
-	old_tid = lru->tid;
-	p_req_madw = old_lru->v;
+	/* the shard is full, evict its oldest request */
+	m = (umad_match_t *) cl_qlist_head(&p_shard->lru);
+	old_tid = m->tid;
+	match_shard(p_vend, old_tid, &pp);
+	while (*pp != m)
+		pp = &(*pp)->next;
+	match_unlink(p_shard, pp, m);
+	p_shard->free_list = m->next;
+	cl_atomic_inc(&p_vend->mtbl.evicted);
+
+	p_req_madw = m->v;
 	p_bind = p_req_madw->h_bind;
 	p_req_madw->status = IB_CANCELED;
 	pthread_mutex_lock(&p_vend->cb_mutex);
 	(*p_bind->send_err_callback) (p_bind->client_context, p_req_madw);
 	pthread_mutex_unlock(&p_vend->cb_mutex);
-	lru->tid = tid;
-	lru->v = p_madw;
-	lru->version =
-	    cl_atomic_inc((atomic32_t *) & p_vend->mtbl.last_version);
-	pthread_mutex_unlock(&p_vend->match_tbl_mutex);
+	m->tid = tid;
+	m->v = p_madw;
+	m->next = *head;
+	*head = m;
+	cl_qlist_insert_tail(&p_shard->lru, &m->lru_item);
+	pthread_mutex_unlock(&p_shard->lock);
 	OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "ERR 5402: "
-		"evicting entry %p (tid was 0x%" PRIx64 ")\n", old_lru,
+		"evicting entry %p (tid was 0x%" PRIx64 ")\n", m,
 		cl_ntoh64(old_tid));
 }
 
@@ -233,6 +333,55 @@ static void *swap_mad_bufs(osm_madw_t * p_madw, void *umad)
 	return old;
 }
 
+/*
+ * MAD sized umads are recycled through a free list linked through
+ * their first bytes; larger (RMPP) ones go back to the heap.
+ */
+static void *umad_cache_get(osm_vendor_t * p_vend)
+{
+	void *umad;
+
+	pthread_mutex_lock(&p_vend->umad_cache_lock);
+	if ((umad = p_vend->umad_cache) != NULL) {
+		p_vend->umad_cache = *(void **)umad;
+		p_vend->umad_cached--;
+	}
+	pthread_mutex_unlock(&p_vend->umad_cache_lock);
+
+	if (umad)
+		memset(umad, 0, umad_size() + MAD_BLOCK_SIZE);
+	else
+		umad = umad_alloc(1, umad_size() + MAD_BLOCK_SIZE);
+	return umad;
+}
+
+static void umad_cache_put(osm_vendor_t * p_vend, void *umad)
+{
+	pthread_mutex_lock(&p_vend->umad_cache_lock);
+	if (p_vend->umad_cached < OSM_UMAD_MAX_CACHED) {
+		*(void **)umad = p_vend->umad_cache;
+		p_vend->umad_cache = umad;
+		p_vend->umad_cached++;
+		umad = NULL;
+	}
+	pthread_mutex_unlock(&p_vend->umad_cache_lock);
+
+	if (umad)
+		umad_free(umad);
+}
+
+static void umad_cache_destroy(osm_vendor_t * p_vend)
+{
+	void *umad;
+
+	while ((umad = p_vend->umad_cache) != NULL) {
+		p_vend->umad_cache = *(void **)umad;
+		umad_free(umad);
+	}
+	p_vend->umad_cached = 0;
+	pthread_mutex_destroy(&p_vend->umad_cache_lock);
+}
+
 static void unlock_mutex(void *arg)
 {
 	pthread_mutex_unlock(arg);
@@ -247,24 +396,42 @@ static void *umad_receiver(void *p_ptr)
 	osm_mad_addr_t osm_addr;
 	osm_madw_t *p_madw, *p_req_madw;
 	ib_mad_t *mad;
+	struct pollfd pfd;
 	void *umad = 0;
 	int mad_agent, length;
 	int status;
 
 	OSM_LOG_ENTER(p_ur->p_log);
 
+	pfd.fd = umad_get_fd(p_vend->umad_port_id);
+	pfd.events = POLLIN;
+
 	for (;;) {
-		if (!umad &&
-		    !(umad = umad_alloc(1, umad_size() + MAD_BLOCK_SIZE))) {
+		if (!umad && !(umad = umad_cache_get(p_vend))) {
 			OSM_LOG(p_ur->p_log, OSM_LOG_ERROR, "ERR 5403: "
 				"can't alloc MAD sized umad\n");
 			break;
 		}
 
+		/*
+		 * Drain everything that is queued without blocking and
+		 * only go back to poll() once the queue is empty, so a
+		 * burst of responses costs one wakeup instead of one
+		 * poll() per MAD.
+		 */
 		length = MAD_BLOCK_SIZE;
+		p_vend->io_stats.recv_calls++;
 		if ((mad_agent = umad_recv(p_vend->umad_port_id, umad,
-					   &length, -1)) < 0) {
-			if (length <= MAD_BLOCK_SIZE) {
+					   &length, 0)) < 0) {
+			if (mad_agent == -EAGAIN || mad_agent == -EWOULDBLOCK ||
+			    mad_agent == -ETIMEDOUT) {
+				p_vend->io_stats.recv_polls++;
+				if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+					OSM_LOG(p_ur->p_log, OSM_LOG_ERROR,
+						"ERR 5434: "
+						"poll on umad fd failed (%m)\n");
+				continue;
+			} else if (length <= MAD_BLOCK_SIZE) {
 				OSM_LOG(p_ur->p_log, OSM_LOG_ERROR, "ERR 5404: "
 					"recv error on MAD sized umad (%m)\n");
 				continue;
@@ -280,6 +447,7 @@ static void *umad_receiver(void *p_ptr)
 					continue;
 				}
 
+				p_vend->io_stats.recv_calls++;
 				if ((mad_agent = umad_recv(p_vend->umad_port_id,
 							   umad, &length,
 							   -1)) < 0) {
@@ -299,6 +467,7 @@ static void *umad_receiver(void *p_ptr)
 			continue;
 		}
 
+		p_vend->io_stats.recv_mads++;
 		mad = (ib_mad_t *) umad_get_mad(umad);
 		ib_mad_addr = umad_get_mad_addr(umad);
 
@@ -453,7 +622,7 @@ osm_vendor_init(IN osm_vendor_t * const p_vend,
 	p_vend->timeout = timeout;
 	p_vend->max_retries = OSM_DEFAULT_RETRY_COUNT;
 	pthread_mutex_init(&p_vend->cb_mutex, NULL);
-	pthread_mutex_init(&p_vend->match_tbl_mutex, NULL);
+	pthread_mutex_init(&p_vend->umad_cache_lock, NULL);
 	p_vend->umad_port_id = -1;
 	p_vend->issmfd = -1;
 
@@ -489,8 +658,7 @@ osm_vendor_init(IN osm_vendor_t * const p_vend,
 	OSM_LOG(p_vend->p_log, OSM_LOG_INFO, "%d pending umads specified\n",
 		p_vend->mtbl.max);
 
-	p_vend->mtbl.tbl = calloc(p_vend->mtbl.max, sizeof(*(p_vend->mtbl.tbl)));
-	if (!p_vend->mtbl.tbl) {
+	if (match_tbl_init(p_vend)) {
 		OSM_LOG(p_vend->p_log, OSM_LOG_ERROR, "Error:"
 			"failed to allocate vendor match table\n");
 		r = IB_INSUFFICIENT_MEMORY;
@@ -543,8 +711,8 @@ void osm_vendor_delete(IN osm_vendor_t ** const pp_vend)
 	umad_done();
 
 	pthread_mutex_destroy(&(*pp_vend)->cb_mutex);
-	pthread_mutex_destroy(&(*pp_vend)->match_tbl_mutex);
-	free((*pp_vend)->mtbl.tbl);
+	match_tbl_destroy(*pp_vend);
+	umad_cache_destroy(*pp_vend);
 	free(*pp_vend);
 	*pp_vend = NULL;
 }
@@ -955,7 +1123,10 @@ ib_mad_t *osm_vendor_get(IN osm_bind_handle_t h_bind,
 		"Acquiring UMAD for p_madw = %p, size = %u\n", p_vw, mad_size);
 	CL_ASSERT(p_vw);
 	p_vw->size = mad_size;
-	p_vw->umad = umad_alloc(1, mad_size + umad_size());
+	if (mad_size == MAD_BLOCK_SIZE)
+		p_vw->umad = umad_cache_get(p_vend);
+	else
+		p_vw->umad = umad_alloc(1, mad_size + umad_size());
 
 	/* track locally */
 	p_vw->h_bind = h_bind;
@@ -986,7 +1157,10 @@ osm_vendor_put(IN osm_bind_handle_t h_bind, IN osm_vend_wrap_t * const p_vw)
 	 */
 
 	/* free the mad but the wrapper is part of the madw object */
-	umad_free(p_vw->umad);
+	if (p_vw->size == MAD_BLOCK_SIZE)
+		umad_cache_put(p_vend, p_vw->umad);
+	else
+		umad_free(p_vw->umad);
 	p_vw->umad = 0;
 	p_madw = PARENT_STRUCT(p_vw, osm_madw_t, vend_wrap);
 	p_madw->p_mad = NULL;
@@ -1073,6 +1247,7 @@ Resp:
 	    p_madw->mad_size;
 #endif
 	tid = cl_ntoh64(p_mad->trans_id);
+	cl_atomic_inc(&p_vend->io_stats.send_calls);
 	if ((ret = umad_send(p_bind->port_id, p_bind->agent_id, p_vw->umad,
 			     sent_mad_size,
 			     resp_expected ? p_bind->timeout : 0,
@@ -1142,4 +1317,17 @@ void osm_vendor_set_debug(IN osm_vendor_t * const p_vend, IN int32_t level)
 	umad_debug(level);
 }
 
+void osm_vendor_get_io_stats(IN osm_vendor_t * const p_vend,
+			     OUT umad_io_stats_t * const p_stats)
+{
+	umad_io_stats_t *mark = &p_vend->io_stats_mark;
+	umad_io_stats_t now = p_vend->io_stats;
+
+	p_stats->recv_polls = now.recv_polls - mark->recv_polls;
+	p_stats->recv_calls = now.recv_calls - mark->recv_calls;
+	p_stats->recv_mads = now.recv_mads - mark->recv_mads;
+	p_stats->send_calls = now.send_calls - mark->send_calls;
+	*mark = now;
+}
+
 #endif				/* OSM_VENDOR_INTF_OPENIB */
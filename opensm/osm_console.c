@@ -232,7 +232,7 @@ static void help_update_desc(FILE *out, int detail)
 static void help_perfmgr(FILE * out, int detail)
 {
 	fprintf(out,
-		"perfmgr(pm) [enable|disable|clear_counters|dump_counters|print_counters|dump_redir|clear_redir|sweep_time[seconds]]\n");
+		"perfmgr(pm) [enable|disable|clear_counters|dump_counters|print_counters|dump_redir|clear_redir|history|sweep_time[seconds]]\n");
 	if (detail) {
 		fprintf(out,
 			"perfmgr -- print the performance manager state\n");
@@ -258,6 +258,12 @@ static void help_perfmgr(FILE * out, int detail)
 			"   [dump_redir [<nodename|nodeguid>]] -- dump the redirection table\n");
 		fprintf(out,
 			"   [clear_redir [<nodename|nodeguid>]] -- clear the redirection table\n");
+		fprintf(out,
+			"   [history [<seconds>|all [<nodename|nodeguid>[:port]]]] -- print the rates\n"
+			"                                             kept in the history file over the last\n"
+			"                                             [seconds] (default 3600), or list its ports\n");
+		fprintf(out,
+			"   [history_summary ...] -- same as history, averages only\n");
 	}
 }
 static void help_pm(FILE *out, int detail)
@@ -395,9 +401,41 @@ static void dump_sms(osm_opensm_t * p_osm, FILE * out)
 	CL_PLOCK_RELEASE(p_osm->sm.p_lock);
 }
 
+static void print_hops_mem(osm_opensm_t * p_osm, FILE * out)
+{
+	cl_qmap_t *tbl = &p_osm->subn.sw_guid_tbl;
+	cl_map_item_t *item;
+	unsigned long rows = 0, lids = 0;
+	size_t size = 0, row_layout_size = 0;
+
+	for (item = cl_qmap_head(tbl); item != cl_qmap_end(tbl);
+	     item = cl_qmap_next(item)) {
+		osm_switch_t *p_sw = (osm_switch_t *) item;
+
+		size += osm_switch_get_hops_mem_size(p_sw);
+		rows += p_sw->num_hops_rows;
+		lids += p_sw->num_hops;
+		/* the same tables with one malloc'd row per LID */
+		row_layout_size += p_sw->num_hops * sizeof(uint8_t *) +
+		    p_sw->num_hops_rows * p_sw->num_ports;
+	}
+
+	fprintf(out, "\n   Hop tables\n"
+		"   ----------\n"
+		"   Switches                       : %u\n"
+		"   LID entries                    : %lu\n"
+		"   Rows in use                    : %lu\n"
+		"   Memory used (KB)               : %lu\n"
+		"   Per LID row layout (KB)        : %lu\n",
+		cl_qmap_count(tbl), lids, rows,
+		(unsigned long)(size / 1024),
+		(unsigned long)(row_layout_size / 1024));
+}
+
 static void print_status(osm_opensm_t * p_osm, FILE * out)
 {
 	cl_list_item_t *item;
+	unsigned i;
 
 	if (out) {
 		const char *re_str;
@@ -447,7 +485,9 @@ static void print_status(osm_opensm_t * p_osm, FILE * out)
 			"   SA MADs rcvd                   : %d\n"
 			"   SA MADs sent                   : %d\n"
 			"   SA unknown MADs rcvd           : %d\n"
-			"   SA MADs ignored                : %d\n",
+			"   SA MADs ignored                : %d\n"
+			"   SA PR cache hits               : %d\n"
+			"   SA PR cache misses             : %d\n",
 			p_osm->stats.qp0_mads_outstanding,
 			p_osm->stats.qp0_mads_outstanding_on_wire,
 			p_osm->stats.qp0_mads_rcvd,
@@ -458,7 +498,32 @@ static void print_status(osm_opensm_t * p_osm, FILE * out)
 			p_osm->stats.sa_mads_rcvd,
 			p_osm->stats.sa_mads_sent,
 			p_osm->stats.sa_mads_rcvd_unknown,
-			p_osm->stats.sa_mads_ignored);
+			p_osm->stats.sa_mads_ignored,
+			p_osm->stats.sa_pr_cache_hits,
+			p_osm->stats.sa_pr_cache_misses);
+		fprintf(out, "   MAD pool wrappers out          : %u\n"
+			"   MAD pool hits                  : %u\n"
+			"   MAD pool misses                : %u\n",
+			osm_mad_pool_get_outstanding(&p_osm->mad_pool),
+			osm_mad_pool_get_hits(&p_osm->mad_pool),
+			osm_mad_pool_get_misses(&p_osm->mad_pool));
+		if (p_osm->log.async)
+			fprintf(out, "   Log messages dropped           : %lu\n",
+				p_osm->log.dropped);
+		for (i = 0; p_osm->vl15.adaptive &&
+		     i < p_osm->vl15.num_windows; i++)
+			fprintf(out, "   VL15 window port %u             : "
+				"%u (%d on wire, %u timeouts, %u late)\n", i,
+				p_osm->vl15.windows[i].cwnd,
+				p_osm->vl15.windows[i].on_wire,
+				p_osm->vl15.windows[i].timeouts,
+				p_osm->vl15.windows[i].late);
+#ifdef OSM_VENDOR_INTF_OPENIB
+		fprintf(out, "   Match table lock contended     : %d\n"
+			"   Match table entries evicted    : %d\n",
+			p_osm->p_vendor->mtbl.contended,
+			p_osm->p_vendor->mtbl.evicted);
+#endif
 		fprintf(out, "\n   Subnet flags\n"
 			"   ------------\n"
 			"   Sweeping enabled               : %d\n"
@@ -475,6 +540,7 @@ static void print_status(osm_opensm_t * p_osm, FILE * out)
 			p_osm->subn.in_sweep_hop_0,
 			p_osm->subn.first_time_master_sweep,
 			p_osm->subn.coming_out_of_standby);
+		print_hops_mem(p_osm, out);
 		dump_sms(p_osm, out);
 		fprintf(out, "\n");
 		cl_plock_release(&p_osm->lock);
@@ -1331,7 +1397,7 @@ static void dump_redir(osm_opensm_t * p_osm, char *nodename, FILE * out)
 
 	fprintf(out, "\nRedirection Table\n");
 	fprintf(out, "-----------------\n");
-	cl_plock_acquire(&p_osm->lock);
+	cl_plock_acquire(&p_osm->perfmgr.lock);
 	if (nodename) {
 		guid = strtoull(nodename, NULL, 0);
 		if (guid == 0 && errno)
@@ -1353,7 +1419,7 @@ static void dump_redir(osm_opensm_t * p_osm, char *nodename, FILE * out)
 			p_mon_node = (monitored_node_t *) cl_qmap_next((const cl_map_item_t *)p_mon_node);
 		}
 	}
-	cl_plock_release(&p_osm->lock);
+	cl_plock_release(&p_osm->perfmgr.lock);
 }
 
 static void clear_redir_entry(monitored_node_t *p_mon_node)
@@ -1381,7 +1447,7 @@ static void clear_redir(osm_opensm_t * p_osm, char *nodename, FILE * out)
 	if (!p_osm->subn.opt.perfmgr_redir)
 		fprintf(out, "Perfmgr redirection not enabled\n");
 
-	cl_plock_acquire(&p_osm->lock);
+	cl_plock_excl_acquire(&p_osm->perfmgr.lock);
 	if (nodename) {
 		guid = strtoull(nodename, NULL, 0);
 		if (guid == 0 && errno)
@@ -1403,7 +1469,7 @@ static void clear_redir(osm_opensm_t * p_osm, char *nodename, FILE * out)
 			p_mon_node = (monitored_node_t *) cl_qmap_next((const cl_map_item_t *)p_mon_node);
 		}
 	}
-	cl_plock_release(&p_osm->lock);
+	cl_plock_release(&p_osm->perfmgr.lock);
 }
 
 static void perfmgr_parse(char **p_last, osm_opensm_t * p_osm, FILE * out)
@@ -1457,6 +1523,26 @@ static void perfmgr_parse(char **p_last, osm_opensm_t * p_osm, FILE * out)
 		} else if (strcmp(p_cmd, "clear_redir") == 0) {
 			p_cmd = name_token(p_last);
 			clear_redir(p_osm, p_cmd, out);
+		} else if (strcmp(p_cmd, "history") == 0 ||
+			   strcmp(p_cmd, "history_summary") == 0) {
+			int summary = strcmp(p_cmd, "history_summary") == 0;
+			time_t since = time(NULL) - 3600;
+			char *port = NULL;
+			p_cmd = next_token(p_last);
+			if (p_cmd && strcmp(p_cmd, "all") == 0)
+				since = 0;
+			else if (p_cmd)
+				since = time(NULL) - strtoul(p_cmd, NULL, 0);
+			p_cmd = p_cmd ? name_token(p_last) : NULL;
+			if (p_cmd) {
+				port = strchr(p_cmd, ':');
+				if (port) {
+					*port = '\0';
+					port++;
+				}
+			}
+			osm_perfmgr_print_history(&p_osm->perfmgr, p_cmd, out,
+						  port, since, summary);
 		} else if (strcmp(p_cmd, "sweep_time") == 0) {
 			p_cmd = next_token(p_last);
 			if (p_cmd) {
@@ -1493,6 +1579,11 @@ static void perfmgr_parse(char **p_last, osm_opensm_t * p_osm, FILE * out)
 			p_osm->perfmgr.max_outstanding_queries,
 			osm_perfmgr_get_rm_nodes(&p_osm->perfmgr)
 						 ? "TRUE" : "FALSE");
+		if (p_osm->perfmgr.pacing)
+			fprintf(out, "paced window/srtt/min rtt   : "
+				"%u/%uus/%uus\n", p_osm->perfmgr.window,
+				p_osm->perfmgr.srtt >> 3,
+				p_osm->perfmgr.min_rtt);
 	}
 }
 #endif				/* ENABLE_OSM_PERF_MGR */
@@ -61,6 +61,7 @@
 #include <opensm/osm_remote_sm.h>
 #include <opensm/osm_inform.h>
 #include <opensm/osm_ucast_mgr.h>
+#include <opensm/osm_opensm.h>
 
 static void drop_mgr_remove_router(osm_sm_t * sm, IN const ib_net64_t portguid)
 {
@@ -339,6 +340,10 @@ static boolean_t drop_mgr_process_node(osm_sm_t * sm, IN osm_node_t * p_node)
 	if (p_node->sw)
 		drop_mgr_remove_switch(sm, p_node);
 
+#ifdef ENABLE_OSM_PERF_MGR
+	osm_perfmgr_drop_node(&sm->p_subn->p_osm->perfmgr, p_node);
+#endif
+
 	p_node_check =
 	    (osm_node_t *) cl_qmap_remove(&sm->p_subn->node_guid_tbl,
 					  osm_node_get_node_guid(p_node));
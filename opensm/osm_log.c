@@ -107,62 +107,23 @@ static void truncate_log_file(osm_log_t * p_log)
 }
 #endif				/* ndef __WIN__ */
 
-void osm_log(IN osm_log_t * p_log, IN osm_log_level_t verbosity,
-	     IN const char *p_str, ...)
+/*
+  Writes one message to the log file, truncating it first if it grew
+  beyond max_size. Called with p_log->lock held.
+ */
+static void log_write(IN osm_log_t * p_log, IN uint64_t time_usecs,
+		      IN uint32_t pid, IN osm_log_level_t verbosity,
+		      IN const char *buffer, IN boolean_t flush)
 {
-	char buffer[LOG_ENTRY_SIZE_MAX];
-	va_list args;
 	int ret;
 #ifdef __WIN__
 	SYSTEMTIME st;
-	uint32_t pid = GetCurrentThreadId();
 #else
-	pid_t pid = 0;
 	time_t tim;
 	struct tm result;
-	uint64_t time_usecs;
 	uint32_t usecs;
 #endif				/* __WIN__ */
 
-	/* If this is a call to syslog - always print it */
-	if (!(verbosity & p_log->level))
-		return;
-
-	va_start(args, p_str);
-#ifndef __WIN__
-	if (p_log->log_prefix == NULL)
-		vsprintf(buffer, p_str, args);
-	else {
-		int n = snprintf(buffer, sizeof(buffer), "%s: ", p_log->log_prefix);
-		vsprintf(buffer + n, p_str, args);
-	}
-#else
-	if (p_log->log_prefix == NULL)
-		_vsnprintf(buffer, 1024, (LPSTR)p_str, args);
-	else {
-		int n = snprintf(buffer, sizeof(buffer), "%s: ", p_log->log_prefix);
-		_vsnprintf(buffer + n, (1024 - n), (LPSTR)p_str, args);
-	}
-#endif
-	va_end(args);
-
-	/* this is a call to the syslog */
-	if (verbosity & OSM_LOG_SYS) {
-		syslog(LOG_INFO, "%s\n", buffer);
-
-		/* SYSLOG should go to stdout too */
-		if (p_log->out_port != stdout) {
-			printf("%s\n", buffer);
-			fflush(stdout);
-		}
-#ifdef __WIN__
-		OsmReportState(buffer);
-#endif				/* __WIN__ */
-	}
-
-	/* regular log to default out_port */
-	cl_spinlock_acquire(&p_log->lock);
-
 	if (p_log->max_size && p_log->count > p_log->max_size) {
 		/* truncate here */
 		fprintf(stderr,
@@ -179,11 +140,9 @@ _retry:
 		    st.wHour, st.wMinute, st.wSecond, st.wMilliseconds,
 		    pid, verbosity, buffer);
 #else
-	time_usecs = cl_get_time_stamp();
 	tim = time_usecs / 1000000;
 	usecs = time_usecs % 1000000;
 	localtime_r(&tim, &result);
-	pid = pthread_self();
 _retry:
 	ret =
 	    fprintf(p_log->out_port,
@@ -195,9 +154,7 @@ _retry:
 #endif
 
 	/*  flush log */
-	if (ret > 0 &&
-	    (p_log->flush || (verbosity & (OSM_LOG_ERROR | OSM_LOG_SYS)))
-	    && fflush(p_log->out_port) < 0)
+	if (ret > 0 && flush && fflush(p_log->out_port) < 0)
 		ret = -1;
 
 	if (ret >= 0) {
@@ -214,7 +171,257 @@ _retry:
 		}
 		fprintf(stderr, "osm_log: write failed: %s\n", strerror(errno));
 	}
+}
+
+#ifndef __WIN__
+/*
+  Asynchronous mode.
+
+  Logging threads copy their formatted message into a byte ring under
+  ring_lock and the writer thread formats the time stamps and writes
+  the messages out in batches. The writer only takes ring_lock to
+  snapshot and to advance the offsets; the bytes between ring_tail and
+  ring_head are its own meanwhile.
+
+  Records are 8 byte aligned. A record that does not fit before the
+  end of the ring is placed at its start; the gap is marked with a
+  zero length header when there is room for one.
+ */
+typedef struct log_rec {
+	uint32_t len;
+	uint32_t pid;
+	uint64_t time_usecs;
+	osm_log_level_t verbosity;
+	char text[0];
+} log_rec_t;
+
+#define LOG_REC_ALIGN(len) (((len) + 7) & ~7)
+
+static boolean_t log_queue(IN osm_log_t * p_log, IN uint64_t time_usecs,
+			   IN uint32_t pid, IN osm_log_level_t verbosity,
+			   IN const char *buffer)
+{
+	size_t text_len = strlen(buffer) + 1;
+	uint32_t len = LOG_REC_ALIGN(sizeof(log_rec_t) + text_len);
+	uint32_t pos, gap = 0;
+	boolean_t was_empty;
+	log_rec_t *p_rec;
+
+	cl_spinlock_acquire(&p_log->ring_lock);
+	pos = p_log->ring_head % OSM_LOG_ASYNC_RING_SIZE;
+	if (OSM_LOG_ASYNC_RING_SIZE - pos < len)
+		gap = OSM_LOG_ASYNC_RING_SIZE - pos;
+	if (p_log->ring_head - p_log->ring_tail + gap + len >
+	    OSM_LOG_ASYNC_RING_SIZE) {
+		p_log->dropped++;
+		cl_spinlock_release(&p_log->ring_lock);
+		return FALSE;
+	}
+
+	was_empty = p_log->ring_head == p_log->ring_tail;
+	if (gap) {
+		if (gap >= sizeof(log_rec_t))
+			((log_rec_t *) (p_log->ring + pos))->len = 0;
+		pos = 0;
+	}
+	p_rec = (log_rec_t *) (p_log->ring + pos);
+	p_rec->len = len;
+	p_rec->pid = pid;
+	p_rec->time_usecs = time_usecs;
+	p_rec->verbosity = verbosity;
+	memcpy(p_rec->text, buffer, text_len);
+	p_log->ring_head += gap + len;
+	cl_spinlock_release(&p_log->ring_lock);
+
+	/* the writer re-checks the ring before it sleeps */
+	if (was_empty || (verbosity & (OSM_LOG_ERROR | OSM_LOG_SYS)))
+		cl_event_signal(&p_log->ring_event);
+
+	return TRUE;
+}
+
+/*
+  Writes out the queued messages and returns nonzero if more were
+  queued meanwhile.
+ */
+static int log_drain(IN osm_log_t * p_log)
+{
+	uint64_t tail, head;
+	unsigned long dropped;
+	uint32_t pos;
+	log_rec_t *p_rec;
+	int more;
+
+	cl_spinlock_acquire(&p_log->ring_lock);
+	tail = p_log->ring_tail;
+	head = p_log->ring_head;
+	dropped = p_log->dropped;
+	cl_spinlock_release(&p_log->ring_lock);
+
+	if (tail == head)
+		return 0;
+
+	cl_spinlock_acquire(&p_log->lock);
+	while (tail != head) {
+		pos = tail % OSM_LOG_ASYNC_RING_SIZE;
+		p_rec = (log_rec_t *) (p_log->ring + pos);
+		if (OSM_LOG_ASYNC_RING_SIZE - pos < sizeof(log_rec_t) ||
+		    p_rec->len == 0) {
+			tail += OSM_LOG_ASYNC_RING_SIZE - pos;
+			continue;
+		}
+		log_write(p_log, p_rec->time_usecs, p_rec->pid,
+			  p_rec->verbosity, p_rec->text, FALSE);
+		tail += p_rec->len;
+	}
+	if (dropped != p_log->dropped_reported) {
+		fprintf(p_log->out_port,
+			"osm_log: %lu messages dropped, log ring full\n",
+			dropped - p_log->dropped_reported);
+		p_log->dropped_reported = dropped;
+	}
+	fflush(p_log->out_port);
+	cl_spinlock_release(&p_log->lock);
+
+	cl_spinlock_acquire(&p_log->ring_lock);
+	p_log->ring_tail = tail;
+	more = p_log->ring_head != tail;
+	cl_spinlock_release(&p_log->ring_lock);
+
+	return more;
+}
+
+static void log_writer(IN void *context)
+{
+	osm_log_t *p_log = context;
+
+	while (!p_log->writer_exit) {
+		if (!log_drain(p_log))
+			cl_event_wait_on(&p_log->ring_event,
+					 EVENT_NO_TIMEOUT, TRUE);
+	}
 
+	while (log_drain(p_log)) ;
+}
+
+ib_api_status_t osm_log_start_async(IN osm_log_t * p_log)
+{
+	if (p_log->async)
+		return IB_SUCCESS;
+
+	p_log->ring = malloc(OSM_LOG_ASYNC_RING_SIZE);
+	if (!p_log->ring)
+		return IB_INSUFFICIENT_MEMORY;
+	p_log->ring_head = p_log->ring_tail = 0;
+	p_log->dropped = p_log->dropped_reported = 0;
+	p_log->writer_exit = FALSE;
+
+	cl_spinlock_construct(&p_log->ring_lock);
+	cl_event_construct(&p_log->ring_event);
+	cl_thread_construct(&p_log->writer);
+	if (cl_spinlock_init(&p_log->ring_lock) != CL_SUCCESS ||
+	    cl_event_init(&p_log->ring_event, FALSE) != CL_SUCCESS ||
+	    cl_thread_init(&p_log->writer, log_writer, p_log,
+			   "opensm log") != CL_SUCCESS) {
+		cl_event_destroy(&p_log->ring_event);
+		cl_spinlock_destroy(&p_log->ring_lock);
+		free(p_log->ring);
+		p_log->ring = NULL;
+		return IB_ERROR;
+	}
+
+	p_log->async = TRUE;
+	return IB_SUCCESS;
+}
+
+void osm_log_stop_async(IN osm_log_t * p_log)
+{
+	if (!p_log->async)
+		return;
+
+	p_log->writer_exit = TRUE;
+	cl_event_signal(&p_log->ring_event);
+	cl_thread_destroy(&p_log->writer);
+	p_log->async = FALSE;
+
+	cl_event_destroy(&p_log->ring_event);
+	cl_spinlock_destroy(&p_log->ring_lock);
+	free(p_log->ring);
+	p_log->ring = NULL;
+}
+#else
+ib_api_status_t osm_log_start_async(IN osm_log_t * p_log)
+{
+	return IB_UNSUPPORTED;
+}
+
+void osm_log_stop_async(IN osm_log_t * p_log)
+{
+}
+#endif				/* ndef __WIN__ */
+
+void osm_log(IN osm_log_t * p_log, IN osm_log_level_t verbosity,
+	     IN const char *p_str, ...)
+{
+	char buffer[LOG_ENTRY_SIZE_MAX];
+	va_list args;
+	uint64_t time_usecs = 0;
+#ifdef __WIN__
+	uint32_t pid = GetCurrentThreadId();
+#else
+	pid_t pid = 0;
+#endif				/* __WIN__ */
+
+	/* If this is a call to syslog - always print it */
+	if (!(verbosity & p_log->level))
+		return;
+
+	va_start(args, p_str);
+#ifndef __WIN__
+	if (p_log->log_prefix == NULL)
+		vsprintf(buffer, p_str, args);
+	else {
+		int n = snprintf(buffer, sizeof(buffer), "%s: ", p_log->log_prefix);
+		vsprintf(buffer + n, p_str, args);
+	}
+#else
+	if (p_log->log_prefix == NULL)
+		_vsnprintf(buffer, 1024, (LPSTR)p_str, args);
+	else {
+		int n = snprintf(buffer, sizeof(buffer), "%s: ", p_log->log_prefix);
+		_vsnprintf(buffer + n, (1024 - n), (LPSTR)p_str, args);
+	}
+#endif
+	va_end(args);
+
+	/* this is a call to the syslog */
+	if (verbosity & OSM_LOG_SYS) {
+		syslog(LOG_INFO, "%s\n", buffer);
+
+		/* SYSLOG should go to stdout too */
+		if (p_log->out_port != stdout) {
+			printf("%s\n", buffer);
+			fflush(stdout);
+		}
+#ifdef __WIN__
+		OsmReportState(buffer);
+#endif				/* __WIN__ */
+	}
+
+#ifndef __WIN__
+	time_usecs = cl_get_time_stamp();
+	pid = pthread_self();
+
+	if (p_log->async) {
+		log_queue(p_log, time_usecs, pid, verbosity, buffer);
+		return;
+	}
+#endif
+
+	/* regular log to default out_port */
+	cl_spinlock_acquire(&p_log->lock);
+	log_write(p_log, time_usecs, pid, verbosity, buffer,
+		  p_log->flush || (verbosity & (OSM_LOG_ERROR | OSM_LOG_SYS)));
 	cl_spinlock_release(&p_log->lock);
 }
 
@@ -316,6 +523,17 @@ int osm_log_reopen_file(osm_log_t * p_log)
 	return ret;
 }
 
+void osm_log_destroy(IN osm_log_t * p_log)
+{
+	osm_log_stop_async(p_log);
+	cl_spinlock_destroy(&p_log->lock);
+	if (p_log->out_port != stdout) {
+		fclose(p_log->out_port);
+		p_log->out_port = stdout;
+	}
+	closelog();
+}
+
 ib_api_status_t osm_log_init_v2(IN osm_log_t * p_log, IN boolean_t flush,
 				IN uint8_t log_flags, IN const char *log_file,
 				IN unsigned long max_size,
@@ -327,6 +545,9 @@ ib_api_status_t osm_log_init_v2(IN osm_log_t * p_log, IN boolean_t flush,
 	p_log->max_size = max_size << 20; /* convert size in MB to bytes */
 	p_log->accum_log_file = accum_log_file;
 	p_log->log_file_name = (char *)log_file;
+	p_log->async = FALSE;
+	p_log->ring = NULL;
+	p_log->dropped = 0;
 
 	openlog("OpenSM", LOG_CONS | LOG_PID, LOG_USER);
 
@@ -50,21 +50,188 @@
 #include <opensm/osm_madw.h>
 #include <vendor/osm_vendor_api.h>
 
+/* Number of wrappers moved between a thread cache and the shared list */
+#define MAD_POOL_BATCH 32
+
+typedef struct mad_pool_cache {
+	cl_list_item_t list_item;
+	osm_mad_pool_t *p_pool;
+	cl_qlist_t free_list;
+} mad_pool_cache_t;
+
+static void free_madw_list(IN cl_qlist_t * p_list)
+{
+	while (!cl_is_qlist_empty(p_list))
+		free(cl_qlist_remove_head(p_list));
+}
+
+/*
+  Moves up to count wrappers from p_src to p_dest and returns
+  the number moved.
+ */
+static unsigned move_madws(IN cl_qlist_t * p_dest, IN cl_qlist_t * p_src,
+			   IN unsigned count)
+{
+	unsigned n;
+
+	for (n = 0; n < count && !cl_is_qlist_empty(p_src); n++)
+		cl_qlist_insert_head(p_dest, cl_qlist_remove_head(p_src));
+
+	return n;
+}
+
+/*
+  Spills the wrappers of p_list to the shared free list, freeing the
+  ones above the high-water mark. Called with the pool lock held.
+ */
+static void spill_madws(IN osm_mad_pool_t * p_pool, IN cl_qlist_t * p_list,
+			IN cl_qlist_t * p_excess)
+{
+	size_t room = 0;
+
+	if (cl_qlist_count(&p_pool->free_list) < p_pool->max_free)
+		room = p_pool->max_free - cl_qlist_count(&p_pool->free_list);
+	move_madws(&p_pool->free_list, p_list, room);
+	cl_qlist_insert_list_tail(p_excess, p_list);
+}
+
+static void cache_release(IN void *context)
+{
+	mad_pool_cache_t *p_cache = context;
+	osm_mad_pool_t *p_pool = p_cache->p_pool;
+	cl_qlist_t excess;
+
+	cl_qlist_init(&excess);
+	cl_spinlock_acquire(&p_pool->lock);
+	cl_qlist_remove_item(&p_pool->caches, &p_cache->list_item);
+	spill_madws(p_pool, &p_cache->free_list, &excess);
+	cl_spinlock_release(&p_pool->lock);
+
+	free_madw_list(&excess);
+	free(p_cache);
+}
+
+static mad_pool_cache_t *get_cache(IN osm_mad_pool_t * p_pool)
+{
+	mad_pool_cache_t *p_cache;
+
+	if (!p_pool->key_created)
+		return NULL;
+
+	p_cache = pthread_getspecific(p_pool->cache_key);
+	if (p_cache)
+		return p_cache;
+
+	p_cache = malloc(sizeof(*p_cache));
+	if (!p_cache)
+		return NULL;
+	p_cache->p_pool = p_pool;
+	cl_qlist_init(&p_cache->free_list);
+	if (pthread_setspecific(p_pool->cache_key, p_cache)) {
+		free(p_cache);
+		return NULL;
+	}
+
+	cl_spinlock_acquire(&p_pool->lock);
+	cl_qlist_insert_tail(&p_pool->caches, &p_cache->list_item);
+	cl_spinlock_release(&p_pool->lock);
+
+	return p_cache;
+}
+
+static osm_madw_t *alloc_madw(IN osm_mad_pool_t * p_pool)
+{
+	mad_pool_cache_t *p_cache = get_cache(p_pool);
+
+	if (p_cache) {
+		if (cl_is_qlist_empty(&p_cache->free_list)) {
+			cl_spinlock_acquire(&p_pool->lock);
+			move_madws(&p_cache->free_list, &p_pool->free_list,
+				   MAD_POOL_BATCH);
+			cl_spinlock_release(&p_pool->lock);
+		}
+		if (!cl_is_qlist_empty(&p_cache->free_list)) {
+			cl_atomic_inc(&p_pool->hits);
+			return (osm_madw_t *)
+			    cl_qlist_remove_head(&p_cache->free_list);
+		}
+	}
+
+	cl_atomic_inc(&p_pool->misses);
+	return malloc(sizeof(osm_madw_t));
+}
+
+static void free_madw(IN osm_mad_pool_t * p_pool, IN osm_madw_t * p_madw)
+{
+	mad_pool_cache_t *p_cache = get_cache(p_pool);
+	cl_qlist_t batch, excess;
+
+	if (!p_cache) {
+		free(p_madw);
+		return;
+	}
+
+	cl_qlist_insert_head(&p_cache->free_list, &p_madw->list_item);
+	if (cl_qlist_count(&p_cache->free_list) <= 2 * MAD_POOL_BATCH)
+		return;
+
+	cl_qlist_init(&batch);
+	cl_qlist_init(&excess);
+	move_madws(&batch, &p_cache->free_list, MAD_POOL_BATCH);
+
+	cl_spinlock_acquire(&p_pool->lock);
+	spill_madws(p_pool, &batch, &excess);
+	cl_spinlock_release(&p_pool->lock);
+
+	free_madw_list(&excess);
+}
+
 void osm_mad_pool_construct(IN osm_mad_pool_t * p_pool)
 {
 	CL_ASSERT(p_pool);
 
 	memset(p_pool, 0, sizeof(*p_pool));
+	cl_spinlock_construct(&p_pool->lock);
+	cl_qlist_init(&p_pool->free_list);
+	cl_qlist_init(&p_pool->caches);
 }
 
 void osm_mad_pool_destroy(IN osm_mad_pool_t * p_pool)
 {
+	mad_pool_cache_t *p_cache;
+
 	CL_ASSERT(p_pool);
+
+	if (p_pool->key_created) {
+		pthread_key_delete(p_pool->cache_key);
+		p_pool->key_created = FALSE;
+	}
+
+	while (!cl_is_qlist_empty(&p_pool->caches)) {
+		p_cache = (mad_pool_cache_t *)
+		    cl_qlist_remove_head(&p_pool->caches);
+		free_madw_list(&p_cache->free_list);
+		free(p_cache);
+	}
+	free_madw_list(&p_pool->free_list);
+
+	cl_spinlock_destroy(&p_pool->lock);
 }
 
 ib_api_status_t osm_mad_pool_init(IN osm_mad_pool_t * p_pool)
 {
+	ib_api_status_t status;
+
 	p_pool->mads_out = 0;
+	p_pool->max_free = OSM_DEFAULT_MAD_POOL_MAX_FREE;
+
+	status = cl_spinlock_init(&p_pool->lock);
+	if (status != IB_SUCCESS)
+		return status;
+
+	/* without a key every get and put simply goes to the heap */
+	p_pool->key_created =
+	    pthread_key_create(&p_pool->cache_key, cache_release) == 0;
 
 	return IB_SUCCESS;
 }
@@ -83,7 +250,7 @@ osm_madw_t *osm_mad_pool_get(IN osm_mad_pool_t * p_pool,
 	/*
 	   First, acquire a mad wrapper from the mad wrapper pool.
 	 */
-	p_madw = malloc(sizeof(*p_madw));
+	p_madw = alloc_madw(p_pool);
 	if (p_madw == NULL)
 		goto Exit;
 
@@ -95,7 +262,7 @@ osm_madw_t *osm_mad_pool_get(IN osm_mad_pool_t * p_pool,
 	p_mad = osm_vendor_get(h_bind, total_size, &p_madw->vend_wrap);
 	if (p_mad == NULL) {
 		/* Don't leak wrappers! */
-		free(p_madw);
+		free_madw(p_pool, p_madw);
 		p_madw = NULL;
 		goto Exit;
 	}
@@ -125,7 +292,7 @@ osm_madw_t *osm_mad_pool_get_wrapper(IN osm_mad_pool_t * p_pool,
 	/*
 	   First, acquire a mad wrapper from the mad wrapper pool.
 	 */
-	p_madw = malloc(sizeof(*p_madw));
+	p_madw = alloc_madw(p_pool);
 	if (p_madw == NULL)
 		goto Exit;
 
@@ -144,7 +311,7 @@ osm_madw_t *osm_mad_pool_get_wrapper_raw(IN osm_mad_pool_t * p_pool)
 {
 	osm_madw_t *p_madw;
 
-	p_madw = malloc(sizeof(*p_madw));
+	p_madw = alloc_madw(p_pool);
 	if (!p_madw)
 		return NULL;
 
@@ -168,6 +335,6 @@ void osm_mad_pool_put(IN osm_mad_pool_t * p_pool, IN osm_madw_t * p_madw)
 	/*
 	   Return the mad wrapper to the wrapper pool
 	 */
-	free(p_madw);
+	free_madw(p_pool, p_madw);
 	cl_atomic_dec(&p_pool->mads_out);
 }
@@ -233,6 +233,7 @@ void osm_opensm_construct(IN osm_opensm_t * p_osm)
 	osm_db_construct(&p_osm->db);
 	osm_mad_pool_construct(&p_osm->mad_pool);
 	osm_vl15_construct(&p_osm->vl15);
+	osm_trace_construct(&p_osm->trace);
 	osm_log_construct(&p_osm->log);
 }
 
@@ -308,6 +309,7 @@ void osm_opensm_destroy(IN osm_opensm_t * p_osm)
 #endif				/* ENABLE_OSM_PERF_MGR */
 	osm_db_destroy(&p_osm->db);
 	osm_vl15_destroy(&p_osm->vl15, &p_osm->mad_pool);
+	osm_trace_destroy(&p_osm->trace);
 	osm_mad_pool_destroy(&p_osm->mad_pool);
 	osm_vendor_delete(&p_osm->p_vendor);
 	osm_subn_destroy(&p_osm->subn);
@@ -403,6 +405,9 @@ ib_api_status_t osm_opensm_init(IN osm_opensm_t * p_osm,
 	if (status != IB_SUCCESS)
 		return status;
 	p_osm->log.log_prefix = p_opt->log_prefix;
+	if (p_opt->log_async && osm_log_start_async(&p_osm->log) != IB_SUCCESS)
+		OSM_LOG(&p_osm->log, OSM_LOG_ERROR,
+			"failed to start async log writer, logging synchronously\n");
 
 	/* If there is a log level defined - add the OSM_VERSION to it */
 	osm_log(&p_osm->log,
@@ -455,10 +460,18 @@ ib_api_status_t osm_opensm_init(IN osm_opensm_t * p_osm,
 	if (status != IB_SUCCESS)
 		goto Exit;
 
+	if (p_opt->trace_file &&
+	    osm_trace_init(&p_osm->trace, &p_osm->log, p_opt->trace_file,
+			   p_opt->trace_size) != IB_SUCCESS)
+		OSM_LOG(&p_osm->log, OSM_LOG_ERROR,
+			"MAD tracing disabled\n");
+
 	status = osm_vl15_init(&p_osm->vl15, p_osm->p_vendor,
-			       &p_osm->log, &p_osm->stats,
+			       &p_osm->log, &p_osm->stats, &p_osm->trace,
 			       p_opt->max_wire_smps, p_opt->max_wire_smps2,
-			       p_opt->max_smps_timeout);
+			       p_opt->max_smps_timeout,
+			       p_opt->adaptive_wire_smps,
+			       p_opt->vl15_threads);
 	if (status != IB_SUCCESS)
 		goto Exit;
 
@@ -469,14 +482,15 @@ ib_api_status_t osm_opensm_init(IN osm_opensm_t * p_osm,
 
 	status = osm_sm_init(&p_osm->sm, &p_osm->subn, &p_osm->db,
 			     p_osm->p_vendor, &p_osm->mad_pool, &p_osm->vl15,
-			     &p_osm->log, &p_osm->stats, &p_osm->disp,
-			     &p_osm->lock);
+			     &p_osm->log, &p_osm->stats, &p_osm->trace,
+			     &p_osm->disp, &p_osm->lock);
 	if (status != IB_SUCCESS)
 		goto Exit;
 
 	status = osm_sa_init(&p_osm->sm, &p_osm->sa, &p_osm->subn,
 			     p_osm->p_vendor, &p_osm->mad_pool, &p_osm->log,
-			     &p_osm->stats, &p_osm->disp, &p_osm->lock);
+			     &p_osm->stats, &p_osm->trace, &p_osm->disp,
+			     &p_osm->lock);
 	if (status != IB_SUCCESS)
 		goto Exit;
 
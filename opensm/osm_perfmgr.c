@@ -67,6 +67,17 @@
 #include <opensm/osm_helper.h>
 
 #define PERFMGR_INITIAL_TID_VALUE 0xcafe
+#define PERFMGR_ALL_PORT_SELECT 0xFF
+
+/*
+ * Pacing: the window of outstanding queries is halved when the smoothed
+ * round trip time exceeds PERFMGR_PACE_RTT_FACTOR times the fastest one
+ * seen (at least PERFMGR_PACE_MIN_RTT_USEC) and grows by one query per
+ * window of responses otherwise.
+ */
+#define PERFMGR_PACE_RTT_FACTOR 4
+#define PERFMGR_PACE_MIN_RTT_USEC 100
+#define PERFMGR_PACE_RTT_WARMUP 8
 
 #if ENABLE_OSM_PERF_MGR_PROFILE
 struct {
@@ -119,45 +130,87 @@ static inline void diff_time(struct timeval *before, struct timeval *after,
  **********************************************************************/
 static void init_monitored_nodes(osm_perfmgr_t * pm)
 {
+	cl_plock_construct(&pm->lock);
+	cl_plock_init(&pm->lock);
 	cl_qmap_init(&pm->monitored_map);
-	pm->remove_list = NULL;
 	cl_event_construct(&pm->sig_query);
 	cl_event_init(&pm->sig_query, FALSE);
 }
 
-static void mark_for_removal(osm_perfmgr_t * pm, monitored_node_t * node)
+static void free_monitored_node(monitored_node_t * mon_node)
 {
-	if (pm->remove_list) {
-		node->next = pm->remove_list;
-		pm->remove_list = node;
-	} else {
-		node->next = NULL;
-		pm->remove_list = node;
-	}
+	if (mon_node->name)
+		free(mon_node->name);
+	free(mon_node);
 }
 
-static void remove_marked_nodes(osm_perfmgr_t * pm)
+static inline void decrement_outstanding_queries(osm_perfmgr_t * pm)
 {
-	while (pm->remove_list) {
-		monitored_node_t *next = pm->remove_list->next;
+	cl_atomic_dec(&pm->outstanding_queries);
+	cl_event_signal(&pm->sig_query);
+}
 
-		cl_qmap_remove_item(&pm->monitored_map,
-				    (cl_map_item_t *) (pm->remove_list));
+/**********************************************************************
+ * Update the pacing window with the response to, or the timeout of,
+ * a query.
+ **********************************************************************/
+static void perfmgr_pace_complete(osm_perfmgr_t * pm, osm_madw_t * p_madw,
+				  boolean_t timed_out)
+{
+	uint32_t rtt, base;
+	int32_t err;
+	uint64_t now;
 
-		if (pm->rm_nodes)
-			perfmgr_db_delete_entry(pm->db, pm->remove_list->guid);
+	if (!pm->pacing || !p_madw->send_time)
+		return;
+
+	now = cl_get_time_stamp();
+	rtt = now > p_madw->send_time ?
+	    (uint32_t) (now - p_madw->send_time) : 0;
 
-		if (pm->remove_list->name)
-			free(pm->remove_list->name);
-		free(pm->remove_list);
-		pm->remove_list = next;
+	cl_spinlock_acquire(&pm->poll_lock);
+
+	if (!timed_out) {
+		/* Jacobson/Karels estimator, srtt scaled by 8 and rttvar by 4 */
+		if (pm->rtt_samples++ == 0) {
+			pm->srtt = rtt << 3;
+			pm->rttvar = rtt << 1;
+		} else {
+			err = (int32_t) rtt - (int32_t) (pm->srtt >> 3);
+			pm->srtt += err;
+			if (err < 0)
+				err = -err;
+			pm->rttvar += err - (int32_t) (pm->rttvar >> 2);
+		}
+		if (!pm->min_rtt || rtt < pm->min_rtt)
+			pm->min_rtt = rtt;
+
+		base = pm->min_rtt > PERFMGR_PACE_MIN_RTT_USEC ?
+		    pm->min_rtt : PERFMGR_PACE_MIN_RTT_USEC;
+		if (pm->rtt_samples < PERFMGR_PACE_RTT_WARMUP ||
+		    pm->srtt >> 3 <= PERFMGR_PACE_RTT_FACTOR * base) {
+			if (++pm->acked >= pm->window) {
+				pm->acked = 0;
+				if (pm->window < pm->max_outstanding_queries)
+					pm->window++;
+			}
+			goto Exit;
+		}
 	}
-}
 
-static inline void decrement_outstanding_queries(osm_perfmgr_t * pm)
-{
-	cl_atomic_dec(&pm->outstanding_queries);
-	cl_event_signal(&pm->sig_query);
+	/* back off once per window, queries sent before are stale */
+	if (p_madw->send_time >= pm->last_backoff) {
+		pm->window = pm->window > 1 ? pm->window / 2 : 1;
+		pm->acked = 0;
+		pm->last_backoff = now;
+		OSM_LOG(pm->log, OSM_LOG_VERBOSE, "PerfMgr query %s (srtt "
+			"%u usec), window reduced to %u\n",
+			timed_out ? "timed out" : "slow", pm->srtt >> 3,
+			pm->window);
+	}
+
+Exit:
+	cl_spinlock_release(&pm->poll_lock);
 }
 
 /**********************************************************************
@@ -172,6 +225,7 @@ static void perfmgr_mad_recv_callback(osm_madw_t * p_madw, void *bind_context,
 	OSM_LOG_ENTER(pm->log);
 
 	osm_madw_copy_context(p_madw, p_req_madw);
+	perfmgr_pace_complete(pm, p_req_madw, FALSE);
 	osm_mad_pool_put(pm->mad_pool, p_req_madw);
 
 	decrement_outstanding_queries(pm);
@@ -202,12 +256,16 @@ static void perfmgr_mad_send_err_callback(void *bind_context,
 
 	OSM_LOG_ENTER(pm->log);
 
+	perfmgr_pace_complete(pm, p_madw, p_madw->status == IB_TIMEOUT);
+
 	/*
 	 * get the monitored node struct to have the printable name
 	 * for log messages
 	 */
+	cl_plock_acquire(&pm->lock);
 	if ((p_node = cl_qmap_get(&pm->monitored_map, node_guid)) ==
 	    cl_qmap_end(&pm->monitored_map)) {
+		cl_plock_release(&pm->lock);
 		OSM_LOG(pm->log, OSM_LOG_ERROR, "ERR 4C15: GUID 0x%016"
 			PRIx64 " not found in monitored map\n", node_guid);
 		goto Exit;
@@ -217,12 +275,11 @@ static void perfmgr_mad_send_err_callback(void *bind_context,
 	OSM_LOG(pm->log, OSM_LOG_ERROR, "ERR 4C02: %s (0x%" PRIx64
 		") port %u\n", p_mon_node->name, p_mon_node->guid, port);
 
-	if (pm->subn->opt.perfmgr_redir && p_madw->status == IB_TIMEOUT) {
-		/* First, find the node in the monitored map */
-		cl_plock_acquire(&pm->osm->lock);
+	if (pm->subn->opt.perfmgr_redir && p_madw->status == IB_TIMEOUT &&
+	    port != PERFMGR_ALL_PORT_SELECT) {
 		/* Now, validate port number */
 		if (port >= p_mon_node->num_ports) {
-			cl_plock_release(&pm->osm->lock);
+			cl_plock_release(&pm->lock);
 			OSM_LOG(pm->log, OSM_LOG_ERROR, "ERR 4C16: "
 				"Invalid port num %u for %s (GUID 0x%016"
 				PRIx64 ") num ports %u\n", port,
@@ -235,8 +292,8 @@ static void perfmgr_mad_send_err_callback(void *bind_context,
 		memset(&p_mon_node->port[port], 0, sizeof(monitored_port_t));
 		p_mon_node->port[port].orig_lid = orig_lid;
 		p_mon_node->port[port].valid = TRUE;
-		cl_plock_release(&pm->osm->lock);
 	}
+	cl_plock_release(&pm->lock);
 
 Exit:
 	osm_mad_pool_put(pm->mad_pool, p_madw);
@@ -336,17 +393,18 @@ static ib_net16_t get_base_lid(osm_node_t * p_node, uint8_t port)
 }
 
 /**********************************************************************
- * Given a node, a port, and an optional monitored node,
- * return the lid appropriate to query that port
+ * Given a monitored node and a port, return the lid appropriate to
+ * query that port
  **********************************************************************/
-static ib_net16_t get_lid(osm_node_t * p_node, uint8_t port,
-			  monitored_node_t * mon_node)
+static ib_net16_t get_lid(monitored_node_t * mon_node, uint8_t port)
 {
-	if (mon_node && mon_node->num_ports && port < mon_node->num_ports &&
-	    mon_node->port[port].lid)
+	if (port >= mon_node->num_ports)
+		return 0;
+
+	if (mon_node->port[port].lid)
 		return mon_node->port[port].lid;
 
-	return get_base_lid(p_node, port);
+	return mon_node->port[port].orig_lid;
 }
 
 
@@ -414,13 +472,16 @@ static osm_madw_t *perfmgr_build_mad(osm_perfmgr_t * perfmgr,
 static ib_api_status_t perfmgr_send_mad(osm_perfmgr_t *perfmgr,
 					osm_madw_t * const p_madw)
 {
-	ib_api_status_t status = osm_vendor_send(perfmgr->bind_handle, p_madw,
-						 TRUE);
+	ib_api_status_t status;
+	uint32_t max_queries = perfmgr->pacing ?
+	    perfmgr->window : perfmgr->max_outstanding_queries;
+
+	p_madw->send_time = cl_get_time_stamp();
+	status = osm_vendor_send(perfmgr->bind_handle, p_madw, TRUE);
 	if (status == IB_SUCCESS) {
 		/* pause thread if there are too many outstanding requests */
 		cl_atomic_inc(&(perfmgr->outstanding_queries));
-		if (perfmgr->outstanding_queries >
-		    perfmgr->max_outstanding_queries) {
+		if (perfmgr->outstanding_queries > max_queries) {
 			perfmgr->sweep_state = PERFMGR_SWEEP_SUSPENDED;
 			cl_event_wait_on(&perfmgr->sig_query, EVENT_NO_TIMEOUT,
 					 TRUE);
@@ -466,62 +527,121 @@ static ib_api_status_t perfmgr_send_pc_mad(osm_perfmgr_t * perfmgr,
 }
 
 /**********************************************************************
- * sweep the node_guid_tbl and collect the node guids to be tracked
+ * Allocate the monitored node for a node of the subnet
  **********************************************************************/
-static void collect_guids(cl_map_item_t * p_map_item, void *context)
+static monitored_node_t *new_monitored_node(osm_perfmgr_t * pm,
+					    osm_node_t * node)
 {
-	osm_node_t *node = (osm_node_t *) p_map_item;
 	uint64_t node_guid = cl_ntoh64(node->node_info.node_guid);
-	osm_perfmgr_t *pm = (osm_perfmgr_t *) context;
 	monitored_node_t *mon_node = NULL;
 	uint32_t num_ports;
 	int port;
 
-	OSM_LOG_ENTER(pm->log);
+	num_ports = osm_node_get_num_physp(node);
+	mon_node = malloc(sizeof(*mon_node) +
+			  sizeof(monitored_port_t) * num_ports);
+	if (!mon_node) {
+		OSM_LOG(pm->log, OSM_LOG_ERROR, "PerfMgr: ERR 4C06: "
+			"malloc failed: not handling node %s"
+			"(GUID 0x%" PRIx64 ")\n", node->print_desc,
+			node_guid);
+		return NULL;
+	}
+	memset(mon_node, 0,
+	       sizeof(*mon_node) + sizeof(monitored_port_t) * num_ports);
+	mon_node->guid = node_guid;
+	mon_node->name = strdup(node->print_desc);
+	mon_node->num_ports = num_ports;
+	mon_node->node_type = node->node_info.node_type;
+	/* check for enhanced switch port 0 */
+	mon_node->esp0 = (node->sw &&
+			  ib_switch_info_is_enhanced_port0(&node->sw->
+							   switch_info));
+	for (port = mon_node->esp0 ? 0 : 1; port < num_ports; port++) {
+		mon_node->port[port].orig_lid = 0;
+		mon_node->port[port].valid = FALSE;
+		if (osm_physp_is_valid(&node->physp_table[port])) {
+			mon_node->port[port].orig_lid = get_base_lid(node, port);
+			mon_node->port[port].valid = TRUE;
+		}
+	}
 
-	if (cl_qmap_get(&pm->monitored_map, node_guid)
-	    == cl_qmap_end(&pm->monitored_map)) {
+	return mon_node;
+}
 
-		if (pm->ignore_cas &&
-		    (node->node_info.node_type == IB_NODE_TYPE_CA))
-			goto Exit;
+/**********************************************************************
+ * Compare the LIDs cached for the ports of a monitored node with the
+ * ones of the subnet and, if update is set, refresh them.
+ * Return TRUE if any of them differ.
+ **********************************************************************/
+static boolean_t update_monitored_ports(monitored_node_t * mon_node,
+					osm_node_t * node, boolean_t update)
+{
+	boolean_t changed = FALSE;
+	ib_net16_t lid;
+	uint32_t port;
 
-		/* if not already in map add it */
-		num_ports = osm_node_get_num_physp(node);
-		mon_node = malloc(sizeof(*mon_node) +
-				  sizeof(monitored_port_t) * num_ports);
-		if (!mon_node) {
-			OSM_LOG(pm->log, OSM_LOG_ERROR, "PerfMgr: ERR 4C06: "
-				"malloc failed: not handling node %s"
-				"(GUID 0x%" PRIx64 ")\n", node->print_desc,
-				node_guid);
-			goto Exit;
-		}
-		memset(mon_node, 0,
-		       sizeof(*mon_node) + sizeof(monitored_port_t) * num_ports);
-		mon_node->guid = node_guid;
-		mon_node->name = strdup(node->print_desc);
-		mon_node->num_ports = num_ports;
-		mon_node->node_type = node->node_info.node_type;
-		/* check for enhanced switch port 0 */
-		mon_node->esp0 = (node->sw &&
-				  ib_switch_info_is_enhanced_port0(&node->sw->
-								   switch_info));
-		for (port = mon_node->esp0 ? 0 : 1; port < num_ports; port++) {
-			mon_node->port[port].orig_lid = 0;
-			mon_node->port[port].valid = FALSE;
-			if (osm_physp_is_valid(&node->physp_table[port])) {
-				mon_node->port[port].orig_lid = get_base_lid(node, port);
-				mon_node->port[port].valid = TRUE;
-			}
-		}
+	for (port = mon_node->esp0 ? 0 : 1; port < mon_node->num_ports;
+	     port++) {
+		if (!osm_physp_is_valid(&node->physp_table[port]))
+			continue;
 
-		cl_qmap_insert(&pm->monitored_map, node_guid,
-			       (cl_map_item_t *) mon_node);
+		lid = get_base_lid(node, port);
+		if (lid == mon_node->port[port].orig_lid)
+			continue;
+
+		changed = TRUE;
+		if (!update)
+			break;
+
+		/* a port which was down when the node was added */
+		if (!mon_node->port[port].orig_lid)
+			mon_node->port[port].valid = TRUE;
+		mon_node->port[port].orig_lid = lid;
 	}
 
-Exit:
-	OSM_LOG_EXIT(pm->log);
+	return changed;
+}
+
+/**********************************************************************
+ * Cache the P_Key table of the PerfMgr port for redirection
+ **********************************************************************/
+static void update_local_port(osm_perfmgr_t * pm, osm_port_t * p_port)
+{
+	const osm_pkey_tbl_t *p_pkey_tbl;
+	ib_pkey_table_t *block;
+	ib_net16_t *pkeys;
+	uint16_t num_blocks, block_index;
+
+	pm->local_port =
+	    ib_node_info_get_local_port_num(&p_port->p_node->node_info);
+
+	if (!p_port->p_physp || !osm_physp_is_valid(p_port->p_physp))
+		return;
+
+	p_pkey_tbl = osm_physp_get_pkey_tbl(p_port->p_physp);
+	num_blocks = osm_pkey_tbl_get_num_blocks(p_pkey_tbl);
+	if (!num_blocks)
+		return;
+
+	pkeys = calloc(num_blocks * IB_NUM_PKEY_ELEMENTS_IN_BLOCK,
+		       sizeof(*pkeys));
+	if (!pkeys)
+		return;
+
+	for (block_index = 0; block_index < num_blocks; block_index++) {
+		block = osm_pkey_tbl_block_get(p_pkey_tbl, block_index);
+		if (block)
+			memcpy(&pkeys[block_index *
+				      IB_NUM_PKEY_ELEMENTS_IN_BLOCK],
+			       block->pkey_entry, sizeof(block->pkey_entry));
+	}
+
+	cl_plock_excl_acquire(&pm->lock);
+	free(pm->local_pkeys);
+	pm->local_pkeys = pkeys;
+	pm->num_local_pkeys = num_blocks * IB_NUM_PKEY_ELEMENTS_IN_BLOCK;
+	cl_plock_release(&pm->lock);
 }
 
 /**********************************************************************
@@ -610,62 +730,49 @@ static ib_api_status_t perfmgr_send_pce_mad(osm_perfmgr_t * perfmgr,
 }
 
 /**********************************************************************
- * query the Port Counters of all the nodes in the subnet.
+ * return if the switch PMA can sum the counters of all its ports
  **********************************************************************/
-static void perfmgr_query_counters(cl_map_item_t * p_map_item, void *context)
+static inline boolean_t all_port_select_supported(osm_perfmgr_t * pm,
+						  monitored_node_t * mon_node)
 {
-	ib_api_status_t status = IB_SUCCESS;
-	osm_perfmgr_t *pm = context;
-	osm_node_t *node = NULL;
-	monitored_node_t *mon_node = (monitored_node_t *) p_map_item;
-	osm_madw_context_t mad_context;
-	uint64_t node_guid = 0;
-	ib_net32_t remote_qp;
-	uint8_t port, num_ports = 0;
+	monitored_port_t *mon_port;
 
-	OSM_LOG_ENTER(pm->log);
+	if (!pm->all_port_select ||
+	    mon_node->node_type != IB_NODE_TYPE_SWITCH ||
+	    mon_node->num_ports < 2)
+		return FALSE;
 
-	cl_plock_acquire(&pm->osm->lock);
-	node = osm_get_node_by_guid(pm->subn, cl_hton64(mon_node->guid));
-	if (!node) {
-		OSM_LOG(pm->log, OSM_LOG_ERROR,
-			"ERR 4C07: Node \"%s\" (guid 0x%" PRIx64
-			") no longer exists so removing from PerfMgr monitoring\n",
-			mon_node->name, mon_node->guid);
-		mark_for_removal(pm, mon_node);
-		goto Exit;
-	}
-
-	num_ports = osm_node_get_num_physp(node);
-	node_guid = cl_ntoh64(node->node_info.node_guid);
+	/* switches share one ClassPortInfo for all their ports */
+	mon_port = &(mon_node->port[1]);
+	return (mon_port->cpi_valid
+		&& (mon_port->cap_mask & IB_PM_ALL_PORT_SELECT));
+}
 
-	/* make sure there is a database object ready to store this info */
-	if (perfmgr_db_create_entry(pm->db, node_guid, mon_node->esp0,
-				    num_ports, node->print_desc) !=
-	    PERFMGR_EVENT_DB_SUCCESS) {
-		OSM_LOG(pm->log, OSM_LOG_ERROR,
-			"ERR 4C08: DB create entry failed for 0x%"
-			PRIx64 " (%s) : %s\n", node_guid, node->print_desc,
-			strerror(errno));
-		goto Exit;
-	}
+/**********************************************************************
+ * Issue the queries for each port of a node.
+ * Called with the PerfMgr lock held.
+ **********************************************************************/
+static void perfmgr_query_ports(osm_perfmgr_t * pm,
+				monitored_node_t * mon_node)
+{
+	ib_api_status_t status = IB_SUCCESS;
+	osm_madw_context_t mad_context;
+	uint64_t node_guid = mon_node->guid;
+	ib_net32_t remote_qp;
+	uint8_t port;
 
-	/* issue the query for each port */
-	for (port = mon_node->esp0 ? 0 : 1; port < num_ports; port++) {
+	for (port = mon_node->esp0 ? 0 : 1; port < mon_node->num_ports;
+	     port++) {
 		ib_net16_t lid;
 
-		if (!osm_node_get_physp_ptr(node, port))
-			continue;
-
 		if (!mon_node->port[port].valid)
 			continue;
 
-		lid = get_lid(node, port, mon_node);
+		lid = get_lid(mon_node, port);
 		if (lid == 0) {
 			OSM_LOG(pm->log, OSM_LOG_DEBUG, "WARN: node 0x%" PRIx64
 				" port %d (%s): port out of range, skipping\n",
-				cl_ntoh64(node->node_info.node_guid), port,
-				node->print_desc);
+				node_guid, port, mon_node->name);
 			continue;
 		}
 
@@ -685,11 +792,10 @@ static void perfmgr_query_counters(cl_map_item_t * p_map_item, void *context)
 					"Failed to issue ClassPortInfo query "
 					"for node 0x%" PRIx64
 					" port %d (%s)\n",
-					node->node_info.node_guid, port,
-					node->print_desc);
+					node_guid, port, mon_node->name);
 			if (mon_node->node_type == IB_NODE_TYPE_SWITCH)
-				goto Exit; /* only need to issue 1 CPI query
-						for switches */
+				return; /* only need to issue 1 CPI query
+					   for switches */
 		} else {
 
 #if ENABLE_OSM_PERF_MGR_PROFILE
@@ -697,7 +803,7 @@ static void perfmgr_query_counters(cl_map_item_t * p_map_item, void *context)
 #endif
 			OSM_LOG(pm->log, OSM_LOG_VERBOSE, "Getting stats for node 0x%"
 				PRIx64 " port %d (lid %u) (%s)\n", node_guid, port,
-				cl_ntoh16(lid), node->print_desc);
+				cl_ntoh16(lid), mon_node->name);
 			status = perfmgr_send_pc_mad(pm, lid, remote_qp,
 						     mon_node->port[port].pkey_ix,
 						     port, IB_MAD_METHOD_GET,
@@ -707,8 +813,7 @@ static void perfmgr_query_counters(cl_map_item_t * p_map_item, void *context)
 				OSM_LOG(pm->log, OSM_LOG_ERROR, "ERR 4C09: "
 					"Failed to issue port counter query for node 0x%"
 					PRIx64 " port %d (%s)\n",
-					node->node_info.node_guid, port,
-					node->print_desc);
+					node_guid, port, mon_node->name);
 
 			if (pce_supported(mon_node, port)) {
 
@@ -727,17 +832,212 @@ static void perfmgr_query_counters(cl_map_item_t * p_map_item, void *context)
 						"port counter query for "
 						"node 0x%" PRIx64 " port "
 						"%d (%s)\n",
-						node->node_info.node_guid,
-						port,
-						node->print_desc);
+						node_guid, port,
+						mon_node->name);
 			}
 		}
 	}
+}
+
+/**********************************************************************
+ * Issue a PortCounters query with AllPortSelect to a switch.
+ * Called with the PerfMgr lock held.
+ **********************************************************************/
+static void perfmgr_query_all_ports(osm_perfmgr_t * pm,
+				    monitored_node_t * mon_node)
+{
+	ib_api_status_t status;
+	osm_madw_context_t mad_context;
+	ib_net16_t lid;
+
+	lid = get_lid(mon_node, 1);
+	if (lid == 0)
+		return;
+
+	mad_context.perfmgr_context.node_guid = mon_node->guid;
+	mad_context.perfmgr_context.port = PERFMGR_ALL_PORT_SELECT;
+	mad_context.perfmgr_context.mad_method = IB_MAD_METHOD_GET;
+#if ENABLE_OSM_PERF_MGR_PROFILE
+	gettimeofday(&mad_context.perfmgr_context.query_start, NULL);
+#endif
+	OSM_LOG(pm->log, OSM_LOG_VERBOSE, "Getting summed stats for node 0x%"
+		PRIx64 " (lid %u) (%s)\n", mon_node->guid, cl_ntoh16(lid),
+		mon_node->name);
+	status = perfmgr_send_pc_mad(pm, lid, get_qp(mon_node, 1),
+				     mon_node->port[1].pkey_ix,
+				     PERFMGR_ALL_PORT_SELECT,
+				     IB_MAD_METHOD_GET, &mad_context,
+				     0); /* FIXME SL != 0 */
+	if (status != IB_SUCCESS)
+		OSM_LOG(pm->log, OSM_LOG_ERROR, "ERR 4C1A: "
+			"Failed to issue AllPortSelect counter query for "
+			"node 0x%" PRIx64 " (%s)\n", mon_node->guid,
+			mon_node->name);
+}
+
+/**********************************************************************
+ * query the Port Counters of a node.
+ * Only the PerfMgr state is used, the subnet is not looked at.
+ * Called with the PerfMgr lock held.
+ **********************************************************************/
+static void perfmgr_query_node(osm_perfmgr_t * pm, monitored_node_t * mon_node)
+{
+	OSM_LOG_ENTER(pm->log);
+
+	/* make sure there is a database object ready to store this info */
+	if (perfmgr_db_create_entry(pm->db, mon_node->guid, mon_node->esp0,
+				    mon_node->num_ports, mon_node->name) !=
+	    PERFMGR_EVENT_DB_SUCCESS) {
+		OSM_LOG(pm->log, OSM_LOG_ERROR,
+			"ERR 4C08: DB create entry failed for 0x%"
+			PRIx64 " (%s) : %s\n", mon_node->guid, mon_node->name,
+			strerror(errno));
+		goto Exit;
+	}
+
+	/*
+	 * Switches which can sum their counters are read with a single
+	 * MAD; their ports are only queried when the summed error
+	 * counters change (see perfmgr_check_all_ports) and every
+	 * all_port_full_sweeps sweeps so the data counters stay current.
+	 */
+	if (mon_node->aps_ports_due) {
+		mon_node->aps_ports_due = FALSE;
+		OSM_LOG(pm->log, OSM_LOG_VERBOSE, "Summed error counters of "
+			"%s (0x%" PRIx64 ") changed; querying its ports\n",
+			mon_node->name, mon_node->guid);
+	} else if (all_port_select_supported(pm, mon_node)) {
+		boolean_t full = !mon_node->aps_valid ||
+		    ++mon_node->aps_sweeps >= pm->all_port_full_sweeps;
+
+		if (full)
+			mon_node->aps_sweeps = 0;
+		perfmgr_query_all_ports(pm, mon_node);
+		if (!full)
+			goto Exit;
+	}
+
+	/* issue the query for each port */
+	perfmgr_query_ports(pm, mon_node);
 Exit:
-	cl_plock_release(&pm->osm->lock);
 	OSM_LOG_EXIT(pm->log);
 }
 
+/**********************************************************************
+ * query the Port Counters of all the nodes in the subnet.
+ * The PerfMgr lock is only held while one node is queried, as in the
+ * poller, so dropping or reporting nodes does not wait for the sweep;
+ * the walk resumes from the GUID of the last node queried.
+ **********************************************************************/
+static void perfmgr_query_counters(osm_perfmgr_t * pm)
+{
+	cl_map_item_t *item;
+	uint64_t guid = 0;
+
+	for (;;) {
+		cl_plock_acquire(&pm->lock);
+		item = cl_qmap_get_next(&pm->monitored_map, guid);
+		if (item == cl_qmap_end(&pm->monitored_map)) {
+			cl_plock_release(&pm->lock);
+			break;
+		}
+		guid = cl_qmap_key(item);
+		perfmgr_query_node(pm, (monitored_node_t *) item);
+		cl_plock_release(&pm->lock);
+	}
+}
+
+/**********************************************************************
+ * Pacing: queue a node for the poller thread
+ **********************************************************************/
+static void perfmgr_queue_poll(osm_perfmgr_t * pm,
+			       monitored_node_t * mon_node)
+{
+	cl_spinlock_acquire(&pm->poll_lock);
+	if (!mon_node->poll_queued) {
+		cl_qlist_insert_tail(&pm->poll_list, &mon_node->poll_item);
+		mon_node->poll_queued = TRUE;
+	}
+	cl_spinlock_release(&pm->poll_lock);
+	cl_event_signal(&pm->sig_poll);
+}
+
+/**********************************************************************
+ * Pacing: the poll wheel event of a node aged, queue the node for the
+ * poller thread and return the time of its next poll.
+ **********************************************************************/
+static uint64_t perfmgr_poll_due(uint64_t key, uint32_t num_regs,
+				 void *context)
+{
+	monitored_node_t *mon_node = context;
+	osm_perfmgr_t *pm = mon_node->pm;
+	uint64_t period = pm->sweep_time_s * 1000000ULL;
+	uint64_t now = cl_get_time_stamp();
+
+	perfmgr_queue_poll(pm, mon_node);
+
+	/* keep the phase; polls missed while falling behind are skipped */
+	do
+		mon_node->next_poll += period;
+	while (mon_node->next_poll <= now);
+
+	return mon_node->next_poll;
+}
+
+/**********************************************************************
+ * Pacing: schedule the polls of a new node at a fixed offset in the
+ * sweep period derived from its GUID so the nodes spread evenly.
+ **********************************************************************/
+static void perfmgr_schedule_node(osm_perfmgr_t * pm,
+				  monitored_node_t * mon_node)
+{
+	uint64_t period = pm->sweep_time_s * 1000000ULL;
+	uint64_t hash = mon_node->guid * 0x9E3779B97F4A7C15ULL;
+
+	mon_node->pm = pm;
+	mon_node->next_poll = cl_get_time_stamp() + (hash >> 32) % period;
+	if (cl_event_wheel_reg(&pm->poll_wheel, mon_node->guid,
+			       mon_node->next_poll, perfmgr_poll_due,
+			       mon_node) != CL_SUCCESS)
+		OSM_LOG(pm->log, OSM_LOG_ERROR, "ERR 4C1B: "
+			"Failed to schedule polling of %s (0x%" PRIx64 ")\n",
+			mon_node->name, mon_node->guid);
+}
+
+/**********************************************************************
+ * Pacing: query the nodes whose poll time has come
+ **********************************************************************/
+static void perfmgr_poller(void *context)
+{
+	osm_perfmgr_t *pm = context;
+	monitored_node_t *mon_node;
+	cl_list_item_t *item;
+
+	while (!pm->poll_exit) {
+		cl_event_wait_on(&pm->sig_poll, EVENT_NO_TIMEOUT, TRUE);
+
+		while (!pm->poll_exit) {
+			/* the lock keeps the node from being dropped */
+			cl_plock_acquire(&pm->lock);
+			cl_spinlock_acquire(&pm->poll_lock);
+			item = cl_qlist_remove_head(&pm->poll_list);
+			if (item == cl_qlist_end(&pm->poll_list)) {
+				cl_spinlock_release(&pm->poll_lock);
+				cl_plock_release(&pm->lock);
+				break;
+			}
+			mon_node = PARENT_STRUCT(item, monitored_node_t,
+						 poll_item);
+			mon_node->poll_queued = FALSE;
+			cl_spinlock_release(&pm->poll_lock);
+
+			if (pm->state == PERFMGR_STATE_ENABLED)
+				perfmgr_query_node(pm, mon_node);
+			cl_plock_release(&pm->lock);
+		}
+	}
+}
+
 /**********************************************************************
  * Discovery stuff.
  * This code should not be here, but merged with main OpenSM
@@ -960,6 +1260,101 @@ _exit:
 	return ret;
 }
 
+/**********************************************************************
+ * Start monitoring the node of a port or refresh its cached LIDs
+ **********************************************************************/
+void osm_perfmgr_report_port(osm_perfmgr_t * pm, osm_port_t * p_port)
+{
+	osm_node_t *node = p_port->p_node;
+	monitored_node_t *mon_node;
+	cl_map_item_t *item;
+	uint64_t node_guid;
+
+	if (!node)
+		return;
+
+	if (osm_port_get_guid(p_port) == pm->port_guid)
+		update_local_port(pm, p_port);
+
+	if (pm->ignore_cas && node->node_info.node_type == IB_NODE_TYPE_CA)
+		return;
+
+	node_guid = cl_ntoh64(osm_node_get_node_guid(node));
+
+	/*
+	 * Nodes are only added and removed from the SM thread so the
+	 * item found here stays valid once the lock is dropped.
+	 */
+	cl_plock_acquire(&pm->lock);
+	item = cl_qmap_get(&pm->monitored_map, node_guid);
+	if (item != cl_qmap_end(&pm->monitored_map) &&
+	    !update_monitored_ports((monitored_node_t *) item, node, FALSE)) {
+		cl_plock_release(&pm->lock);
+		return;
+	}
+	cl_plock_release(&pm->lock);
+
+	if (item == cl_qmap_end(&pm->monitored_map)) {
+		mon_node = new_monitored_node(pm, node);
+		if (!mon_node)
+			return;
+		OSM_LOG(pm->log, OSM_LOG_VERBOSE, "Monitoring node %s "
+			"(GUID 0x%" PRIx64 ")\n", mon_node->name, node_guid);
+		cl_plock_excl_acquire(&pm->lock);
+		cl_qmap_insert(&pm->monitored_map, node_guid,
+			       (cl_map_item_t *) mon_node);
+		cl_plock_release(&pm->lock);
+		if (pm->pacing)
+			perfmgr_schedule_node(pm, mon_node);
+	} else {
+		cl_plock_excl_acquire(&pm->lock);
+		update_monitored_ports((monitored_node_t *) item, node, TRUE);
+		cl_plock_release(&pm->lock);
+	}
+}
+
+static void report_port(cl_map_item_t * p_map_item, void *context)
+{
+	osm_perfmgr_report_port(context, (osm_port_t *) p_map_item);
+}
+
+/**********************************************************************
+ * Stop monitoring a node removed from the subnet
+ **********************************************************************/
+void osm_perfmgr_drop_node(osm_perfmgr_t * pm, osm_node_t * p_node)
+{
+	uint64_t node_guid = cl_ntoh64(osm_node_get_node_guid(p_node));
+	monitored_node_t *mon_node;
+
+	/* no poll can be queued for the node once it is unregistered */
+	if (pm->pacing)
+		cl_event_wheel_unreg(&pm->poll_wheel, node_guid);
+
+	cl_plock_excl_acquire(&pm->lock);
+	mon_node = (monitored_node_t *) cl_qmap_remove(&pm->monitored_map,
+						       node_guid);
+	if (mon_node != (monitored_node_t *) cl_qmap_end(&pm->monitored_map)
+	    && pm->pacing) {
+		cl_spinlock_acquire(&pm->poll_lock);
+		if (mon_node->poll_queued)
+			cl_qlist_remove_item(&pm->poll_list,
+					     &mon_node->poll_item);
+		cl_spinlock_release(&pm->poll_lock);
+	}
+	cl_plock_release(&pm->lock);
+	if (mon_node == (monitored_node_t *) cl_qmap_end(&pm->monitored_map))
+		return;
+
+	OSM_LOG(pm->log, OSM_LOG_VERBOSE, "Node \"%s\" (guid 0x%" PRIx64
+		") no longer exists so removing from PerfMgr monitoring\n",
+		mon_node->name, mon_node->guid);
+
+	if (pm->rm_nodes)
+		perfmgr_db_delete_entry(pm->db, node_guid);
+
+	free_monitored_node(mon_node);
+}
+
 /**********************************************************************
  * Main PerfMgr processor - query the performance counters.
  **********************************************************************/
@@ -973,24 +1368,12 @@ void osm_perfmgr_process(osm_perfmgr_t * pm)
 		return;
 
 	if (pm->subn->sm_state == IB_SMINFO_STATE_STANDBY ||
-	    pm->subn->sm_state == IB_SMINFO_STATE_NOTACTIVE)
+	    pm->subn->sm_state == IB_SMINFO_STATE_NOTACTIVE) {
 		perfmgr_discovery(pm->subn->p_osm);
 
-	/* if redirection enabled, determine local port */
-	if (pm->subn->opt.perfmgr_redir && pm->local_port == -1) {
-		osm_node_t *p_node;
-		osm_port_t *p_port;
-
+		/* no master state manager reports the ports to us */
 		CL_PLOCK_ACQUIRE(pm->sm->p_lock);
-		p_port = osm_get_port_by_guid(pm->subn, pm->port_guid);
-		if (p_port) {
-			p_node = p_port->p_node;
-			CL_ASSERT(p_node);
-			pm->local_port =
-			    ib_node_info_get_local_port_num(&p_node->node_info);
-		} else
-			OSM_LOG(pm->log, OSM_LOG_ERROR,
-				"ERR 4C87: No PerfMgr port object\n");
+		cl_qmap_apply_func(&pm->subn->port_guid_tbl, report_port, pm);
 		CL_PLOCK_RELEASE(pm->sm->p_lock);
 	}
 
@@ -998,20 +1381,16 @@ void osm_perfmgr_process(osm_perfmgr_t * pm)
 	gettimeofday(&before, NULL);
 #endif
 	pm->sweep_state = PERFMGR_SWEEP_ACTIVE;
-	/* With the global lock held, collect the node guids */
-	/* FIXME we should be able to track SA notices
-	 * and not have to sweep the node_guid_tbl each pass
+	/*
+	 * The monitored nodes are kept up to date by the state manager
+	 * (osm_perfmgr_report_port) and the drop manager
+	 * (osm_perfmgr_drop_node) so the subnet is not looked at here.
 	 */
 	OSM_LOG(pm->log, OSM_LOG_VERBOSE, "Gathering PerfMgr stats\n");
-	cl_plock_acquire(&pm->osm->lock);
-	cl_qmap_apply_func(&pm->subn->node_guid_tbl, collect_guids, pm);
-	cl_plock_release(&pm->osm->lock);
-
-	/* then for each node query their counters */
-	cl_qmap_apply_func(&pm->monitored_map, perfmgr_query_counters, pm);
 
-	/* clean out any nodes found to be removed during the sweep */
-	remove_marked_nodes(pm);
+	/* for each node query their counters, unless paced by the poller */
+	if (!pm->pacing)
+		perfmgr_query_counters(pm);
 
 #if ENABLE_OSM_PERF_MGR_PROFILE
 	/* spin on outstanding queries */
@@ -1049,6 +1428,13 @@ void osm_perfmgr_shutdown(osm_perfmgr_t * pm)
 {
 	OSM_LOG_ENTER(pm->log);
 	cl_timer_stop(&pm->sweep_timer);
+	if (pm->pacing) {
+		cl_event_wheel_destroy(&pm->poll_wheel);
+		pm->poll_exit = TRUE;
+		cl_event_signal(&pm->sig_poll);
+		cl_event_signal(&pm->sig_query);
+		cl_thread_destroy(&pm->poll_thread);
+	}
 	cl_disp_unregister(pm->pc_disp_h);
 	perfmgr_mad_unbind(pm);
 	OSM_LOG_EXIT(pm->log);
@@ -1056,9 +1442,24 @@ void osm_perfmgr_shutdown(osm_perfmgr_t * pm)
 
 void osm_perfmgr_destroy(osm_perfmgr_t * pm)
 {
+	monitored_node_t *mon_node;
+
 	OSM_LOG_ENTER(pm->log);
 	perfmgr_db_destroy(pm->db);
 	cl_timer_destroy(&pm->sweep_timer);
+	while ((mon_node = (monitored_node_t *)
+		cl_qmap_head(&pm->monitored_map)) !=
+	       (monitored_node_t *) cl_qmap_end(&pm->monitored_map)) {
+		cl_qmap_remove_item(&pm->monitored_map,
+				    (cl_map_item_t *) mon_node);
+		free_monitored_node(mon_node);
+	}
+	free(pm->local_pkeys);
+	if (pm->pacing) {
+		cl_event_destroy(&pm->sig_poll);
+		cl_spinlock_destroy(&pm->poll_lock);
+	}
+	cl_plock_destroy(&pm->lock);
 	OSM_LOG_EXIT(pm->log);
 }
 
@@ -1165,7 +1566,6 @@ static void perfmgr_check_overflow(osm_perfmgr_t * pm,
 	     counter_overflow_32(pc->rcv_data) ||
 	     counter_overflow_32(pc->xmit_pkts) ||
 	     counter_overflow_32(pc->rcv_pkts)))) {
-		osm_node_t *p_node = NULL;
 		ib_net16_t lid = 0;
 
 		if (!mon_node->port[port].valid)
@@ -1176,11 +1576,7 @@ static void perfmgr_check_overflow(osm_perfmgr_t * pm,
 			") port %d; clearing counters\n",
 			mon_node->name, mon_node->guid, port);
 
-		cl_plock_acquire(&pm->osm->lock);
-		p_node =
-		    osm_get_node_by_guid(pm->subn, cl_hton64(mon_node->guid));
-		lid = get_lid(p_node, port, mon_node);
-		cl_plock_release(&pm->osm->lock);
+		lid = get_lid(mon_node, port);
 		if (lid == 0) {
 			OSM_LOG(pm->log, OSM_LOG_ERROR, "PerfMgr: ERR 4C0C: "
 				"Failed to clear counters for %s (0x%"
@@ -1239,7 +1635,6 @@ static void perfmgr_check_pce_overflow(osm_perfmgr_t * pm,
 	    counter_overflow_64(pc->unicast_rcv_pkts) ||
 	    counter_overflow_64(pc->multicast_xmit_pkts) ||
 	    counter_overflow_64(pc->multicast_rcv_pkts)))) {
-		osm_node_t *p_node = NULL;
 		ib_net16_t lid = 0;
 
 		if (!mon_node->port[port].valid)
@@ -1250,11 +1645,7 @@ static void perfmgr_check_pce_overflow(osm_perfmgr_t * pm,
 			PRIx64 ") port %d; clearing counters\n",
 			mon_node->name, mon_node->guid, port);
 
-		cl_plock_acquire(&pm->osm->lock);
-		p_node =
-		    osm_get_node_by_guid(pm->subn, cl_hton64(mon_node->guid));
-		lid = get_lid(p_node, port, mon_node);
-		cl_plock_release(&pm->osm->lock);
+		lid = get_lid(mon_node, port);
 		if (lid == 0) {
 			OSM_LOG(pm->log, OSM_LOG_ERROR, "PerfMgr: ERR 4C18: "
 				"Failed to clear counters for %s (0x%"
@@ -1330,58 +1721,35 @@ static void perfmgr_log_events(osm_perfmgr_t * pm,
 			time_diff, mon_node->name, mon_node->guid, port);
 }
 
+/**********************************************************************
+ * Return the index of a P_Key in the cached table of the PerfMgr port.
+ * Called with the PerfMgr lock held.
+ **********************************************************************/
 static int16_t validate_redir_pkey(osm_perfmgr_t *pm, ib_net16_t pkey)
 {
 	int16_t pkey_ix = -1;
-	osm_port_t *p_port;
-	osm_pkey_tbl_t *p_pkey_tbl;
-	ib_net16_t *p_orig_pkey;
-	uint16_t block;
-	uint8_t index;
+	uint16_t i;
 
 	OSM_LOG_ENTER(pm->log);
 
-	CL_PLOCK_ACQUIRE(pm->sm->p_lock);
-	p_port = osm_get_port_by_guid(pm->subn, pm->port_guid);
-	if (!p_port) {
-		CL_PLOCK_RELEASE(pm->sm->p_lock);
+	if (!pm->local_pkeys) {
 		OSM_LOG(pm->log, OSM_LOG_ERROR,
-			"ERR 4C1E: No PerfMgr port object\n");
+			"ERR 4C1E: No P_Key table for PerfMgr port\n");
 		goto Exit;
 	}
-	if (p_port->p_physp && osm_physp_is_valid(p_port->p_physp)) {
-		p_pkey_tbl = &p_port->p_physp->pkeys;
-		if (!p_pkey_tbl) {
-			CL_PLOCK_RELEASE(pm->sm->p_lock);
-			OSM_LOG(pm->log, OSM_LOG_VERBOSE,
-				"No PKey table found for PerfMgr port\n");
-			goto Exit;
-		}
-		p_orig_pkey = cl_map_get(&p_pkey_tbl->keys,
-					 ib_pkey_get_base(pkey));
-		if (!p_orig_pkey) {
-			CL_PLOCK_RELEASE(pm->sm->p_lock);
-			OSM_LOG(pm->log, OSM_LOG_VERBOSE,
-				"PKey 0x%x not found for PerfMgr port\n",
-				cl_ntoh16(pkey));
-			goto Exit;
-		}
-		if (osm_pkey_tbl_get_block_and_idx(p_pkey_tbl, p_orig_pkey,
-						   &block, &index) == IB_SUCCESS) {
-			CL_PLOCK_RELEASE(pm->sm->p_lock);
-			pkey_ix = block * IB_NUM_PKEY_ELEMENTS_IN_BLOCK + index;
-		} else {
-			CL_PLOCK_RELEASE(pm->sm->p_lock);
-			OSM_LOG(pm->log, OSM_LOG_ERROR,
-				"ERR 0x4C1F: Failed to obtain P_Key 0x%04x "
-				"block and index for PerfMgr port\n",
-				cl_ntoh16(pkey));
+
+	for (i = 0; i < pm->num_local_pkeys; i++)
+		if (pm->local_pkeys[i] &&
+		    ib_pkey_get_base(pm->local_pkeys[i]) ==
+		    ib_pkey_get_base(pkey)) {
+			pkey_ix = i;
+			break;
 		}
-	} else {
-		CL_PLOCK_RELEASE(pm->sm->p_lock);
-		OSM_LOG(pm->log, OSM_LOG_ERROR,
-			"ERR 4C20: Local PerfMgt port physp invalid\n");
-	}
+
+	if (pkey_ix == -1)
+		OSM_LOG(pm->log, OSM_LOG_VERBOSE,
+			"PKey 0x%x not found for PerfMgr port\n",
+			cl_ntoh16(pkey));
 
 Exit:
 	OSM_LOG_EXIT(pm->log);
@@ -1449,7 +1817,6 @@ static void handle_redirect(osm_perfmgr_t *pm,
 	}
 
 	/* LID redirection support (easier than GID redirection) */
-	cl_plock_acquire(&pm->osm->lock);
 	p_mon_node->port[port].redirection = TRUE;
 	p_mon_node->port[port].valid = valid;
 	memcpy(&p_mon_node->port[port].gid, &cpi->redir_gid,
@@ -1459,13 +1826,10 @@ static void handle_redirect(osm_perfmgr_t *pm,
 	p_mon_node->port[port].pkey = cpi->redir_pkey;
 	if (pkey_ix != -1)
 		p_mon_node->port[port].pkey_ix = pkey_ix;
-	cl_plock_release(&pm->osm->lock);
 
 	if (valid) {
 		/* Finally, issue a CPI query to the redirected location */
-		cl_plock_acquire(&pm->osm->lock);
 		p_mon_node->port[port].cpi_valid = FALSE;
-		cl_plock_release(&pm->osm->lock);
 		status = perfmgr_send_cpi_mad(pm, cpi->redir_lid,
 					      cpi->redir_qp, pkey_ix,
 					      port, mad_context,
@@ -1520,6 +1884,47 @@ static void perfmgr_check_data_cnt_oob_clear(osm_perfmgr_t * pm,
 	}
 }
 
+/**********************************************************************
+ * Compare the summed error counters of a switch read with AllPortSelect
+ * to the previous ones and mark its ports to be queried if any of them
+ * changed.  The queries are issued by the next sweep, as sending could
+ * block this dispatcher thread on the outstanding query limit; pacing
+ * never reads the summed counters (see osm_subn_verify_config).
+ * Called with the PerfMgr lock held.
+ **********************************************************************/
+static void perfmgr_check_all_ports(osm_perfmgr_t * pm,
+				    monitored_node_t * mon_node,
+				    ib_port_counters_t * pc)
+{
+	perfmgr_db_err_reading_t cr;
+	perfmgr_db_err_reading_t *prev = &mon_node->aps_err;
+	boolean_t changed;
+
+	perfmgr_db_fill_err_read(pc, &cr);
+
+	changed = !mon_node->aps_valid ||
+	    cr.symbol_err_cnt != prev->symbol_err_cnt ||
+	    cr.link_err_recover != prev->link_err_recover ||
+	    cr.link_downed != prev->link_downed ||
+	    cr.rcv_err != prev->rcv_err ||
+	    cr.rcv_rem_phys_err != prev->rcv_rem_phys_err ||
+	    cr.rcv_switch_relay_err != prev->rcv_switch_relay_err ||
+	    cr.xmit_discards != prev->xmit_discards ||
+	    cr.xmit_constraint_err != prev->xmit_constraint_err ||
+	    cr.rcv_constraint_err != prev->rcv_constraint_err ||
+	    cr.link_integrity != prev->link_integrity ||
+	    cr.buffer_overrun != prev->buffer_overrun ||
+	    cr.vl15_dropped != prev->vl15_dropped;
+	*prev = cr;
+	mon_node->aps_valid = TRUE;
+
+	/* the ports were queried along with this read on a full sweep */
+	if (!changed || mon_node->aps_sweeps == 0)
+		return;
+
+	mon_node->aps_ports_due = TRUE;
+}
+
 /**********************************************************************
  * The dispatcher uses a thread pool which will call this function when
  * there is a thread available to process the mad received on the wire.
@@ -1542,10 +1947,13 @@ static void pc_recv_process(void *context, void *data)
 
 	/*
 	 * get the monitored node struct to have the printable name
-	 * for log messages
+	 * for log messages; the lock keeps it from being dropped
+	 * while the MAD is processed
 	 */
+	cl_plock_acquire(&pm->lock);
 	if ((p_node = cl_qmap_get(&pm->monitored_map, node_guid)) ==
 	    cl_qmap_end(&pm->monitored_map)) {
+		cl_plock_release(&pm->lock);
 		OSM_LOG(pm->log, OSM_LOG_ERROR, "ERR 4C12: GUID 0x%016"
 			PRIx64 " not found in monitored map\n", node_guid);
 		goto Exit;
@@ -1565,15 +1973,13 @@ static void pc_recv_process(void *context, void *data)
 		cpi = (ib_class_port_info_t *) &
 		    (osm_madw_get_perfmgt_mad_ptr(p_madw)->data);
 
-		cl_plock_acquire(&pm->osm->lock);
 		/* validate port number */
 		if (port >= p_mon_node->num_ports) {
-			cl_plock_release(&pm->osm->lock);
 			OSM_LOG(pm->log, OSM_LOG_ERROR, "ERR 4C13: "
 				"Invalid port num %d for GUID 0x%016"
 				PRIx64 " num ports %d\n", port, node_guid,
 				p_mon_node->num_ports);
-			goto Exit;
+			goto Release;
 		}
 		if (p_mon_node->node_type == IB_NODE_TYPE_SWITCH) {
 			int i = 0;
@@ -1587,14 +1993,13 @@ static void pc_recv_process(void *context, void *data)
 			p_mon_node->port[port].cap_mask = cpi->cap_mask;
 			p_mon_node->port[port].cpi_valid = TRUE;
 		}
-		cl_plock_release(&pm->osm->lock);
 
 		/* Response could also be redirection (IBM eHCA PMA does this) */
 		if (p_mad->status & IB_MAD_STATUS_REDIRECT)
 			handle_redirect(pm, cpi, p_mon_node, port,
 					mad_context);
 
-		goto Exit;
+		goto Release;
 	}
 
 	if (p_mad->attr_id == IB_MAD_ATTR_PORT_CNTRS_EXT) {
@@ -1628,6 +2033,9 @@ static void pc_recv_process(void *context, void *data)
 		perfmgr_check_pce_overflow(pm, p_mon_node,
 					   p_mon_node->port[port].pkey_ix,
 					   port, ext_wire_read);
+	} else if (port == PERFMGR_ALL_PORT_SELECT) {
+		perfmgr_check_all_ports(pm, p_mon_node, (ib_port_counters_t *)
+					&osm_madw_get_perfmgt_mad_ptr(p_madw)->data);
 	} else {
 		boolean_t pce_sup = pce_supported(p_mon_node, port);
 		ib_port_counters_t *wire_read =
@@ -1666,6 +2074,9 @@ static void pc_recv_process(void *context, void *data)
 
 	}
 
+Release:
+	cl_plock_release(&pm->lock);
+
 #if ENABLE_OSM_PERF_MGR_PROFILE
 	do {
 		struct timeval proc_time;
@@ -1696,6 +2107,8 @@ ib_api_status_t osm_perfmgr_init(osm_perfmgr_t * pm, osm_opensm_t * osm,
 
 	memset(pm, 0, sizeof(*pm));
 
+	init_monitored_nodes(pm);
+
 	cl_event_construct(&pm->sig_sweep);
 	cl_event_init(&pm->sig_sweep, FALSE);
 	pm->subn = &osm->subn;
@@ -1709,6 +2122,8 @@ ib_api_status_t osm_perfmgr_init(osm_perfmgr_t * pm, osm_opensm_t * osm,
 	pm->sweep_time_s = p_opt->perfmgr_sweep_time_s;
 	pm->max_outstanding_queries = p_opt->perfmgr_max_outstanding_queries;
 	pm->ignore_cas = p_opt->perfmgr_ignore_cas;
+	pm->all_port_select = p_opt->perfmgr_all_port_select;
+	pm->all_port_full_sweeps = p_opt->perfmgr_all_port_full_sweeps;
 	pm->osm = osm;
 	pm->local_port = -1;
 
@@ -1723,6 +2138,19 @@ ib_api_status_t osm_perfmgr_init(osm_perfmgr_t * pm, osm_opensm_t * osm,
 		goto Exit;
 	}
 
+	/* the history is optional, PerfMgr runs without it on failure */
+	if (p_opt->perfmgr_history_file) {
+		uint32_t depth = (p_opt->perfmgr_history_retention_s +
+				  pm->sweep_time_s - 1) / pm->sweep_time_s;
+		if (depth < 2)
+			depth = 2;
+		else if (depth > PERFMGR_HIST_MAX_DEPTH)
+			depth = PERFMGR_HIST_MAX_DEPTH;
+		perfmgr_hist_init(&pm->db->hist, pm->log,
+				  p_opt->perfmgr_history_file,
+				  p_opt->perfmgr_history_ports, depth);
+	}
+
 	pm->pc_disp_h = cl_disp_register(&osm->disp, OSM_MSG_MAD_PORT_COUNTERS,
 					 pc_recv_process, pm);
 	if (pm->pc_disp_h == CL_DISP_INVALID_HANDLE) {
@@ -1730,7 +2158,24 @@ ib_api_status_t osm_perfmgr_init(osm_perfmgr_t * pm, osm_opensm_t * osm,
 		goto Exit;
 	}
 
-	init_monitored_nodes(pm);
+	if (p_opt->perfmgr_pacing) {
+		pm->pacing = TRUE;
+		pm->window = pm->max_outstanding_queries;
+		cl_spinlock_construct(&pm->poll_lock);
+		cl_spinlock_init(&pm->poll_lock);
+		cl_qlist_init(&pm->poll_list);
+		cl_event_construct(&pm->sig_poll);
+		cl_event_init(&pm->sig_poll, FALSE);
+		cl_event_wheel_construct(&pm->poll_wheel);
+		cl_thread_construct(&pm->poll_thread);
+		if (cl_event_wheel_init(&pm->poll_wheel) != CL_SUCCESS ||
+		    cl_thread_init(&pm->poll_thread, perfmgr_poller, pm,
+				   "opensm perfmgr") != CL_SUCCESS) {
+			OSM_LOG(pm->log, OSM_LOG_ERROR, "ERR 4C1C: "
+				"Failed to start paced polling\n");
+			goto Exit;
+		}
+	}
 
 	if (pm->state == PERFMGR_STATE_ENABLED)
 		cl_timer_start(&pm->sweep_timer, pm->sweep_time_s * 1000);
@@ -1792,4 +2237,23 @@ void osm_perfmgr_print_counters(osm_perfmgr_t * pm, char *nodename, FILE * fp,
 	} else
 		perfmgr_db_print_all(pm->db, fp, err_only);
 }
+
+/*******************************************************************
+ * Print the rates of a node from the history file to the fp specified
+ * The history is read without the DB lock
+ *******************************************************************/
+void osm_perfmgr_print_history(osm_perfmgr_t * pm, char *nodename, FILE * fp,
+			       char *port, time_t since, int summary)
+{
+	if (!pm->db || !perfmgr_hist_is_active(&pm->db->hist)) {
+		fprintf(fp, "PerfMgr history is disabled "
+			"(see perfmgr_history_file)\n");
+		return;
+	}
+	if (nodename)
+		perfmgr_hist_print(pm->db->hist.p_hdr, fp, nodename, port,
+				   since, summary);
+	else
+		perfmgr_hist_list(pm->db->hist.p_hdr, fp);
+}
 #endif				/* ENABLE_OSM_PERF_MGR */
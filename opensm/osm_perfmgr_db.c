@@ -40,6 +40,8 @@
 #ifdef ENABLE_OSM_PERF_MGR
 
 #include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 #include <errno.h>
 #include <limits.h>
 #include <dlfcn.h>
@@ -49,20 +51,101 @@
 #include <opensm/osm_perfmgr.h>
 #include <opensm/osm_opensm.h>
 
-static void free_node(db_node_t * node);
+/** =========================================================================
+ * Counter fields of the readings and of the events, in counter index order
+ */
+#define ERR_CNTR_OFFSETS(type) {			\
+	offsetof(type, symbol_err_cnt),			\
+	offsetof(type, link_err_recover),		\
+	offsetof(type, link_downed),			\
+	offsetof(type, rcv_err),			\
+	offsetof(type, rcv_rem_phys_err),		\
+	offsetof(type, rcv_switch_relay_err),		\
+	offsetof(type, xmit_discards),			\
+	offsetof(type, xmit_constraint_err),		\
+	offsetof(type, rcv_constraint_err),		\
+	offsetof(type, link_integrity),			\
+	offsetof(type, buffer_overrun),			\
+	offsetof(type, vl15_dropped) }
+
+#define DC_CNTR_OFFSETS(type) {				\
+	offsetof(type, xmit_data),			\
+	offsetof(type, rcv_data),			\
+	offsetof(type, xmit_pkts),			\
+	offsetof(type, rcv_pkts),			\
+	offsetof(type, unicast_xmit_pkts),		\
+	offsetof(type, unicast_rcv_pkts),		\
+	offsetof(type, multicast_xmit_pkts),		\
+	offsetof(type, multicast_rcv_pkts) }
+
+static const size_t err_reading_offset[PERFMGR_DB_NUM_ERR_CNTRS] =
+    ERR_CNTR_OFFSETS(perfmgr_db_err_reading_t);
+static const size_t err_event_offset[PERFMGR_DB_NUM_ERR_CNTRS] =
+    ERR_CNTR_OFFSETS(osm_epi_pe_event_t);
+static const size_t dc_reading_offset[PERFMGR_DB_NUM_DC_CNTRS] =
+    DC_CNTR_OFFSETS(perfmgr_db_data_cnt_reading_t);
+static const size_t dc_event_offset[PERFMGR_DB_NUM_DC_CNTRS] =
+    DC_CNTR_OFFSETS(osm_epi_dc_event_t);
+
+#define CNTR(p_struct, offset) (*(uint64_t *)((char *)(p_struct) + (offset)))
+
+/* names used by the debug dumps */
+static const char *err_short_name[PERFMGR_DB_NUM_ERR_CNTRS] = {
+	"sym", "ler", "ld", "re", "rrp", "rsr",
+	"xd", "xce", "rce", "li", "bo", "vld"
+};
+
+static const char *dc_short_name[PERFMGR_DB_RCV_PKTS + 1] = {
+	"xd", "rd", "xp", "rp"
+};
+
+/* names used by the human readable dumps */
+static const char *err_name[PERFMGR_DB_NUM_ERR_CNTRS] = {
+	"symbol_err_cnt",
+	"link_err_recover",
+	"link_downed",
+	"rcv_err",
+	"rcv_rem_phys_err",
+	"rcv_switch_relay_err",
+	"xmit_discards",
+	"xmit_constraint_err",
+	"rcv_constraint_err",
+	"link_integrity_err",
+	"buf_overrun_err",
+	"vl15_dropped"
+};
+
+static const char *dc_name[PERFMGR_DB_NUM_DC_CNTRS] = {
+	"xmit_data",
+	"rcv_data",
+	"xmit_pkts",
+	"rcv_pkts",
+	"unicast_xmit_pkts",
+	"unicast_rcv_pkts",
+	"multicast_xmit_pkts",
+	"multicast_rcv_pkts"
+};
+
+/* marks the index entries of removed nodes */
+static db_node_t deleted_node;
+
+#define DB_MIN_INDEX_SIZE	64
+#define DB_MIN_PORTS_SIZE	256
 
 /** =========================================================================
  */
 perfmgr_db_t *perfmgr_db_construct(osm_perfmgr_t *perfmgr)
 {
-	perfmgr_db_t *db = malloc(sizeof(*db));
+	perfmgr_db_t *db = calloc(1, sizeof(*db));
 	if (!db)
 		return NULL;
 
-	cl_qmap_init(&db->pc_data);
+	cl_qlist_init(&db->node_list);
+	memset(db->ports.free_head, 0xff, sizeof(db->ports.free_head));
 	cl_plock_construct(&db->lock);
 	cl_plock_init(&db->lock);
 	db->perfmgr = perfmgr;
+	perfmgr_hist_construct(&db->hist);
 	return db;
 }
 
@@ -70,31 +153,132 @@ perfmgr_db_t *perfmgr_db_construct(osm_perfmgr_t *perfmgr)
  */
 void perfmgr_db_destroy(perfmgr_db_t * db)
 {
-	cl_map_item_t *item, *next_item;
+	perfmgr_db_ports_t *ports;
+	db_node_t *node;
+	int c;
 
 	if (db) {
-		item = cl_qmap_head(&db->pc_data);
-		while (item != cl_qmap_end(&db->pc_data)) {
-			next_item = cl_qmap_next(item);
-			free_node((db_node_t *)item);
-			item = next_item;
+		while ((node = (db_node_t *)
+			cl_qlist_remove_head(&db->node_list)) !=
+		       (db_node_t *) cl_qlist_end(&db->node_list)) {
+			cl_spinlock_destroy(&node->lock);
+			free(node);
+		}
+		free(db->index);
+
+		ports = &db->ports;
+		for (c = 0; c < PERFMGR_DB_NUM_ERR_CNTRS; c++) {
+			free(ports->err_total[c]);
+			free(ports->err_previous[c]);
+		}
+		for (c = 0; c < PERFMGR_DB_NUM_DC_CNTRS; c++) {
+			free(ports->dc_total[c]);
+			free(ports->dc_previous[c]);
 		}
+		free(ports->err_previous_time);
+		free(ports->dc_previous_time);
+		free(ports->last_reset);
+		free(ports->hist_slot);
+		free(ports->hist_flags);
+		free(ports->hist_sample);
+		free(ports->next_free);
+
+		perfmgr_hist_destroy(&db->hist);
 		cl_plock_destroy(&db->lock);
 		free(db);
 	}
 }
 
 /**********************************************************************
- * Internal call db->lock should be held when calling
+ * GUID index; open addressing with linear probing.  It is kept at most
+ * half full, counting removed entries, so lookups stay short and
+ * always reach an empty entry.
+ * Internal calls db->lock should be held when calling
  **********************************************************************/
+static inline uint32_t guid_hash(uint64_t guid, uint32_t size)
+{
+	return (uint32_t) ((guid * 0x9E3779B97F4A7C15ULL) >> 32) & (size - 1);
+}
+
 static inline db_node_t *get(perfmgr_db_t * db, uint64_t guid)
 {
-	cl_map_item_t *rc = cl_qmap_get(&db->pc_data, guid);
-	const cl_map_item_t *end = cl_qmap_end(&db->pc_data);
+	db_node_t *node;
+	uint32_t mask = db->index_size - 1;
+	uint32_t i;
 
-	if (rc == end)
+	if (!db->index_size)
 		return NULL;
-	return (db_node_t *) rc;
+
+	for (i = guid_hash(guid, db->index_size); (node = db->index[i]);
+	     i = (i + 1) & mask)
+		if (node != &deleted_node && node->node_guid == guid)
+			return node;
+	return NULL;
+}
+
+/* db->lock must be held exclusively */
+static perfmgr_db_err_t resize_index(perfmgr_db_t * db)
+{
+	db_node_t **index, *node;
+	uint32_t size = DB_MIN_INDEX_SIZE;
+	uint32_t i, j;
+
+	/* leave room to grow before the next resize */
+	while (size < 4 * (db->num_nodes + 1))
+		size *= 2;
+
+	index = calloc(size, sizeof(*index));
+	if (!index)
+		return PERFMGR_EVENT_DB_NOMEM;
+
+	for (i = 0; i < db->index_size; i++) {
+		node = db->index[i];
+		if (!node || node == &deleted_node)
+			continue;
+		for (j = guid_hash(node->node_guid, size); index[j];
+		     j = (j + 1) & (size - 1)) ;
+		index[j] = node;
+	}
+
+	free(db->index);
+	db->index = index;
+	db->index_size = size;
+	db->index_used = db->num_nodes;
+	return PERFMGR_EVENT_DB_SUCCESS;
+}
+
+/* insert nodes to the database; db->lock must be held exclusively */
+static perfmgr_db_err_t insert(perfmgr_db_t * db, db_node_t * node)
+{
+	perfmgr_db_err_t rc;
+	uint32_t i;
+
+	if (get(db, node->node_guid))
+		return PERFMGR_EVENT_DB_FAIL;
+
+	if (2 * (db->index_used + 1) > db->index_size &&
+	    (rc = resize_index(db)) != PERFMGR_EVENT_DB_SUCCESS)
+		return rc;
+
+	for (i = guid_hash(node->node_guid, db->index_size);
+	     db->index[i] && db->index[i] != &deleted_node;
+	     i = (i + 1) & (db->index_size - 1)) ;
+	if (!db->index[i])
+		db->index_used++;
+	db->index[i] = node;
+	db->num_nodes++;
+	return PERFMGR_EVENT_DB_SUCCESS;
+}
+
+/* db->lock must be held exclusively */
+static void remove_node(perfmgr_db_t * db, db_node_t * node)
+{
+	uint32_t i;
+
+	for (i = guid_hash(node->node_guid, db->index_size);
+	     db->index[i] != node; i = (i + 1) & (db->index_size - 1)) ;
+	db->index[i] = &deleted_node;
+	db->num_nodes--;
 }
 
 static inline perfmgr_db_err_t bad_node_port(db_node_t * node, uint8_t port)
@@ -106,34 +290,126 @@ static inline perfmgr_db_err_t bad_node_port(db_node_t * node, uint8_t port)
 	return PERFMGR_EVENT_DB_SUCCESS;
 }
 
+/**********************************************************************
+ * Port ranges in the counter arrays
+ * db->lock must be held exclusively
+ **********************************************************************/
+#define GROW_ARRAY(array, size)						\
+	do {								\
+		void *p_new = realloc(array, (size) * sizeof(*(array)));\
+		if (!p_new)						\
+			return PERFMGR_EVENT_DB_NOMEM;			\
+		array = p_new;						\
+	} while (0)
+
+static perfmgr_db_err_t grow_ports(perfmgr_db_ports_t * ports, uint32_t need)
+{
+	uint32_t size = ports->size ? ports->size : DB_MIN_PORTS_SIZE;
+	int c;
+
+	while (size < need)
+		size *= 2;
+
+	/* arrays already grown stay valid if a later one fails */
+	for (c = 0; c < PERFMGR_DB_NUM_ERR_CNTRS; c++) {
+		GROW_ARRAY(ports->err_total[c], size);
+		GROW_ARRAY(ports->err_previous[c], size);
+	}
+	for (c = 0; c < PERFMGR_DB_NUM_DC_CNTRS; c++) {
+		GROW_ARRAY(ports->dc_total[c], size);
+		GROW_ARRAY(ports->dc_previous[c], size);
+	}
+	GROW_ARRAY(ports->err_previous_time, size);
+	GROW_ARRAY(ports->dc_previous_time, size);
+	GROW_ARRAY(ports->last_reset, size);
+	GROW_ARRAY(ports->hist_slot, size);
+	GROW_ARRAY(ports->hist_flags, size);
+	GROW_ARRAY(ports->hist_sample, size);
+	GROW_ARRAY(ports->next_free, size);
+
+	ports->size = size;
+	return PERFMGR_EVENT_DB_SUCCESS;
+}
+
+static uint32_t alloc_ports(perfmgr_db_ports_t * ports, uint8_t num_ports)
+{
+	uint32_t first, i;
+	time_t cur_time;
+	int c;
+
+	if (!num_ports)
+		return PERFMGR_DB_NO_PORT;
+
+	first = ports->free_head[num_ports];
+	if (first != PERFMGR_DB_NO_PORT)
+		ports->free_head[num_ports] = ports->next_free[first];
+	else {
+		if (ports->used + num_ports > ports->size &&
+		    grow_ports(ports, ports->used + num_ports))
+			return PERFMGR_DB_NO_PORT;
+		first = ports->used;
+		ports->used += num_ports;
+	}
+
+	for (c = 0; c < PERFMGR_DB_NUM_ERR_CNTRS; c++) {
+		memset(&ports->err_total[c][first], 0,
+		       num_ports * sizeof(uint64_t));
+		memset(&ports->err_previous[c][first], 0,
+		       num_ports * sizeof(uint64_t));
+	}
+	for (c = 0; c < PERFMGR_DB_NUM_DC_CNTRS; c++) {
+		memset(&ports->dc_total[c][first], 0,
+		       num_ports * sizeof(uint64_t));
+		memset(&ports->dc_previous[c][first], 0,
+		       num_ports * sizeof(uint64_t));
+	}
+	memset(&ports->hist_flags[first], 0, num_ports);
+	memset(&ports->hist_sample[first], 0,
+	       num_ports * sizeof(perfmgr_hist_sample_t));
+
+	cur_time = time(NULL);
+	for (i = first; i < first + num_ports; i++) {
+		ports->err_previous_time[i] = cur_time;
+		ports->dc_previous_time[i] = cur_time;
+		ports->last_reset[i] = cur_time;
+		ports->hist_slot[i] = -1;
+	}
+	return first;
+}
+
+static void free_ports(perfmgr_db_ports_t * ports, uint32_t first,
+		       uint8_t num_ports)
+{
+	if (first == PERFMGR_DB_NO_PORT)
+		return;
+	ports->next_free[first] = ports->free_head[num_ports];
+	ports->free_head[num_ports] = first;
+}
+
 /** =========================================================================
  */
-static db_node_t *malloc_node(uint64_t guid, boolean_t esp0,
-			      uint8_t num_ports, char *name)
+static db_node_t *malloc_node(perfmgr_db_t * db, uint64_t guid,
+			      boolean_t esp0, uint8_t num_ports, char *name)
 {
-	int i = 0;
-	time_t cur_time = 0;
 	db_node_t *rc = malloc(sizeof(*rc));
 	if (!rc)
 		return NULL;
 
-	rc->ports = calloc(num_ports, sizeof(db_port_t));
-	if (!rc->ports)
+	rc->first_port = alloc_ports(&db->ports, num_ports);
+	if (num_ports && rc->first_port == PERFMGR_DB_NO_PORT)
 		goto free_rc;
+	cl_spinlock_construct(&rc->lock);
+	if (cl_spinlock_init(&rc->lock) != CL_SUCCESS)
+		goto free_ports;
 	rc->num_ports = num_ports;
 	rc->node_guid = guid;
 	rc->esp0 = esp0;
-
-	cur_time = time(NULL);
-	for (i = 0; i < num_ports; i++) {
-		rc->ports[i].last_reset = cur_time;
-		rc->ports[i].err_previous.time = cur_time;
-		rc->ports[i].dc_previous.time = cur_time;
-	}
 	snprintf(rc->node_name, sizeof(rc->node_name), "%s", name);
 
 	return rc;
 
+free_ports:
+	free_ports(&db->ports, rc->first_port, num_ports);
 free_rc:
 	free(rc);
 	return NULL;
@@ -141,26 +417,15 @@ free_rc:
 
 /** =========================================================================
  */
-static void free_node(db_node_t * node)
+static void free_node(perfmgr_db_t * db, db_node_t * node)
 {
 	if (!node)
 		return;
-	if (node->ports)
-		free(node->ports);
+	free_ports(&db->ports, node->first_port, node->num_ports);
+	cl_spinlock_destroy(&node->lock);
 	free(node);
 }
 
-/* insert nodes to the database */
-static perfmgr_db_err_t insert(perfmgr_db_t * db, db_node_t * node)
-{
-	cl_map_item_t *rc = cl_qmap_insert(&db->pc_data, node->node_guid,
-					   (cl_map_item_t *) node);
-
-	if ((void *)rc != (void *)node)
-		return PERFMGR_EVENT_DB_FAIL;
-	return PERFMGR_EVENT_DB_SUCCESS;
-}
-
 perfmgr_db_err_t
 perfmgr_db_create_entry(perfmgr_db_t * db, uint64_t guid, boolean_t esp0,
 			uint8_t num_ports, char *name)
@@ -169,17 +434,24 @@ perfmgr_db_create_entry(perfmgr_db_t * db, uint64_t guid, boolean_t esp0,
 
 	cl_plock_excl_acquire(&db->lock);
 	if (!get(db, guid)) {
-		db_node_t *pc_node = malloc_node(guid, esp0, num_ports,
+		db_node_t *pc_node = malloc_node(db, guid, esp0, num_ports,
 						 name);
 		if (!pc_node) {
 			rc = PERFMGR_EVENT_DB_NOMEM;
 			goto Exit;
 		}
-		if (insert(db, pc_node)) {
-			free_node(pc_node);
-			rc = PERFMGR_EVENT_DB_FAIL;
+		if ((rc = insert(db, pc_node)) != PERFMGR_EVENT_DB_SUCCESS) {
+			free_node(db, pc_node);
 			goto Exit;
 		}
+		cl_qlist_insert_tail(&db->node_list, &pc_node->list_item);
+		if (perfmgr_hist_is_active(&db->hist)) {
+			int i;
+			for (i = esp0 ? 0 : 1; i < num_ports; i++)
+				db->ports.hist_slot[pc_node->first_port + i] =
+				    perfmgr_hist_get_slot(&db->hist, guid, i,
+							  name);
+		}
 	}
 Exit:
 	cl_plock_release(&db->lock);
@@ -189,14 +461,21 @@ Exit:
 perfmgr_db_err_t
 perfmgr_db_delete_entry(perfmgr_db_t * db, uint64_t guid)
 {
-	cl_map_item_t * rc = cl_qmap_remove(&db->pc_data, guid);
-
-	if (rc == cl_qmap_end(&db->pc_data))
-		return(PERFMGR_EVENT_DB_GUIDNOTFOUND);
+	perfmgr_db_err_t rc = PERFMGR_EVENT_DB_SUCCESS;
+	db_node_t *pc_node;
 
-	db_node_t *pc_node = (db_node_t *)rc;
-	free_node(pc_node);
-	return(PERFMGR_EVENT_DB_SUCCESS);
+	cl_plock_excl_acquire(&db->lock);
+	pc_node = get(db, guid);
+	if (!pc_node) {
+		rc = PERFMGR_EVENT_DB_GUIDNOTFOUND;
+		goto Exit;
+	}
+	remove_node(db, pc_node);
+	cl_qlist_remove_item(&db->node_list, &pc_node->list_item);
+	free_node(db, pc_node);
+Exit:
+	cl_plock_release(&db->lock);
+	return rc;
 }
 
 /**********************************************************************
@@ -204,139 +483,155 @@ perfmgr_db_delete_entry(perfmgr_db_t * db, uint64_t guid)
  **********************************************************************/
 static inline void
 debug_dump_err_reading(perfmgr_db_t * db, uint64_t guid, uint8_t port_num,
-		       db_port_t * port, perfmgr_db_err_reading_t * cur)
+		       uint32_t p, perfmgr_db_err_reading_t * cur)
 {
 	osm_log_t *log = db->perfmgr->log;
+	int c;
 
 	if (!osm_log_is_active(log, OSM_LOG_DEBUG))
 		return;		/* optimize this a bit */
 
 	osm_log(log, OSM_LOG_DEBUG,
 		"GUID 0x%" PRIx64 " Port %u:\n", guid, port_num);
-	osm_log(log, OSM_LOG_DEBUG,
-		"sym %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n",
-		cur->symbol_err_cnt, port->err_previous.symbol_err_cnt,
-		port->err_total.symbol_err_cnt);
-	osm_log(log, OSM_LOG_DEBUG,
-		"ler %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n",
-		cur->link_err_recover, port->err_previous.link_err_recover,
-		port->err_total.link_err_recover);
-	osm_log(log, OSM_LOG_DEBUG,
-		"ld %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n",
-		cur->link_downed, port->err_previous.link_downed,
-		port->err_total.link_downed);
-	osm_log(log, OSM_LOG_DEBUG,
-		"re %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n", cur->rcv_err,
-		port->err_previous.rcv_err, port->err_total.rcv_err);
-	osm_log(log, OSM_LOG_DEBUG,
-		"rrp %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n",
-		cur->rcv_rem_phys_err, port->err_previous.rcv_rem_phys_err,
-		port->err_total.rcv_rem_phys_err);
-	osm_log(log, OSM_LOG_DEBUG,
-		"rsr %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n",
-		cur->rcv_switch_relay_err,
-		port->err_previous.rcv_switch_relay_err,
-		port->err_total.rcv_switch_relay_err);
-	osm_log(log, OSM_LOG_DEBUG,
-		"xd %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n",
-		cur->xmit_discards, port->err_previous.xmit_discards,
-		port->err_total.xmit_discards);
-	osm_log(log, OSM_LOG_DEBUG,
-		"xce %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n",
-		cur->xmit_constraint_err,
-		port->err_previous.xmit_constraint_err,
-		port->err_total.xmit_constraint_err);
-	osm_log(log, OSM_LOG_DEBUG,
-		"rce %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n",
-		cur->rcv_constraint_err, port->err_previous.rcv_constraint_err,
-		port->err_total.rcv_constraint_err);
-	osm_log(log, OSM_LOG_DEBUG,
-		"li %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n",
-		cur->link_integrity, port->err_previous.link_integrity,
-		port->err_total.link_integrity);
-	osm_log(log, OSM_LOG_DEBUG,
-		"bo %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n",
-		cur->buffer_overrun, port->err_previous.buffer_overrun,
-		port->err_total.buffer_overrun);
-	osm_log(log, OSM_LOG_DEBUG,
-		"vld %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n",
-		cur->vl15_dropped, port->err_previous.vl15_dropped,
-		port->err_total.vl15_dropped);
+	for (c = 0; c < PERFMGR_DB_NUM_ERR_CNTRS; c++)
+		osm_log(log, OSM_LOG_DEBUG,
+			"%s %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n",
+			err_short_name[c], CNTR(cur, err_reading_offset[c]),
+			db->ports.err_previous[c][p],
+			db->ports.err_total[c][p]);
+}
+
+static inline uint32_t hist_sat32(uint64_t val)
+{
+	return val > UINT32_MAX ? UINT32_MAX : (uint32_t) val;
+}
+
+/**********************************************************************
+ * History samples are assembled from the error reading and the data
+ * reading of a port, which come from different MADs on ports
+ * supporting PortCountersExtended, and written once both are in.
+ * The node lock must be held
+ **********************************************************************/
+#define HIST_ERR_SEEN	0x01	/* first error reading received */
+#define HIST_DC_SEEN	0x02	/* first data reading received */
+#define HIST_HAVE_ERR	0x04	/* sample holds an error reading */
+#define HIST_HAVE_DC	0x08	/* sample holds a data reading */
+
+static void flush_hist_sample(perfmgr_db_t * db, db_node_t * node,
+			      uint8_t port, uint32_t p)
+{
+	perfmgr_db_ports_t *ports = &db->ports;
+
+	/* stop recording once the slot went to another port */
+	if (!perfmgr_hist_add(&db->hist, ports->hist_slot[p], node->node_guid,
+			      port, &ports->hist_sample[p]))
+		ports->hist_slot[p] = -1;
+	memset(&ports->hist_sample[p], 0, sizeof(ports->hist_sample[p]));
+	ports->hist_flags[p] &= ~(HIST_HAVE_ERR | HIST_HAVE_DC);
+}
+
+static void add_hist_err(perfmgr_db_t * db, db_node_t * node, uint8_t port,
+			 uint32_t p, perfmgr_db_err_reading_t * reading,
+			 osm_epi_pe_event_t * delta)
+{
+	perfmgr_db_ports_t *ports = &db->ports;
+	perfmgr_hist_sample_t *sample = &ports->hist_sample[p];
+	int c;
+
+	/* the data reading of the previous sample never came */
+	if (ports->hist_flags[p] & HIST_HAVE_ERR) {
+		flush_hist_sample(db, node, port, p);
+		if (ports->hist_slot[p] < 0)
+			return;
+	}
+
+	sample->time = (uint32_t) reading->time;
+	/* the first reading holds the counts from before monitoring */
+	if (!(ports->hist_flags[p] & HIST_ERR_SEEN))
+		sample->interval = 0;
+	else if (delta->time_diff_s > 0)
+		sample->interval = (uint32_t) delta->time_diff_s;
+	else
+		sample->interval = 1;
+
+	/* the history columns follow the counter order */
+	for (c = 0; c < PERFMGR_DB_NUM_ERR_CNTRS; c++)
+		sample->err[c] = hist_sat32(CNTR(delta, err_event_offset[c]));
+
+	ports->hist_flags[p] |= HIST_ERR_SEEN | HIST_HAVE_ERR;
+	if (ports->hist_flags[p] & HIST_HAVE_DC)
+		flush_hist_sample(db, node, port, p);
+}
+
+static void add_hist_dc(perfmgr_db_t * db, db_node_t * node, uint8_t port,
+			uint32_t p, osm_epi_dc_event_t * delta)
+{
+	perfmgr_db_ports_t *ports = &db->ports;
+	perfmgr_hist_sample_t *sample = &ports->hist_sample[p];
+	int c;
+
+	/* deltas of data readings whose error reading was lost add up */
+	if (ports->hist_flags[p] & HIST_DC_SEEN)
+		for (c = 0; c < PERFMGR_HIST_DATA_COLS; c++)
+			sample->data[c] += CNTR(delta, dc_event_offset[c]);
+
+	ports->hist_flags[p] |= HIST_DC_SEEN | HIST_HAVE_DC;
+	if (ports->hist_flags[p] & HIST_HAVE_ERR)
+		flush_hist_sample(db, node, port, p);
 }
 
 /**********************************************************************
  * perfmgr_db_err_reading_t functions
+ *
+ * Readings are recorded with db->lock held shared and the lock of the
+ * node held, so readings of different nodes do not wait for each other.
+ * Events are reported once the locks are released.
  **********************************************************************/
 perfmgr_db_err_t
 perfmgr_db_add_err_reading(perfmgr_db_t * db, uint64_t guid, uint8_t port,
 			   perfmgr_db_err_reading_t * reading)
 {
-	db_port_t *p_port = NULL;
+	perfmgr_db_ports_t *ports = &db->ports;
 	db_node_t *node = NULL;
-	perfmgr_db_err_reading_t *previous = NULL;
 	perfmgr_db_err_t rc = PERFMGR_EVENT_DB_SUCCESS;
 	osm_epi_pe_event_t epi_pe_data;
+	uint64_t value, delta;
+	uint32_t p;
+	int c;
 
-	cl_plock_excl_acquire(&db->lock);
+	cl_plock_acquire(&db->lock);
 	node = get(db, guid);
 	if ((rc = bad_node_port(node, port)) != PERFMGR_EVENT_DB_SUCCESS)
 		goto Exit;
 
-	p_port = &(node->ports[port]);
-	previous = &(node->ports[port].err_previous);
-
-	debug_dump_err_reading(db, guid, port, p_port, reading);
-
-	epi_pe_data.time_diff_s = (reading->time - previous->time);
+	p = node->first_port + port;
 	osm_epi_create_port_id(&epi_pe_data.port_id, guid, port,
 			       node->node_name);
 
+	cl_spinlock_acquire(&node->lock);
+	debug_dump_err_reading(db, guid, port, p, reading);
+
+	epi_pe_data.time_diff_s = reading->time - ports->err_previous_time[p];
+
 	/* calculate changes from previous reading */
-	epi_pe_data.symbol_err_cnt =
-	    (reading->symbol_err_cnt - previous->symbol_err_cnt);
-	p_port->err_total.symbol_err_cnt += epi_pe_data.symbol_err_cnt;
-	epi_pe_data.link_err_recover =
-	    (reading->link_err_recover - previous->link_err_recover);
-	p_port->err_total.link_err_recover += epi_pe_data.link_err_recover;
-	epi_pe_data.link_downed =
-	    (reading->link_downed - previous->link_downed);
-	p_port->err_total.link_downed += epi_pe_data.link_downed;
-	epi_pe_data.rcv_err = (reading->rcv_err - previous->rcv_err);
-	p_port->err_total.rcv_err += epi_pe_data.rcv_err;
-	epi_pe_data.rcv_rem_phys_err =
-	    (reading->rcv_rem_phys_err - previous->rcv_rem_phys_err);
-	p_port->err_total.rcv_rem_phys_err += epi_pe_data.rcv_rem_phys_err;
-	epi_pe_data.rcv_switch_relay_err =
-	    (reading->rcv_switch_relay_err - previous->rcv_switch_relay_err);
-	p_port->err_total.rcv_switch_relay_err +=
-	    epi_pe_data.rcv_switch_relay_err;
-	epi_pe_data.xmit_discards =
-	    (reading->xmit_discards - previous->xmit_discards);
-	p_port->err_total.xmit_discards += epi_pe_data.xmit_discards;
-	epi_pe_data.xmit_constraint_err =
-	    (reading->xmit_constraint_err - previous->xmit_constraint_err);
-	p_port->err_total.xmit_constraint_err +=
-	    epi_pe_data.xmit_constraint_err;
-	epi_pe_data.rcv_constraint_err =
-	    (reading->rcv_constraint_err - previous->rcv_constraint_err);
-	p_port->err_total.rcv_constraint_err += epi_pe_data.rcv_constraint_err;
-	epi_pe_data.link_integrity =
-	    (reading->link_integrity - previous->link_integrity);
-	p_port->err_total.link_integrity += epi_pe_data.link_integrity;
-	epi_pe_data.buffer_overrun =
-	    (reading->buffer_overrun - previous->buffer_overrun);
-	p_port->err_total.buffer_overrun += epi_pe_data.buffer_overrun;
-	epi_pe_data.vl15_dropped =
-	    (reading->vl15_dropped - previous->vl15_dropped);
-	p_port->err_total.vl15_dropped += epi_pe_data.vl15_dropped;
-
-	p_port->err_previous = *reading;
-
-	osm_opensm_report_event(db->perfmgr->osm, OSM_EVENT_ID_PORT_ERRORS,
-				&epi_pe_data);
+	for (c = 0; c < PERFMGR_DB_NUM_ERR_CNTRS; c++) {
+		value = CNTR(reading, err_reading_offset[c]);
+		delta = value - ports->err_previous[c][p];
+		CNTR(&epi_pe_data, err_event_offset[c]) = delta;
+		ports->err_total[c][p] += delta;
+		ports->err_previous[c][p] = value;
+	}
+	ports->err_previous_time[p] = reading->time;
+
+	if (ports->hist_slot[p] >= 0)
+		add_hist_err(db, node, port, p, reading, &epi_pe_data);
+	cl_spinlock_release(&node->lock);
 
 Exit:
 	cl_plock_release(&db->lock);
+	if (rc == PERFMGR_EVENT_DB_SUCCESS)
+		osm_opensm_report_event(db->perfmgr->osm,
+					OSM_EVENT_ID_PORT_ERRORS, &epi_pe_data);
 	return rc;
 }
 
@@ -344,8 +639,11 @@ perfmgr_db_err_t perfmgr_db_get_prev_err(perfmgr_db_t * db, uint64_t guid,
 					 uint8_t port,
 					 perfmgr_db_err_reading_t * reading)
 {
+	perfmgr_db_ports_t *ports = &db->ports;
 	db_node_t *node = NULL;
 	perfmgr_db_err_t rc = PERFMGR_EVENT_DB_SUCCESS;
+	uint32_t p;
+	int c;
 
 	cl_plock_acquire(&db->lock);
 
@@ -353,7 +651,13 @@ perfmgr_db_err_t perfmgr_db_get_prev_err(perfmgr_db_t * db, uint64_t guid,
 	if ((rc = bad_node_port(node, port)) != PERFMGR_EVENT_DB_SUCCESS)
 		goto Exit;
 
-	*reading = node->ports[port].err_previous;
+	p = node->first_port + port;
+	cl_spinlock_acquire(&node->lock);
+	for (c = 0; c < PERFMGR_DB_NUM_ERR_CNTRS; c++)
+		CNTR(reading, err_reading_offset[c]) =
+		    ports->err_previous[c][p];
+	reading->time = ports->err_previous_time[p];
+	cl_spinlock_release(&node->lock);
 
 Exit:
 	cl_plock_release(&db->lock);
@@ -363,19 +667,23 @@ Exit:
 perfmgr_db_err_t
 perfmgr_db_clear_prev_err(perfmgr_db_t * db, uint64_t guid, uint8_t port)
 {
+	perfmgr_db_ports_t *ports = &db->ports;
 	db_node_t *node = NULL;
-	perfmgr_db_err_reading_t *previous = NULL;
 	perfmgr_db_err_t rc = PERFMGR_EVENT_DB_SUCCESS;
+	uint32_t p;
+	int c;
 
-	cl_plock_excl_acquire(&db->lock);
+	cl_plock_acquire(&db->lock);
 	node = get(db, guid);
 	if ((rc = bad_node_port(node, port)) != PERFMGR_EVENT_DB_SUCCESS)
 		goto Exit;
 
-	previous = &(node->ports[port].err_previous);
-
-	memset(previous, 0, sizeof(*previous));
-	node->ports[port].err_previous.time = time(NULL);
+	p = node->first_port + port;
+	cl_spinlock_acquire(&node->lock);
+	for (c = 0; c < PERFMGR_DB_NUM_ERR_CNTRS; c++)
+		ports->err_previous[c][p] = 0;
+	ports->err_previous_time[p] = time(NULL);
+	cl_spinlock_release(&node->lock);
 
 Exit:
 	cl_plock_release(&db->lock);
@@ -384,26 +692,19 @@ Exit:
 
 static inline void
 debug_dump_dc_reading(perfmgr_db_t * db, uint64_t guid, uint8_t port_num,
-		      db_port_t * port, perfmgr_db_data_cnt_reading_t * cur)
+		      uint32_t p, perfmgr_db_data_cnt_reading_t * cur)
 {
 	osm_log_t *log = db->perfmgr->log;
+	int c;
+
 	if (!osm_log_is_active(log, OSM_LOG_DEBUG))
 		return;
 
-	osm_log(log, OSM_LOG_DEBUG,
-		"xd %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n",
-		cur->xmit_data, port->dc_previous.xmit_data,
-		port->dc_total.xmit_data);
-	osm_log(log, OSM_LOG_DEBUG,
-		"rd %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n", cur->rcv_data,
-		port->dc_previous.rcv_data, port->dc_total.rcv_data);
-	osm_log(log, OSM_LOG_DEBUG,
-		"xp %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n",
-		cur->xmit_pkts, port->dc_previous.xmit_pkts,
-		port->dc_total.xmit_pkts);
-	osm_log(log, OSM_LOG_DEBUG,
-		"rp %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n", cur->rcv_pkts,
-		port->dc_previous.rcv_pkts, port->dc_total.rcv_pkts);
+	for (c = PERFMGR_DB_XMIT_DATA; c <= PERFMGR_DB_RCV_PKTS; c++)
+		osm_log(log, OSM_LOG_DEBUG,
+			"%s %" PRIu64 " <-- %" PRIu64 " (%" PRIu64 ")\n",
+			dc_short_name[c], CNTR(cur, dc_reading_offset[c]),
+			db->ports.dc_previous[c][p], db->ports.dc_total[c][p]);
 }
 
 /**********************************************************************
@@ -414,59 +715,52 @@ perfmgr_db_add_dc_reading(perfmgr_db_t * db, uint64_t guid, uint8_t port,
 			  perfmgr_db_data_cnt_reading_t * reading,
 			  int ietf_sup)
 {
-	db_port_t *p_port = NULL;
+	perfmgr_db_ports_t *ports = &db->ports;
 	db_node_t *node = NULL;
-	perfmgr_db_data_cnt_reading_t *previous = NULL;
 	perfmgr_db_err_t rc = PERFMGR_EVENT_DB_SUCCESS;
 	osm_epi_dc_event_t epi_dc_data;
+	uint64_t value, delta;
+	uint32_t p;
+	int c;
 
-	cl_plock_excl_acquire(&db->lock);
+	cl_plock_acquire(&db->lock);
 	node = get(db, guid);
 	if ((rc = bad_node_port(node, port)) != PERFMGR_EVENT_DB_SUCCESS)
 		goto Exit;
 
-	p_port = &node->ports[port];
-	previous = &node->ports[port].dc_previous;
-
-	debug_dump_dc_reading(db, guid, port, p_port, reading);
-
-	epi_dc_data.time_diff_s = reading->time - previous->time;
+	p = node->first_port + port;
 	osm_epi_create_port_id(&epi_dc_data.port_id, guid, port,
 			       node->node_name);
 
-	/* calculate changes from previous reading */
-	epi_dc_data.xmit_data = reading->xmit_data - previous->xmit_data;
-	p_port->dc_total.xmit_data += epi_dc_data.xmit_data;
-	epi_dc_data.rcv_data = reading->rcv_data - previous->rcv_data;
-	p_port->dc_total.rcv_data += epi_dc_data.rcv_data;
-	epi_dc_data.xmit_pkts = reading->xmit_pkts - previous->xmit_pkts;
-	p_port->dc_total.xmit_pkts += epi_dc_data.xmit_pkts;
-	epi_dc_data.rcv_pkts = reading->rcv_pkts - previous->rcv_pkts;
-	p_port->dc_total.rcv_pkts += epi_dc_data.rcv_pkts;
+	cl_spinlock_acquire(&node->lock);
+	debug_dump_dc_reading(db, guid, port, p, reading);
 
-	if (ietf_sup)
-	{
-		epi_dc_data.unicast_xmit_pkts =
-		    reading->unicast_xmit_pkts - previous->unicast_xmit_pkts;
-		p_port->dc_total.unicast_xmit_pkts += epi_dc_data.unicast_xmit_pkts;
-		epi_dc_data.unicast_rcv_pkts =
-		    reading->unicast_rcv_pkts - previous->unicast_rcv_pkts;
-		p_port->dc_total.unicast_rcv_pkts += epi_dc_data.unicast_rcv_pkts;
-		epi_dc_data.multicast_xmit_pkts =
-		    reading->multicast_xmit_pkts - previous->multicast_xmit_pkts;
-		p_port->dc_total.multicast_xmit_pkts += epi_dc_data.multicast_xmit_pkts;
-		epi_dc_data.multicast_rcv_pkts =
-		    reading->multicast_rcv_pkts - previous->multicast_rcv_pkts;
-		p_port->dc_total.multicast_rcv_pkts += epi_dc_data.multicast_rcv_pkts;
-	}
+	epi_dc_data.time_diff_s = reading->time - ports->dc_previous_time[p];
 
-	p_port->dc_previous = *reading;
+	/* calculate changes from previous reading */
+	for (c = 0; c < PERFMGR_DB_NUM_DC_CNTRS; c++) {
+		if (!ietf_sup && c >= PERFMGR_DB_UNICAST_XMIT_PKTS) {
+			CNTR(&epi_dc_data, dc_event_offset[c]) = 0;
+			continue;
+		}
+		value = CNTR(reading, dc_reading_offset[c]);
+		delta = value - ports->dc_previous[c][p];
+		CNTR(&epi_dc_data, dc_event_offset[c]) = delta;
+		ports->dc_total[c][p] += delta;
+		ports->dc_previous[c][p] = value;
+	}
+	ports->dc_previous_time[p] = reading->time;
 
-	osm_opensm_report_event(db->perfmgr->osm,
-				OSM_EVENT_ID_PORT_DATA_COUNTERS, &epi_dc_data);
+	if (ports->hist_slot[p] >= 0)
+		add_hist_dc(db, node, port, p, &epi_dc_data);
+	cl_spinlock_release(&node->lock);
 
 Exit:
 	cl_plock_release(&db->lock);
+	if (rc == PERFMGR_EVENT_DB_SUCCESS)
+		osm_opensm_report_event(db->perfmgr->osm,
+					OSM_EVENT_ID_PORT_DATA_COUNTERS,
+					&epi_dc_data);
 	return rc;
 }
 
@@ -474,8 +768,11 @@ perfmgr_db_err_t perfmgr_db_get_prev_dc(perfmgr_db_t * db, uint64_t guid,
 					uint8_t port,
 					perfmgr_db_data_cnt_reading_t * reading)
 {
+	perfmgr_db_ports_t *ports = &db->ports;
 	db_node_t *node = NULL;
 	perfmgr_db_err_t rc = PERFMGR_EVENT_DB_SUCCESS;
+	uint32_t p;
+	int c;
 
 	cl_plock_acquire(&db->lock);
 
@@ -483,7 +780,12 @@ perfmgr_db_err_t perfmgr_db_get_prev_dc(perfmgr_db_t * db, uint64_t guid,
 	if ((rc = bad_node_port(node, port)) != PERFMGR_EVENT_DB_SUCCESS)
 		goto Exit;
 
-	*reading = node->ports[port].dc_previous;
+	p = node->first_port + port;
+	cl_spinlock_acquire(&node->lock);
+	for (c = 0; c < PERFMGR_DB_NUM_DC_CNTRS; c++)
+		CNTR(reading, dc_reading_offset[c]) = ports->dc_previous[c][p];
+	reading->time = ports->dc_previous_time[p];
+	cl_spinlock_release(&node->lock);
 
 Exit:
 	cl_plock_release(&db->lock);
@@ -493,67 +795,46 @@ Exit:
 perfmgr_db_err_t
 perfmgr_db_clear_prev_dc(perfmgr_db_t * db, uint64_t guid, uint8_t port)
 {
+	perfmgr_db_ports_t *ports = &db->ports;
 	db_node_t *node = NULL;
-	perfmgr_db_data_cnt_reading_t *previous = NULL;
 	perfmgr_db_err_t rc = PERFMGR_EVENT_DB_SUCCESS;
+	uint32_t p;
+	int c;
 
-	cl_plock_excl_acquire(&db->lock);
+	cl_plock_acquire(&db->lock);
 	node = get(db, guid);
 	if ((rc = bad_node_port(node, port)) != PERFMGR_EVENT_DB_SUCCESS)
 		goto Exit;
 
-	previous = &node->ports[port].dc_previous;
-
-	memset(previous, 0, sizeof(*previous));
-	node->ports[port].dc_previous.time = time(NULL);
+	p = node->first_port + port;
+	cl_spinlock_acquire(&node->lock);
+	for (c = 0; c < PERFMGR_DB_NUM_DC_CNTRS; c++)
+		ports->dc_previous[c][p] = 0;
+	ports->dc_previous_time[p] = time(NULL);
+	cl_spinlock_release(&node->lock);
 
 Exit:
 	cl_plock_release(&db->lock);
 	return rc;
 }
 
-static void clear_counters(cl_map_item_t * const p_map_item, void *context)
-{
-	db_node_t *node = (db_node_t *) p_map_item;
-	int i = 0;
-	time_t ts = time(NULL);
-
-	for (i = 0; i < node->num_ports; i++) {
-		node->ports[i].err_total.symbol_err_cnt = 0;
-		node->ports[i].err_total.link_err_recover = 0;
-		node->ports[i].err_total.link_downed = 0;
-		node->ports[i].err_total.rcv_err = 0;
-		node->ports[i].err_total.rcv_rem_phys_err = 0;
-		node->ports[i].err_total.rcv_switch_relay_err = 0;
-		node->ports[i].err_total.xmit_discards = 0;
-		node->ports[i].err_total.xmit_constraint_err = 0;
-		node->ports[i].err_total.rcv_constraint_err = 0;
-		node->ports[i].err_total.link_integrity = 0;
-		node->ports[i].err_total.buffer_overrun = 0;
-		node->ports[i].err_total.vl15_dropped = 0;
-		node->ports[i].err_total.time = ts;
-
-		node->ports[i].dc_total.xmit_data = 0;
-		node->ports[i].dc_total.rcv_data = 0;
-		node->ports[i].dc_total.xmit_pkts = 0;
-		node->ports[i].dc_total.rcv_pkts = 0;
-		node->ports[i].dc_total.unicast_xmit_pkts = 0;
-		node->ports[i].dc_total.unicast_rcv_pkts = 0;
-		node->ports[i].dc_total.multicast_xmit_pkts = 0;
-		node->ports[i].dc_total.multicast_rcv_pkts = 0;
-		node->ports[i].dc_total.time = ts;
-
-		node->ports[i].last_reset = ts;
-	}
-}
-
 /**********************************************************************
  * Clear all the counters from the db
  **********************************************************************/
 void perfmgr_db_clear_counters(perfmgr_db_t * db)
 {
+	perfmgr_db_ports_t *ports = &db->ports;
+	time_t ts = time(NULL);
+	uint32_t i;
+	int c;
+
 	cl_plock_excl_acquire(&db->lock);
-	cl_qmap_apply_func(&db->pc_data, clear_counters, (void *)db);
+	for (c = 0; c < PERFMGR_DB_NUM_ERR_CNTRS; c++)
+		memset(ports->err_total[c], 0, ports->used * sizeof(uint64_t));
+	for (c = 0; c < PERFMGR_DB_NUM_DC_CNTRS; c++)
+		memset(ports->dc_total[c], 0, ports->used * sizeof(uint64_t));
+	for (i = 0; i < ports->used; i++)
+		ports->last_reset[i] = ts;
 	cl_plock_release(&db->lock);
 #if 0
 	if (db->db_impl->clear_counters)
@@ -561,12 +842,38 @@ void perfmgr_db_clear_counters(perfmgr_db_t * db)
 #endif
 }
 
+/**********************************************************************
+ * Totals of a port, copied under the node lock for printing
+ **********************************************************************/
+typedef struct {
+	uint64_t err[PERFMGR_DB_NUM_ERR_CNTRS];
+	uint64_t dc[PERFMGR_DB_NUM_DC_CNTRS];
+	time_t last_reset;
+} port_totals_t;
+
+static void get_totals(perfmgr_db_t * db, db_node_t * node, int port,
+		       port_totals_t * totals)
+{
+	perfmgr_db_ports_t *ports = &db->ports;
+	uint32_t p = node->first_port + port;
+	int c;
+
+	cl_spinlock_acquire(&node->lock);
+	for (c = 0; c < PERFMGR_DB_NUM_ERR_CNTRS; c++)
+		totals->err[c] = ports->err_total[c][p];
+	for (c = 0; c < PERFMGR_DB_NUM_DC_CNTRS; c++)
+		totals->dc[c] = ports->dc_total[c][p];
+	totals->last_reset = ports->last_reset[p];
+	cl_spinlock_release(&node->lock);
+}
+
 /**********************************************************************
  * Output a tab delimited output of the port counters
  **********************************************************************/
-static void dump_node_mr(db_node_t * node, FILE * fp)
+static void dump_node_mr(perfmgr_db_t * db, db_node_t * node, FILE * fp)
 {
-	int i = 0;
+	port_totals_t totals;
+	int i = 0, c;
 
 	fprintf(fp, "\nName\tGUID\tPort\tLast Reset\t"
 		"%s\t%s\t"
@@ -594,37 +901,19 @@ static void dump_node_mr(db_node_t * node, FILE * fp)
 		"multicast_xmit_pkts",
 		"multicast_rcv_pkts");
 	for (i = (node->esp0) ? 0 : 1; i < node->num_ports; i++) {
-		char *since = ctime(&node->ports[i].last_reset);
+		char *since;
+
+		get_totals(db, node, i, &totals);
+		since = ctime(&totals.last_reset);
 		since[strlen(since) - 1] = '\0';	/* remove \n */
 
-		fprintf(fp,
-			"%s\t0x%" PRIx64 "\t%d\t%s\t%" PRIu64 "\t%" PRIu64 "\t"
-			"%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t"
-			"%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t" "%" PRIu64
-			"\t%" PRIu64 "\t%" PRIu64 "\t" "%" PRIu64 "\t%" PRIu64
-			"\t%" PRIu64 "\t%" PRIu64 "\t" "%" PRIu64 "\t%" PRIu64
-			"\t%" PRIu64 "\t%" PRIu64 "\n", node->node_name,
-			node->node_guid, i, since,
-			node->ports[i].err_total.symbol_err_cnt,
-			node->ports[i].err_total.link_err_recover,
-			node->ports[i].err_total.link_downed,
-			node->ports[i].err_total.rcv_err,
-			node->ports[i].err_total.rcv_rem_phys_err,
-			node->ports[i].err_total.rcv_switch_relay_err,
-			node->ports[i].err_total.xmit_discards,
-			node->ports[i].err_total.xmit_constraint_err,
-			node->ports[i].err_total.rcv_constraint_err,
-			node->ports[i].err_total.link_integrity,
-			node->ports[i].err_total.buffer_overrun,
-			node->ports[i].err_total.vl15_dropped,
-			node->ports[i].dc_total.xmit_data,
-			node->ports[i].dc_total.rcv_data,
-			node->ports[i].dc_total.xmit_pkts,
-			node->ports[i].dc_total.rcv_pkts,
-			node->ports[i].dc_total.unicast_xmit_pkts,
-			node->ports[i].dc_total.unicast_rcv_pkts,
-			node->ports[i].dc_total.multicast_xmit_pkts,
-			node->ports[i].dc_total.multicast_rcv_pkts);
+		fprintf(fp, "%s\t0x%" PRIx64 "\t%d\t%s", node->node_name,
+			node->node_guid, i, since);
+		for (c = 0; c < PERFMGR_DB_NUM_ERR_CNTRS; c++)
+			fprintf(fp, "\t%" PRIu64, totals.err[c]);
+		for (c = 0; c < PERFMGR_DB_NUM_DC_CNTRS; c++)
+			fprintf(fp, "\t%" PRIu64, totals.dc[c]);
+		fprintf(fp, "\n");
 	}
 }
 
@@ -680,10 +969,13 @@ static void dump_hr_dc(FILE *fp, uint64_t val64, int data)
 /**********************************************************************
  * Output a human readable output of the port counters
  **********************************************************************/
-static void dump_node_hr(db_node_t * node, FILE * fp, char *port, int err_only)
+static void dump_node_hr(perfmgr_db_t * db, db_node_t * node, FILE * fp,
+			 char *port, int err_only)
 {
+	port_totals_t totals;
 	int i = (node->esp0) ? 0 : 1;
 	int num_ports = node->num_ports;
+	int c, errors;
 
 	if (port) {
 		char *end = NULL;
@@ -696,114 +988,33 @@ static void dump_node_hr(db_node_t * node, FILE * fp, char *port, int err_only)
 		}
 	}
 	for (/* set above */; i < num_ports; i++) {
-		char *since = ctime(&node->ports[i].last_reset);
-		since[strlen(since) - 1] = '\0';	/* remove \n */
-		perfmgr_db_err_reading_t *err = &node->ports[i].err_total;
-
-		if (err_only
-		    && err->symbol_err_cnt == 0
-		    && err->link_err_recover == 0
-		    && err->link_downed == 0
-		    && err->rcv_err == 0
-		    && err->rcv_rem_phys_err == 0
-		    && err->rcv_switch_relay_err == 0
-		    && err->xmit_discards == 0
-		    && err->xmit_constraint_err == 0
-		    && err->rcv_constraint_err == 0
-		    && err->link_integrity == 0
-		    && err->buffer_overrun == 0
-		    && err->vl15_dropped == 0)
+		char *since;
+
+		get_totals(db, node, i, &totals);
+
+		for (errors = 0, c = 0; c < PERFMGR_DB_NUM_ERR_CNTRS; c++)
+			if (totals.err[c])
+				errors = 1;
+		if (err_only && !errors)
 			continue;
 
+		since = ctime(&totals.last_reset);
+		since[strlen(since) - 1] = '\0';	/* remove \n */
 		fprintf(fp, "\"%s\" 0x%" PRIx64 " port %d (Since %s)\n",
 			node->node_name, node->node_guid, i, since);
 
-		if (!err_only || err->symbol_err_cnt != 0)
-			fprintf(fp, "     symbol_err_cnt       : %" PRIu64 "\n",
-				err->symbol_err_cnt);
-		if (!err_only || err->link_err_recover != 0)
-			fprintf(fp, "     link_err_recover     : %" PRIu64 "\n",
-				err->link_err_recover);
-		if (!err_only || err->link_downed != 0)
-			fprintf(fp, "     link_downed          : %" PRIu64 "\n",
-				err->link_downed);
-		if (!err_only || err->rcv_err != 0)
-			fprintf(fp, "     rcv_err              : %" PRIu64 "\n",
-				err->rcv_err);
-		if (!err_only || err->rcv_rem_phys_err != 0)
-			fprintf(fp, "     rcv_rem_phys_err     : %" PRIu64 "\n",
-				err->rcv_rem_phys_err);
-		if (!err_only || err->rcv_switch_relay_err != 0)
-			fprintf(fp, "     rcv_switch_relay_err : %" PRIu64 "\n",
-				err->rcv_switch_relay_err);
-		if (!err_only || err->xmit_discards != 0)
-			fprintf(fp, "     xmit_discards        : %" PRIu64 "\n",
-				err->xmit_discards);
-		if (!err_only || err->xmit_constraint_err != 0)
-			fprintf(fp, "     xmit_constraint_err  : %" PRIu64 "\n",
-				err->xmit_constraint_err);
-		if (!err_only || err->rcv_constraint_err != 0)
-			fprintf(fp, "     rcv_constraint_err   : %" PRIu64 "\n",
-				err->rcv_constraint_err);
-		if (!err_only || err->link_integrity != 0)
-			fprintf(fp, "     link_integrity_err   : %" PRIu64 "\n",
-				err->link_integrity);
-		if (!err_only || err->buffer_overrun != 0)
-			fprintf(fp, "     buf_overrun_err      : %" PRIu64 "\n",
-				err->buffer_overrun);
-		if (!err_only || err->vl15_dropped != 0)
-			fprintf(fp, "     vl15_dropped         : %" PRIu64 "\n",
-				err->vl15_dropped);
-
-
-		fprintf(fp, "     xmit_data            : %" PRIu64,
-			node->ports[i].dc_total.xmit_data);
-		dump_hr_dc(fp, node->ports[i].dc_total.xmit_data, 1);
-		fprintf(fp, "     rcv_data             : %" PRIu64,
-			node->ports[i].dc_total.rcv_data);
-		dump_hr_dc(fp, node->ports[i].dc_total.rcv_data, 1);
-		fprintf(fp, "     xmit_pkts            : %" PRIu64,
-			node->ports[i].dc_total.xmit_pkts);
-		dump_hr_dc(fp, node->ports[i].dc_total.xmit_pkts, 0);
-		fprintf(fp, "     rcv_pkts             : %" PRIu64,
-			node->ports[i].dc_total.rcv_pkts);
-		dump_hr_dc(fp, node->ports[i].dc_total.rcv_pkts, 0);
-		fprintf(fp, "     unicast_xmit_pkts    : %" PRIu64,
-			node->ports[i].dc_total.unicast_xmit_pkts);
-		dump_hr_dc(fp, node->ports[i].dc_total.unicast_xmit_pkts, 0);
-		fprintf(fp, "     unicast_rcv_pkts     : %" PRIu64,
-			node->ports[i].dc_total.unicast_rcv_pkts);
-		dump_hr_dc(fp, node->ports[i].dc_total.unicast_rcv_pkts, 0);
-		fprintf(fp, "     multicast_xmit_pkts  : %" PRIu64,
-			node->ports[i].dc_total.multicast_xmit_pkts);
-		dump_hr_dc(fp, node->ports[i].dc_total.multicast_xmit_pkts, 0);
-		fprintf(fp, "     multicast_rcv_pkts   : %" PRIu64,
-			node->ports[i].dc_total.multicast_rcv_pkts);
-		dump_hr_dc(fp, node->ports[i].dc_total.multicast_rcv_pkts, 0);
-
-	}
-}
-
-/* Define a context for the __db_dump callback */
-typedef struct {
-	FILE *fp;
-	perfmgr_db_dump_t dump_type;
-} dump_context_t;
-
-static void db_dump(cl_map_item_t * const p_map_item, void *context)
-{
-	db_node_t *node = (db_node_t *) p_map_item;
-	dump_context_t *c = (dump_context_t *) context;
-	FILE *fp = c->fp;
-
-	switch (c->dump_type) {
-	case PERFMGR_EVENT_DB_DUMP_MR:
-		dump_node_mr(node, fp);
-		break;
-	case PERFMGR_EVENT_DB_DUMP_HR:
-	default:
-		dump_node_hr(node, fp, NULL, 0);
-		break;
+		for (c = 0; c < PERFMGR_DB_NUM_ERR_CNTRS; c++)
+			if (!err_only || totals.err[c] != 0)
+				fprintf(fp, "     %-20s : %" PRIu64 "\n",
+					err_name[c], totals.err[c]);
+
+		for (c = 0; c < PERFMGR_DB_NUM_DC_CNTRS; c++) {
+			fprintf(fp, "     %-20s : %" PRIu64, dc_name[c],
+				totals.dc[c]);
+			dump_hr_dc(fp, totals.dc[c],
+				   c == PERFMGR_DB_XMIT_DATA ||
+				   c == PERFMGR_DB_RCV_DATA);
+		}
 	}
 }
 
@@ -813,16 +1024,13 @@ static void db_dump(cl_map_item_t * const p_map_item, void *context)
 void
 perfmgr_db_print_all(perfmgr_db_t * db, FILE *fp, int err_only)
 {
-	cl_map_item_t *item;
-	db_node_t *node;
+	cl_list_item_t *item;
 
 	cl_plock_acquire(&db->lock);
-	item = cl_qmap_head(&db->pc_data);
-	while (item != cl_qmap_end(&db->pc_data)) {
-		node = (db_node_t *)item;
-		dump_node_hr(node, fp, NULL, err_only);
-		item = cl_qmap_next(item);
-	}
+	for (item = cl_qlist_head(&db->node_list);
+	     item != cl_qlist_end(&db->node_list);
+	     item = cl_qlist_next(item))
+		dump_node_hr(db, (db_node_t *) item, fp, NULL, err_only);
 	cl_plock_release(&db->lock);
 }
 
@@ -833,20 +1041,20 @@ void
 perfmgr_db_print_by_name(perfmgr_db_t * db, char *nodename, FILE *fp,
 			 char *port, int err_only)
 {
-	cl_map_item_t *item;
+	cl_list_item_t *item;
 	db_node_t *node;
 
 	cl_plock_acquire(&db->lock);
 
 	/* find the node */
-	item = cl_qmap_head(&db->pc_data);
-	while (item != cl_qmap_end(&db->pc_data)) {
+	for (item = cl_qlist_head(&db->node_list);
+	     item != cl_qlist_end(&db->node_list);
+	     item = cl_qlist_next(item)) {
 		node = (db_node_t *)item;
 		if (strcmp(node->node_name, nodename) == 0) {
-			dump_node_hr(node, fp, port, err_only);
+			dump_node_hr(db, node, fp, port, err_only);
 			goto done;
 		}
-		item = cl_qmap_next(item);
 	}
 
 	fprintf(fp, "Node %s not found...\n", nodename);
@@ -861,13 +1069,13 @@ void
 perfmgr_db_print_by_guid(perfmgr_db_t * db, uint64_t nodeguid, FILE *fp,
 			 char *port, int err_only)
 {
-	cl_map_item_t *node;
+	db_node_t *node;
 
 	cl_plock_acquire(&db->lock);
 
-	node = cl_qmap_get(&db->pc_data, nodeguid);
-	if (node != cl_qmap_end(&db->pc_data))
-		dump_node_hr((db_node_t *)node, fp, port, err_only);
+	node = get(db, nodeguid);
+	if (node)
+		dump_node_hr(db, node, fp, port, err_only);
 	else
 		fprintf(fp, "Node 0x%" PRIx64 " not found...\n", nodeguid);
 
@@ -880,17 +1088,29 @@ perfmgr_db_print_by_guid(perfmgr_db_t * db, uint64_t nodeguid, FILE *fp,
 perfmgr_db_err_t
 perfmgr_db_dump(perfmgr_db_t * db, char *file, perfmgr_db_dump_t dump_type)
 {
-	dump_context_t context;
+	cl_list_item_t *item;
+	FILE *fp;
 
-	context.fp = fopen(file, "w+");
-	if (!context.fp)
+	fp = fopen(file, "w+");
+	if (!fp)
 		return PERFMGR_EVENT_DB_FAIL;
-	context.dump_type = dump_type;
 
 	cl_plock_acquire(&db->lock);
-	cl_qmap_apply_func(&db->pc_data, db_dump, (void *)&context);
+	for (item = cl_qlist_head(&db->node_list);
+	     item != cl_qlist_end(&db->node_list);
+	     item = cl_qlist_next(item)) {
+		switch (dump_type) {
+		case PERFMGR_EVENT_DB_DUMP_MR:
+			dump_node_mr(db, (db_node_t *) item, fp);
+			break;
+		case PERFMGR_EVENT_DB_DUMP_HR:
+		default:
+			dump_node_hr(db, (db_node_t *) item, fp, NULL, 0);
+			break;
+		}
+	}
 	cl_plock_release(&db->lock);
-	fclose(context.fp);
+	fclose(fp);
 	return PERFMGR_EVENT_DB_SUCCESS;
 }
 
@@ -0,0 +1,611 @@
+/*
+ * Copyright (c) 2004-2009 Voltaire, Inc. All rights reserved.
+ * Copyright (c) 2002-2006 Mellanox Technologies LTD. All rights reserved.
+ * Copyright (c) 1996-2003 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *    Implementation of perfmgr_hist_t.
+ * This object represents the PerfMgr counter history file.
+ * This object is part of the opensm family of objects.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <opensm/osm_perfmgr_hist.h>
+
+#define hist_barrier()	__sync_synchronize()
+#define HIST_READ_RETRIES 100
+#define HIST_CLOCK_SCAN 16
+
+static const char *err_col_str[PERFMGR_HIST_ERR_COLS] = {
+	"symbol_err_cnt",
+	"link_err_recover",
+	"link_downed",
+	"rcv_err",
+	"rcv_rem_phys_err",
+	"rcv_switch_relay_err",
+	"xmit_discards",
+	"xmit_constraint_err",
+	"rcv_constraint_err",
+	"link_integrity_err",
+	"buf_overrun_err",
+	"vl15_dropped"
+};
+
+/**********************************************************************
+ * File layout helpers
+ **********************************************************************/
+static inline size_t hist_size(uint32_t num_slots, uint32_t depth)
+{
+	return sizeof(perfmgr_hist_hdr_t) +
+	    (size_t) num_slots * sizeof(perfmgr_hist_slot_t) +
+	    (size_t) num_slots * depth * PERFMGR_HIST_SAMPLE_SIZE;
+}
+
+static inline perfmgr_hist_slot_t *hist_slot(const perfmgr_hist_hdr_t * p_hdr,
+					     uint32_t slot)
+{
+	return (perfmgr_hist_slot_t *) (p_hdr + 1) + slot;
+}
+
+/* column 0 holds the time stamps, 1 the intervals, 2.. the errors */
+static inline uint32_t *hist_col32(const perfmgr_hist_hdr_t * p_hdr,
+				   uint32_t slot, unsigned col)
+{
+	uint8_t *block = (uint8_t *) hist_slot(p_hdr, p_hdr->num_slots) +
+	    (size_t) slot * p_hdr->depth * p_hdr->sample_size;
+
+	return (uint32_t *) block + (size_t) col * p_hdr->depth;
+}
+
+static inline uint64_t *hist_col64(const perfmgr_hist_hdr_t * p_hdr,
+				   uint32_t slot, unsigned col)
+{
+	uint64_t *data = (uint64_t *) hist_col32(p_hdr, slot,
+						 2 + PERFMGR_HIST_ERR_COLS);
+
+	return data + (size_t) col * p_hdr->depth;
+}
+
+static int index_cmp(IN const void *const p_key1, IN const void *const p_key2)
+{
+	const perfmgr_hist_index_t *k1 = p_key1, *k2 = p_key2;
+
+	if (k1->guid != k2->guid)
+		return k1->guid < k2->guid ? -1 : 1;
+	return (int)k1->port - (int)k2->port;
+}
+
+/**********************************************************************
+ * Writer
+ **********************************************************************/
+void perfmgr_hist_construct(IN perfmgr_hist_t * p_hist)
+{
+	memset(p_hist, 0, sizeof(*p_hist));
+	p_hist->fd = -1;
+	cl_fmap_init(&p_hist->index, index_cmp);
+}
+
+static boolean_t hist_matches(const perfmgr_hist_hdr_t * p_hdr,
+			      uint32_t num_slots, uint32_t depth)
+{
+	return p_hdr->magic == PERFMGR_HIST_MAGIC &&
+	    p_hdr->version == PERFMGR_HIST_VERSION &&
+	    p_hdr->slot_hdr_size == sizeof(perfmgr_hist_slot_t) &&
+	    p_hdr->sample_size == PERFMGR_HIST_SAMPLE_SIZE &&
+	    p_hdr->num_slots == num_slots && p_hdr->depth == depth;
+}
+
+ib_api_status_t perfmgr_hist_init(IN perfmgr_hist_t * p_hist,
+				  IN osm_log_t * p_log,
+				  IN const char *file_name,
+				  IN uint32_t num_slots, IN uint32_t depth)
+{
+	perfmgr_hist_hdr_t *p_hdr;
+	perfmgr_hist_slot_t *p_slot;
+	boolean_t keep = FALSE;
+	struct stat st;
+	void *map;
+	size_t size;
+	uint32_t i;
+
+	p_hist->log = p_log;
+
+	if (!num_slots || depth < 2 || depth > PERFMGR_HIST_MAX_DEPTH) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5801: "
+			"Invalid history geometry %u ports, %u samples\n",
+			num_slots, depth);
+		return IB_INVALID_PARAMETER;
+	}
+
+	size = hist_size(num_slots, depth);
+
+	p_hist->fd = open(file_name, O_RDWR | O_CREAT, 0644);
+	if (p_hist->fd < 0) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5802: "
+			"Cannot open history file \'%s\': %s\n",
+			file_name, strerror(errno));
+		return IB_ERROR;
+	}
+
+	if (fstat(p_hist->fd, &st) == 0 && (size_t) st.st_size == size) {
+		map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			   p_hist->fd, 0);
+		if (map != MAP_FAILED) {
+			keep = hist_matches(map, num_slots, depth);
+			if (!keep)
+				munmap(map, size);
+		}
+	}
+
+	if (!keep) {
+		if (ftruncate(p_hist->fd, 0) < 0 ||
+		    ftruncate(p_hist->fd, size) < 0) {
+			OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5803: "
+				"Cannot size history file \'%s\' to %zu "
+				"bytes: %s\n", file_name, size,
+				strerror(errno));
+			goto Error;
+		}
+		map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			   p_hist->fd, 0);
+		if (map == MAP_FAILED) {
+			OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5804: "
+				"Cannot map history file \'%s\': %s\n",
+				file_name, strerror(errno));
+			goto Error;
+		}
+		p_hdr = map;
+		p_hdr->magic = PERFMGR_HIST_MAGIC;
+		p_hdr->version = PERFMGR_HIST_VERSION;
+		p_hdr->slot_hdr_size = sizeof(perfmgr_hist_slot_t);
+		p_hdr->num_slots = num_slots;
+		p_hdr->depth = depth;
+		p_hdr->sample_size = PERFMGR_HIST_SAMPLE_SIZE;
+		p_hdr->create_time = time(NULL);
+	}
+
+	p_hist->index_items = calloc(num_slots, sizeof(*p_hist->index_items));
+	if (!p_hist->index_items) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5805: "
+			"Cannot allocate the history index\n");
+		munmap(map, size);
+		goto Error;
+	}
+
+	p_hist->map_size = size;
+	p_hist->p_hdr = map;
+	p_hist->slots = hist_slot(map, 0);
+
+	/* slots are assigned in order and never released */
+	for (i = 0; keep && i < num_slots; i++) {
+		p_slot = &p_hist->slots[i];
+		if (!p_slot->guid)
+			break;
+		/* a sample may have been cut short by a crash */
+		p_slot->seq &= ~1;
+		p_hist->index_items[i].guid = p_slot->guid;
+		p_hist->index_items[i].port = p_slot->port;
+		cl_fmap_insert(&p_hist->index, &p_hist->index_items[i],
+			       &p_hist->index_items[i].map_item);
+	}
+	p_hist->next_free = i;
+
+	OSM_LOG(p_log, OSM_LOG_VERBOSE,
+		"Recording PerfMgr history to \'%s\' (%u ports, %u samples "
+		"per port, %u ports kept)\n", file_name, num_slots, depth,
+		p_hist->next_free);
+	return IB_SUCCESS;
+
+Error:
+	close(p_hist->fd);
+	p_hist->fd = -1;
+	return IB_ERROR;
+}
+
+void perfmgr_hist_destroy(IN perfmgr_hist_t * p_hist)
+{
+	if (p_hist->p_hdr) {
+		msync(p_hist->p_hdr, p_hist->map_size, MS_ASYNC);
+		munmap(p_hist->p_hdr, p_hist->map_size);
+		p_hist->p_hdr = NULL;
+		p_hist->slots = NULL;
+	}
+	if (p_hist->fd >= 0) {
+		close(p_hist->fd);
+		p_hist->fd = -1;
+	}
+	free(p_hist->index_items);
+	p_hist->index_items = NULL;
+	cl_fmap_init(&p_hist->index, index_cmp);
+}
+
+/*
+ * Second chance clock over the assigned slots: a slot is reused only
+ * when its port was neither looked up nor sampled since the hand last
+ * passed it.  The hand moves at most one slot per sample taken, so a
+ * port read every sweep has its next reading before the hand comes
+ * back to it.
+ */
+static int32_t hist_clock_reuse(IN perfmgr_hist_t * p_hist)
+{
+	perfmgr_hist_index_t *p_item;
+	uint32_t slot, n;
+
+	for (n = 0; n < HIST_CLOCK_SCAN && p_hist->clock_credit; n++) {
+		slot = p_hist->clock_hand;
+		p_hist->clock_hand = (slot + 1) % p_hist->p_hdr->num_slots;
+		p_hist->clock_credit--;
+		p_item = &p_hist->index_items[slot];
+		if (p_item->referenced) {
+			p_item->referenced = FALSE;
+			continue;
+		}
+		OSM_LOG(p_hist->log, OSM_LOG_VERBOSE,
+			"Reusing history of 0x%016" PRIx64 " port %u\n",
+			p_hist->slots[slot].guid, p_hist->slots[slot].port);
+		cl_fmap_remove_item(&p_hist->index, &p_item->map_item);
+		return (int32_t) slot;
+	}
+	return -1;
+}
+
+int32_t perfmgr_hist_get_slot(IN perfmgr_hist_t * p_hist, IN uint64_t guid,
+			      IN uint8_t port, IN const char *node_name)
+{
+	perfmgr_hist_index_t key, *p_item;
+	perfmgr_hist_slot_t *p_slot;
+	cl_fmap_item_t *p_map_item;
+	int32_t slot;
+
+	CL_ASSERT(p_hist->p_hdr);
+
+	key.guid = guid;
+	key.port = port;
+	p_map_item = cl_fmap_get(&p_hist->index, &key);
+	if (p_map_item != cl_fmap_end(&p_hist->index)) {
+		p_item = (perfmgr_hist_index_t *) p_map_item;
+		p_item->referenced = TRUE;
+		return (int32_t) (p_item - p_hist->index_items);
+	}
+
+	if (p_hist->next_free < p_hist->p_hdr->num_slots)
+		slot = (int32_t) p_hist->next_free++;
+	else if ((slot = hist_clock_reuse(p_hist)) < 0) {
+		OSM_LOG(p_hist->log, OSM_LOG_DEBUG,
+			"History full, not keeping 0x%016" PRIx64
+			" port %u\n", guid, port);
+		return -1;
+	}
+
+	p_slot = &p_hist->slots[slot];
+	p_slot->seq++;
+	hist_barrier();
+	p_slot->guid = guid;
+	p_slot->port = port;
+	p_slot->count = 0;
+	p_slot->last_time = time(NULL);
+	snprintf(p_slot->node_name, sizeof(p_slot->node_name), "%s",
+		 node_name);
+	hist_barrier();
+	p_slot->seq++;
+
+	p_item = &p_hist->index_items[slot];
+	p_item->guid = guid;
+	p_item->port = port;
+	p_item->referenced = TRUE;
+	cl_fmap_insert(&p_hist->index, p_item, &p_item->map_item);
+
+	return slot;
+}
+
+boolean_t perfmgr_hist_add(IN perfmgr_hist_t * p_hist, IN int32_t slot,
+			   IN uint64_t guid, IN uint8_t port,
+			   IN const perfmgr_hist_sample_t * p_sample)
+{
+	const perfmgr_hist_hdr_t *p_hdr = p_hist->p_hdr;
+	perfmgr_hist_slot_t *p_slot = &p_hist->slots[slot];
+	uint32_t i;
+	unsigned col;
+
+	/* the slot was reused for another port */
+	if (p_slot->guid != guid || p_slot->port != port)
+		return FALSE;
+
+	i = p_slot->count % p_hdr->depth;
+	p_slot->seq++;
+	hist_barrier();
+	hist_col32(p_hdr, slot, 0)[i] = p_sample->time;
+	hist_col32(p_hdr, slot, 1)[i] = p_sample->interval;
+	for (col = 0; col < PERFMGR_HIST_ERR_COLS; col++)
+		hist_col32(p_hdr, slot, 2 + col)[i] = p_sample->err[col];
+	for (col = 0; col < PERFMGR_HIST_DATA_COLS; col++)
+		hist_col64(p_hdr, slot, col)[i] = p_sample->data[col];
+	p_slot->count++;
+	p_slot->last_time = p_sample->time;
+	hist_barrier();
+	p_slot->seq++;
+
+	p_hist->index_items[slot].referenced = TRUE;
+	if (p_hist->clock_credit < p_hdr->num_slots)
+		p_hist->clock_credit++;
+	return TRUE;
+}
+
+/**********************************************************************
+ * Readers; these run without any lock, in OpenSM or in another process
+ **********************************************************************/
+const char *perfmgr_hist_check(IN const perfmgr_hist_hdr_t * p_hdr,
+			       IN size_t size)
+{
+	if (size < sizeof(*p_hdr))
+		return "file too short";
+	if (p_hdr->magic != PERFMGR_HIST_MAGIC)
+		return p_hdr->magic == cl_hton32(PERFMGR_HIST_MAGIC) ?
+		    "history file of another byte order" :
+		    "not a PerfMgr history file";
+	if (p_hdr->version != PERFMGR_HIST_VERSION ||
+	    p_hdr->slot_hdr_size != sizeof(perfmgr_hist_slot_t) ||
+	    p_hdr->sample_size != PERFMGR_HIST_SAMPLE_SIZE)
+		return "unsupported history file version";
+	if (!p_hdr->num_slots || p_hdr->depth < 2 ||
+	    p_hdr->depth > PERFMGR_HIST_MAX_DEPTH ||
+	    hist_size(p_hdr->num_slots, p_hdr->depth) > size)
+		return "corrupted history file header";
+	return NULL;
+}
+
+/*
+ * Copy the directory entry of a slot and its samples taken since
+ * "since", oldest first.  Returns the number of samples copied.
+ */
+static uint32_t read_slot(const perfmgr_hist_hdr_t * p_hdr, uint32_t slot,
+			  perfmgr_hist_slot_t * p_copy,
+			  perfmgr_hist_sample_t * samples, time_t since)
+{
+	const perfmgr_hist_slot_t *p_slot = hist_slot(p_hdr, slot);
+	uint32_t seq, count, i, n, retry;
+	unsigned col;
+
+	for (retry = 0; retry < HIST_READ_RETRIES; retry++) {
+		seq = p_slot->seq;
+		if (seq & 1) {
+			sched_yield();
+			continue;
+		}
+		hist_barrier();
+		memcpy(p_copy, (const void *)p_slot, sizeof(*p_copy));
+		count = p_copy->count;
+		i = count > p_hdr->depth ? count - p_hdr->depth : 0;
+		for (n = 0; i < count; i++) {
+			uint32_t ix = i % p_hdr->depth;
+			perfmgr_hist_sample_t *s = &samples[n];
+
+			s->time = hist_col32(p_hdr, slot, 0)[ix];
+			if ((time_t) s->time < since)
+				continue;
+			s->interval = hist_col32(p_hdr, slot, 1)[ix];
+			for (col = 0; col < PERFMGR_HIST_ERR_COLS; col++)
+				s->err[col] =
+				    hist_col32(p_hdr, slot, 2 + col)[ix];
+			for (col = 0; col < PERFMGR_HIST_DATA_COLS; col++)
+				s->data[col] = hist_col64(p_hdr, slot, col)[ix];
+			n++;
+		}
+		hist_barrier();
+		if (p_slot->seq == seq)
+			return n;
+	}
+
+	p_copy->guid = 0;
+	return 0;
+}
+
+void perfmgr_hist_list(IN const perfmgr_hist_hdr_t * p_hdr, IN FILE * fp)
+{
+	const perfmgr_hist_slot_t *p_slot;
+	uint32_t slot, count;
+	time_t t;
+	char buf[32];
+
+	fprintf(fp, "# %u ports, %u samples per port\n", p_hdr->num_slots,
+		p_hdr->depth);
+	for (slot = 0; slot < p_hdr->num_slots; slot++) {
+		p_slot = hist_slot(p_hdr, slot);
+		if (!p_slot->guid)
+			break;
+		count = p_slot->count;
+		t = p_slot->last_time;
+		strftime(buf, sizeof(buf), "%F %T", localtime(&t));
+		fprintf(fp, "\"%.*s\" 0x%016" PRIx64 " port %u: %u samples, "
+			"last %s\n", PERFMGR_HIST_NAME_SIZE,
+			p_slot->node_name, p_slot->guid, p_slot->port,
+			count < p_hdr->depth ? count : p_hdr->depth, buf);
+	}
+}
+
+static void print_rate(FILE * fp, uint64_t val, uint64_t interval, int data)
+{
+	static const char *unit[] = { "", "K", "M", "G", "T", "P", "E" };
+	double rate = interval ? (double)val / interval : 0.0;
+	char buf[32];
+	int ui = 0;
+
+	if (data)
+		rate *= 4;
+	while (rate >= 1024 && ui < 6) {
+		rate /= 1024;
+		ui++;
+	}
+	snprintf(buf, sizeof(buf), "%.3f%s%s", rate, unit[ui],
+		 data ? "B/s" : "/s");
+	fprintf(fp, " %13s", buf);
+}
+
+static void print_errors(FILE * fp, const uint64_t * err)
+{
+	unsigned col;
+
+	for (col = 0; col < PERFMGR_HIST_ERR_COLS; col++)
+		if (err[col])
+			fprintf(fp, " %s %" PRIu64, err_col_str[col], err[col]);
+	fprintf(fp, "\n");
+}
+
+static void print_port(const perfmgr_hist_hdr_t * p_hdr, FILE * fp,
+		       const perfmgr_hist_slot_t * p_slot,
+		       const perfmgr_hist_sample_t * samples, uint32_t n,
+		       boolean_t summary)
+{
+	uint64_t data[PERFMGR_HIST_DATA_COLS] = { 0 };
+	uint64_t err[PERFMGR_HIST_ERR_COLS] = { 0 };
+	uint64_t interval = 0, sample_err[PERFMGR_HIST_ERR_COLS];
+	char buf[32], buf2[32];
+	time_t t;
+	uint32_t i;
+	unsigned col;
+
+	fprintf(fp, "\"%.*s\" 0x%016" PRIx64 " port %u:", PERFMGR_HIST_NAME_SIZE,
+		p_slot->node_name, p_slot->guid, p_slot->port);
+	if (!n) {
+		fprintf(fp, " no samples\n");
+		return;
+	}
+	t = samples[0].time;
+	strftime(buf, sizeof(buf), "%F %T", localtime(&t));
+	t = samples[n - 1].time;
+	strftime(buf2, sizeof(buf2), "%F %T", localtime(&t));
+	fprintf(fp, " %u samples from %s to %s\n", n, buf, buf2);
+
+	if (!summary)
+		fprintf(fp, "     time    intvl     xmit_data      rcv_data"
+			"     xmit_pkts      rcv_pkts  errors\n");
+	for (i = 0; i < n; i++) {
+		/* the first reading of a port only serves as a base */
+		if (!samples[i].interval)
+			continue;
+		interval += samples[i].interval;
+		for (col = 0; col < PERFMGR_HIST_DATA_COLS; col++)
+			data[col] += samples[i].data[col];
+		for (col = 0; col < PERFMGR_HIST_ERR_COLS; col++) {
+			sample_err[col] = samples[i].err[col];
+			err[col] += samples[i].err[col];
+		}
+		if (summary)
+			continue;
+		t = samples[i].time;
+		strftime(buf, sizeof(buf), "%T", localtime(&t));
+		fprintf(fp, "  %s %7u", buf, samples[i].interval);
+		for (col = 0; col < PERFMGR_HIST_DATA_COLS; col++)
+			print_rate(fp, samples[i].data[col],
+				   samples[i].interval,
+				   col <= PERFMGR_HIST_RCV_DATA);
+		print_errors(fp, sample_err);
+	}
+
+	fprintf(fp, "  average  %7" PRIu64, interval);
+	for (col = 0; col < PERFMGR_HIST_DATA_COLS; col++)
+		print_rate(fp, data[col], interval,
+			   col <= PERFMGR_HIST_RCV_DATA);
+	print_errors(fp, err);
+}
+
+int perfmgr_hist_print(IN const perfmgr_hist_hdr_t * p_hdr, IN FILE * fp,
+		       IN const char *node, IN const char *port,
+		       IN time_t since, IN boolean_t summary)
+{
+	const perfmgr_hist_slot_t *p_slot;
+	perfmgr_hist_sample_t *samples;
+	perfmgr_hist_slot_t copy;
+	uint64_t guid;
+	char *end = NULL;
+	int port_num = -1, printed = 0;
+	boolean_t by_guid;
+	uint32_t slot, n;
+
+	guid = strtoull(node, &end, 0);
+	by_guid = *node && *end == '\0';
+
+	if (port) {
+		port_num = strtoul(port, &end, 0);
+		if (!*port || *end || port_num > 255) {
+			fprintf(fp, "Warning: \"%s\" is not a valid port\n",
+				port);
+			return 0;
+		}
+	}
+
+	samples = malloc(p_hdr->depth * sizeof(*samples));
+	if (!samples) {
+		fprintf(fp, "Cannot allocate %u samples\n", p_hdr->depth);
+		return 0;
+	}
+
+	for (slot = 0; slot < p_hdr->num_slots; slot++) {
+		p_slot = hist_slot(p_hdr, slot);
+		if (!p_slot->guid)
+			break;
+		if ((by_guid && p_slot->guid != guid) ||
+		    (!by_guid && strncmp(p_slot->node_name, node,
+					 PERFMGR_HIST_NAME_SIZE)) ||
+		    (port_num >= 0 && p_slot->port != port_num))
+			continue;
+		n = read_slot(p_hdr, slot, &copy, samples, since);
+		/* the slot may have been reused while it was read */
+		if ((by_guid && copy.guid != guid) ||
+		    (!by_guid && strncmp(copy.node_name, node,
+					 PERFMGR_HIST_NAME_SIZE)) ||
+		    (port_num >= 0 && copy.port != port_num))
+			continue;
+		print_port(p_hdr, fp, &copy, samples, n, summary);
+		printed++;
+	}
+
+	free(samples);
+	if (!printed)
+		fprintf(fp, "No history for %s%s%s\n", node,
+			port ? " port " : "", port ? port : "");
+	return printed;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2004-2009 Voltaire, Inc. All rights reserved.
+ * Copyright (c) 2002-2006 Mellanox Technologies LTD. All rights reserved.
+ * Copyright (c) 1996-2003 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *    osmperfhist - prints the port rates kept in the PerfMgr history
+ *    file written by OpenSM when the perfmgr_history_file option is set.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <opensm/osm_perfmgr_hist.h>
+
+static void show_usage(const char *prog)
+{
+	printf("Usage: %s [-s <seconds> | -a] [-S] <history file> "
+	       "[<nodename|nodeguid> [<port>]]\n"
+	       "  -s <seconds>  print the samples of the last <seconds> "
+	       "(default 3600)\n"
+	       "  -a            print all the samples kept\n"
+	       "  -S            print only the averages and error totals\n"
+	       "Without a node, list the ports held in the file.\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *file, *reason;
+	time_t since = time(NULL) - 3600;
+	boolean_t summary = FALSE;
+	int fd, ch, rc = 0;
+	struct stat st;
+	void *map;
+
+	while ((ch = getopt(argc, argv, "s:aSh")) != -1) {
+		switch (ch) {
+		case 's':
+			since = time(NULL) - strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			since = 0;
+			break;
+		case 'S':
+			summary = TRUE;
+			break;
+		default:
+			show_usage(argv[0]);
+			return ch == 'h' ? 0 : 1;
+		}
+	}
+	if (optind >= argc || argc - optind > 3) {
+		show_usage(argv[0]);
+		return 1;
+	}
+	file = argv[optind];
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "cannot open %s: %s\n", file, strerror(errno));
+		return 1;
+	}
+	if ((size_t) st.st_size < sizeof(perfmgr_hist_hdr_t)) {
+		fprintf(stderr, "%s: file too short\n", file);
+		return 1;
+	}
+
+	/* OpenSM keeps writing while we read, see perfmgr_hist_print */
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "cannot map %s: %s\n", file, strerror(errno));
+		return 1;
+	}
+
+	reason = perfmgr_hist_check(map, st.st_size);
+	if (reason) {
+		fprintf(stderr, "%s: %s\n", file, reason);
+		return 1;
+	}
+
+	if (optind + 1 == argc)
+		perfmgr_hist_list(map, stdout);
+	else if (!perfmgr_hist_print(map, stdout, argv[optind + 1],
+				     optind + 2 < argc ? argv[optind + 2] :
+				     NULL, since, summary))
+		rc = 1;
+
+	munmap(map, st.st_size);
+	close(fd);
+	return rc;
+}
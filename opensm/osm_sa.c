@@ -97,6 +97,8 @@ void osm_sa_construct(IN osm_sa_t * p_sa)
 	p_sa->sa_trans_id = OSM_SA_INITIAL_TID_VALUE;
 
 	cl_timer_construct(&p_sa->sr_timer);
+	cl_spinlock_construct(&p_sa->pr_cache.lock);
+	cl_spinlock_construct(&p_sa->snapshot_lock);
 }
 
 void osm_sa_shutdown(IN osm_sa_t * p_sa)
@@ -141,13 +143,59 @@ void osm_sa_destroy(IN osm_sa_t * p_sa)
 
 	cl_timer_destroy(&p_sa->sr_timer);
 
+	cl_spinlock_destroy(&p_sa->pr_cache.lock);
+	free(p_sa->pr_cache.entries);
+	p_sa->pr_cache.entries = NULL;
+	p_sa->pr_cache.size = 0;
+
+	osm_sa_path_table_destroy(p_sa);
+
+	if (p_sa->snapshot)
+		osm_sa_snapshot_put(p_sa->snapshot);
+	p_sa->snapshot = NULL;
+	cl_spinlock_destroy(&p_sa->snapshot_lock);
+
 	OSM_LOG_EXIT(p_sa->p_log);
 }
 
+static ib_api_status_t sa_pr_cache_init(IN osm_sa_t * p_sa)
+{
+	osm_sa_pr_cache_t *c = &p_sa->pr_cache;
+	uint32_t size = p_sa->p_subn->opt.sa_pr_cache_size;
+
+	if (cl_spinlock_init(&c->lock) != CL_SUCCESS)
+		return IB_ERROR;
+
+	c->epoch = 1;
+	if (!size)
+		return IB_SUCCESS;
+
+	for (c->size = 1; c->size < size && c->size < 0x80000000;
+	     c->size <<= 1) ;
+	c->entries = calloc(c->size, sizeof(*c->entries));
+	if (!c->entries) {
+		OSM_LOG(p_sa->p_log, OSM_LOG_ERROR, "ERR 4C21: "
+			"cannot allocate PathRecord cache of %u entries, "
+			"cache disabled\n", c->size);
+		c->size = 0;
+	}
+	return IB_SUCCESS;
+}
+
+void osm_sa_pr_cache_invalidate(IN osm_sa_t * p_sa)
+{
+	osm_sa_pr_cache_t *c = &p_sa->pr_cache;
+
+	cl_spinlock_acquire(&c->lock);
+	c->epoch++;
+	cl_spinlock_release(&c->lock);
+}
+
 ib_api_status_t osm_sa_init(IN osm_sm_t * p_sm, IN osm_sa_t * p_sa,
 			    IN osm_subn_t * p_subn, IN osm_vendor_t * p_vendor,
 			    IN osm_mad_pool_t * p_mad_pool,
 			    IN osm_log_t * p_log, IN osm_stats_t * p_stats,
+			    IN osm_trace_t * p_trace,
 			    IN cl_dispatcher_t * p_disp, IN cl_plock_t * p_lock)
 {
 	ib_api_status_t status;
@@ -166,7 +214,7 @@ ib_api_status_t osm_sa_init(IN osm_sm_t * p_sm, IN osm_sa_t * p_sa,
 
 	status = osm_sa_mad_ctrl_init(&p_sa->mad_ctrl, p_sa, p_sa->p_mad_pool,
 				      p_sa->p_vendor, p_subn, p_log, p_stats,
-				      p_disp);
+				      p_trace, p_disp);
 	if (status != IB_SUCCESS)
 		goto Exit;
 
@@ -174,6 +222,14 @@ ib_api_status_t osm_sa_init(IN osm_sm_t * p_sm, IN osm_sa_t * p_sa,
 	if (status != IB_SUCCESS)
 		goto Exit;
 
+	status = sa_pr_cache_init(p_sa);
+	if (status != IB_SUCCESS)
+		goto Exit;
+
+	status = cl_spinlock_init(&p_sa->snapshot_lock);
+	if (status != IB_SUCCESS)
+		goto Exit;
+
 	status = IB_INSUFFICIENT_RESOURCES;
 	p_sa->cpi_disp_h = cl_disp_register(p_disp, OSM_MSG_MAD_CLASS_PORT_INFO,
 					    osm_cpi_rcv_process, p_sa);
@@ -273,6 +329,28 @@ ib_api_status_t osm_sa_init(IN osm_sm_t * p_sm, IN osm_sa_t * p_sa,
 	if (p_sa->mft_disp_h == CL_DISP_INVALID_HANDLE)
 		goto Exit;
 
+	/* SA queries must not hold up the SM's own MADs */
+	cl_disp_set_priority(p_sa->cpi_disp_h, CL_DISP_PRIO_LOW);
+	cl_disp_set_priority(p_sa->nr_disp_h, CL_DISP_PRIO_LOW);
+	cl_disp_set_priority(p_sa->pir_disp_h, CL_DISP_PRIO_LOW);
+	cl_disp_set_priority(p_sa->gir_disp_h, CL_DISP_PRIO_LOW);
+	cl_disp_set_priority(p_sa->lr_disp_h, CL_DISP_PRIO_LOW);
+	cl_disp_set_priority(p_sa->pr_disp_h, CL_DISP_PRIO_LOW);
+#if defined (VENDOR_RMPP_SUPPORT) && defined (DUAL_SIDED_RMPP)
+	cl_disp_set_priority(p_sa->mpr_disp_h, CL_DISP_PRIO_LOW);
+#endif
+	cl_disp_set_priority(p_sa->smir_disp_h, CL_DISP_PRIO_LOW);
+	cl_disp_set_priority(p_sa->mcmr_disp_h, CL_DISP_PRIO_LOW);
+	cl_disp_set_priority(p_sa->sr_disp_h, CL_DISP_PRIO_LOW);
+	cl_disp_set_priority(p_sa->infr_disp_h, CL_DISP_PRIO_LOW);
+	cl_disp_set_priority(p_sa->infir_disp_h, CL_DISP_PRIO_LOW);
+	cl_disp_set_priority(p_sa->vlarb_disp_h, CL_DISP_PRIO_LOW);
+	cl_disp_set_priority(p_sa->slvl_disp_h, CL_DISP_PRIO_LOW);
+	cl_disp_set_priority(p_sa->pkey_disp_h, CL_DISP_PRIO_LOW);
+	cl_disp_set_priority(p_sa->lft_disp_h, CL_DISP_PRIO_LOW);
+	cl_disp_set_priority(p_sa->sir_disp_h, CL_DISP_PRIO_LOW);
+	cl_disp_set_priority(p_sa->mft_disp_h, CL_DISP_PRIO_LOW);
+
 	status = IB_SUCCESS;
 Exit:
 	OSM_LOG_EXIT(p_log);
@@ -376,24 +454,22 @@ Exit:
 	OSM_LOG_EXIT(sa->p_log);
 }
 
-void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
-		    cl_qlist_t *list)
+/*
+ * Validates the record count against the request method, allocates the
+ * response MAD and fills in its header. Returns NULL (after having sent
+ * an error response if needed) when no records are to be copied.
+ */
+static osm_madw_t *sa_respond_prepare(osm_sa_t * sa, osm_madw_t * madw,
+				      size_t attr_size, unsigned *p_num_rec)
 {
-	struct item_data {
-		cl_list_item_t list;
-		char data[0];
-	};
-	cl_list_item_t *item;
 	osm_madw_t *resp_madw;
 	ib_sa_mad_t *sa_mad, *resp_sa_mad;
-	unsigned num_rec, i;
+	unsigned num_rec = *p_num_rec;
 #ifndef VENDOR_RMPP_SUPPORT
 	unsigned trim_num_rec;
 #endif
-	unsigned char *p;
 
 	sa_mad = osm_madw_get_sa_mad_ptr(madw);
-	num_rec = cl_qlist_count(list);
 
 	/*
 	 * C15-0.1.30:
@@ -405,7 +481,7 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 			num_rec, ib_get_sa_attr_str(sa_mad->attr_id),
 			cl_ntoh64(sa_mad->comp_mask));
 		osm_sa_send_error(sa, madw, IB_SA_MAD_STATUS_TOO_MANY_RECORDS);
-		goto Exit;
+		return NULL;
 	}
 
 #ifndef VENDOR_RMPP_SUPPORT
@@ -422,7 +498,7 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 
 	if (sa_mad->method == IB_MAD_METHOD_GET && num_rec == 0) {
 		osm_sa_send_error(sa, madw, IB_SA_MAD_STATUS_NO_RECORDS);
-		goto Exit;
+		return NULL;
 	}
 
 	/*
@@ -435,7 +511,7 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 4C06: "
 			"osm_mad_pool_get failed\n");
 		osm_sa_send_error(sa, madw, IB_SA_MAD_STATUS_NO_RESOURCES);
-		goto Exit;
+		return NULL;
 	}
 
 	resp_sa_mad = osm_madw_get_sa_mad_ptr(resp_madw);
@@ -443,7 +519,7 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 	/*
 	   Copy the MAD header back into the response mad.
 	   Set the 'R' bit and the payload length,
-	   Then copy all records from the list into the response payload.
+	   The caller then copies the records into the response payload.
 	 */
 
 	memcpy(resp_sa_mad, sa_mad, IB_SA_MAD_HDR_SIZE);
@@ -456,8 +532,6 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 	/* Fill in the offset (paylen will be done by the rmpp SAR) */
 	resp_sa_mad->attr_offset = num_rec ? ib_get_attr_offset(attr_size) : 0;
 
-	p = ib_sa_mad_get_payload_ptr(resp_sa_mad);
-
 #ifndef VENDOR_RMPP_SUPPORT
 	/* we support only one packet RMPP - so we will set the first and
 	   last flags for gettable */
@@ -473,6 +547,35 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 		resp_sa_mad->rmpp_flags = IB_RMPP_FLAG_ACTIVE;
 #endif
 
+	*p_num_rec = num_rec;
+	return resp_madw;
+}
+
+static void sa_respond_send(osm_sa_t * sa, osm_madw_t * resp_madw)
+{
+	osm_dump_sa_mad(sa->p_log, osm_madw_get_sa_mad_ptr(resp_madw),
+			OSM_LOG_FRAMES);
+	osm_sa_send(sa, resp_madw, FALSE);
+}
+
+void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
+		    cl_qlist_t *list)
+{
+	struct item_data {
+		cl_list_item_t list;
+		char data[0];
+	};
+	cl_list_item_t *item;
+	osm_madw_t *resp_madw;
+	unsigned num_rec, i;
+	unsigned char *p;
+
+	num_rec = cl_qlist_count(list);
+	resp_madw = sa_respond_prepare(sa, madw, attr_size, &num_rec);
+	if (!resp_madw)
+		goto Exit;
+
+	p = ib_sa_mad_get_payload_ptr(osm_madw_get_sa_mad_ptr(resp_madw));
 	for (i = 0; i < num_rec; i++) {
 		item = cl_qlist_remove_head(list);
 		memcpy(p, ((struct item_data *)item)->data, attr_size);
@@ -480,8 +583,7 @@ void osm_sa_respond(osm_sa_t *sa, osm_madw_t *madw, size_t attr_size,
 		free(item);
 	}
 
-	osm_dump_sa_mad(sa->p_log, resp_sa_mad, OSM_LOG_FRAMES);
-	osm_sa_send(sa, resp_madw, FALSE);
+	sa_respond_send(sa, resp_madw);
 
 Exit:
 	/* need to set the mem free ... */
@@ -492,6 +594,64 @@ Exit:
 	}
 }
 
+void osm_sa_recs_init(osm_sa_recs_t * recs, size_t attr_size)
+{
+	recs->attr_size = attr_size;
+	recs->num_rec = 0;
+	recs->max_rec = 0;
+	recs->buf = NULL;
+}
+
+void *osm_sa_recs_add(osm_sa_recs_t * recs)
+{
+	uint8_t *rec;
+
+	if (recs->num_rec == recs->max_rec) {
+		unsigned max_rec;
+		uint8_t *buf;
+
+		/* start with what fits into a single MAD and double from there */
+		max_rec = recs->max_rec ? recs->max_rec * 2 :
+		    (MAD_BLOCK_SIZE - IB_SA_MAD_HDR_SIZE) / recs->attr_size;
+		if (max_rec == 0)
+			max_rec = 1;
+		buf = realloc(recs->buf, (size_t) max_rec * recs->attr_size);
+		if (!buf)
+			return NULL;
+		recs->buf = buf;
+		recs->max_rec = max_rec;
+	}
+
+	rec = recs->buf + (size_t) recs->num_rec++ * recs->attr_size;
+	memset(rec, 0, recs->attr_size);
+	return rec;
+}
+
+void osm_sa_recs_destroy(osm_sa_recs_t * recs)
+{
+	free(recs->buf);
+	osm_sa_recs_init(recs, recs->attr_size);
+}
+
+void osm_sa_respond_recs(osm_sa_t * sa, osm_madw_t * madw,
+			 osm_sa_recs_t * recs)
+{
+	osm_madw_t *resp_madw;
+	unsigned num_rec;
+
+	num_rec = recs->num_rec;
+	resp_madw = sa_respond_prepare(sa, madw, recs->attr_size, &num_rec);
+	if (resp_madw) {
+		if (num_rec)
+			memcpy(ib_sa_mad_get_payload_ptr
+			       (osm_madw_get_sa_mad_ptr(resp_madw)), recs->buf,
+			       (size_t) num_rec * recs->attr_size);
+		sa_respond_send(sa, resp_madw);
+	}
+
+	osm_sa_recs_destroy(recs);
+}
+
 /*
  *  SA DB Dumper
  *
@@ -57,34 +57,29 @@
 #include <opensm/osm_pkey.h>
 #include <opensm/osm_sa.h>
 
-typedef struct osm_gir_item {
-	cl_list_item_t list_item;
-	ib_guidinfo_record_t rec;
-} osm_gir_item_t;
-
 typedef struct osm_gir_search_ctxt {
 	const ib_guidinfo_record_t *p_rcvd_rec;
 	ib_net64_t comp_mask;
-	cl_qlist_t *p_list;
+	osm_sa_recs_t *p_recs;
 	osm_sa_t *sa;
 	const osm_physp_t *p_req_physp;
 } osm_gir_search_ctxt_t;
 
 static ib_api_status_t gir_rcv_new_gir(IN osm_sa_t * sa,
 				       IN const osm_node_t * p_node,
-				       IN cl_qlist_t * p_list,
+				       IN osm_sa_recs_t * p_recs,
 				       IN ib_net64_t const match_port_guid,
 				       IN ib_net16_t const match_lid,
 				       IN const osm_physp_t * p_req_physp,
 				       IN uint8_t const block_num)
 {
-	osm_gir_item_t *p_rec_item;
+	ib_guidinfo_record_t *p_rec;
 	ib_api_status_t status = IB_SUCCESS;
 
 	OSM_LOG_ENTER(sa->p_log);
 
-	p_rec_item = malloc(sizeof(*p_rec_item));
-	if (p_rec_item == NULL) {
+	p_rec = osm_sa_recs_add(p_recs);
+	if (p_rec == NULL) {
 		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 5102: "
 			"rec_item alloc failed\n");
 		status = IB_INSUFFICIENT_RESOURCES;
@@ -95,23 +90,19 @@ static ib_api_status_t gir_rcv_new_gir(IN osm_sa_t * sa,
 		"New GUIDInfoRecord: lid %u, block num %d\n",
 		cl_ntoh16(match_lid), block_num);
 
-	memset(p_rec_item, 0, sizeof(*p_rec_item));
-
-	p_rec_item->rec.lid = match_lid;
-	p_rec_item->rec.block_num = block_num;
+	p_rec->lid = match_lid;
+	p_rec->block_num = block_num;
 	if (!block_num)
-		p_rec_item->rec.guid_info.guid[0] =
+		p_rec->guid_info.guid[0] =
 		    osm_physp_get_port_guid(p_req_physp);
 
-	cl_qlist_insert_tail(p_list, &p_rec_item->list_item);
-
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
 	return status;
 }
 
 static void sa_gir_create_gir(IN osm_sa_t * sa, IN osm_node_t * p_node,
-			      IN cl_qlist_t * p_list,
+			      IN osm_sa_recs_t * p_recs,
 			      IN ib_net64_t const match_port_guid,
 			      IN ib_net16_t const match_lid,
 			      IN const osm_physp_t * p_req_physp,
@@ -199,7 +190,7 @@ static void sa_gir_create_gir(IN osm_sa_t * sa, IN osm_node_t * p_node,
 
 		for (block_num = start_block_num; block_num <= end_block_num;
 		     block_num++)
-			gir_rcv_new_gir(sa, p_node, p_list, port_guid,
+			gir_rcv_new_gir(sa, p_node, p_recs, port_guid,
 					cl_ntoh16(base_lid_ho), p_physp,
 					block_num);
 	}
@@ -272,7 +263,7 @@ static void sa_gir_by_comp_mask_cb(IN cl_map_item_t * p_map_item, IN void *cxt)
 			goto Exit;
 	}
 
-	sa_gir_create_gir(sa, p_node, p_ctxt->p_list, match_port_guid,
+	sa_gir_create_gir(sa, p_node, p_ctxt->p_recs, match_port_guid,
 			  match_lid, p_req_physp, match_block_num);
 
 Exit:
@@ -285,7 +276,7 @@ void osm_gir_rcv_process(IN void *ctx, IN void *data)
 	osm_madw_t *p_madw = data;
 	const ib_sa_mad_t *p_rcvd_mad;
 	const ib_guidinfo_record_t *p_rcvd_rec;
-	cl_qlist_t rec_list;
+	osm_sa_recs_t recs;
 	osm_gir_search_ctxt_t context;
 	osm_physp_t *p_req_physp;
 
@@ -324,10 +315,10 @@ void osm_gir_rcv_process(IN void *ctx, IN void *data)
 	if (osm_log_is_active(sa->p_log, OSM_LOG_DEBUG))
 		osm_dump_guidinfo_record(sa->p_log, p_rcvd_rec, OSM_LOG_DEBUG);
 
-	cl_qlist_init(&rec_list);
+	osm_sa_recs_init(&recs, sizeof(ib_guidinfo_record_t));
 
 	context.p_rcvd_rec = p_rcvd_rec;
-	context.p_list = &rec_list;
+	context.p_recs = &recs;
 	context.comp_mask = p_rcvd_mad->comp_mask;
 	context.sa = sa;
 	context.p_req_physp = p_req_physp;
@@ -339,7 +330,7 @@ void osm_gir_rcv_process(IN void *ctx, IN void *data)
 
 	cl_plock_release(sa->p_lock);
 
-	osm_sa_respond(sa, p_madw, sizeof(ib_guidinfo_record_t), &rec_list);
+	osm_sa_respond_recs(sa, p_madw, &recs);
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
@@ -54,31 +54,30 @@
 #include <opensm/osm_pkey.h>
 #include <opensm/osm_sa.h>
 
-typedef struct osm_lftr_item {
-	cl_list_item_t list_item;
-	ib_lft_record_t rec;
-} osm_lftr_item_t;
-
 typedef struct osm_lftr_search_ctxt {
 	const ib_lft_record_t *p_rcvd_rec;
 	ib_net64_t comp_mask;
-	cl_qlist_t *p_list;
+	osm_sa_recs_t *p_recs;
 	osm_sa_t *sa;
 	const osm_physp_t *p_req_physp;
+	const osm_sa_snapshot_t *p_snap;
+	const osm_sa_snapshot_port_t *p_req_port;
 } osm_lftr_search_ctxt_t;
 
 static ib_api_status_t lftr_rcv_new_lftr(IN osm_sa_t * sa,
-					 IN const osm_switch_t * p_sw,
-					 IN cl_qlist_t * p_list,
+					 IN ib_net64_t node_guid,
+					 IN const uint8_t * lft,
+					 IN uint16_t max_lid_ho,
+					 IN osm_sa_recs_t * p_recs,
 					 IN ib_net16_t lid, IN uint16_t block)
 {
-	osm_lftr_item_t *p_rec_item;
+	ib_lft_record_t *p_rec;
 	ib_api_status_t status = IB_SUCCESS;
 
 	OSM_LOG_ENTER(sa->p_log);
 
-	p_rec_item = malloc(sizeof(*p_rec_item));
-	if (p_rec_item == NULL) {
+	p_rec = osm_sa_recs_add(p_recs);
+	if (p_rec == NULL) {
 		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 4402: "
 			"rec_item alloc failed\n");
 		status = IB_INSUFFICIENT_RESOURCES;
@@ -88,18 +87,15 @@ static ib_api_status_t lftr_rcv_new_lftr(IN osm_sa_t * sa,
 	OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
 		"New LinearForwardingTable: sw 0x%016" PRIx64
 		"\n\t\t\t\tblock 0x%02X lid %u\n",
-		cl_ntoh64(osm_node_get_node_guid(p_sw->p_node)),
-		block, cl_ntoh16(lid));
-
-	memset(p_rec_item, 0, sizeof(*p_rec_item));
+		cl_ntoh64(node_guid), block, cl_ntoh16(lid));
 
-	p_rec_item->rec.lid = lid;
-	p_rec_item->rec.block_num = cl_hton16(block);
+	p_rec->lid = lid;
+	p_rec->block_num = cl_hton16(block);
 
 	/* copy the lft block */
-	osm_switch_get_lft_block(p_sw, block, p_rec_item->rec.lft);
-
-	cl_qlist_insert_tail(p_list, &p_rec_item->list_item);
+	if (block * IB_SMP_DATA_SIZE <= max_lid_ho)
+		memcpy(p_rec->lft, lft + block * IB_SMP_DATA_SIZE,
+		       IB_SMP_DATA_SIZE);
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
@@ -168,19 +164,65 @@ static void lftr_rcv_by_comp_mask(IN cl_map_item_t * p_map_item, IN void *cxt)
 
 	/* so we can add these blocks one by one ... */
 	for (block = min_block; block <= max_block; block++)
-		lftr_rcv_new_lftr(sa, p_sw, p_ctxt->p_list,
+		lftr_rcv_new_lftr(sa, osm_node_get_node_guid(p_sw->p_node),
+				  p_sw->lft, p_sw->max_lid_ho, p_ctxt->p_recs,
 				  osm_port_get_base_lid(p_port), block);
 }
 
+/*
+ * Same as lftr_rcv_by_comp_mask() for a switch of the subnet snapshot.
+ */
+static void lftr_rcv_snap_by_comp_mask(IN const osm_lftr_search_ctxt_t *
+				       p_ctxt,
+				       IN const osm_sa_snapshot_switch_t * p_sw)
+{
+	const osm_sa_snapshot_t *p_snap = p_ctxt->p_snap;
+	const osm_sa_snapshot_node_t *p_node = &p_snap->nodes[p_sw->node];
+	const osm_sa_snapshot_port_t *p_port = &p_snap->ports[p_node->ports];
+	const ib_lft_record_t *const p_rcvd_rec = p_ctxt->p_rcvd_rec;
+	ib_net64_t const comp_mask = p_ctxt->comp_mask;
+	uint16_t min_lid_ho, max_lid_ho;
+	uint16_t min_block, max_block, block;
+
+	if (!p_port->valid ||
+	    !osm_sa_snapshot_share_pkey(p_snap, p_ctxt->p_req_port, p_port))
+		return;
+
+	min_lid_ho = cl_ntoh16(p_port->base_lid);
+	max_lid_ho = (uint16_t) (min_lid_ho + (1 << p_port->lmc) - 1);
+
+	if ((comp_mask & IB_LFTR_COMPMASK_LID) &&
+	    (min_lid_ho > cl_ntoh16(p_rcvd_rec->lid) ||
+	     max_lid_ho < cl_ntoh16(p_rcvd_rec->lid)))
+		return;
+
+	max_block = p_sw->max_block;
+	if (comp_mask & IB_LFTR_COMPMASK_BLOCK) {
+		min_block = cl_ntoh16(p_rcvd_rec->block_num);
+		if (min_block > max_block)
+			return;
+		max_block = min_block;
+	} else
+		min_block = 0;
+
+	for (block = min_block; block <= max_block; block++)
+		lftr_rcv_new_lftr(p_ctxt->sa, p_node->node_info.node_guid,
+				  p_snap->lfts + p_sw->lft, p_sw->max_lid_ho,
+				  p_ctxt->p_recs, p_port->base_lid, block);
+}
+
 void osm_lftr_rcv_process(IN void *ctx, IN void *data)
 {
 	osm_sa_t *sa = ctx;
 	osm_madw_t *p_madw = data;
 	const ib_sa_mad_t *p_rcvd_mad;
 	const ib_lft_record_t *p_rcvd_rec;
-	cl_qlist_t rec_list;
+	osm_sa_recs_t recs;
 	osm_lftr_search_ctxt_t context;
-	osm_physp_t *p_req_physp;
+	osm_physp_t *p_req_physp = NULL;
+	osm_sa_snapshot_t *p_snap = NULL;
+	const osm_sa_snapshot_port_t *p_req_port = NULL;
+	uint32_t i;
 
 	CL_ASSERT(sa);
 
@@ -203,34 +245,51 @@ void osm_lftr_rcv_process(IN void *ctx, IN void *data)
 		goto Exit;
 	}
 
+	/* use the subnet snapshot if there is one */
+	p_snap = osm_sa_snapshot_get(sa);
+
 	/* update the requester physical port. */
-	p_req_physp = osm_get_physp_by_mad_addr(sa->p_log, sa->p_subn,
-						osm_madw_get_mad_addr_ptr
-						(p_madw));
-	if (p_req_physp == NULL) {
+	if (p_snap)
+		p_req_port = osm_sa_snapshot_get_port_by_lid(p_snap,
+							     osm_madw_get_mad_addr_ptr
+							     (p_madw)->dest_lid);
+	else
+		p_req_physp = osm_get_physp_by_mad_addr(sa->p_log, sa->p_subn,
+							osm_madw_get_mad_addr_ptr
+							(p_madw));
+	if (p_req_physp == NULL && p_req_port == NULL) {
 		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 4407: "
 			"Cannot find requester physical port\n");
 		goto Exit;
 	}
 
-	cl_qlist_init(&rec_list);
+	osm_sa_recs_init(&recs, sizeof(ib_lft_record_t));
 
 	context.p_rcvd_rec = p_rcvd_rec;
-	context.p_list = &rec_list;
+	context.p_recs = &recs;
 	context.comp_mask = p_rcvd_mad->comp_mask;
 	context.sa = sa;
 	context.p_req_physp = p_req_physp;
-
-	cl_plock_acquire(sa->p_lock);
+	context.p_snap = p_snap;
+	context.p_req_port = p_req_port;
 
 	/* Go over all switches */
-	cl_qmap_apply_func(&sa->p_subn->sw_guid_tbl, lftr_rcv_by_comp_mask,
-			   &context);
+	if (p_snap)
+		for (i = 0; i < p_snap->num_sws; i++)
+			lftr_rcv_snap_by_comp_mask(&context, &p_snap->sws[i]);
+	else {
+		cl_plock_acquire(sa->p_lock);
+
+		cl_qmap_apply_func(&sa->p_subn->sw_guid_tbl,
+				   lftr_rcv_by_comp_mask, &context);
 
-	cl_plock_release(sa->p_lock);
+		cl_plock_release(sa->p_lock);
+	}
 
-	osm_sa_respond(sa, p_madw, sizeof(ib_lft_record_t), &rec_list);
+	osm_sa_respond_recs(sa, p_madw, &recs);
 
 Exit:
+	if (p_snap)
+		osm_sa_snapshot_put(p_snap);
 	OSM_LOG_EXIT(sa->p_log);
 }
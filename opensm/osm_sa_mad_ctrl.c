@@ -292,6 +292,10 @@ static void sa_mad_ctrl_rcv_callback(IN osm_madw_t * p_madw, IN void *context,
 	OSM_LOG(p_ctrl->p_log, OSM_LOG_DEBUG,
 		"%u SA MADs received\n", p_ctrl->p_stats->sa_mads_rcvd);
 
+	if (osm_trace_is_active(p_ctrl->p_trace))
+		osm_trace_mad(p_ctrl->p_trace,
+			      OSM_TRACE_EVENT_SA_RCV, p_madw, p_req_madw);
+
 	/*
 	 * C15-0.1.3 requires not responding to any MAD if the SM is
 	 * not in active state!
@@ -467,6 +471,7 @@ ib_api_status_t osm_sa_mad_ctrl_init(IN osm_sa_mad_ctrl_t * p_ctrl,
 				     IN osm_subn_t * p_subn,
 				     IN osm_log_t * p_log,
 				     IN osm_stats_t * p_stats,
+				     IN osm_trace_t * p_trace,
 				     IN cl_dispatcher_t * p_disp)
 {
 	ib_api_status_t status = IB_SUCCESS;
@@ -481,6 +486,7 @@ ib_api_status_t osm_sa_mad_ctrl_init(IN osm_sa_mad_ctrl_t * p_ctrl,
 	p_ctrl->p_mad_pool = p_mad_pool;
 	p_ctrl->p_vendor = p_vendor;
 	p_ctrl->p_stats = p_stats;
+	p_ctrl->p_trace = p_trace;
 	p_ctrl->p_subn = p_subn;
 
 	p_ctrl->h_disp = cl_disp_register(p_disp, CL_DISP_MSGID_NONE, NULL,
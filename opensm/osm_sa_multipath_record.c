@@ -147,43 +147,37 @@ sa_multipath_rec_apply_tavor_mtu_limit(IN const ib_multipath_rec_t * p_mpr,
 	return TRUE;
 }
 
-static ib_api_status_t mpr_rcv_get_path_parms(IN osm_sa_t * sa,
-					      IN const ib_multipath_rec_t *
-					      p_mpr,
-					      IN const osm_port_t * p_src_port,
-					      IN const osm_port_t * p_dest_port,
-					      IN const uint16_t dest_lid_ho,
-					      IN const ib_net64_t comp_mask,
-					      OUT osm_path_parms_t * p_parms)
+/*
+ * Walk the route from the source port to dest_lid hop by hop through the
+ * switch LFTs, tracking the most restrictive MTU and rate and, with QoS,
+ * the SLs which are not dropped on the way.
+ */
+static ib_api_status_t mpr_rcv_walk_path(IN osm_sa_t * sa,
+					 IN const osm_port_t * p_src_port,
+					 IN const osm_port_t * p_dest_port,
+					 IN const osm_physp_t * p_dest_physp,
+					 IN const uint16_t dest_lid_ho,
+					 OUT uint8_t * p_mtu,
+					 OUT uint8_t * p_rate,
+					 OUT uint16_t * p_sl_mask,
+					 OUT int *p_hops)
 {
 	const osm_node_t *p_node;
 	const osm_physp_t *p_physp, *p_physp0;
 	const osm_physp_t *p_src_physp;
-	const osm_physp_t *p_dest_physp;
-	const osm_prtn_t *p_prtn = NULL;
 	const ib_port_info_t *p_pi, *p_pi0;
 	ib_slvl_table_t *p_slvl_tbl;
 	ib_api_status_t status = IB_SUCCESS;
 	uint8_t mtu;
 	uint8_t rate;
-	uint8_t pkt_life;
-	uint8_t required_mtu;
-	uint8_t required_rate;
-	ib_net16_t required_pkey;
-	uint8_t required_sl;
-	uint8_t required_pkt_life;
 	ib_net16_t dest_lid;
 	int hops = 0;
 	int in_port_num = 0;
 	uint8_t i;
-	osm_qos_level_t *p_qos_level = NULL;
 	uint16_t valid_sl_mask = 0xffff;
 
-	OSM_LOG_ENTER(sa->p_log);
-
 	dest_lid = cl_hton16(dest_lid_ho);
 
-	p_dest_physp = p_dest_port->p_physp;
 	p_physp = p_src_port->p_physp;
 	p_src_physp = p_physp;
 	p_pi = &p_physp->port_info;
@@ -192,21 +186,6 @@ static ib_api_status_t mpr_rcv_get_path_parms(IN osm_sa_t * sa,
 	rate = ib_port_info_compute_rate(p_pi,
 					 p_pi->capability_mask & IB_PORT_CAP_HAS_EXT_SPEEDS);
 
-	/*
-	   Mellanox Tavor device performance is better using 1K MTU.
-	   If required MTU and MTU selector are such that 1K is OK
-	   and at least one end of the path is Tavor we override the
-	   port MTU with 1K.
-	 */
-	if (sa->p_subn->opt.enable_quirks &&
-	    sa_multipath_rec_apply_tavor_mtu_limit(p_mpr, p_src_port,
-						   p_dest_port, comp_mask))
-		if (mtu > IB_MTU_LEN_1024) {
-			mtu = IB_MTU_LEN_1024;
-			OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
-				"Optimized Path MTU to 1K for Mellanox Tavor device\n");
-		}
-
 	/*
 	   Walk the subnet object from source to destination,
 	   tracking the most restrictive rate and mtu values along the way...
@@ -257,30 +236,6 @@ static ib_api_status_t mpr_rcv_get_path_parms(IN osm_sa_t * sa,
 		}
 	}
 
-	/*
-	 * Same as above
-	 */
-	p_node = osm_physp_get_node_ptr(p_dest_physp);
-
-	if (p_node->sw) {
-		/*
-		 * if destination is switch, we want p_dest_physp to point to port 0
-		 */
-		p_dest_physp =
-		    osm_switch_get_route_by_lid(p_node->sw, dest_lid);
-
-		if (p_dest_physp == 0) {
-			OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 4515: "
-				"Can't find routing to LID %u on switch %s "
-				"(GUID 0x%016"PRIx64")\n", dest_lid_ho,
-				p_node->print_desc,
-				cl_ntoh64(osm_node_get_node_guid(p_node)));
-			status = IB_NOT_FOUND;
-			goto Exit;
-		}
-
-	}
-
 	/*
 	 * Now go through the path step by step
 	 */
@@ -434,6 +389,99 @@ static ib_api_status_t mpr_rcv_get_path_parms(IN osm_sa_t * sa,
 		rate = ib_port_info_compute_rate(p_pi,
 						 p_pi->capability_mask & IB_PORT_CAP_HAS_EXT_SPEEDS);
 
+	*p_mtu = mtu;
+	*p_rate = rate;
+	*p_sl_mask = valid_sl_mask;
+	*p_hops = hops;
+Exit:
+	return status;
+}
+
+static ib_api_status_t mpr_rcv_get_path_parms(IN osm_sa_t * sa,
+					      IN const ib_multipath_rec_t *
+					      p_mpr,
+					      IN const osm_port_t * p_src_port,
+					      IN const osm_port_t * p_dest_port,
+					      IN const uint16_t dest_lid_ho,
+					      IN const ib_net64_t comp_mask,
+					      OUT osm_path_parms_t * p_parms)
+{
+	const osm_node_t *p_node;
+	const osm_physp_t *p_src_physp;
+	const osm_physp_t *p_dest_physp;
+	const osm_prtn_t *p_prtn = NULL;
+	ib_api_status_t status = IB_SUCCESS;
+	uint8_t mtu;
+	uint8_t rate;
+	uint8_t pkt_life;
+	uint8_t required_mtu;
+	uint8_t required_rate;
+	ib_net16_t required_pkey;
+	uint8_t required_sl;
+	uint8_t required_pkt_life;
+	ib_net16_t dest_lid;
+	int hops = 0;
+	uint8_t i;
+	osm_qos_level_t *p_qos_level = NULL;
+	uint16_t valid_sl_mask = 0xffff;
+
+	OSM_LOG_ENTER(sa->p_log);
+
+	dest_lid = cl_hton16(dest_lid_ho);
+
+	p_dest_physp = p_dest_port->p_physp;
+	p_src_physp = p_src_port->p_physp;
+
+	p_node = osm_physp_get_node_ptr(p_dest_physp);
+
+	if (p_node->sw) {
+		/*
+		 * if destination is switch, we want p_dest_physp to point to port 0
+		 */
+		p_dest_physp =
+		    osm_switch_get_route_by_lid(p_node->sw, dest_lid);
+
+		if (p_dest_physp == 0) {
+			OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 4515: "
+				"Can't find routing to LID %u on switch %s "
+				"(GUID 0x%016"PRIx64")\n", dest_lid_ho,
+				p_node->print_desc,
+				cl_ntoh64(osm_node_get_node_guid(p_node)));
+			status = IB_NOT_FOUND;
+			goto Exit;
+		}
+
+	}
+
+	if (osm_sa_path_table_lookup(sa, p_src_port, p_dest_physp,
+				     dest_lid_ho, &mtu, &rate, &valid_sl_mask,
+				     &hops)) {
+		/* the table counts switches, we count links */
+		if (!p_node->sw && p_src_port != p_dest_port)
+			hops++;
+	} else {
+		status = mpr_rcv_walk_path(sa, p_src_port, p_dest_port,
+					   p_dest_physp, dest_lid_ho, &mtu,
+					   &rate, &valid_sl_mask, &hops);
+		if (status != IB_SUCCESS)
+			goto Exit;
+	}
+
+	/*
+	   Mellanox Tavor device performance is better using 1K MTU.
+	   If required MTU and MTU selector are such that 1K is OK
+	   and at least one end of the path is Tavor we override the
+	   port MTU with 1K.
+	 */
+	if (sa->p_subn->opt.enable_quirks &&
+	    sa_multipath_rec_apply_tavor_mtu_limit(p_mpr, p_src_port,
+						   p_dest_port, comp_mask))
+		if (mtu > IB_MTU_LEN_1024) {
+			mtu = IB_MTU_LEN_1024;
+			OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
+				"Optimized Path MTU to 1K for Mellanox Tavor device\n");
+		}
+
 	OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
 		"Path min MTU = %u, min rate = %u\n", mtu, rate);
 
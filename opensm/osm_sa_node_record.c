@@ -54,32 +54,33 @@
 #include <opensm/osm_pkey.h>
 #include <opensm/osm_sa.h>
 
-typedef struct osm_nr_item {
-	cl_list_item_t list_item;
-	ib_node_record_t rec;
-} osm_nr_item_t;
-
 typedef struct osm_nr_search_ctxt {
 	const ib_node_record_t *p_rcvd_rec;
 	ib_net64_t comp_mask;
-	cl_qlist_t *p_list;
+	osm_sa_recs_t *p_recs;
 	osm_sa_t *sa;
 	const osm_physp_t *p_req_physp;
+	const osm_sa_snapshot_t *p_snap;
+	const osm_sa_snapshot_port_t *p_req_port;
+	ib_net64_t match_port_guid;
+	ib_net16_t match_lid;
+	unsigned int match_port_num;
 } osm_nr_search_ctxt_t;
 
 static ib_api_status_t nr_rcv_new_nr(osm_sa_t * sa,
-				     IN const osm_node_t * p_node,
-				     IN cl_qlist_t * p_list,
+				     IN const ib_node_info_t * p_node_info,
+				     IN const ib_node_desc_t * p_node_desc,
+				     IN osm_sa_recs_t * p_recs,
 				     IN ib_net64_t port_guid, IN ib_net16_t lid,
 	                             IN unsigned int port_num)
 {
-	osm_nr_item_t *p_rec_item;
+	ib_node_record_t *p_rec;
 	ib_api_status_t status = IB_SUCCESS;
 
 	OSM_LOG_ENTER(sa->p_log);
 
-	p_rec_item = malloc(sizeof(*p_rec_item));
-	if (p_rec_item == NULL) {
+	p_rec = osm_sa_recs_add(p_recs);
+	if (p_rec == NULL) {
 		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1D02: "
 			"rec_item alloc failed\n");
 		status = IB_INSUFFICIENT_RESOURCES;
@@ -89,29 +90,66 @@ static ib_api_status_t nr_rcv_new_nr(osm_sa_t * sa,
 	OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
 		"New NodeRecord: node 0x%016" PRIx64
 		"\n\t\t\t\tport 0x%016" PRIx64 ", lid %u\n",
-		cl_ntoh64(osm_node_get_node_guid(p_node)),
+		cl_ntoh64(p_node_info->node_guid),
 		cl_ntoh64(port_guid), cl_ntoh16(lid));
 
-	memset(p_rec_item, 0, sizeof(*p_rec_item));
-
-	p_rec_item->rec.lid = lid;
+	p_rec->lid = lid;
 
-	p_rec_item->rec.node_info = p_node->node_info;
-	p_rec_item->rec.node_info.port_guid = port_guid;
-	p_rec_item->rec.node_info.port_num_vendor_id =
-		(p_rec_item->rec.node_info.port_num_vendor_id & IB_NODE_INFO_VEND_ID_MASK) |
+	p_rec->node_info = *p_node_info;
+	p_rec->node_info.port_guid = port_guid;
+	p_rec->node_info.port_num_vendor_id =
+		(p_rec->node_info.port_num_vendor_id & IB_NODE_INFO_VEND_ID_MASK) |
 		((port_num << IB_NODE_INFO_PORT_NUM_SHIFT) & IB_NODE_INFO_PORT_NUM_MASK);
-	memcpy(&(p_rec_item->rec.node_desc), &(p_node->node_desc),
+	memcpy(&(p_rec->node_desc), p_node_desc,
 	       IB_NODE_DESCRIPTION_SIZE);
-	cl_qlist_insert_tail(p_list, &p_rec_item->list_item);
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
 	return status;
 }
 
+static boolean_t nr_rcv_match_port(IN osm_sa_t * sa,
+				   IN ib_net64_t const match_port_guid,
+				   IN ib_net16_t const match_lid,
+				   IN unsigned int const match_port_num,
+				   IN const ib_net64_t comp_mask,
+				   IN ib_net64_t port_guid,
+				   IN ib_net16_t base_lid, IN uint8_t lmc,
+				   IN unsigned int port_num)
+{
+	uint16_t match_lid_ho;
+	ib_net16_t base_lid_ho;
+	ib_net16_t max_lid_ho;
+
+	if ((comp_mask & IB_NR_COMPMASK_PORTGUID)
+	    && (port_guid != match_port_guid))
+		return FALSE;
+
+	if (comp_mask & IB_NR_COMPMASK_LID) {
+		base_lid_ho = cl_ntoh16(base_lid);
+		max_lid_ho = (uint16_t) (base_lid_ho + (1 << lmc) - 1);
+		match_lid_ho = cl_ntoh16(match_lid);
+
+		/*
+		   We validate that the lid belongs to this node.
+		 */
+		OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
+			"Comparing LID: %u <= %u <= %u\n",
+			base_lid_ho, match_lid_ho, max_lid_ho);
+
+		if (match_lid_ho < base_lid_ho || match_lid_ho > max_lid_ho)
+			return FALSE;
+	}
+
+	if ((comp_mask & IB_NR_COMPMASK_PORTNUM) &&
+	    (port_num != match_port_num))
+		return FALSE;
+
+	return TRUE;
+}
+
 static void nr_rcv_create_nr(IN osm_sa_t * sa, IN osm_node_t * p_node,
-			     IN cl_qlist_t * p_list,
+			     IN osm_sa_recs_t * p_recs,
 			     IN ib_net64_t const match_port_guid,
 			     IN ib_net16_t const match_lid,
 			     IN unsigned int const match_port_num,
@@ -121,11 +159,7 @@ static void nr_rcv_create_nr(IN osm_sa_t * sa, IN osm_node_t * p_node,
 	const osm_physp_t *p_physp;
 	uint8_t port_num;
 	uint8_t num_ports;
-	uint16_t match_lid_ho;
 	ib_net16_t base_lid;
-	ib_net16_t base_lid_ho;
-	ib_net16_t max_lid_ho;
-	uint8_t lmc;
 	ib_net64_t port_guid;
 
 	OSM_LOG_ENTER(sa->p_log);
@@ -154,141 +188,167 @@ static void nr_rcv_create_nr(IN osm_sa_t * sa, IN osm_node_t * p_node,
 			continue;
 
 		port_guid = osm_physp_get_port_guid(p_physp);
-
-		if ((comp_mask & IB_NR_COMPMASK_PORTGUID)
-		    && (port_guid != match_port_guid))
-			continue;
-
 		base_lid = osm_physp_get_base_lid(p_physp);
 
-		if (comp_mask & IB_NR_COMPMASK_LID) {
-			base_lid_ho = cl_ntoh16(base_lid);
-			lmc = osm_physp_get_lmc(p_physp);
-			max_lid_ho = (uint16_t) (base_lid_ho + (1 << lmc) - 1);
-			match_lid_ho = cl_ntoh16(match_lid);
-
-			/*
-			   We validate that the lid belongs to this node.
-			 */
-			OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
-				"Comparing LID: %u <= %u <= %u\n",
-				base_lid_ho, match_lid_ho, max_lid_ho);
-
-			if (match_lid_ho < base_lid_ho
-			    || match_lid_ho > max_lid_ho)
-				continue;
-		}
-
-		if ((comp_mask & IB_NR_COMPMASK_PORTNUM) &&
-		    (port_num != match_port_num))
+		if (!nr_rcv_match_port(sa, match_port_guid, match_lid,
+				       match_port_num, comp_mask, port_guid,
+				       base_lid, osm_physp_get_lmc(p_physp),
+				       port_num))
 			continue;
 
-		nr_rcv_new_nr(sa, p_node, p_list, port_guid, base_lid, port_num);
+		nr_rcv_new_nr(sa, &p_node->node_info, &p_node->node_desc,
+			      p_recs, port_guid, base_lid, port_num);
 	}
 
 	OSM_LOG_EXIT(sa->p_log);
 }
 
-static void nr_rcv_by_comp_mask(IN cl_map_item_t * p_map_item, IN void *context)
+/*
+ * Same as nr_rcv_create_nr() for a node of the subnet snapshot.
+ */
+static void nr_rcv_create_nr_snap(IN osm_sa_t * sa,
+				  IN const osm_sa_snapshot_t * p_snap,
+				  IN const osm_sa_snapshot_node_t * p_node,
+				  IN osm_sa_recs_t * p_recs,
+				  IN ib_net64_t const match_port_guid,
+				  IN ib_net16_t const match_lid,
+				  IN unsigned int const match_port_num,
+				  IN const osm_sa_snapshot_port_t * p_req_port,
+				  IN const ib_net64_t comp_mask)
+{
+	const osm_sa_snapshot_port_t *p_port;
+	uint8_t port_num;
+	uint8_t num_ports;
+
+	if (p_node->node_info.node_type == IB_NODE_TYPE_SWITCH)
+		num_ports = 1;
+	else
+		num_ports = p_node->num_ports;
+
+	for (port_num = 0; port_num < num_ports; port_num++) {
+		p_port = &p_snap->ports[p_node->ports + port_num];
+		if (!p_port->valid)
+			continue;
+
+		if (!osm_sa_snapshot_share_pkey(p_snap, p_port, p_req_port))
+			continue;
+
+		if (!nr_rcv_match_port(sa, match_port_guid, match_lid,
+				       match_port_num, comp_mask,
+				       p_port->port_guid, p_port->base_lid,
+				       p_port->lmc, port_num))
+			continue;
+
+		nr_rcv_new_nr(sa, &p_node->node_info, &p_node->node_desc,
+			      p_recs, p_port->port_guid, p_port->base_lid,
+			      port_num);
+	}
+}
+
+static boolean_t nr_rcv_match_node(IN const osm_nr_search_ctxt_t * p_ctxt,
+				   IN const ib_node_info_t * p_node_info,
+				   IN const ib_node_desc_t * p_node_desc)
 {
-	const osm_nr_search_ctxt_t *p_ctxt = context;
-	osm_node_t *p_node = (osm_node_t *) p_map_item;
 	const ib_node_record_t *const p_rcvd_rec = p_ctxt->p_rcvd_rec;
-	const osm_physp_t *const p_req_physp = p_ctxt->p_req_physp;
 	osm_sa_t *sa = p_ctxt->sa;
 	ib_net64_t comp_mask = p_ctxt->comp_mask;
-	ib_net64_t match_port_guid = 0;
-	ib_net16_t match_lid = 0;
-	unsigned int match_port_num = 0;
-
-	OSM_LOG_ENTER(p_ctxt->sa->p_log);
 
-	osm_dump_node_info(p_ctxt->sa->p_log, &p_node->node_info,
-			   OSM_LOG_DEBUG);
-
-	if (comp_mask & IB_NR_COMPMASK_LID)
-		match_lid = p_rcvd_rec->lid;
+	osm_dump_node_info(sa->p_log, p_node_info, OSM_LOG_DEBUG);
 
 	if (comp_mask & IB_NR_COMPMASK_NODEGUID) {
 		OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
 			"Looking for node 0x%016" PRIx64
 			", found 0x%016" PRIx64 "\n",
 			cl_ntoh64(p_rcvd_rec->node_info.node_guid),
-			cl_ntoh64(osm_node_get_node_guid(p_node)));
+			cl_ntoh64(p_node_info->node_guid));
 
-		if (p_node->node_info.node_guid !=
-		    p_rcvd_rec->node_info.node_guid)
-			goto Exit;
+		if (p_node_info->node_guid != p_rcvd_rec->node_info.node_guid)
+			return FALSE;
 	}
 
-	if (comp_mask & IB_NR_COMPMASK_PORTGUID)
-		match_port_guid = p_rcvd_rec->node_info.port_guid;
-
 	if ((comp_mask & IB_NR_COMPMASK_SYSIMAGEGUID) &&
-	    p_node->node_info.sys_guid != p_rcvd_rec->node_info.sys_guid)
-			goto Exit;
+	    p_node_info->sys_guid != p_rcvd_rec->node_info.sys_guid)
+		return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_BASEVERSION) &&
-	    p_node->node_info.base_version !=
-	    p_rcvd_rec->node_info.base_version)
-			goto Exit;
+	    p_node_info->base_version != p_rcvd_rec->node_info.base_version)
+		return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_CLASSVERSION) &&
-	    p_node->node_info.class_version !=
-	    p_rcvd_rec->node_info.class_version)
-		goto Exit;
+	    p_node_info->class_version != p_rcvd_rec->node_info.class_version)
+		return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_NODETYPE) &&
-	    p_node->node_info.node_type != p_rcvd_rec->node_info.node_type)
-		goto Exit;
+	    p_node_info->node_type != p_rcvd_rec->node_info.node_type)
+		return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_NUMPORTS) &&
-	    p_node->node_info.num_ports != p_rcvd_rec->node_info.num_ports)
-		goto Exit;
+	    p_node_info->num_ports != p_rcvd_rec->node_info.num_ports)
+		return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_PARTCAP) &&
-	    p_node->node_info.partition_cap !=
-	    p_rcvd_rec->node_info.partition_cap)
-		goto Exit;
+	    p_node_info->partition_cap != p_rcvd_rec->node_info.partition_cap)
+		return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_DEVID) &&
-	    p_node->node_info.device_id != p_rcvd_rec->node_info.device_id)
-		goto Exit;
+	    p_node_info->device_id != p_rcvd_rec->node_info.device_id)
+		return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_REV) &&
-	    p_node->node_info.revision !=
-	    p_rcvd_rec->node_info.revision)
-		goto Exit;
-
-	if (comp_mask & IB_NR_COMPMASK_PORTNUM)
-		match_port_num = ib_node_info_get_local_port_num(&p_rcvd_rec->node_info);
+	    p_node_info->revision != p_rcvd_rec->node_info.revision)
+		return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_VENDID) &&
-	    ib_node_info_get_vendor_id(&p_node->node_info) !=
+	    ib_node_info_get_vendor_id(p_node_info) !=
 	    ib_node_info_get_vendor_id(&p_rcvd_rec->node_info))
-		goto Exit;
+		return FALSE;
 
 	if ((comp_mask & IB_NR_COMPMASK_NODEDESC) &&
-	    strncmp((char *)&p_node->node_desc, (char *)&p_rcvd_rec->node_desc,
+	    strncmp((char *)p_node_desc, (char *)&p_rcvd_rec->node_desc,
 		    sizeof(ib_node_desc_t)))
-		goto Exit;
+		return FALSE;
 
-	nr_rcv_create_nr(sa, p_node, p_ctxt->p_list, match_port_guid,
-			 match_lid, match_port_num, p_req_physp, comp_mask);
+	return TRUE;
+}
+
+static void nr_rcv_by_comp_mask(IN cl_map_item_t * p_map_item, IN void *context)
+{
+	const osm_nr_search_ctxt_t *p_ctxt = context;
+	osm_node_t *p_node = (osm_node_t *) p_map_item;
+
+	OSM_LOG_ENTER(p_ctxt->sa->p_log);
+
+	if (nr_rcv_match_node(p_ctxt, &p_node->node_info, &p_node->node_desc))
+		nr_rcv_create_nr(p_ctxt->sa, p_node, p_ctxt->p_recs,
+				 p_ctxt->match_port_guid, p_ctxt->match_lid,
+				 p_ctxt->match_port_num, p_ctxt->p_req_physp,
+				 p_ctxt->comp_mask);
 
-Exit:
 	OSM_LOG_EXIT(p_ctxt->sa->p_log);
 }
 
+static void nr_rcv_snap_by_comp_mask(IN const osm_nr_search_ctxt_t * p_ctxt,
+				     IN const osm_sa_snapshot_node_t * p_node)
+{
+	if (nr_rcv_match_node(p_ctxt, &p_node->node_info, &p_node->node_desc))
+		nr_rcv_create_nr_snap(p_ctxt->sa, p_ctxt->p_snap, p_node,
+				      p_ctxt->p_recs, p_ctxt->match_port_guid,
+				      p_ctxt->match_lid, p_ctxt->match_port_num,
+				      p_ctxt->p_req_port, p_ctxt->comp_mask);
+}
+
 void osm_nr_rcv_process(IN void *ctx, IN void *data)
 {
 	osm_sa_t *sa = ctx;
 	osm_madw_t *p_madw = data;
 	const ib_sa_mad_t *p_rcvd_mad;
 	const ib_node_record_t *p_rcvd_rec;
-	cl_qlist_t rec_list;
+	osm_sa_recs_t recs;
 	osm_nr_search_ctxt_t context;
-	osm_physp_t *p_req_physp;
+	osm_physp_t *p_req_physp = NULL;
+	osm_sa_snapshot_t *p_snap = NULL;
+	const osm_sa_snapshot_port_t *p_req_port = NULL;
+	uint32_t i;
 
 	CL_ASSERT(sa);
 
@@ -311,11 +371,19 @@ void osm_nr_rcv_process(IN void *ctx, IN void *data)
 		goto Exit;
 	}
 
+	/* use the subnet snapshot if there is one */
+	p_snap = osm_sa_snapshot_get(sa);
+
 	/* update the requester physical port. */
-	p_req_physp = osm_get_physp_by_mad_addr(sa->p_log, sa->p_subn,
-						osm_madw_get_mad_addr_ptr
-						(p_madw));
-	if (p_req_physp == NULL) {
+	if (p_snap)
+		p_req_port = osm_sa_snapshot_get_port_by_lid(p_snap,
+							     osm_madw_get_mad_addr_ptr
+							     (p_madw)->dest_lid);
+	else
+		p_req_physp = osm_get_physp_by_mad_addr(sa->p_log, sa->p_subn,
+							osm_madw_get_mad_addr_ptr
+							(p_madw));
+	if (p_req_physp == NULL && p_req_port == NULL) {
 		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1D04: "
 			"Cannot find requester physical port\n");
 		goto Exit;
@@ -324,23 +392,45 @@ void osm_nr_rcv_process(IN void *ctx, IN void *data)
 	if (osm_log_is_active(sa->p_log, OSM_LOG_DEBUG))
 		osm_dump_node_record(sa->p_log, p_rcvd_rec, OSM_LOG_DEBUG);
 
-	cl_qlist_init(&rec_list);
+	osm_sa_recs_init(&recs, sizeof(ib_node_record_t));
 
 	context.p_rcvd_rec = p_rcvd_rec;
-	context.p_list = &rec_list;
+	context.p_recs = &recs;
 	context.comp_mask = p_rcvd_mad->comp_mask;
 	context.sa = sa;
 	context.p_req_physp = p_req_physp;
+	context.p_snap = p_snap;
+	context.p_req_port = p_req_port;
+	context.match_lid = 0;
+	context.match_port_guid = 0;
+	context.match_port_num = 0;
 
-	cl_plock_acquire(sa->p_lock);
+	if (context.comp_mask & IB_NR_COMPMASK_LID)
+		context.match_lid = p_rcvd_rec->lid;
 
-	cl_qmap_apply_func(&sa->p_subn->node_guid_tbl, nr_rcv_by_comp_mask,
-			   &context);
+	if (context.comp_mask & IB_NR_COMPMASK_PORTGUID)
+		context.match_port_guid = p_rcvd_rec->node_info.port_guid;
 
-	cl_plock_release(sa->p_lock);
+	if (context.comp_mask & IB_NR_COMPMASK_PORTNUM)
+		context.match_port_num =
+		    ib_node_info_get_local_port_num(&p_rcvd_rec->node_info);
+
+	if (p_snap)
+		for (i = 0; i < p_snap->num_nodes; i++)
+			nr_rcv_snap_by_comp_mask(&context, &p_snap->nodes[i]);
+	else {
+		cl_plock_acquire(sa->p_lock);
+
+		cl_qmap_apply_func(&sa->p_subn->node_guid_tbl,
+				   nr_rcv_by_comp_mask, &context);
+
+		cl_plock_release(sa->p_lock);
+	}
 
-	osm_sa_respond(sa, p_madw, sizeof(ib_node_record_t), &rec_list);
+	osm_sa_respond_recs(sa, p_madw, &recs);
 
 Exit:
+	if (p_snap)
+		osm_sa_snapshot_put(p_snap);
 	OSM_LOG_EXIT(sa->p_log);
 }
@@ -72,11 +72,6 @@
 
 #define MAX_HOPS 64
 
-typedef struct osm_pr_item {
-	cl_list_item_t list_item;
-	ib_path_rec_t path_rec;
-} osm_pr_item_t;
-
 typedef struct osm_path_parms {
 	ib_net16_t pkey;
 	uint8_t mtu;
@@ -150,146 +145,36 @@ sa_path_rec_apply_tavor_mtu_limit(IN const ib_path_rec_t * p_pr,
 	return TRUE;
 }
 
-static ib_api_status_t pr_rcv_get_path_parms(IN osm_sa_t * sa,
-					     IN const ib_path_rec_t * p_pr,
-					     IN const osm_port_t * p_src_port,
-					     IN const osm_port_t * p_dest_port,
-					     IN const uint16_t dest_lid_ho,
-					     IN const ib_net64_t comp_mask,
-					     OUT osm_path_parms_t * p_parms)
+/*
+ * Continue a route walk towards dest_lid_ho from p_physp, an egress port
+ * of the source node, folding the ports passed into *p_mtu, *p_rate and
+ * *p_sl_mask. hops is the number of switches already traversed.
+ */
+static ib_api_status_t pr_rcv_walk_from(IN osm_sa_t * sa,
+					IN const osm_physp_t * p_physp,
+					IN const osm_physp_t * p_src_physp,
+					IN const osm_port_t * p_dest_port,
+					IN const osm_physp_t * p_dest_physp,
+					IN const uint16_t dest_lid_ho,
+					IN int hops,
+					IN OUT uint8_t * p_mtu,
+					IN OUT uint8_t * p_rate,
+					IN OUT uint16_t * p_sl_mask)
 {
 	const osm_node_t *p_node;
-	const osm_physp_t *p_physp, *p_physp0;
-	const osm_physp_t *p_src_physp;
-	const osm_physp_t *p_dest_physp;
-	const osm_prtn_t *p_prtn = NULL;
-	osm_opensm_t *p_osm;
-	struct osm_routing_engine *p_re;
+	const osm_physp_t *p_physp0;
 	const ib_port_info_t *p_pi, *p_pi0;
 	ib_api_status_t status = IB_SUCCESS;
-	ib_net16_t pkey;
-	uint8_t mtu;
-	uint8_t rate;
-	uint8_t pkt_life;
-	uint8_t required_mtu;
-	uint8_t required_rate;
-	uint8_t required_pkt_life;
-	uint8_t sl;
+	uint8_t mtu = *p_mtu;
+	uint8_t rate = *p_rate;
 	uint8_t in_port_num;
 	ib_net16_t dest_lid;
 	uint8_t i;
-	ib_slvl_table_t *p_slvl_tbl = NULL;
-	osm_qos_level_t *p_qos_level = NULL;
-	uint16_t valid_sl_mask = 0xffff;
-	int hops = 0;
-
-	OSM_LOG_ENTER(sa->p_log);
+	ib_slvl_table_t *p_slvl_tbl;
+	uint16_t valid_sl_mask = *p_sl_mask;
 
 	dest_lid = cl_hton16(dest_lid_ho);
 
-	p_dest_physp = p_dest_port->p_physp;
-	p_physp = p_src_port->p_physp;
-	p_src_physp = p_physp;
-	p_pi = &p_physp->port_info;
-	p_osm = sa->p_subn->p_osm;
-	p_re = p_osm->routing_engine_used;
-
-	mtu = ib_port_info_get_mtu_cap(p_pi);
-	rate = ib_port_info_compute_rate(p_pi,
-					 p_pi->capability_mask & IB_PORT_CAP_HAS_EXT_SPEEDS);
-
-	/*
-	   Mellanox Tavor device performance is better using 1K MTU.
-	   If required MTU and MTU selector are such that 1K is OK
-	   and at least one end of the path is Tavor we override the
-	   port MTU with 1K.
-	 */
-	if (sa->p_subn->opt.enable_quirks &&
-	    sa_path_rec_apply_tavor_mtu_limit(p_pr, p_src_port, p_dest_port,
-					      comp_mask))
-		if (mtu > IB_MTU_LEN_1024) {
-			mtu = IB_MTU_LEN_1024;
-			OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
-				"Optimized Path MTU to 1K for Mellanox Tavor device\n");
-		}
-
-	/*
-	   Walk the subnet object from source to destination,
-	   tracking the most restrictive rate and mtu values along the way...
-
-	   If source port node is a switch, then p_physp should
-	   point to the port that routes the destination lid
-	 */
-
-	p_node = osm_physp_get_node_ptr(p_physp);
-
-	if (p_node->sw) {
-		/*
-		 * Source node is a switch.
-		 * Make sure that p_physp points to the out port of the
-		 * switch that routes to the destination lid (dest_lid_ho)
-		 */
-		p_physp = osm_switch_get_route_by_lid(p_node->sw, dest_lid);
-		if (p_physp == 0) {
-			OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F02: "
-				"Cannot find routing to LID %u on switch "
-				"%s (GUID: 0x%016" PRIx64 ")\n", dest_lid_ho,
-				p_node->print_desc,
-				cl_ntoh64(osm_node_get_node_guid(p_node)));
-			status = IB_NOT_FOUND;
-			goto Exit;
-		}
-	}
-
-	if (sa->p_subn->opt.qos) {
-		/*
-		 * Whether this node is switch or CA, the IN port for
-		 * the sl2vl table is 0, because this is a source node.
-		 */
-		p_slvl_tbl = osm_physp_get_slvl_tbl(p_physp, 0);
-
-		/* update valid SLs that still exist on this route */
-		for (i = 0; i < IB_MAX_NUM_VLS; i++) {
-			if (valid_sl_mask & (1 << i) &&
-			    ib_slvl_table_get(p_slvl_tbl, i) == IB_DROP_VL)
-				valid_sl_mask &= ~(1 << i);
-		}
-		if (!valid_sl_mask) {
-			OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
-				"All the SLs lead to VL15 on this path\n");
-			status = IB_NOT_FOUND;
-			goto Exit;
-		}
-	}
-
-	/*
-	 * Same as above
-	 */
-	p_node = osm_physp_get_node_ptr(p_dest_physp);
-
-	if (p_node->sw) {
-		/*
-		 * if destination is switch, we want p_dest_physp to point to port 0
-		 */
-		p_dest_physp =
-		    osm_switch_get_route_by_lid(p_node->sw, dest_lid);
-
-		if (p_dest_physp == 0) {
-			OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F03: "
-				"Cannot find routing to LID %u on switch "
-				"%s (GUID: 0x%016" PRIx64 ")\n", dest_lid_ho,
-				p_node->print_desc,
-				cl_ntoh64(osm_node_get_node_guid(p_node)));
-			status = IB_NOT_FOUND;
-			goto Exit;
-		}
-
-	}
-
-	/*
-	 * Now go through the path step by step
-	 */
-
 	while (p_physp != p_dest_physp) {
 
 		int tmp_pnum = p_physp->port_num;
@@ -330,9 +215,9 @@ static ib_api_status_t pr_rcv_get_path_parms(IN osm_sa_t * sa,
 				"%s (GUID: 0x%016"PRIx64") port %d to "
 				"%s (GUID: 0x%016"PRIx64") port %d; "
 				"ended at %s port %d\n",
-				p_src_port->p_node->print_desc,
-				cl_ntoh64(p_src_port->p_node->node_info.node_guid),
-				p_src_port->p_physp->port_num,
+				p_src_physp->p_node->print_desc,
+				cl_ntoh64(p_src_physp->p_node->node_info.node_guid),
+				p_src_physp->port_num,
 				p_dest_port->p_node->print_desc,
 				cl_ntoh64(p_dest_port->p_node->node_info.node_guid),
 				p_dest_port->p_physp->port_num,
@@ -384,7 +269,7 @@ static ib_api_status_t pr_rcv_get_path_parms(IN osm_sa_t * sa,
 					  ib_port_info_compute_rate(p_pi,
 								    p_pi0->capability_mask & IB_PORT_CAP_HAS_EXT_SPEEDS)) > 0)
 			rate = ib_port_info_compute_rate(p_pi,
-							 p_pi->capability_mask & IB_PORT_CAP_HAS_EXT_SPEEDS);
+							 p_pi0->capability_mask & IB_PORT_CAP_HAS_EXT_SPEEDS);
 
 		if (sa->p_subn->opt.qos) {
 			/*
@@ -442,6 +327,467 @@ static ib_api_status_t pr_rcv_get_path_parms(IN osm_sa_t * sa,
 		rate = ib_port_info_compute_rate(p_pi,
 						 p_pi->capability_mask & IB_PORT_CAP_HAS_EXT_SPEEDS);
 
+	*p_mtu = mtu;
+	*p_rate = rate;
+	*p_sl_mask = valid_sl_mask;
+Exit:
+	return status;
+}
+
+/*
+ * Walk the route from the source port to dest_lid hop by hop through the
+ * switch LFTs, tracking the most restrictive MTU and rate and, with QoS,
+ * the SLs which are not dropped on the way.
+ */
+static ib_api_status_t pr_rcv_walk_path(IN osm_sa_t * sa,
+					IN const osm_port_t * p_src_port,
+					IN const osm_port_t * p_dest_port,
+					IN const osm_physp_t * p_dest_physp,
+					IN const uint16_t dest_lid_ho,
+					OUT uint8_t * p_mtu,
+					OUT uint8_t * p_rate,
+					OUT uint16_t * p_sl_mask)
+{
+	const osm_node_t *p_node;
+	const osm_physp_t *p_physp;
+	const osm_physp_t *p_src_physp;
+	const ib_port_info_t *p_pi;
+	ib_api_status_t status = IB_SUCCESS;
+	uint8_t mtu;
+	uint8_t rate;
+	ib_net16_t dest_lid;
+	uint8_t i;
+	ib_slvl_table_t *p_slvl_tbl = NULL;
+	uint16_t valid_sl_mask = 0xffff;
+
+	dest_lid = cl_hton16(dest_lid_ho);
+
+	p_physp = p_src_port->p_physp;
+	p_src_physp = p_physp;
+	p_pi = &p_physp->port_info;
+
+	mtu = ib_port_info_get_mtu_cap(p_pi);
+	rate = ib_port_info_compute_rate(p_pi,
+					 p_pi->capability_mask & IB_PORT_CAP_HAS_EXT_SPEEDS);
+
+	/*
+	   Walk the subnet object from source to destination,
+	   tracking the most restrictive rate and mtu values along the way...
+
+	   If source port node is a switch, then p_physp should
+	   point to the port that routes the destination lid
+	 */
+
+	p_node = osm_physp_get_node_ptr(p_physp);
+
+	if (p_node->sw) {
+		/*
+		 * Source node is a switch.
+		 * Make sure that p_physp points to the out port of the
+		 * switch that routes to the destination lid (dest_lid_ho)
+		 */
+		p_physp = osm_switch_get_route_by_lid(p_node->sw, dest_lid);
+		if (p_physp == 0) {
+			OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F02: "
+				"Cannot find routing to LID %u on switch "
+				"%s (GUID: 0x%016" PRIx64 ")\n", dest_lid_ho,
+				p_node->print_desc,
+				cl_ntoh64(osm_node_get_node_guid(p_node)));
+			status = IB_NOT_FOUND;
+			goto Exit;
+		}
+	}
+
+	if (sa->p_subn->opt.qos) {
+		/*
+		 * Whether this node is switch or CA, the IN port for
+		 * the sl2vl table is 0, because this is a source node.
+		 */
+		p_slvl_tbl = osm_physp_get_slvl_tbl(p_physp, 0);
+
+		/* update valid SLs that still exist on this route */
+		for (i = 0; i < IB_MAX_NUM_VLS; i++) {
+			if (valid_sl_mask & (1 << i) &&
+			    ib_slvl_table_get(p_slvl_tbl, i) == IB_DROP_VL)
+				valid_sl_mask &= ~(1 << i);
+		}
+		if (!valid_sl_mask) {
+			OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
+				"All the SLs lead to VL15 on this path\n");
+			status = IB_NOT_FOUND;
+			goto Exit;
+		}
+	}
+
+	status = pr_rcv_walk_from(sa, p_physp, p_src_physp, p_dest_port,
+				  p_dest_physp, dest_lid_ho, 0, &mtu, &rate,
+				  &valid_sl_mask);
+	if (status != IB_SUCCESS)
+		goto Exit;
+
+	*p_mtu = mtu;
+	*p_rate = rate;
+	*p_sl_mask = valid_sl_mask;
+Exit:
+	return status;
+}
+
+static inline uint32_t pr_cache_index(IN const osm_sa_pr_cache_t * c,
+				      IN uint32_t key)
+{
+	key *= 0x9E3779B1;
+	return (key ^ (key >> 16)) & (c->size - 1);
+}
+
+/*
+ * Returns TRUE and the cached path parameters if there is a valid entry
+ * for key. The epoch the lookup was done in is returned in p_epoch for
+ * the following pr_cache_store(), so a walk which raced with an
+ * invalidation is not stored as valid.
+ */
+static boolean_t pr_cache_lookup(IN osm_sa_t * sa, IN uint32_t key,
+				 OUT uint8_t * p_mtu, OUT uint8_t * p_rate,
+				 OUT uint16_t * p_sl_mask,
+				 OUT uint32_t * p_epoch)
+{
+	osm_sa_pr_cache_t *c = &sa->pr_cache;
+	osm_sa_pr_cache_entry_t *e;
+	boolean_t found = FALSE;
+
+	e = &c->entries[pr_cache_index(c, key)];
+
+	cl_spinlock_acquire(&c->lock);
+	if (e->key == key && e->epoch == c->epoch) {
+		*p_mtu = e->mtu;
+		*p_rate = e->rate;
+		*p_sl_mask = e->sl_mask;
+		found = TRUE;
+	}
+	*p_epoch = c->epoch;
+	cl_spinlock_release(&c->lock);
+
+	if (found)
+		cl_atomic_inc(&sa->p_subn->p_osm->stats.sa_pr_cache_hits);
+	else
+		cl_atomic_inc(&sa->p_subn->p_osm->stats.sa_pr_cache_misses);
+	return found;
+}
+
+static void pr_cache_store(IN osm_sa_t * sa, IN uint32_t key,
+			   IN uint32_t epoch, IN uint8_t mtu, IN uint8_t rate,
+			   IN uint16_t sl_mask)
+{
+	osm_sa_pr_cache_t *c = &sa->pr_cache;
+	osm_sa_pr_cache_entry_t *e;
+
+	e = &c->entries[pr_cache_index(c, key)];
+
+	cl_spinlock_acquire(&c->lock);
+	e->key = key;
+	e->epoch = epoch;
+	e->mtu = mtu;
+	e->rate = rate;
+	e->sl_mask = sl_mask;
+	cl_spinlock_release(&c->lock);
+}
+
+/*
+ * Per query memo of route segments for the wildcard (world and half)
+ * PathRecord queries. A CA port reaches any LID through the switch it is
+ * attached to, so everything past the ingress port of that switch only
+ * depends on the switch and the destination LID and is walked once for
+ * all the ports attached to it.
+ */
+typedef struct osm_pr_batch_entry {
+	uint32_t key;
+	ib_api_status_t status;
+	uint16_t sl_mask;
+	uint8_t mtu;
+	uint8_t rate;
+	uint8_t egress_port;
+} osm_pr_batch_entry_t;
+
+typedef struct osm_pr_batch {
+	uint32_t size;
+	osm_pr_batch_entry_t *entries;
+} osm_pr_batch_t;
+
+static void pr_batch_init(IN osm_sa_t * sa, IN unsigned num_ports,
+			  OUT osm_pr_batch_t * p_batch)
+{
+	uint32_t n, size;
+
+	/*
+	 * The working set of one pass of the grouped iteration is every
+	 * LID of the ports as seen from one switch plus the LIDs of one
+	 * port as seen from every switch.
+	 */
+	n = (num_ports + cl_qmap_count(&sa->p_subn->sw_guid_tbl)) <<
+	    sa->p_subn->opt.lmc;
+	for (size = 64; size < 2 * n && size < (1 << 20); size <<= 1) ;
+
+	p_batch->entries = calloc(size, sizeof(*p_batch->entries));
+	p_batch->size = p_batch->entries ? size : 0;
+}
+
+static void pr_batch_destroy(IN osm_pr_batch_t * p_batch)
+{
+	free(p_batch->entries);
+	p_batch->entries = NULL;
+	p_batch->size = 0;
+}
+
+/*
+ * Walk from the egress port of switch p_sw_node for dest_lid_ho to the
+ * destination, the part of the path shared by all its attached ports.
+ */
+static void pr_batch_walk_segment(IN osm_sa_t * sa,
+				  IN const osm_node_t * p_sw_node,
+				  IN const osm_port_t * p_dest_port,
+				  IN const osm_physp_t * p_dest_physp,
+				  IN uint16_t dest_lid_ho,
+				  OUT osm_pr_batch_entry_t * p_entry)
+{
+	const osm_physp_t *p_physp, *p_physp0;
+	const ib_port_info_t *p_pi;
+	uint16_t sl_mask = 0xffff;
+	uint8_t mtu, rate;
+
+	p_physp = osm_switch_get_route_by_lid(p_sw_node->sw,
+					      cl_hton16(dest_lid_ho));
+	if (p_physp == 0) {
+		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F07: "
+			"Dead end path on switch "
+			"%s (GUID: 0x%016"PRIx64") to LID %u\n",
+			p_sw_node->print_desc,
+			cl_ntoh64(osm_node_get_node_guid(p_sw_node)),
+			dest_lid_ho);
+		p_entry->status = IB_ERROR;
+		return;
+	}
+
+	p_physp0 = osm_node_get_physp_ptr((osm_node_t *) p_sw_node, 0);
+	p_pi = &p_physp->port_info;
+	mtu = ib_port_info_get_mtu_cap(p_pi);
+	rate = ib_port_info_compute_rate(p_pi,
+					 p_physp0->port_info.capability_mask &
+					 IB_PORT_CAP_HAS_EXT_SPEEDS);
+
+	p_entry->status = pr_rcv_walk_from(sa, p_physp, p_physp0, p_dest_port,
+					   p_dest_physp, dest_lid_ho, 1, &mtu,
+					   &rate, &sl_mask);
+	p_entry->egress_port = osm_physp_get_port_num(p_physp);
+	p_entry->mtu = mtu;
+	p_entry->rate = rate;
+	p_entry->sl_mask = sl_mask;
+}
+
+/*
+ * Returns TRUE if the route from p_src_port to dest_lid_ho was resolved
+ * through the batch, with the result in *p_status and, on success, the
+ * path parameters. Returns FALSE if the source is not a CA port attached
+ * to a switch and the route has to be walked as usual.
+ */
+static boolean_t pr_batch_lookup(IN osm_sa_t * sa, IN osm_pr_batch_t * p_batch,
+				 IN const osm_port_t * p_src_port,
+				 IN const osm_port_t * p_dest_port,
+				 IN const osm_physp_t * p_dest_physp,
+				 IN uint16_t dest_lid_ho, OUT uint8_t * p_mtu,
+				 OUT uint8_t * p_rate, OUT uint16_t * p_sl_mask,
+				 OUT ib_api_status_t * p_status)
+{
+	const osm_physp_t *p_src_physp = p_src_port->p_physp;
+	const osm_physp_t *p_in, *p_physp0, *p_egress;
+	const osm_node_t *p_sw_node;
+	const ib_port_info_t *p_pi;
+	osm_pr_batch_entry_t *p_entry;
+	ib_slvl_table_t *p_slvl_tbl;
+	uint16_t sw_lid_ho, sl_mask = 0xffff;
+	uint32_t key, idx;
+	uint8_t mtu, rate, i;
+
+	if (!p_batch || !p_batch->size || p_src_physp == p_dest_physp ||
+	    osm_physp_get_node_ptr(p_src_physp)->sw)
+		return FALSE;
+
+	p_in = osm_physp_get_remote(p_src_physp);
+	if (!p_in || p_in == p_dest_physp)
+		return FALSE;
+	p_sw_node = osm_physp_get_node_ptr(p_in);
+	if (!p_sw_node->sw)
+		return FALSE;
+
+	p_physp0 = osm_node_get_physp_ptr((osm_node_t *) p_sw_node, 0);
+	sw_lid_ho = cl_ntoh16(osm_physp_get_base_lid(p_physp0));
+	if (!sw_lid_ho)
+		return FALSE;
+
+	key = (uint32_t) sw_lid_ho << 16 | dest_lid_ho;
+	idx = key * 0x9E3779B1;
+	p_entry = &p_batch->entries[(idx ^ (idx >> 16)) & (p_batch->size - 1)];
+	if (p_entry->key != key) {
+		pr_batch_walk_segment(sa, p_sw_node, p_dest_port, p_dest_physp,
+				      dest_lid_ho, p_entry);
+		p_entry->key = key;
+	}
+
+	*p_status = p_entry->status;
+	if (p_entry->status != IB_SUCCESS)
+		return TRUE;
+
+	/* the source port and the ingress port of its switch */
+	p_pi = &p_src_physp->port_info;
+	mtu = ib_port_info_get_mtu_cap(p_pi);
+	rate = ib_port_info_compute_rate(p_pi,
+					 p_pi->capability_mask & IB_PORT_CAP_HAS_EXT_SPEEDS);
+
+	p_pi = &p_in->port_info;
+	if (mtu > ib_port_info_get_mtu_cap(p_pi))
+		mtu = ib_port_info_get_mtu_cap(p_pi);
+	if (ib_path_compare_rates(rate,
+				  ib_port_info_compute_rate(p_pi,
+							    p_physp0->port_info.capability_mask & IB_PORT_CAP_HAS_EXT_SPEEDS)) > 0)
+		rate = ib_port_info_compute_rate(p_pi,
+						 p_physp0->port_info.capability_mask & IB_PORT_CAP_HAS_EXT_SPEEDS);
+
+	if (mtu > p_entry->mtu)
+		mtu = p_entry->mtu;
+	if (ib_path_compare_rates(rate, p_entry->rate) > 0)
+		rate = p_entry->rate;
+
+	if (sa->p_subn->opt.qos) {
+		p_slvl_tbl = osm_physp_get_slvl_tbl(p_src_physp, 0);
+		p_egress = osm_node_get_physp_ptr((osm_node_t *) p_sw_node,
+						  p_entry->egress_port);
+		for (i = 0; i < IB_MAX_NUM_VLS; i++)
+			if (ib_slvl_table_get(p_slvl_tbl, i) == IB_DROP_VL)
+				sl_mask &= ~(1 << i);
+		p_slvl_tbl = osm_physp_get_slvl_tbl(p_egress,
+						    osm_physp_get_port_num(p_in));
+		for (i = 0; i < IB_MAX_NUM_VLS; i++)
+			if (ib_slvl_table_get(p_slvl_tbl, i) == IB_DROP_VL)
+				sl_mask &= ~(1 << i);
+		sl_mask &= p_entry->sl_mask;
+		if (!sl_mask) {
+			OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
+				"All the SLs lead to VL15 on this path\n");
+			*p_status = IB_NOT_FOUND;
+			return TRUE;
+		}
+	}
+
+	*p_mtu = mtu;
+	*p_rate = rate;
+	*p_sl_mask = sl_mask;
+	return TRUE;
+}
+
+static ib_api_status_t pr_rcv_get_path_parms(IN osm_sa_t * sa,
+					     IN const ib_path_rec_t * p_pr,
+					     IN const osm_port_t * p_src_port,
+					     IN const osm_port_t * p_dest_port,
+					     IN const uint16_t dest_lid_ho,
+					     IN const ib_net64_t comp_mask,
+					     IN osm_pr_batch_t * p_batch,
+					     OUT osm_path_parms_t * p_parms)
+{
+	const osm_node_t *p_node;
+	const osm_physp_t *p_src_physp;
+	const osm_physp_t *p_dest_physp;
+	const osm_prtn_t *p_prtn = NULL;
+	osm_opensm_t *p_osm;
+	struct osm_routing_engine *p_re;
+	ib_api_status_t status = IB_SUCCESS;
+	ib_net16_t pkey;
+	uint8_t mtu;
+	uint8_t rate;
+	uint8_t pkt_life;
+	uint8_t required_mtu;
+	uint8_t required_rate;
+	uint8_t required_pkt_life;
+	uint8_t sl;
+	ib_net16_t dest_lid;
+	uint8_t i;
+	osm_qos_level_t *p_qos_level = NULL;
+	uint16_t valid_sl_mask = 0xffff;
+	boolean_t use_cache;
+	uint32_t key = 0, epoch = 0;
+
+	OSM_LOG_ENTER(sa->p_log);
+
+	dest_lid = cl_hton16(dest_lid_ho);
+
+	p_dest_physp = p_dest_port->p_physp;
+	p_src_physp = p_src_port->p_physp;
+	p_osm = sa->p_subn->p_osm;
+	p_re = p_osm->routing_engine_used;
+
+	p_node = osm_physp_get_node_ptr(p_dest_physp);
+
+	if (p_node->sw) {
+		/*
+		 * if destination is switch, we want p_dest_physp to point to port 0
+		 */
+		p_dest_physp =
+		    osm_switch_get_route_by_lid(p_node->sw, dest_lid);
+
+		if (p_dest_physp == 0) {
+			OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F03: "
+				"Cannot find routing to LID %u on switch "
+				"%s (GUID: 0x%016" PRIx64 ")\n", dest_lid_ho,
+				p_node->print_desc,
+				cl_ntoh64(osm_node_get_node_guid(p_node)));
+			status = IB_NOT_FOUND;
+			goto Exit;
+		}
+
+	}
+
+	/*
+	 * The route between the ports only depends on the source port and
+	 * the destination LID, so it is taken from the precomputed path
+	 * table when there is one, from the query batch for wildcard
+	 * queries, otherwise the walk result is cached per
+	 * (source base LID, destination LID).
+	 */
+	key = (uint32_t) cl_ntoh16(osm_port_get_base_lid(p_src_port)) << 16 |
+	    dest_lid_ho;
+	use_cache = sa->pr_cache.size && (key >> 16);
+
+	if (!osm_sa_path_table_lookup(sa, p_src_port, p_dest_physp,
+				      dest_lid_ho, &mtu, &rate,
+				      &valid_sl_mask, NULL) &&
+	    !pr_batch_lookup(sa, p_batch, p_src_port, p_dest_port,
+			     p_dest_physp, dest_lid_ho, &mtu, &rate,
+			     &valid_sl_mask, &status) &&
+	    (!use_cache ||
+	     !pr_cache_lookup(sa, key, &mtu, &rate, &valid_sl_mask,
+			      &epoch))) {
+		status = pr_rcv_walk_path(sa, p_src_port, p_dest_port,
+					  p_dest_physp, dest_lid_ho, &mtu,
+					  &rate, &valid_sl_mask);
+		if (status == IB_SUCCESS && use_cache)
+			pr_cache_store(sa, key, epoch, mtu, rate,
+				       valid_sl_mask);
+	}
+	if (status != IB_SUCCESS)
+		goto Exit;
+
+	/*
+	   Mellanox Tavor device performance is better using 1K MTU.
+	   If required MTU and MTU selector are such that 1K is OK
+	   and at least one end of the path is Tavor we override the
+	   port MTU with 1K.
+	 */
+	if (sa->p_subn->opt.enable_quirks &&
+	    sa_path_rec_apply_tavor_mtu_limit(p_pr, p_src_port, p_dest_port,
+					      comp_mask))
+		if (mtu > IB_MTU_LEN_1024) {
+			mtu = IB_MTU_LEN_1024;
+			OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
+				"Optimized Path MTU to 1K for Mellanox Tavor device\n");
+		}
+
 	OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
 		"Path min MTU = %u, min rate = %u\n", mtu, rate);
 
@@ -845,7 +1191,7 @@ ib_api_status_t osm_get_path_params(IN osm_sa_t * sa,
 	ib_path_rec_t pr;
 	memset(&pr, 0, sizeof(ib_path_rec_t));
 	return pr_rcv_get_path_parms(sa, &pr,
-		p_src_port, p_dest_port, dlid_ho, 0, p_parms);
+		p_src_port, p_dest_port, dlid_ho, 0, NULL, p_parms);
 }
 
 static void pr_rcv_build_pr(IN osm_sa_t * sa, IN const osm_port_t * p_src_port,
@@ -909,48 +1255,41 @@ static void pr_rcv_build_pr(IN osm_sa_t * sa, IN const osm_port_t * p_src_port,
 	OSM_LOG_EXIT(sa->p_log);
 }
 
-static osm_pr_item_t *pr_rcv_get_lid_pair_path(IN osm_sa_t * sa,
-					       IN const ib_path_rec_t * p_pr,
-					       IN const osm_port_t * p_src_port,
-					       IN const osm_port_t *
-					       p_dest_port,
-					       IN const ib_gid_t * p_dgid,
-					       IN const uint16_t src_lid_ho,
-					       IN const uint16_t dest_lid_ho,
-					       IN const ib_net64_t comp_mask,
-					       IN const uint8_t preference)
+static boolean_t pr_rcv_get_lid_pair_path(IN osm_sa_t * sa,
+					   IN const ib_path_rec_t * p_pr,
+					   IN const osm_port_t * p_src_port,
+					   IN const osm_port_t * p_dest_port,
+					   IN const ib_gid_t * p_dgid,
+					   IN const uint16_t src_lid_ho,
+					   IN const uint16_t dest_lid_ho,
+					   IN const ib_net64_t comp_mask,
+					   IN const uint8_t preference,
+					   IN osm_pr_batch_t * p_batch,
+					   IN osm_sa_recs_t * p_recs)
 {
 	osm_path_parms_t path_parms;
 	osm_path_parms_t rev_path_parms;
-	osm_pr_item_t *p_pr_item;
+	ib_path_rec_t *p_path_rec;
 	ib_api_status_t status, rev_path_status;
+	boolean_t found = FALSE;
 
 	OSM_LOG_ENTER(sa->p_log);
 
 	OSM_LOG(sa->p_log, OSM_LOG_DEBUG, "Src LID %u, Dest LID %u\n",
 		src_lid_ho, dest_lid_ho);
 
-	p_pr_item = malloc(sizeof(*p_pr_item));
-	if (p_pr_item == NULL) {
-		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F01: "
-			"Unable to allocate path record\n");
-		goto Exit;
-	}
-	memset(p_pr_item, 0, sizeof(*p_pr_item));
-
 	status = pr_rcv_get_path_parms(sa, p_pr, p_src_port, p_dest_port,
-				       dest_lid_ho, comp_mask, &path_parms);
+				       dest_lid_ho, comp_mask, p_batch,
+				       &path_parms);
 
-	if (status != IB_SUCCESS) {
-		free(p_pr_item);
-		p_pr_item = NULL;
+	if (status != IB_SUCCESS)
 		goto Exit;
-	}
 
 	/* now try the reversible path */
 	rev_path_status = pr_rcv_get_path_parms(sa, p_pr, p_dest_port,
 						p_src_port, src_lid_ho,
-						comp_mask, &rev_path_parms);
+						comp_mask, p_batch,
+						&rev_path_parms);
 	path_parms.reversible = (rev_path_status == IB_SUCCESS);
 
 	/* did we get a Reversible Path compmask ? */
@@ -963,18 +1302,23 @@ static osm_pr_item_t *pr_rcv_get_lid_pair_path(IN osm_sa_t * sa,
 	    !path_parms.reversible && (p_pr->num_path & 0x80)) {
 		OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
 			"Requested reversible path but failed to get one\n");
-		free(p_pr_item);
-		p_pr_item = NULL;
+		goto Exit;
+	}
+
+	p_path_rec = osm_sa_recs_add(p_recs);
+	if (p_path_rec == NULL) {
+		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F01: "
+			"Unable to allocate path record\n");
 		goto Exit;
 	}
 
 	pr_rcv_build_pr(sa, p_src_port, p_dest_port, p_dgid, src_lid_ho,
-			dest_lid_ho, preference, &path_parms,
-			&p_pr_item->path_rec);
+			dest_lid_ho, preference, &path_parms, p_path_rec);
+	found = TRUE;
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
-	return p_pr_item;
+	return found;
 }
 
 static void pr_rcv_get_port_pair_paths(IN osm_sa_t * sa,
@@ -983,11 +1327,11 @@ static void pr_rcv_get_port_pair_paths(IN osm_sa_t * sa,
 				       IN const osm_port_t * p_src_port,
 				       IN const osm_port_t * p_dest_port,
 				       IN const ib_gid_t * p_dgid,
-				       IN cl_qlist_t * p_list)
+				       IN osm_pr_batch_t * p_batch,
+				       IN osm_sa_recs_t * p_recs)
 {
 	const ib_path_rec_t *p_pr = ib_sa_mad_get_payload_ptr(sa_mad);
 	ib_net64_t comp_mask = sa_mad->comp_mask;
-	osm_pr_item_t *p_pr_item;
 	uint16_t src_lid_min_ho;
 	uint16_t src_lid_max_ho;
 	uint16_t dest_lid_min_ho;
@@ -1119,15 +1463,11 @@ static void pr_rcv_get_port_pair_paths(IN osm_sa_t * sa,
 		   These paths are "fully redundant"
 		 */
 
-		p_pr_item = pr_rcv_get_lid_pair_path(sa, p_pr, p_src_port,
-						     p_dest_port, p_dgid,
-						     src_lid_ho, dest_lid_ho,
-						     comp_mask, preference);
-
-		if (p_pr_item) {
-			cl_qlist_insert_tail(p_list, &p_pr_item->list_item);
+		if (pr_rcv_get_lid_pair_path(sa, p_pr, p_src_port,
+					     p_dest_port, p_dgid, src_lid_ho,
+					     dest_lid_ho, comp_mask,
+					     preference, p_batch, p_recs))
 			++path_num;
-		}
 
 		if (++src_lid_ho > src_lid_max_ho)
 			break;
@@ -1182,15 +1522,11 @@ static void pr_rcv_get_port_pair_paths(IN osm_sa_t * sa,
 		if (src_offset == dest_offset)
 			continue;	/* already reported */
 
-		p_pr_item = pr_rcv_get_lid_pair_path(sa, p_pr, p_src_port,
-						     p_dest_port, p_dgid,
-						     src_lid_ho, dest_lid_ho,
-						     comp_mask, preference);
-
-		if (p_pr_item) {
-			cl_qlist_insert_tail(p_list, &p_pr_item->list_item);
+		if (pr_rcv_get_lid_pair_path(sa, p_pr, p_src_port,
+					     p_dest_port, p_dgid, src_lid_ho,
+					     dest_lid_ho, comp_mask,
+					     preference, p_batch, p_recs))
 			++path_num;
-		}
 	}
 
 Exit:
@@ -1357,14 +1693,79 @@ Exit:
 	return sa_status;
 }
 
+/*
+ * Returns the switch a port is attached to: its own node for a switch
+ * port, the remote node of a CA or router port.
+ */
+static const osm_node_t *pr_port_leaf(IN const osm_port_t * p_port)
+{
+	const osm_physp_t *p_remote;
+
+	if (p_port->p_node->sw)
+		return p_port->p_node;
+
+	p_remote = osm_physp_get_remote(p_port->p_physp);
+	return p_remote ? osm_physp_get_node_ptr(p_remote) : NULL;
+}
+
+static int pr_compare_ports_by_leaf(IN const void *p1, IN const void *p2)
+{
+	const osm_port_t *p_port1 = *(const osm_port_t * const *)p1;
+	const osm_port_t *p_port2 = *(const osm_port_t * const *)p2;
+	const osm_node_t *p_leaf1 = pr_port_leaf(p_port1);
+	const osm_node_t *p_leaf2 = pr_port_leaf(p_port2);
+	uint64_t guid1, guid2;
+
+	guid1 = p_leaf1 ? cl_ntoh64(osm_node_get_node_guid(p_leaf1)) : 0;
+	guid2 = p_leaf2 ? cl_ntoh64(osm_node_get_node_guid(p_leaf2)) : 0;
+	if (guid1 == guid2) {
+		guid1 = cl_ntoh64(osm_port_get_guid(p_port1));
+		guid2 = cl_ntoh64(osm_port_get_guid(p_port2));
+	}
+
+	return guid1 < guid2 ? -1 : guid1 > guid2 ? 1 : 0;
+}
+
+/*
+ * Returns the ports of the subnet ordered by the switch they are attached
+ * to, so the ports sharing route segments in the batch are visited
+ * together, or NULL if there are none or on allocation failure.
+ */
+static const osm_port_t **pr_ports_by_leaf(IN osm_sa_t * sa,
+					   OUT unsigned *p_num_ports)
+{
+	const cl_qmap_t *p_tbl = &sa->p_subn->port_guid_tbl;
+	const osm_port_t **ports;
+	cl_map_item_t *item;
+	unsigned n = 0;
+
+	*p_num_ports = cl_qmap_count(p_tbl);
+	if (*p_num_ports == 0)
+		return NULL;
+
+	ports = malloc(*p_num_ports * sizeof(*ports));
+	if (!ports) {
+		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F26: "
+			"Unable to allocate the port array\n");
+		return NULL;
+	}
+
+	for (item = cl_qmap_head(p_tbl); item != cl_qmap_end(p_tbl);
+	     item = cl_qmap_next(item))
+		ports[n++] = (const osm_port_t *) item;
+
+	qsort(ports, n, sizeof(*ports), pr_compare_ports_by_leaf);
+	return ports;
+}
+
 static void pr_rcv_process_world(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 				 IN const osm_port_t * requester_port,
 				 IN const ib_gid_t * p_dgid,
-				 IN cl_qlist_t * p_list)
+				 IN osm_sa_recs_t * p_recs)
 {
-	const cl_qmap_t *p_tbl;
-	const osm_port_t *p_dest_port;
-	const osm_port_t *p_src_port;
+	const osm_port_t **ports;
+	osm_pr_batch_t batch;
+	unsigned num_ports, i, j;
 
 	OSM_LOG_ENTER(sa->p_log);
 
@@ -1375,28 +1776,30 @@ static void pr_rcv_process_world(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad
 
 	   We compute both A -> B and B -> A, since we don't have
 	   any check to determine the reversability of the paths.
+
+	   Ports are visited grouped by the switch they are attached to,
+	   so the routes from a switch to a LID are walked once for all
+	   of its ports.
 	 */
-	p_tbl = &sa->p_subn->port_guid_tbl;
+	ports = pr_ports_by_leaf(sa, &num_ports);
+	if (!ports)
+		goto Exit;
 
-	p_dest_port = (osm_port_t *) cl_qmap_head(p_tbl);
-	while (p_dest_port != (osm_port_t *) cl_qmap_end(p_tbl)) {
-		p_src_port = (osm_port_t *) cl_qmap_head(p_tbl);
-		while (p_src_port != (osm_port_t *) cl_qmap_end(p_tbl)) {
+	pr_batch_init(sa, num_ports, &batch);
+
+	for (i = 0; i < num_ports; i++)
+		for (j = 0; j < num_ports; j++) {
 			pr_rcv_get_port_pair_paths(sa, sa_mad, requester_port,
-						   p_src_port, p_dest_port,
-						   p_dgid, p_list);
+						   ports[j], ports[i], p_dgid,
+						   &batch, p_recs);
 			if (sa_mad->method == IB_MAD_METHOD_GET &&
-			    cl_qlist_count(p_list) > 0)
-				goto Exit;
-
-			p_src_port =
-			    (osm_port_t *) cl_qmap_next(&p_src_port->map_item);
+			    osm_sa_recs_count(p_recs) > 0)
+				goto Done;
 		}
 
-		p_dest_port =
-		    (osm_port_t *) cl_qmap_next(&p_dest_port->map_item);
-	}
-
+Done:
+	pr_batch_destroy(&batch);
+	free(ports);
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
 }
@@ -1406,10 +1809,11 @@ static void pr_rcv_process_half(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 				IN const osm_port_t * p_src_port,
 				IN const osm_port_t * p_dest_port,
 				IN const ib_gid_t * p_dgid,
-				IN cl_qlist_t * p_list)
+				IN osm_sa_recs_t * p_recs)
 {
 	const cl_qmap_t *p_tbl;
 	const osm_port_t *p_port;
+	osm_pr_batch_t batch;
 
 	OSM_LOG_ENTER(sa->p_log);
 
@@ -1417,39 +1821,35 @@ static void pr_rcv_process_half(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 	   Iterate over every port, looking for matches...
 	   A path record from a port to itself is legit, so no
 	   need to special case that one.
+
+	   The batch holds the routes to and from the fixed port for
+	   all the switches at once, so the ports need no grouping here.
 	 */
 	p_tbl = &sa->p_subn->port_guid_tbl;
 
-	if (p_src_port) {
+	pr_batch_init(sa, cl_qmap_count(p_tbl), &batch);
+
+	for (p_port = (osm_port_t *) cl_qmap_head(p_tbl);
+	     p_port != (osm_port_t *) cl_qmap_end(p_tbl);
+	     p_port = (osm_port_t *) cl_qmap_next(&p_port->map_item)) {
 		/*
-		   The src port if fixed, so iterate over destination ports.
+		   Either the src or the dest port is fixed,
+		   iterate over the other one.
 		 */
-		p_port = (osm_port_t *) cl_qmap_head(p_tbl);
-		while (p_port != (osm_port_t *) cl_qmap_end(p_tbl)) {
+		if (p_src_port)
 			pr_rcv_get_port_pair_paths(sa, sa_mad, requester_port,
-						   p_src_port, p_port, p_dgid,
-						   p_list);
-			if (sa_mad->method == IB_MAD_METHOD_GET &&
-			    cl_qlist_count(p_list) > 0)
-				break;
-			p_port = (osm_port_t *) cl_qmap_next(&p_port->map_item);
-		}
-	} else {
-		/*
-		   The dest port if fixed, so iterate over source ports.
-		 */
-		p_port = (osm_port_t *) cl_qmap_head(p_tbl);
-		while (p_port != (osm_port_t *) cl_qmap_end(p_tbl)) {
+						   p_src_port, p_port,
+						   p_dgid, &batch, p_recs);
+		else
 			pr_rcv_get_port_pair_paths(sa, sa_mad, requester_port,
-						   p_port, p_dest_port, p_dgid,
-						   p_list);
-			if (sa_mad->method == IB_MAD_METHOD_GET &&
-			    cl_qlist_count(p_list) > 0)
-				break;
-			p_port = (osm_port_t *) cl_qmap_next(&p_port->map_item);
-		}
+						   p_port, p_dest_port,
+						   p_dgid, &batch, p_recs);
+		if (sa_mad->method == IB_MAD_METHOD_GET &&
+		    osm_sa_recs_count(p_recs) > 0)
+			break;
 	}
 
+	pr_batch_destroy(&batch);
 	OSM_LOG_EXIT(sa->p_log);
 }
 
@@ -1458,12 +1858,12 @@ static void pr_rcv_process_pair(IN osm_sa_t * sa, IN const ib_sa_mad_t * sa_mad,
 				IN const osm_port_t * p_src_port,
 				IN const osm_port_t * p_dest_port,
 				IN const ib_gid_t * p_dgid,
-				IN cl_qlist_t * p_list)
+				IN osm_sa_recs_t * p_recs)
 {
 	OSM_LOG_ENTER(sa->p_log);
 
 	pr_rcv_get_port_pair_paths(sa, sa_mad, requester_port, p_src_port,
-				   p_dest_port, p_dgid, p_list);
+				   p_dest_port, p_dgid, NULL, p_recs);
 
 	OSM_LOG_EXIT(sa->p_log);
 }
@@ -1536,12 +1936,12 @@ Exit:
 }
 
 static void pr_process_multicast(osm_sa_t * sa, const ib_sa_mad_t *sa_mad,
-				 cl_qlist_t *list)
+				 osm_sa_recs_t *recs)
 {
 	ib_path_rec_t *pr = ib_sa_mad_get_payload_ptr(sa_mad);
 	osm_mgrp_t *mgrp;
 	ib_api_status_t status;
-	osm_pr_item_t *pr_item;
+	ib_path_rec_t *path_rec;
 	uint32_t flow_label;
 	uint8_t sl, hop_limit;
 
@@ -1565,34 +1965,33 @@ static void pr_process_multicast(osm_sa_t * sa, const ib_sa_mad_t *sa_mad,
 		return;
 	}
 
-	pr_item = malloc(sizeof(*pr_item));
-	if (pr_item == NULL) {
+	path_rec = osm_sa_recs_add(recs);
+	if (path_rec == NULL) {
 		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 1F18: "
 			"Unable to allocate path record for MC group\n");
 		return;
 	}
-	memset(pr_item, 0, sizeof(*pr_item));
 
 	/* Copy PathRecord request into response */
-	pr_item->path_rec = *pr;
+	*path_rec = *pr;
 
 	/* Now, use the MC info to cruft up the PathRecord response */
-	pr_item->path_rec.dgid = mgrp->mcmember_rec.mgid;
-	pr_item->path_rec.dlid = mgrp->mcmember_rec.mlid;
-	pr_item->path_rec.tclass = mgrp->mcmember_rec.tclass;
-	pr_item->path_rec.num_path = 1;
-	pr_item->path_rec.pkey = mgrp->mcmember_rec.pkey;
+	path_rec->dgid = mgrp->mcmember_rec.mgid;
+	path_rec->dlid = mgrp->mcmember_rec.mlid;
+	path_rec->tclass = mgrp->mcmember_rec.tclass;
+	path_rec->num_path = 1;
+	path_rec->pkey = mgrp->mcmember_rec.pkey;
 
 	/* MTU, rate, and packet lifetime should be exactly */
-	pr_item->path_rec.mtu = (2 << 6) | mgrp->mcmember_rec.mtu;
-	pr_item->path_rec.rate = (2 << 6) | mgrp->mcmember_rec.rate;
-	pr_item->path_rec.pkt_life = (2 << 6) | mgrp->mcmember_rec.pkt_life;
+	path_rec->mtu = (2 << 6) | mgrp->mcmember_rec.mtu;
+	path_rec->rate = (2 << 6) | mgrp->mcmember_rec.rate;
+	path_rec->pkt_life = (2 << 6) | mgrp->mcmember_rec.pkt_life;
 
 	/* SL, Hop Limit, and Flow Label */
 	ib_member_get_sl_flow_hop(mgrp->mcmember_rec.sl_flow_hop,
 				  &sl, &flow_label, &hop_limit);
-	ib_path_rec_set_sl(&pr_item->path_rec, sl);
-	ib_path_rec_set_qos_class(&pr_item->path_rec, 0);
+	ib_path_rec_set_sl(path_rec, sl);
+	ib_path_rec_set_qos_class(path_rec, 0);
 
 	/* HopLimit is not yet set in non link local MC groups */
 	/* If it were, this would not be needed */
@@ -1600,10 +1999,7 @@ static void pr_process_multicast(osm_sa_t * sa, const ib_sa_mad_t *sa_mad,
 	    IB_MC_SCOPE_LINK_LOCAL)
 		hop_limit = IB_HOPLIMIT_MAX;
 
-	pr_item->path_rec.hop_flow_raw =
-	    cl_hton32(hop_limit) | (flow_label << 8);
-
-	cl_qlist_insert_tail(list, &pr_item->list_item);
+	path_rec->hop_flow_raw = cl_hton32(hop_limit) | (flow_label << 8);
 }
 
 void osm_pr_rcv_process(IN void *context, IN void *data)
@@ -1612,7 +2008,7 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 	osm_madw_t *p_madw = data;
 	const ib_sa_mad_t *p_sa_mad = osm_madw_get_sa_mad_ptr(p_madw);
 	ib_path_rec_t *p_pr = ib_sa_mad_get_payload_ptr(p_sa_mad);
-	cl_qlist_t pr_list;
+	osm_sa_recs_t pr_recs;
 	const ib_gid_t *p_dgid = NULL;
 	const osm_port_t *p_src_port, *p_dest_port;
 	osm_port_t *requester_port;
@@ -1646,7 +2042,7 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 	if (osm_log_is_active(sa->p_log, OSM_LOG_DEBUG))
 		osm_dump_path_record(sa->p_log, p_pr, OSM_LOG_DEBUG);
 
-	cl_qlist_init(&pr_list);
+	osm_sa_recs_init(&pr_recs, sizeof(ib_path_rec_t));
 
 	/*
 	   Most SA functions (including this one) are read-only on the
@@ -1657,7 +2053,7 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 	/* Handle multicast destinations separately */
 	if ((p_sa_mad->comp_mask & IB_PR_COMPMASK_DGID) &&
 	    ib_gid_is_multicast(&p_pr->dgid)) {
-		pr_process_multicast(sa, p_sa_mad, &pr_list);
+		pr_process_multicast(sa, p_sa_mad, &pr_recs);
 		goto Unlock;
 	}
 
@@ -1674,27 +2070,27 @@ void osm_pr_rcv_process(IN void *context, IN void *data)
 		if (p_dest_port)
 			pr_rcv_process_pair(sa, p_sa_mad, requester_port,
 					    p_src_port, p_dest_port, p_dgid,
-					    &pr_list);
+					    &pr_recs);
 		else
 			pr_rcv_process_half(sa, p_sa_mad, requester_port,
-					    p_src_port, NULL, p_dgid, &pr_list);
+					    p_src_port, NULL, p_dgid, &pr_recs);
 	} else {
 		if (p_dest_port)
 			pr_rcv_process_half(sa, p_sa_mad, requester_port,
-					    NULL, p_dest_port, p_dgid, &pr_list);
+					    NULL, p_dest_port, p_dgid, &pr_recs);
 		else
 			/*
 			   Katie, bar the door!
 			 */
 			pr_rcv_process_world(sa, p_sa_mad, requester_port,
-					     p_dgid, &pr_list);
+					     p_dgid, &pr_recs);
 	}
 
 Unlock:
 	cl_plock_release(sa->p_lock);
 
 	/* Now, (finally) respond to the PathRecord request */
-	osm_sa_respond(sa, p_madw, sizeof(ib_path_rec_t), &pr_list);
+	osm_sa_respond_recs(sa, p_madw, &pr_recs);
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
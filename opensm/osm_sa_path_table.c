@@ -0,0 +1,520 @@
+/*
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *    Implementation of the SA precomputed path parameters table.
+ *
+ * Environment:
+ *    Linux User Mode
+ *
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <iba/ib_types.h>
+#include <complib/cl_qmap.h>
+#include <complib/cl_passivelock.h>
+#include <opensm/osm_sa.h>
+#include <opensm/osm_switch.h>
+#include <opensm/osm_node.h>
+#include <opensm/osm_port.h>
+#include <opensm/osm_helper.h>
+
+#define MAX_HOPS 64
+
+/*
+ * Packed table entry: valid bit, MTU, rate and the number of switches
+ * traversed. An entry describes the path from the egress port a switch
+ * uses for the LID up to and including the destination port, not
+ * counting the attributes of that egress port itself (these are
+ * accounted by the source port or the ingress step that led to it).
+ */
+#define PT_VALID	0x8000
+#define PT_MTU_SHIFT	12
+#define PT_MTU_MASK	0x7
+#define PT_RATE_SHIFT	6
+#define PT_RATE_MASK	0x3f
+#define PT_HOPS_MASK	0x3f
+
+#define PT_STATE_NONE	0
+#define PT_STATE_WALK	1
+#define PT_STATE_DONE	2
+
+typedef struct pt_parms {
+	uint8_t mtu;
+	uint8_t rate;
+	uint8_t hops;
+	uint16_t sl_mask;
+} pt_parms_t;
+
+static inline uint16_t pt_pack(IN const pt_parms_t * p)
+{
+	return PT_VALID | p->mtu << PT_MTU_SHIFT | p->rate << PT_RATE_SHIFT |
+	    p->hops;
+}
+
+static inline void pt_unpack(IN uint16_t e, OUT pt_parms_t * p)
+{
+	p->mtu = (e >> PT_MTU_SHIFT) & PT_MTU_MASK;
+	p->rate = (e >> PT_RATE_SHIFT) & PT_RATE_MASK;
+	p->hops = e & PT_HOPS_MASK;
+}
+
+static inline uint8_t pt_port_rate(IN const osm_physp_t * p_physp,
+				   IN const osm_physp_t * p_physp0)
+{
+	return ib_port_info_compute_rate(&p_physp->port_info,
+					 p_physp0->port_info.capability_mask &
+					 IB_PORT_CAP_HAS_EXT_SPEEDS);
+}
+
+/*
+ * Fold port attributes into p the same way the PathRecord walk does:
+ * on equal rates the earlier one wins, so folding is associative and
+ * partial results can be combined.
+ */
+static inline void pt_fold(IN OUT pt_parms_t * p, IN uint8_t mtu,
+			   IN uint8_t rate)
+{
+	if (p->mtu > mtu)
+		p->mtu = mtu;
+	if (ib_path_compare_rates(p->rate, rate) > 0)
+		p->rate = rate;
+}
+
+static void pt_fold_physp(IN OUT pt_parms_t * p,
+			  IN const osm_physp_t * p_physp,
+			  IN const osm_physp_t * p_physp0)
+{
+	pt_fold(p, ib_port_info_get_mtu_cap(&p_physp->port_info),
+		pt_port_rate(p_physp, p_physp0));
+}
+
+static uint16_t pt_slvl_mask(IN const osm_physp_t * p_physp,
+			     IN uint8_t in_port_num)
+{
+	ib_slvl_table_t *p_slvl_tbl;
+	uint16_t mask = 0;
+	uint8_t i;
+
+	p_slvl_tbl = osm_physp_get_slvl_tbl(p_physp, in_port_num);
+	for (i = 0; i < IB_MAX_NUM_VLS; i++)
+		if (ib_slvl_table_get(p_slvl_tbl, i) != IB_DROP_VL)
+			mask |= 1 << i;
+	return mask;
+}
+
+static inline unsigned pt_sw_row(IN const osm_sa_path_table_t * t,
+				 IN const osm_node_t * p_node)
+{
+	uint16_t lid_ho = cl_ntoh16(osm_node_get_base_lid(p_node, 0));
+
+	return lid_ho <= t->max_lid_ho ? t->sw_row[lid_ho] : 0;
+}
+
+static void path_table_free(IN osm_sa_path_table_t * t)
+{
+	if (!t)
+		return;
+	free(t->sw_row);
+	free(t->entries);
+	free(t->sl_masks);
+	free(t);
+}
+
+/*
+ * One step of the route from switch p_sw towards dest_lid: either the
+ * destination port is reached (returns 0 with its attributes in p) or
+ * the row + 1 of the next switch is returned with the attributes of
+ * that switch's ingress and egress ports in p. Returns -1 when the
+ * route is broken.
+ */
+static int pt_step(IN const osm_sa_path_table_t * t, IN boolean_t qos,
+		   IN osm_switch_t * p_sw, IN ib_net16_t dest_lid,
+		   IN const osm_physp_t * p_dest_physp, OUT pt_parms_t * p)
+{
+	const osm_physp_t *p_physp, *p_remote, *p_physp0;
+	const osm_node_t *p_node;
+	unsigned row;
+
+	p_physp = osm_switch_get_route_by_lid(p_sw, dest_lid);
+	if (!p_physp)
+		return -1;
+	if (p_physp != p_dest_physp) {
+		p_remote = osm_physp_get_remote(p_physp);
+		if (!p_remote)
+			return -1;
+		if (p_remote != p_dest_physp) {
+			p_node = osm_physp_get_node_ptr(p_remote);
+			if (!p_node->sw)
+				return -1;
+			row = pt_sw_row(t, p_node);
+			if (!row)
+				return -1;
+			p_physp = osm_switch_get_route_by_lid(p_node->sw,
+							      dest_lid);
+			if (!p_physp)
+				return -1;
+			p_physp0 = osm_node_get_physp_ptr((osm_node_t *)
+							  p_node, 0);
+			p->mtu = ib_port_info_get_mtu_cap(&p_remote->port_info);
+			p->rate = pt_port_rate(p_remote, p_physp0);
+			pt_fold_physp(p, p_physp, p_physp0);
+			p->sl_mask = qos ?
+			    pt_slvl_mask(p_physp, p_remote->port_num) : 0xffff;
+			p->hops = 1;
+			return row;
+		}
+	}
+
+	/* the destination port itself */
+	p->mtu = ib_port_info_get_mtu_cap(&p_dest_physp->port_info);
+	p->rate = pt_port_rate(p_dest_physp, p_dest_physp);
+	p->sl_mask = 0xffff;
+	p->hops = 0;
+	return 0;
+}
+
+/*
+ * Fill the column of dest_lid for all switches. Each switch has a
+ * single next switch towards the LID, so the routes form chains
+ * which are walked once: a switch's entry is its own step combined
+ * with the entry of the next switch.
+ */
+static void path_table_fill_lid(IN osm_sa_path_table_t * t,
+				IN osm_switch_t ** sws, IN boolean_t qos,
+				IN uint16_t dest_lid_ho,
+				IN const osm_physp_t * p_dest_physp,
+				IN uint8_t * state, IN unsigned *stack,
+				IN pt_parms_t * steps)
+{
+	ib_net16_t dest_lid = cl_hton16(dest_lid_ho);
+	size_t stride = t->max_lid_ho + 1;
+	pt_parms_t cur, next;
+	unsigned i, row, depth;
+	uint16_t e;
+	int n;
+
+	memset(state, PT_STATE_NONE, t->num_sw);
+
+	for (i = 0; i < t->num_sw; i++) {
+		if (state[i] != PT_STATE_NONE)
+			continue;
+
+		depth = 0;
+		row = i;
+		e = 0;
+		for (;;) {
+			state[row] = PT_STATE_WALK;
+			stack[depth] = row;
+			n = pt_step(t, qos, sws[row], dest_lid, p_dest_physp,
+				    &steps[depth]);
+			depth++;
+			if (n <= 0) {
+				e = n < 0 ? 0 : pt_pack(&steps[depth - 1]);
+				next = steps[depth - 1];
+				depth--;
+				t->entries[stack[depth] * stride + dest_lid_ho] = e;
+				if (t->sl_masks)
+					t->sl_masks[stack[depth] * stride +
+						    dest_lid_ho] =
+					    e ? next.sl_mask : 0;
+				state[stack[depth]] = PT_STATE_DONE;
+				break;
+			}
+			row = n - 1;
+			if (state[row] == PT_STATE_WALK) {
+				/* routing loop */
+				e = 0;
+				break;
+			}
+			if (state[row] == PT_STATE_DONE) {
+				e = t->entries[row * stride + dest_lid_ho];
+				if (e) {
+					pt_unpack(e, &next);
+					next.sl_mask = t->sl_masks ?
+					    t->sl_masks[row * stride +
+							dest_lid_ho] : 0xffff;
+				}
+				break;
+			}
+		}
+
+		/* unwind the chain combining each step with its successor */
+		while (depth) {
+			depth--;
+			row = stack[depth];
+			if (e) {
+				cur = steps[depth];
+				pt_fold(&cur, next.mtu, next.rate);
+				cur.hops += next.hops;
+				cur.sl_mask &= next.sl_mask;
+				if (cur.hops >= MAX_HOPS - 1 || !cur.sl_mask)
+					e = 0;
+				else {
+					e = pt_pack(&cur);
+					next = cur;
+				}
+			}
+			t->entries[row * stride + dest_lid_ho] = e;
+			if (t->sl_masks)
+				t->sl_masks[row * stride + dest_lid_ho] =
+				    e ? next.sl_mask : 0;
+			state[row] = PT_STATE_DONE;
+		}
+	}
+}
+
+static osm_sa_path_table_t *path_table_create(IN osm_sa_t * sa)
+{
+	osm_subn_t *p_subn = sa->p_subn;
+	cl_qmap_t *p_sw_tbl = &p_subn->sw_guid_tbl;
+	osm_sa_path_table_t *t;
+	osm_switch_t **sws = NULL;
+	osm_switch_t *p_sw;
+	osm_port_t *p_port;
+	const osm_physp_t *p_dest_physp;
+	uint8_t *state = NULL;
+	unsigned *stack = NULL;
+	pt_parms_t *steps = NULL;
+	uint16_t lid_ho;
+	unsigned i;
+
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		return NULL;
+
+	t->max_lid_ho = p_subn->max_ucast_lid_ho;
+	t->num_sw = cl_qmap_count(p_sw_tbl);
+	if (!t->num_sw || !t->max_lid_ho)
+		goto Error;
+
+	t->sw_row = calloc(t->max_lid_ho + 1, sizeof(*t->sw_row));
+	t->entries = calloc((size_t) t->num_sw * (t->max_lid_ho + 1),
+			    sizeof(*t->entries));
+	if (p_subn->opt.qos)
+		t->sl_masks = calloc((size_t) t->num_sw * (t->max_lid_ho + 1),
+				     sizeof(*t->sl_masks));
+	sws = malloc(t->num_sw * sizeof(*sws));
+	state = malloc(t->num_sw);
+	stack = malloc(t->num_sw * sizeof(*stack));
+	steps = malloc(t->num_sw * sizeof(*steps));
+	if (!t->sw_row || !t->entries || (p_subn->opt.qos && !t->sl_masks) ||
+	    !sws || !state || !stack || !steps)
+		goto Error;
+
+	i = 0;
+	for (p_sw = (osm_switch_t *) cl_qmap_head(p_sw_tbl);
+	     p_sw != (osm_switch_t *) cl_qmap_end(p_sw_tbl);
+	     p_sw = (osm_switch_t *) cl_qmap_next(&p_sw->map_item)) {
+		lid_ho = cl_ntoh16(osm_node_get_base_lid(p_sw->p_node, 0));
+		sws[i++] = p_sw;
+		if (lid_ho && lid_ho <= t->max_lid_ho)
+			t->sw_row[lid_ho] = i;
+	}
+
+	for (lid_ho = 1; lid_ho <= t->max_lid_ho; lid_ho++) {
+		p_port = osm_get_port_by_lid_ho(p_subn, lid_ho);
+		if (!p_port)
+			continue;
+		p_dest_physp = p_port->p_physp;
+		if (p_port->p_node->sw) {
+			p_dest_physp =
+			    osm_switch_get_route_by_lid(p_port->p_node->sw,
+							cl_hton16(lid_ho));
+			if (!p_dest_physp)
+				continue;
+		}
+		path_table_fill_lid(t, sws, p_subn->opt.qos, lid_ho,
+				    p_dest_physp, state, stack, steps);
+	}
+
+	free(sws);
+	free(state);
+	free(stack);
+	free(steps);
+	return t;
+
+Error:
+	free(sws);
+	free(state);
+	free(stack);
+	free(steps);
+	path_table_free(t);
+	return NULL;
+}
+
+void osm_sa_path_table_build(IN osm_sa_t * sa)
+{
+	osm_sa_path_table_t *t = NULL, *old;
+	uint32_t epoch;
+
+	OSM_LOG_ENTER(sa->p_log);
+
+	/*
+	 * Take the epoch first: a concurrent invalidation makes the new
+	 * table stale rather than letting it be used with newer data.
+	 */
+	cl_spinlock_acquire(&sa->pr_cache.lock);
+	epoch = sa->pr_cache.epoch;
+	cl_spinlock_release(&sa->pr_cache.lock);
+
+	if (sa->p_subn->opt.sa_path_table) {
+		CL_PLOCK_ACQUIRE(sa->p_lock);
+		t = path_table_create(sa);
+		CL_PLOCK_RELEASE(sa->p_lock);
+		if (!t)
+			OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 4C22: "
+				"cannot build path table, "
+				"PathRecords will be computed on demand\n");
+		else {
+			t->epoch = epoch;
+			OSM_LOG(sa->p_log, OSM_LOG_VERBOSE,
+				"Path table built for %u switches and "
+				"%u LIDs\n", t->num_sw, t->max_lid_ho);
+		}
+	}
+
+	CL_PLOCK_EXCL_ACQUIRE(sa->p_lock);
+	old = sa->path_table;
+	sa->path_table = t;
+	CL_PLOCK_RELEASE(sa->p_lock);
+
+	path_table_free(old);
+
+	OSM_LOG_EXIT(sa->p_log);
+}
+
+void osm_sa_path_table_destroy(IN osm_sa_t * sa)
+{
+	path_table_free(sa->path_table);
+	sa->path_table = NULL;
+}
+
+static boolean_t path_table_get(IN const osm_sa_path_table_t * t,
+				IN unsigned row, IN uint16_t dest_lid_ho,
+				OUT pt_parms_t * p)
+{
+	size_t i = (size_t) (row - 1) * (t->max_lid_ho + 1) + dest_lid_ho;
+	uint16_t e = t->entries[i];
+
+	if (!e)
+		return FALSE;
+	pt_unpack(e, p);
+	p->sl_mask = t->sl_masks ? t->sl_masks[i] : 0xffff;
+	return TRUE;
+}
+
+boolean_t osm_sa_path_table_lookup(IN osm_sa_t * sa,
+				   IN const osm_port_t * p_src_port,
+				   IN const osm_physp_t * p_dest_physp,
+				   IN uint16_t dest_lid_ho,
+				   OUT uint8_t * p_mtu, OUT uint8_t * p_rate,
+				   OUT uint16_t * p_sl_mask, OUT int *p_hops)
+{
+	const osm_sa_path_table_t *t = sa->path_table;
+	const osm_physp_t *p_src_physp = p_src_port->p_physp;
+	const osm_physp_t *p_physp, *p_remote, *p_physp0;
+	const osm_node_t *p_node;
+	boolean_t qos = sa->p_subn->opt.qos;
+	ib_net16_t dest_lid = cl_hton16(dest_lid_ho);
+	pt_parms_t path, rest;
+	uint32_t epoch;
+	unsigned row;
+
+	if (!t || dest_lid_ho > t->max_lid_ho || (qos && !t->sl_masks))
+		return FALSE;
+
+	cl_spinlock_acquire(&sa->pr_cache.lock);
+	epoch = sa->pr_cache.epoch;
+	cl_spinlock_release(&sa->pr_cache.lock);
+	if (t->epoch != epoch)
+		return FALSE;
+
+	path.mtu = ib_port_info_get_mtu_cap(&p_src_physp->port_info);
+	path.rate = pt_port_rate(p_src_physp, p_src_physp);
+	path.hops = 0;
+
+	p_node = osm_physp_get_node_ptr(p_src_physp);
+	if (p_node->sw) {
+		/* the source switch routes from its own egress port */
+		row = pt_sw_row(t, p_node);
+		p_physp = osm_switch_get_route_by_lid(p_node->sw, dest_lid);
+		if (!row || !p_physp)
+			return FALSE;
+		path.sl_mask = qos ? pt_slvl_mask(p_physp, 0) : 0xffff;
+	} else {
+		/* fold in the first switch behind the source port */
+		path.sl_mask = qos ? pt_slvl_mask(p_src_physp, 0) : 0xffff;
+		if (p_src_physp == p_dest_physp)
+			goto Done;
+		p_remote = osm_physp_get_remote(p_src_physp);
+		if (!p_remote || p_remote == p_dest_physp)
+			return FALSE;
+		p_node = osm_physp_get_node_ptr(p_remote);
+		if (!p_node->sw)
+			return FALSE;
+		row = pt_sw_row(t, p_node);
+		p_physp = osm_switch_get_route_by_lid(p_node->sw, dest_lid);
+		if (!row || !p_physp)
+			return FALSE;
+		p_physp0 = osm_node_get_physp_ptr((osm_node_t *) p_node, 0);
+		pt_fold_physp(&path, p_remote, p_physp0);
+		pt_fold_physp(&path, p_physp, p_physp0);
+		if (qos)
+			path.sl_mask &= pt_slvl_mask(p_physp,
+						     p_remote->port_num);
+		path.hops = 1;
+	}
+
+	if (!path_table_get(t, row, dest_lid_ho, &rest))
+		return FALSE;
+
+	pt_fold(&path, rest.mtu, rest.rate);
+	path.sl_mask &= rest.sl_mask;
+	path.hops += rest.hops;
+
+Done:
+	if (!path.sl_mask || path.hops >= MAX_HOPS - 1)
+		return FALSE;
+
+	*p_mtu = path.mtu;
+	*p_rate = path.rate;
+	*p_sl_mask = path.sl_mask;
+	if (p_hops)
+		*p_hops = path.hops;
+	return TRUE;
+}
@@ -50,16 +50,11 @@
 #include <opensm/osm_pkey.h>
 #include <opensm/osm_sa.h>
 
-typedef struct osm_pkey_item {
-	cl_list_item_t list_item;
-	ib_pkey_table_record_t rec;
-} osm_pkey_item_t;
-
 typedef struct osm_pkey_search_ctxt {
 	const ib_pkey_table_record_t *p_rcvd_rec;
 	ib_net64_t comp_mask;
 	uint16_t block_num;
-	cl_qlist_t *p_list;
+	osm_sa_recs_t *p_recs;
 	osm_sa_t *sa;
 	const osm_physp_t *p_req_physp;
 } osm_pkey_search_ctxt_t;
@@ -68,14 +63,14 @@ static void sa_pkey_create(IN osm_sa_t * sa, IN osm_physp_t * p_physp,
 			   IN osm_pkey_search_ctxt_t * p_ctxt,
 			   IN uint16_t block)
 {
-	osm_pkey_item_t *p_rec_item;
+	ib_pkey_table_record_t *p_rec;
 	uint16_t lid;
 	ib_pkey_table_t *tbl;
 
 	OSM_LOG_ENTER(sa->p_log);
 
-	p_rec_item = malloc(sizeof(*p_rec_item));
-	if (p_rec_item == NULL) {
+	p_rec = osm_sa_recs_add(p_ctxt->p_recs);
+	if (p_rec == NULL) {
 		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 4602: "
 			"rec_item alloc failed\n");
 		goto Exit;
@@ -92,11 +87,9 @@ static void sa_pkey_create(IN osm_sa_t * sa, IN osm_physp_t * p_physp,
 		cl_ntoh64(osm_physp_get_port_guid(p_physp)),
 		cl_ntoh16(lid), osm_physp_get_port_num(p_physp), block);
 
-	memset(p_rec_item, 0, sizeof(*p_rec_item));
-
-	p_rec_item->rec.lid = lid;
-	p_rec_item->rec.block_num = block;
-	p_rec_item->rec.port_num = osm_physp_get_port_num(p_physp);
+	p_rec->lid = lid;
+	p_rec->block_num = block;
+	p_rec->port_num = osm_physp_get_port_num(p_physp);
 	/* FIXME: There are ninf.PartitionCap or swinf.PartitionEnforcementCap
 	   pkey entries so everything in that range is a valid block number
 	   even if opensm is not using it. Return 0. However things outside
@@ -105,9 +98,7 @@ static void sa_pkey_create(IN osm_sa_t * sa, IN osm_physp_t * p_physp,
 	   this falsely triggers. */
 	tbl = osm_pkey_tbl_block_get(osm_physp_get_pkey_tbl(p_physp), block);
 	if (tbl)
-		p_rec_item->rec.pkey_tbl = *tbl;
-
-	cl_qlist_insert_tail(p_ctxt->p_list, &p_rec_item->list_item);
+		p_rec->pkey_tbl = *tbl;
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
@@ -216,7 +207,7 @@ void osm_pkey_rec_rcv_process(IN void *ctx, IN void *data)
 	const ib_sa_mad_t *p_rcvd_mad;
 	const ib_pkey_table_record_t *p_rcvd_rec;
 	const osm_port_t *p_port = NULL;
-	cl_qlist_t rec_list;
+	osm_sa_recs_t recs;
 	osm_pkey_search_ctxt_t context;
 	ib_net64_t comp_mask;
 	osm_physp_t *p_req_physp;
@@ -269,10 +260,10 @@ void osm_pkey_rec_rcv_process(IN void *ctx, IN void *data)
 		goto Exit;
 	}
 
-	cl_qlist_init(&rec_list);
+	osm_sa_recs_init(&recs, sizeof(ib_pkey_table_record_t));
 
 	context.p_rcvd_rec = p_rcvd_rec;
-	context.p_list = &rec_list;
+	context.p_recs = &recs;
 	context.comp_mask = p_rcvd_mad->comp_mask;
 	context.sa = sa;
 	context.block_num = cl_ntoh16(p_rcvd_rec->block_num);
@@ -305,7 +296,7 @@ void osm_pkey_rec_rcv_process(IN void *ctx, IN void *data)
 
 	cl_plock_release(sa->p_lock);
 
-	osm_sa_respond(sa, p_madw, sizeof(ib_pkey_table_record_t), &rec_list);
+	osm_sa_respond_recs(sa, p_madw, &recs);
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
@@ -58,34 +58,37 @@
 #include <opensm/osm_pkey.h>
 #include <opensm/osm_sa.h>
 
-typedef struct osm_pir_item {
-	cl_list_item_t list_item;
-	ib_portinfo_record_t rec;
-} osm_pir_item_t;
-
 typedef struct osm_pir_search_ctxt {
 	const ib_portinfo_record_t *p_rcvd_rec;
 	ib_net64_t comp_mask;
-	cl_qlist_t *p_list;
+	osm_sa_recs_t *p_recs;
 	osm_sa_t *sa;
 	const osm_physp_t *p_req_physp;
+	const osm_sa_snapshot_t *p_snap;
+	const osm_sa_snapshot_port_t *p_req_port;
 	boolean_t is_enhanced_comp_mask;
 } osm_pir_search_ctxt_t;
 
+/*
+ * cap_mask is the capability mask of the port, or of port 0 for switch
+ * ports, which tells whether the extended link speeds apply.
+ */
 static ib_api_status_t pir_rcv_new_pir(IN osm_sa_t * sa,
-				       IN const osm_physp_t * p_physp,
 				       IN osm_pir_search_ctxt_t * p_ctxt,
+				       IN const ib_port_info_t * p_port_info,
+				       IN ib_net32_t cap_mask,
+				       IN ib_net64_t port_guid,
+				       IN uint8_t port_num,
 				       IN ib_net16_t const lid)
 {
-	osm_pir_item_t *p_rec_item;
+	ib_portinfo_record_t *p_rec;
 	ib_port_info_t *p_pi;
-	osm_physp_t *p_physp0;
 	ib_api_status_t status = IB_SUCCESS;
 
 	OSM_LOG_ENTER(sa->p_log);
 
-	p_rec_item = malloc(sizeof(*p_rec_item));
-	if (p_rec_item == NULL) {
+	p_rec = osm_sa_recs_add(p_ctxt->p_recs);
+	if (p_rec == NULL) {
 		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 2102: "
 			"rec_item alloc failed\n");
 		status = IB_INSUFFICIENT_RESOURCES;
@@ -95,28 +98,19 @@ static ib_api_status_t pir_rcv_new_pir(IN osm_sa_t * sa,
 	OSM_LOG(sa->p_log, OSM_LOG_DEBUG,
 		"New PortInfoRecord: port 0x%016" PRIx64
 		", lid %u, port %u\n",
-		cl_ntoh64(osm_physp_get_port_guid(p_physp)),
-		cl_ntoh16(lid), osm_physp_get_port_num(p_physp));
-
-	memset(p_rec_item, 0, sizeof(*p_rec_item));
+		cl_ntoh64(port_guid), cl_ntoh16(lid), port_num);
 
-	p_rec_item->rec.lid = lid;
-	p_rec_item->rec.port_info = p_physp->port_info;
+	p_rec->lid = lid;
+	p_rec->port_info = *p_port_info;
 	if (p_ctxt->comp_mask & IB_PIR_COMPMASK_OPTIONS)
-		p_rec_item->rec.options = p_ctxt->p_rcvd_rec->options;
+		p_rec->options = p_ctxt->p_rcvd_rec->options;
 	if ((p_ctxt->comp_mask & IB_PIR_COMPMASK_OPTIONS) == 0 ||
 	    (p_ctxt->p_rcvd_rec->options & 0x80) == 0) {
 		/* Does requested port have an extended link speed active ? */
-		if (osm_node_get_type(p_physp->p_node) ==
-		    IB_NODE_TYPE_SWITCH) {
-			p_physp0 = osm_node_get_physp_ptr(p_physp->p_node, 0);
-			p_pi = &p_physp0->port_info;
-		} else
-			p_pi = (ib_port_info_t *) &p_physp->port_info;
-		if ((p_pi->capability_mask & IB_PORT_CAP_HAS_EXT_SPEEDS) > 0) {
-			if (ib_port_info_get_link_speed_ext_active(&p_physp->port_info)) {
+		if ((cap_mask & IB_PORT_CAP_HAS_EXT_SPEEDS) > 0) {
+			if (ib_port_info_get_link_speed_ext_active(p_port_info)) {
 				/* Add QDR bits to original link speed components */
-				p_pi = &p_rec_item->rec.port_info;
+				p_pi = &p_rec->port_info;
 				ib_port_info_set_link_speed_enabled(p_pi,
 								    ib_port_info_get_link_speed_enabled(p_pi) | IB_LINK_SPEED_ACTIVE_10);
 				p_pi->state_info1 =
@@ -128,37 +122,28 @@ static ib_api_status_t pir_rcv_new_pir(IN osm_sa_t * sa,
 			}
 		}
 	}
-	p_rec_item->rec.port_num = osm_physp_get_port_num(p_physp);
-
-	cl_qlist_insert_tail(p_ctxt->p_list, &p_rec_item->list_item);
+	p_rec->port_num = port_num;
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
 	return status;
 }
 
-static void sa_pir_create(IN osm_sa_t * sa, IN const osm_physp_t * p_physp,
-			  IN osm_pir_search_ctxt_t * p_ctxt)
+/*
+ * base_lid_ho and lmc are those of the port, or of port 0 for switch
+ * ports.
+ */
+static void pir_rcv_create(IN osm_sa_t * sa, IN osm_pir_search_ctxt_t * p_ctxt,
+			   IN const ib_port_info_t * p_port_info,
+			   IN ib_net32_t cap_mask, IN ib_net64_t port_guid,
+			   IN uint8_t port_num, IN uint16_t base_lid_ho,
+			   IN uint8_t lmc)
 {
-	uint8_t lmc;
 	uint16_t max_lid_ho;
-	uint16_t base_lid_ho;
 	uint16_t match_lid_ho;
-	osm_physp_t *p_node_physp;
 
 	OSM_LOG_ENTER(sa->p_log);
 
-	if (p_physp->p_node->sw) {
-		p_node_physp = osm_node_get_physp_ptr(p_physp->p_node, 0);
-		base_lid_ho = cl_ntoh16(osm_physp_get_base_lid(p_node_physp));
-		lmc =
-		    osm_switch_sp0_is_lmc_capable(p_physp->p_node->sw,
-						  sa->p_subn) ?
-		    osm_physp_get_lmc(p_node_physp) : 0;
-	} else {
-		lmc = osm_physp_get_lmc(p_physp);
-		base_lid_ho = cl_ntoh16(osm_physp_get_base_lid(p_physp));
-	}
 	max_lid_ho = (uint16_t) (base_lid_ho + (1 << lmc) - 1);
 
 	if (p_ctxt->comp_mask & IB_PIR_COMPMASK_LID) {
@@ -175,32 +160,53 @@ static void sa_pir_create(IN osm_sa_t * sa, IN const osm_physp_t * p_physp,
 			goto Exit;
 	}
 
-	pir_rcv_new_pir(sa, p_physp, p_ctxt, cl_hton16(base_lid_ho));
+	pir_rcv_new_pir(sa, p_ctxt, p_port_info, cap_mask, port_guid,
+			port_num, cl_hton16(base_lid_ho));
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
 }
 
-static void sa_pir_check_physp(IN osm_sa_t * sa, IN const osm_physp_t * p_physp,
-			       osm_pir_search_ctxt_t * p_ctxt)
+static void sa_pir_create(IN osm_sa_t * sa, IN const osm_physp_t * p_physp,
+			  IN osm_pir_search_ctxt_t * p_ctxt,
+			  IN ib_net32_t cap_mask)
+{
+	uint8_t lmc;
+	uint16_t base_lid_ho;
+	osm_physp_t *p_node_physp;
+
+	if (p_physp->p_node->sw) {
+		p_node_physp = osm_node_get_physp_ptr(p_physp->p_node, 0);
+		base_lid_ho = cl_ntoh16(osm_physp_get_base_lid(p_node_physp));
+		lmc =
+		    osm_switch_sp0_is_lmc_capable(p_physp->p_node->sw,
+						  sa->p_subn) ?
+		    osm_physp_get_lmc(p_node_physp) : 0;
+	} else {
+		lmc = osm_physp_get_lmc(p_physp);
+		base_lid_ho = cl_ntoh16(osm_physp_get_base_lid(p_physp));
+	}
+
+	pir_rcv_create(sa, p_ctxt, &p_physp->port_info, cap_mask,
+		       osm_physp_get_port_guid(p_physp),
+		       osm_physp_get_port_num(p_physp), base_lid_ho, lmc);
+}
+
+/*
+ * Checks a port against the PortInfo fields of the query; cap_mask as
+ * for pir_rcv_new_pir.
+ */
+static boolean_t pir_rcv_match(IN const osm_pir_search_ctxt_t * p_ctxt,
+			       IN const ib_port_info_t * p_pi,
+			       IN ib_net32_t cap_mask)
 {
 	const ib_portinfo_record_t *p_rcvd_rec;
 	ib_net64_t comp_mask;
 	const ib_port_info_t *p_comp_pi;
-	const ib_port_info_t *p_pi;
-	const osm_physp_t * p_physp0;
-	ib_net32_t cap_mask;
-
-	OSM_LOG_ENTER(sa->p_log);
 
 	p_rcvd_rec = p_ctxt->p_rcvd_rec;
 	comp_mask = p_ctxt->comp_mask;
 	p_comp_pi = &p_rcvd_rec->port_info;
-	p_pi = &p_physp->port_info;
-
-	osm_dump_port_info(sa->p_log, osm_node_get_node_guid(p_physp->p_node),
-			   p_physp->port_guid, p_physp->port_num,
-			   &p_physp->port_info, OSM_LOG_DEBUG);
 
 	/* We have to re-check the base_lid, since if the given
 	   base_lid in p_pi is zero - we are comparing on all ports. */
@@ -417,11 +423,6 @@ static void sa_pir_check_physp(IN osm_sa_t * sa, IN const osm_physp_t * p_physp,
 				goto Exit;
 		}
 	}
-	if (osm_node_get_type(p_physp->p_node) == IB_NODE_TYPE_SWITCH) {
-		p_physp0 = osm_node_get_physp_ptr(p_physp->p_node, 0);
-		cap_mask = p_physp0->port_info.capability_mask;
-	} else
-		cap_mask = p_pi->capability_mask;
 	if (comp_mask & IB_PIR_COMPMASK_LINKSPDEXTACT) {
 		if (((cap_mask & IB_PORT_CAP_HAS_EXT_SPEEDS) > 0) &&
 		    (ib_port_info_get_link_speed_ext_active(p_comp_pi) !=
@@ -440,12 +441,65 @@ static void sa_pir_check_physp(IN osm_sa_t * sa, IN const osm_physp_t * p_physp,
 		     ib_port_info_get_link_speed_ext_enabled(p_pi)))
 			goto Exit;
 	}
-	sa_pir_create(sa, p_physp, p_ctxt);
+	return TRUE;
 
 Exit:
+	return FALSE;
+}
+
+static void sa_pir_check_physp(IN osm_sa_t * sa, IN const osm_physp_t * p_physp,
+			       osm_pir_search_ctxt_t * p_ctxt)
+{
+	const osm_physp_t *p_physp0;
+	ib_net32_t cap_mask;
+
+	OSM_LOG_ENTER(sa->p_log);
+
+	osm_dump_port_info(sa->p_log, osm_node_get_node_guid(p_physp->p_node),
+			   p_physp->port_guid, p_physp->port_num,
+			   &p_physp->port_info, OSM_LOG_DEBUG);
+
+	if (osm_node_get_type(p_physp->p_node) == IB_NODE_TYPE_SWITCH) {
+		p_physp0 = osm_node_get_physp_ptr(p_physp->p_node, 0);
+		cap_mask = p_physp0->port_info.capability_mask;
+	} else
+		cap_mask = p_physp->port_info.capability_mask;
+
+	if (pir_rcv_match(p_ctxt, &p_physp->port_info, cap_mask))
+		sa_pir_create(sa, p_physp, p_ctxt, cap_mask);
+
 	OSM_LOG_EXIT(sa->p_log);
 }
 
+/*
+ * Same as sa_pir_check_physp() for a port of the subnet snapshot.
+ */
+static void sa_pir_check_snap_port(IN osm_sa_t * sa,
+				   IN const osm_sa_snapshot_node_t * p_node,
+				   IN const osm_sa_snapshot_port_t * p_port,
+				   osm_pir_search_ctxt_t * p_ctxt)
+{
+	const osm_sa_snapshot_port_t *p_port0 = p_port;
+	ib_net32_t cap_mask;
+	uint8_t lmc;
+
+	osm_dump_port_info(sa->p_log, p_node->node_info.node_guid,
+			   p_port->port_guid, p_port->port_num,
+			   &p_port->port_info, OSM_LOG_DEBUG);
+
+	if (p_node->node_info.node_type == IB_NODE_TYPE_SWITCH) {
+		p_port0 = &p_ctxt->p_snap->ports[p_node->ports];
+		lmc = p_node->sp0_lmc_capable ? p_port0->lmc : 0;
+	} else
+		lmc = p_port->lmc;
+	cap_mask = p_port0->port_info.capability_mask;
+
+	if (pir_rcv_match(p_ctxt, &p_port->port_info, cap_mask))
+		pir_rcv_create(sa, p_ctxt, &p_port->port_info, cap_mask,
+			       p_port->port_guid, p_port->port_num,
+			       cl_ntoh16(p_port0->base_lid), lmc);
+}
+
 static void sa_pir_by_comp_mask(IN osm_sa_t * sa, IN osm_node_t * p_node,
 				osm_pir_search_ctxt_t * p_ctxt)
 {
@@ -503,6 +557,57 @@ static void sa_pir_by_comp_mask_cb(IN cl_map_item_t * p_map_item, IN void *cxt)
 	sa_pir_by_comp_mask(p_ctxt->sa, p_node, p_ctxt);
 }
 
+/*
+ * Same as sa_pir_by_comp_mask() for a node of the subnet snapshot.
+ */
+static void sa_pir_snap_by_comp_mask(IN osm_sa_t * sa,
+				     IN const osm_sa_snapshot_node_t * p_node,
+				     osm_pir_search_ctxt_t * p_ctxt)
+{
+	const osm_sa_snapshot_t *p_snap = p_ctxt->p_snap;
+	const osm_sa_snapshot_port_t *p_port;
+	uint8_t port_num;
+
+	for (port_num = 0; port_num < p_node->num_ports; port_num++) {
+		if ((p_ctxt->comp_mask & IB_PIR_COMPMASK_PORTNUM) &&
+		    port_num != p_ctxt->p_rcvd_rec->port_num)
+			continue;
+
+		p_port = &p_snap->ports[p_node->ports + port_num];
+		if (!p_port->valid ||
+		    !osm_sa_snapshot_share_pkey(p_snap, p_ctxt->p_req_port,
+						p_port))
+			continue;
+
+		sa_pir_check_snap_port(sa, p_node, p_port, p_ctxt);
+	}
+}
+
+static void sa_pir_snap_search(IN osm_sa_t * sa,
+			       osm_pir_search_ctxt_t * p_ctxt)
+{
+	const osm_sa_snapshot_t *p_snap = p_ctxt->p_snap;
+	const osm_sa_snapshot_port_t *p_port;
+	uint32_t i;
+
+	if (p_ctxt->comp_mask &
+	    (IB_PIR_COMPMASK_LID | IB_PIR_COMPMASK_BASELID)) {
+		p_port = osm_sa_snapshot_get_port_by_lid(p_snap,
+							 p_ctxt->p_rcvd_rec->
+							 lid);
+		if (p_port)
+			sa_pir_snap_by_comp_mask(sa,
+						 &p_snap->nodes[p_port->node],
+						 p_ctxt);
+		else
+			OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 2109: "
+				"No port found with LID %u\n",
+				cl_ntoh16(p_ctxt->p_rcvd_rec->lid));
+	} else
+		for (i = 0; i < p_snap->num_nodes; i++)
+			sa_pir_snap_by_comp_mask(sa, &p_snap->nodes[i], p_ctxt);
+}
+
 void osm_pir_rcv_process(IN void *ctx, IN void *data)
 {
 	osm_sa_t *sa = ctx;
@@ -510,10 +615,12 @@ void osm_pir_rcv_process(IN void *ctx, IN void *data)
 	const ib_sa_mad_t *p_rcvd_mad;
 	const ib_portinfo_record_t *p_rcvd_rec;
 	const osm_port_t *p_port = NULL;
-	cl_qlist_t rec_list;
+	osm_sa_recs_t recs;
 	osm_pir_search_ctxt_t context;
 	ib_net64_t comp_mask;
-	osm_physp_t *p_req_physp;
+	osm_physp_t *p_req_physp = NULL;
+	osm_sa_snapshot_t *p_snap = NULL;
+	const osm_sa_snapshot_port_t *p_req_port = NULL;
 
 	CL_ASSERT(sa);
 
@@ -538,11 +645,19 @@ void osm_pir_rcv_process(IN void *ctx, IN void *data)
 		goto Exit;
 	}
 
+	/* use the subnet snapshot if there is one */
+	p_snap = osm_sa_snapshot_get(sa);
+
 	/* update the requester physical port. */
-	p_req_physp = osm_get_physp_by_mad_addr(sa->p_log, sa->p_subn,
-						osm_madw_get_mad_addr_ptr
-						(p_madw));
-	if (p_req_physp == NULL) {
+	if (p_snap)
+		p_req_port = osm_sa_snapshot_get_port_by_lid(p_snap,
+							     osm_madw_get_mad_addr_ptr
+							     (p_madw)->dest_lid);
+	else
+		p_req_physp = osm_get_physp_by_mad_addr(sa->p_log, sa->p_subn,
+							osm_madw_get_mad_addr_ptr
+							(p_madw));
+	if (p_req_physp == NULL && p_req_port == NULL) {
 		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 2104: "
 			"Cannot find requester physical port\n");
 		goto Exit;
@@ -551,35 +666,44 @@ void osm_pir_rcv_process(IN void *ctx, IN void *data)
 	if (osm_log_is_active(sa->p_log, OSM_LOG_DEBUG))
 		osm_dump_portinfo_record(sa->p_log, p_rcvd_rec, OSM_LOG_DEBUG);
 
-	cl_qlist_init(&rec_list);
+	osm_sa_recs_init(&recs, sizeof(ib_portinfo_record_t));
 
 	context.p_rcvd_rec = p_rcvd_rec;
-	context.p_list = &rec_list;
+	context.p_recs = &recs;
 	context.comp_mask = p_rcvd_mad->comp_mask;
 	context.sa = sa;
 	context.p_req_physp = p_req_physp;
+	context.p_snap = p_snap;
+	context.p_req_port = p_req_port;
 	context.is_enhanced_comp_mask =
 	    cl_ntoh32(p_rcvd_mad->attr_mod) & (1 << 31);
 
-	cl_plock_acquire(sa->p_lock);
+	if (p_snap)
+		sa_pir_snap_search(sa, &context);
+	else {
+		cl_plock_acquire(sa->p_lock);
 
-	/*
-	   If the user specified a LID, it obviously narrows our
-	   work load, since we don't have to search every port
-	 */
-	if (comp_mask & (IB_PIR_COMPMASK_LID | IB_PIR_COMPMASK_BASELID)) {
-		p_port = osm_get_port_by_lid(sa->p_subn, p_rcvd_rec->lid);
-		if (p_port)
-			sa_pir_by_comp_mask(sa, p_port->p_node, &context);
-		else
-			OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 2109: "
-				"No port found with LID %u\n",
-				cl_ntoh16(p_rcvd_rec->lid));
-	} else
-		cl_qmap_apply_func(&sa->p_subn->node_guid_tbl,
-				   sa_pir_by_comp_mask_cb, &context);
+		/*
+		   If the user specified a LID, it obviously narrows our
+		   work load, since we don't have to search every port
+		 */
+		if (comp_mask &
+		    (IB_PIR_COMPMASK_LID | IB_PIR_COMPMASK_BASELID)) {
+			p_port = osm_get_port_by_lid(sa->p_subn,
+						     p_rcvd_rec->lid);
+			if (p_port)
+				sa_pir_by_comp_mask(sa, p_port->p_node,
+						    &context);
+			else
+				OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 2109: "
+					"No port found with LID %u\n",
+					cl_ntoh16(p_rcvd_rec->lid));
+		} else
+			cl_qmap_apply_func(&sa->p_subn->node_guid_tbl,
+					   sa_pir_by_comp_mask_cb, &context);
 
-	cl_plock_release(sa->p_lock);
+		cl_plock_release(sa->p_lock);
+	}
 
 	/*
 	   p922 - The M_Key returned shall be zero, except in the case of a
@@ -589,15 +713,16 @@ void osm_pir_rcv_process(IN void *ctx, IN void *data)
 	   sm_key.
 	 */
 	if (!p_rcvd_mad->sm_key) {
-		osm_pir_item_t *item;
-		for (item = (osm_pir_item_t *) cl_qlist_head(&rec_list);
-		     item != (osm_pir_item_t *) cl_qlist_end(&rec_list);
-		     item = (osm_pir_item_t *) cl_qlist_next(&item->list_item))
-			item->rec.port_info.m_key = 0;
+		ib_portinfo_record_t *rec = (ib_portinfo_record_t *) recs.buf;
+		unsigned i;
+		for (i = 0; i < osm_sa_recs_count(&recs); i++)
+			rec[i].port_info.m_key = 0;
 	}
 
-	osm_sa_respond(sa, p_madw, sizeof(ib_portinfo_record_t), &rec_list);
+	osm_sa_respond_recs(sa, p_madw, &recs);
 
 Exit:
+	if (p_snap)
+		osm_sa_snapshot_put(p_snap);
 	OSM_LOG_EXIT(sa->p_log);
 }
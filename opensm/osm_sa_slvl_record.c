@@ -57,16 +57,11 @@
 #include <opensm/osm_pkey.h>
 #include <opensm/osm_sa.h>
 
-typedef struct osm_slvl_item {
-	cl_list_item_t list_item;
-	ib_slvl_table_record_t rec;
-} osm_slvl_item_t;
-
 typedef struct osm_slvl_search_ctxt {
 	const ib_slvl_table_record_t *p_rcvd_rec;
 	ib_net64_t comp_mask;
 	uint8_t in_port_num;
-	cl_qlist_t *p_list;
+	osm_sa_recs_t *p_recs;
 	osm_sa_t *sa;
 	const osm_physp_t *p_req_physp;
 } osm_slvl_search_ctxt_t;
@@ -75,13 +70,13 @@ static void sa_slvl_create(IN osm_sa_t * sa, IN const osm_physp_t * p_physp,
 			   IN osm_slvl_search_ctxt_t * p_ctxt,
 			   IN uint8_t in_port_idx)
 {
-	osm_slvl_item_t *p_rec_item;
+	ib_slvl_table_record_t *p_rec;
 	uint16_t lid;
 
 	OSM_LOG_ENTER(sa->p_log);
 
-	p_rec_item = malloc(sizeof(*p_rec_item));
-	if (p_rec_item == NULL) {
+	p_rec = osm_sa_recs_add(p_ctxt->p_recs);
+	if (p_rec == NULL) {
 		OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 2602: "
 			"rec_item alloc failed\n");
 		goto Exit;
@@ -98,16 +93,12 @@ static void sa_slvl_create(IN osm_sa_t * sa, IN const osm_physp_t * p_physp,
 		cl_ntoh64(osm_physp_get_port_guid(p_physp)),
 		cl_ntoh16(lid), osm_physp_get_port_num(p_physp), in_port_idx);
 
-	memset(p_rec_item, 0, sizeof(*p_rec_item));
-
-	p_rec_item->rec.lid = lid;
-	p_rec_item->rec.out_port_num = osm_physp_get_port_num(p_physp);
-	p_rec_item->rec.in_port_num = in_port_idx;
-	p_rec_item->rec.slvl_tbl =
+	p_rec->lid = lid;
+	p_rec->out_port_num = osm_physp_get_port_num(p_physp);
+	p_rec->in_port_num = in_port_idx;
+	p_rec->slvl_tbl =
 	    *(osm_physp_get_slvl_tbl(p_physp, in_port_idx));
 
-	cl_qlist_insert_tail(p_ctxt->p_list, &p_rec_item->list_item);
-
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
 }
@@ -200,7 +191,7 @@ void osm_slvl_rec_rcv_process(IN void *ctx, IN void *data)
 	const ib_sa_mad_t *p_rcvd_mad;
 	const ib_slvl_table_record_t *p_rcvd_rec;
 	const osm_port_t *p_port = NULL;
-	cl_qlist_t rec_list;
+	osm_sa_recs_t recs;
 	osm_slvl_search_ctxt_t context;
 	ib_api_status_t status = IB_SUCCESS;
 	ib_net64_t comp_mask;
@@ -239,10 +230,10 @@ void osm_slvl_rec_rcv_process(IN void *ctx, IN void *data)
 		goto Exit;
 	}
 
-	cl_qlist_init(&rec_list);
+	osm_sa_recs_init(&recs, sizeof(ib_slvl_table_record_t));
 
 	context.p_rcvd_rec = p_rcvd_rec;
-	context.p_list = &rec_list;
+	context.p_recs = &recs;
 	context.comp_mask = p_rcvd_mad->comp_mask;
 	context.sa = sa;
 	context.in_port_num = p_rcvd_rec->in_port_num;
@@ -285,7 +276,7 @@ void osm_slvl_rec_rcv_process(IN void *ctx, IN void *data)
 
 	cl_plock_release(sa->p_lock);
 
-	osm_sa_respond(sa, p_madw, sizeof(ib_slvl_table_record_t), &rec_list);
+	osm_sa_respond_recs(sa, p_madw, &recs);
 
 Exit:
 	OSM_LOG_EXIT(sa->p_log);
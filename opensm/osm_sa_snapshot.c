@@ -0,0 +1,314 @@
+/*
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *    Implementation of the SA subnet snapshot.
+ *
+ * Environment:
+ *    Linux User Mode
+ *
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <iba/ib_types.h>
+#include <complib/cl_qmap.h>
+#include <complib/cl_map.h>
+#include <complib/cl_atomic.h>
+#include <complib/cl_passivelock.h>
+#include <opensm/osm_sa.h>
+#include <opensm/osm_switch.h>
+#include <opensm/osm_node.h>
+#include <opensm/osm_port.h>
+#include <opensm/osm_pkey.h>
+
+static void snapshot_free(IN osm_sa_snapshot_t * p_snap)
+{
+	free(p_snap->nodes);
+	free(p_snap->ports);
+	free(p_snap->sws);
+	free(p_snap->lids);
+	free(p_snap->pkeys);
+	free(p_snap->lfts);
+	free(p_snap);
+}
+
+static void snapshot_copy_physp(IN osm_sa_snapshot_t * p_snap,
+				IN const osm_physp_t * p_physp,
+				IN osm_sa_snapshot_port_t * p_port,
+				IN OUT uint32_t * p_num_pkeys)
+{
+	const osm_pkey_tbl_t *p_tbl = osm_physp_get_pkey_tbl(p_physp);
+	cl_map_iterator_t it;
+
+	p_port->valid = TRUE;
+	p_port->port_info = p_physp->port_info;
+	p_port->port_num = osm_physp_get_port_num(p_physp);
+	p_port->port_guid = osm_physp_get_port_guid(p_physp);
+	p_port->base_lid = osm_physp_get_base_lid(p_physp);
+	p_port->lmc = osm_physp_get_lmc(p_physp);
+
+	/* the keys map is sorted by PKey base, keep that order */
+	p_port->pkeys = *p_num_pkeys;
+	for (it = cl_map_head(&p_tbl->keys); it != cl_map_end(&p_tbl->keys);
+	     it = cl_map_next(it))
+		p_snap->pkeys[(*p_num_pkeys)++] =
+		    *(ib_net16_t *) cl_map_obj(it);
+	p_port->num_pkeys = (uint16_t) (*p_num_pkeys - p_port->pkeys);
+}
+
+static void snapshot_map_lids(IN osm_sa_snapshot_t * p_snap,
+			      IN const osm_subn_t * p_subn,
+			      IN const osm_physp_t * p_physp,
+			      IN uint32_t index)
+{
+	osm_port_t *p_port;
+	uint16_t min_lid_ho, max_lid_ho, lid_ho;
+
+	p_port = osm_get_port_by_guid(p_subn, osm_physp_get_port_guid(p_physp));
+	if (!p_port || p_port->p_physp != p_physp)
+		return;
+
+	osm_port_get_lid_range_ho(p_port, &min_lid_ho, &max_lid_ho);
+	for (lid_ho = min_lid_ho;
+	     lid_ho && lid_ho <= max_lid_ho && lid_ho <= p_snap->max_lid_ho;
+	     lid_ho++)
+		if (osm_get_port_by_lid_ho(p_subn, lid_ho) == p_port)
+			p_snap->lids[lid_ho] = index + 1;
+}
+
+static osm_sa_snapshot_t *snapshot_create(IN osm_subn_t * p_subn)
+{
+	cl_qmap_t *p_node_tbl = &p_subn->node_guid_tbl;
+	cl_qmap_t *p_sw_tbl = &p_subn->sw_guid_tbl;
+	osm_sa_snapshot_t *p_snap;
+	osm_sa_snapshot_node_t *p_snode;
+	osm_sa_snapshot_switch_t *p_ssw;
+	osm_node_t *p_node;
+	osm_switch_t *p_sw;
+	osm_physp_t *p_physp;
+	uint32_t num_pkeys = 0;
+	size_t lfts_size = 0;
+	size_t vector_size;
+	uint32_t n, i;
+	uint8_t port_num;
+
+	p_snap = calloc(1, sizeof(*p_snap));
+	if (!p_snap)
+		return NULL;
+
+	p_snap->num_nodes = cl_qmap_count(p_node_tbl);
+	p_snap->num_sws = cl_qmap_count(p_sw_tbl);
+	vector_size = cl_ptr_vector_get_size(&p_subn->port_lid_tbl);
+	p_snap->max_lid_ho = vector_size ? (uint16_t) (vector_size - 1) : 0;
+
+	for (p_node = (osm_node_t *) cl_qmap_head(p_node_tbl);
+	     p_node != (osm_node_t *) cl_qmap_end(p_node_tbl);
+	     p_node = (osm_node_t *) cl_qmap_next(&p_node->map_item)) {
+		p_snap->num_ports += osm_node_get_num_physp(p_node);
+		for (port_num = 0; port_num < osm_node_get_num_physp(p_node);
+		     port_num++) {
+			p_physp = osm_node_get_physp_ptr(p_node, port_num);
+			if (p_physp)
+				num_pkeys += cl_map_count(&osm_physp_get_pkey_tbl
+							  (p_physp)->keys);
+		}
+	}
+	for (p_sw = (osm_switch_t *) cl_qmap_head(p_sw_tbl);
+	     p_sw != (osm_switch_t *) cl_qmap_end(p_sw_tbl);
+	     p_sw = (osm_switch_t *) cl_qmap_next(&p_sw->map_item))
+		lfts_size += p_sw->max_lid_ho + 1;
+
+	p_snap->nodes = calloc(p_snap->num_nodes + 1, sizeof(*p_snap->nodes));
+	p_snap->ports = calloc(p_snap->num_ports + 1, sizeof(*p_snap->ports));
+	p_snap->sws = calloc(p_snap->num_sws + 1, sizeof(*p_snap->sws));
+	p_snap->lids = calloc(p_snap->max_lid_ho + 1, sizeof(*p_snap->lids));
+	p_snap->pkeys = malloc((num_pkeys + 1) * sizeof(*p_snap->pkeys));
+	p_snap->lfts = malloc(lfts_size + 1);
+	if (!p_snap->nodes || !p_snap->ports || !p_snap->sws ||
+	    !p_snap->lids || !p_snap->pkeys || !p_snap->lfts) {
+		snapshot_free(p_snap);
+		return NULL;
+	}
+
+	num_pkeys = 0;
+	i = 0;
+	p_snode = p_snap->nodes;
+	for (p_node = (osm_node_t *) cl_qmap_head(p_node_tbl);
+	     p_node != (osm_node_t *) cl_qmap_end(p_node_tbl);
+	     p_node = (osm_node_t *) cl_qmap_next(&p_node->map_item)) {
+		p_snode->node_info = p_node->node_info;
+		p_snode->node_desc = p_node->node_desc;
+		p_snode->ports = i;
+		p_snode->num_ports = osm_node_get_num_physp(p_node);
+		p_snode->sp0_lmc_capable = p_node->sw &&
+		    osm_switch_sp0_is_lmc_capable(p_node->sw, p_subn);
+		for (port_num = 0; port_num < p_snode->num_ports;
+		     port_num++, i++) {
+			p_physp = osm_node_get_physp_ptr(p_node, port_num);
+			if (!p_physp)
+				continue;
+			snapshot_copy_physp(p_snap, p_physp, &p_snap->ports[i],
+					    &num_pkeys);
+			p_snap->ports[i].node =
+			    (uint32_t) (p_snode - p_snap->nodes);
+			/* switches are addressed through port 0 only */
+			if (!p_node->sw || port_num == 0)
+				snapshot_map_lids(p_snap, p_subn, p_physp, i);
+		}
+		p_snode++;
+	}
+
+	/*
+	 * Both tables are keyed by node GUID, so the switch nodes are
+	 * found by walking them side by side.
+	 */
+	lfts_size = 0;
+	n = 0;
+	p_ssw = p_snap->sws;
+	p_node = (osm_node_t *) cl_qmap_head(p_node_tbl);
+	for (p_sw = (osm_switch_t *) cl_qmap_head(p_sw_tbl);
+	     p_sw != (osm_switch_t *) cl_qmap_end(p_sw_tbl);
+	     p_sw = (osm_switch_t *) cl_qmap_next(&p_sw->map_item)) {
+		while (p_node != p_sw->p_node &&
+		       p_node != (osm_node_t *) cl_qmap_end(p_node_tbl)) {
+			p_node = (osm_node_t *) cl_qmap_next(&p_node->map_item);
+			n++;
+		}
+		if (p_node == (osm_node_t *) cl_qmap_end(p_node_tbl)) {
+			snapshot_free(p_snap);
+			return NULL;
+		}
+		p_ssw->node = n;
+		p_ssw->max_block = osm_switch_get_max_block_id_in_use(p_sw);
+		p_ssw->max_lid_ho = p_sw->max_lid_ho;
+		p_ssw->lft = lfts_size;
+		memcpy(p_snap->lfts + lfts_size, p_sw->lft,
+		       p_sw->max_lid_ho + 1);
+		lfts_size += p_sw->max_lid_ho + 1;
+		p_ssw++;
+	}
+
+	p_snap->ref_cnt = 1;
+	return p_snap;
+}
+
+void osm_sa_snapshot_publish(IN osm_sa_t * sa)
+{
+	osm_sa_snapshot_t *p_snap = NULL, *p_old;
+
+	OSM_LOG_ENTER(sa->p_log);
+
+	if (sa->p_subn->opt.sa_snapshot) {
+		CL_PLOCK_ACQUIRE(sa->p_lock);
+		p_snap = snapshot_create(sa->p_subn);
+		CL_PLOCK_RELEASE(sa->p_lock);
+		if (!p_snap)
+			OSM_LOG(sa->p_log, OSM_LOG_ERROR, "ERR 4C23: "
+				"cannot take subnet snapshot, SA records "
+				"will be taken from the subnet\n");
+		else
+			OSM_LOG(sa->p_log, OSM_LOG_VERBOSE,
+				"Subnet snapshot taken: %u nodes, %u switches\n",
+				p_snap->num_nodes, p_snap->num_sws);
+	}
+
+	cl_spinlock_acquire(&sa->snapshot_lock);
+	p_old = sa->snapshot;
+	sa->snapshot = p_snap;
+	cl_spinlock_release(&sa->snapshot_lock);
+
+	if (p_old)
+		osm_sa_snapshot_put(p_old);
+
+	OSM_LOG_EXIT(sa->p_log);
+}
+
+osm_sa_snapshot_t *osm_sa_snapshot_get(IN osm_sa_t * sa)
+{
+	osm_sa_snapshot_t *p_snap;
+
+	cl_spinlock_acquire(&sa->snapshot_lock);
+	p_snap = sa->snapshot;
+	if (p_snap)
+		cl_atomic_inc(&p_snap->ref_cnt);
+	cl_spinlock_release(&sa->snapshot_lock);
+
+	return p_snap;
+}
+
+void osm_sa_snapshot_put(IN osm_sa_snapshot_t * p_snap)
+{
+	if (cl_atomic_dec(&p_snap->ref_cnt) == 0)
+		snapshot_free(p_snap);
+}
+
+boolean_t osm_sa_snapshot_share_pkey(IN const osm_sa_snapshot_t * p_snap,
+				     IN const osm_sa_snapshot_port_t * p_port1,
+				     IN const osm_sa_snapshot_port_t * p_port2)
+{
+	const ib_net16_t *pkey1, *pkey2, *end1, *end2;
+	uint16_t base1, base2;
+
+	if (p_port1 == p_port2)
+		return TRUE;
+
+	/* same as osm_physp_share_pkey: no PKey table means no check */
+	if (!p_port1->num_pkeys || !p_port2->num_pkeys)
+		return TRUE;
+
+	pkey1 = &p_snap->pkeys[p_port1->pkeys];
+	end1 = pkey1 + p_port1->num_pkeys;
+	pkey2 = &p_snap->pkeys[p_port2->pkeys];
+	end2 = pkey2 + p_port2->num_pkeys;
+
+	while (pkey1 != end1 && pkey2 != end2) {
+		base1 = ib_pkey_get_base(*pkey1);
+		base2 = ib_pkey_get_base(*pkey2);
+		if (base1 == base2) {
+			if (ib_pkey_is_full_member(*pkey1) ||
+			    ib_pkey_is_full_member(*pkey2))
+				return TRUE;
+			pkey1++;
+			pkey2++;
+		} else if (base2 < base1)
+			pkey2++;
+		else
+			pkey1++;
+	}
+
+	return FALSE;
+}
@@ -244,7 +244,7 @@ ib_api_status_t osm_sm_init(IN osm_sm_t * p_sm, IN osm_subn_t * p_subn,
 			    IN osm_db_t * p_db, IN osm_vendor_t * p_vendor,
 			    IN osm_mad_pool_t * p_mad_pool,
 			    IN osm_vl15_t * p_vl15, IN osm_log_t * p_log,
-			    IN osm_stats_t * p_stats,
+			    IN osm_stats_t * p_stats, IN osm_trace_t * p_trace,
 			    IN cl_dispatcher_t * p_disp, IN cl_plock_t * p_lock)
 {
 	ib_api_status_t status;
@@ -296,8 +296,8 @@ ib_api_status_t osm_sm_init(IN osm_sm_t * p_sm, IN osm_subn_t * p_subn,
 
 	status = osm_sm_mad_ctrl_init(&p_sm->mad_ctrl, p_sm->p_subn,
 				      p_sm->p_mad_pool, p_sm->p_vl15,
-				      p_sm->p_vendor,
-				      p_log, p_stats, p_lock, p_disp);
+				      p_sm->p_vendor, p_log, p_stats, p_trace,
+				      p_lock, p_disp);
 	if (status != IB_SUCCESS)
 		goto Exit;
 
@@ -148,7 +148,9 @@ static void sm_mad_ctrl_disp_done_callback(IN void *context, IN void *p_data)
  *
  * SYNOPSIS
  */
-static void sm_mad_ctrl_update_wire_stats(IN osm_sm_mad_ctrl_t * p_ctrl)
+static void sm_mad_ctrl_update_wire_stats(IN osm_sm_mad_ctrl_t * p_ctrl,
+					  IN const osm_madw_t * p_req_madw,
+					  IN boolean_t timed_out)
 {
 	uint32_t mads_on_wire;
 
@@ -165,6 +167,7 @@ static void sm_mad_ctrl_update_wire_stats(IN osm_sm_mad_ctrl_t * p_ctrl)
 	   We can signal the VL15 controller to send another MAD
 	   if any are waiting for transmission.
 	 */
+	osm_vl15_complete(p_ctrl->p_vl15, p_req_madw, timed_out);
 	osm_vl15_poll(p_ctrl->p_vl15);
 	OSM_LOG_EXIT(p_ctrl->p_log);
 }
@@ -203,7 +206,7 @@ static void sm_mad_ctrl_process_get_resp(IN osm_sm_mad_ctrl_t * p_ctrl,
 
 	p_old_madw = transaction_context;
 
-	sm_mad_ctrl_update_wire_stats(p_ctrl);
+	sm_mad_ctrl_update_wire_stats(p_ctrl, p_old_madw, FALSE);
 
 	/*
 	   Copy the MAD Wrapper context from the requesting MAD
@@ -648,6 +651,10 @@ static void sm_mad_ctrl_rcv_callback(IN osm_madw_t * p_madw,
 	if (osm_log_is_active(p_ctrl->p_log, OSM_LOG_FRAMES))
 		osm_dump_dr_smp(p_ctrl->p_log, p_smp, OSM_LOG_FRAMES);
 
+	if (osm_trace_is_active(p_ctrl->p_trace))
+		osm_trace_mad(p_ctrl->p_trace,
+			      OSM_TRACE_EVENT_SMP_RCV, p_madw, p_req_madw);
+
 	if (p_smp->mgmt_class == IB_MCLASS_SUBN_DIR)
 		status = ib_smp_get_status(p_smp);
 	else
@@ -787,7 +794,7 @@ static void sm_mad_ctrl_send_err_cb(IN void *context, IN osm_madw_t * p_madw)
 	   An error occurred.  No response was received to a request MAD.
 	   Retire the original request MAD.
 	 */
-	sm_mad_ctrl_update_wire_stats(p_ctrl);
+	sm_mad_ctrl_update_wire_stats(p_ctrl, p_madw, TRUE);
 
 	if (osm_madw_get_err_msg(p_madw) != CL_DISP_MSGID_NONE) {
 		OSM_LOG(p_ctrl->p_log, OSM_LOG_DEBUG,
@@ -843,6 +850,7 @@ ib_api_status_t osm_sm_mad_ctrl_init(IN osm_sm_mad_ctrl_t * p_ctrl,
 				     IN osm_vendor_t * p_vendor,
 				     IN osm_log_t * p_log,
 				     IN osm_stats_t * p_stats,
+				     IN osm_trace_t * p_trace,
 				     IN cl_plock_t * p_lock,
 				     IN cl_dispatcher_t * p_disp)
 {
@@ -858,6 +866,7 @@ ib_api_status_t osm_sm_mad_ctrl_init(IN osm_sm_mad_ctrl_t * p_ctrl,
 	p_ctrl->p_mad_pool = p_mad_pool;
 	p_ctrl->p_vendor = p_vendor;
 	p_ctrl->p_stats = p_stats;
+	p_ctrl->p_trace = p_trace;
 	p_ctrl->p_lock = p_lock;
 	p_ctrl->p_vl15 = p_vl15;
 
@@ -844,7 +844,7 @@ Exit:
 }
 
 /**********************************************************************
- * Send Trap 64 on all new ports.
+ * Send Trap 64 on all new ports and report the ports to the PerfMgr.
  **********************************************************************/
 static void state_mgr_report_new_ports(IN osm_sm_t * sm)
 {
@@ -865,6 +865,11 @@ static void state_mgr_report_new_ports(IN osm_sm_t * sm)
 		p_port = (osm_port_t *) p_next;
 		p_next = cl_qmap_next(p_next);
 
+#ifdef ENABLE_OSM_PERF_MGR
+		/* new nodes and LID changes, now that the LIDs are set */
+		osm_perfmgr_report_port(&sm->p_subn->p_osm->perfmgr, p_port);
+#endif
+
 		if (!p_port->is_new)
 			continue;
 
@@ -1165,6 +1170,7 @@ static void do_sweep(osm_sm_t * sm)
 		}
 
 		rc = osm_ucast_mgr_process(&sm->ucast_mgr);
+		osm_sa_pr_cache_invalidate(&sm->p_subn->p_osm->sa);
 
 		if (qlogic_adaptive_routing_enabled(sm->p_subn)) {
 			/* clear AR pause */
@@ -1180,6 +1186,7 @@ static void do_sweep(osm_sm_t * sm)
 		}
 
 		osm_qos_setup(sm->p_subn->p_osm);
+		osm_sa_pr_cache_invalidate(&sm->p_subn->p_osm->sa);
 
 		/* Reset flag */
 		sm->p_subn->ignore_existing_lfts = FALSE;
@@ -1188,8 +1195,12 @@ static void do_sweep(osm_sm_t * sm)
 			return;
 
 		if (!sm->p_subn->subnet_initialization_error) {
+			/* drop paths cached while the switches were updated */
+			osm_sa_pr_cache_invalidate(&sm->p_subn->p_osm->sa);
 			OSM_LOG_MSG_BOX(sm->p_log, OSM_LOG_VERBOSE,
 					"REROUTE COMPLETE");
+			osm_sa_path_table_build(&sm->p_subn->p_osm->sa);
+			osm_sa_snapshot_publish(&sm->p_subn->p_osm->sa);
 			osm_opensm_report_event(sm->p_subn->p_osm,
 				OSM_EVENT_ID_UCAST_ROUTING_DONE, NULL);
 			return;
@@ -1367,6 +1378,7 @@ repeat_discovery:
 		}
 
 		rc = osm_ucast_mgr_process(&sm->ucast_mgr);
+		osm_sa_pr_cache_invalidate(&sm->p_subn->p_osm->sa);
 
 		if (qlogic_adaptive_routing_enabled(sm->p_subn)) {
 			/* clear AR pause */
@@ -1380,6 +1392,7 @@ repeat_discovery:
 	}
 
 	osm_qos_setup(sm->p_subn->p_osm);
+	osm_sa_pr_cache_invalidate(&sm->p_subn->p_osm->sa);
 
 	if (wait_for_pending_transactions(&sm->p_subn->p_osm->stats))
 		return;
@@ -1435,6 +1448,11 @@ repeat_discovery:
 	 * The sweep completed!
 	 */
 
+	/* path parameters may have changed with the new port states */
+	osm_sa_pr_cache_invalidate(&sm->p_subn->p_osm->sa);
+	osm_sa_path_table_build(&sm->p_subn->p_osm->sa);
+	osm_sa_snapshot_publish(&sm->p_subn->p_osm->sa);
+
 	/*
 	 * Send trap 64 on newly discovered endports
 	 */
@@ -1475,6 +1493,19 @@ repeat_discovery:
 		osm_sm_signal(sm, OSM_SIGNAL_SWEEP);
 }
 
+static void state_mgr_report_io_stats(IN osm_sm_t * sm)
+{
+#ifdef OSM_VENDOR_INTF_OPENIB
+	umad_io_stats_t io;
+
+	osm_vendor_get_io_stats(sm->p_vendor, &io);
+	OSM_LOG(sm->p_log, OSM_LOG_VERBOSE,
+		"Sweep MAD I/O: %u MADs received in %u recv calls and "
+		"%u wakeups, %d send calls\n", io.recv_mads, io.recv_calls,
+		io.recv_polls, io.send_calls);
+#endif
+}
+
 static void do_process_mgrp_queue(osm_sm_t * sm)
 {
 	if (sm->p_subn->sm_state != IB_SMINFO_STATE_MASTER)
@@ -1502,8 +1533,10 @@ void osm_state_mgr_process(IN osm_sm_t * sm, IN osm_signal_t signal)
 				"ignoring signal %s in state %s\n",
 				osm_get_sm_signal_str(signal),
 				osm_get_sm_mgr_state_str(sm->p_subn->sm_state));
-		} else
+		} else {
 			do_sweep(sm);
+			state_mgr_report_io_stats(sm);
+		}
 		break;
 	case OSM_SIGNAL_IDLE_TIME_PROCESS_REQUEST:
 		do_process_mgrp_queue(sm);
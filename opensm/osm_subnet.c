@@ -303,6 +303,8 @@ static const opt_rec_t opt_tbl[] = {
 	{ "max_wire_smps", OPT_OFFSET(max_wire_smps), opts_parse_uint32, NULL, 1 },
 	{ "max_wire_smps2", OPT_OFFSET(max_wire_smps2), opts_parse_uint32, NULL, 1 },
 	{ "max_smps_timeout", OPT_OFFSET(max_smps_timeout), opts_parse_uint32, NULL, 1 },
+	{ "adaptive_wire_smps", OPT_OFFSET(adaptive_wire_smps), opts_parse_boolean, NULL, 0 },
+	{ "vl15_threads", OPT_OFFSET(vl15_threads), opts_parse_uint32, NULL, 0 },
 	{ "console", OPT_OFFSET(console), opts_parse_charp, NULL, 0 },
 	{ "console_port", OPT_OFFSET(console_port), opts_parse_uint16, NULL, 0 },
 	{ "transaction_timeout", OPT_OFFSET(transaction_timeout), opts_parse_uint32, NULL, 0 },
@@ -347,6 +349,9 @@ static const opt_rec_t opt_tbl[] = {
 	{ "log_flags", OPT_OFFSET(log_flags), opts_parse_uint8, opts_setup_log_flags, 1 },
 	{ "force_log_flush", OPT_OFFSET(force_log_flush), opts_parse_boolean, opts_setup_force_log_flush, 1 },
 	{ "accum_log_file", OPT_OFFSET(accum_log_file), opts_parse_boolean, opts_setup_accum_log_file, 1 },
+	{ "log_async", OPT_OFFSET(log_async), opts_parse_boolean, NULL, 0 },
+	{ "trace_file", OPT_OFFSET(trace_file), opts_parse_charp, NULL, 0 },
+	{ "trace_size", OPT_OFFSET(trace_size), opts_parse_uint32, NULL, 0 },
 	{ "partition_config_file", OPT_OFFSET(partition_config_file), opts_parse_charp, NULL, 0 },
 	{ "no_partition_enforcement", OPT_OFFSET(no_partition_enforcement), opts_parse_boolean, NULL, 1 },
 	{ "qos", OPT_OFFSET(qos), opts_parse_boolean, NULL, 1 },
@@ -360,11 +365,16 @@ static const opt_rec_t opt_tbl[] = {
 	{ "port_shifting", OPT_OFFSET(port_shifting), opts_parse_boolean, NULL, 1 },
 	{ "remote_guid_sorting", OPT_OFFSET(remote_guid_sorting), opts_parse_boolean, NULL, 1 },
 	{ "scatter_ports", OPT_OFFSET(scatter_ports), opts_parse_uint32, NULL, 0 },
+	{ "routing_threads", OPT_OFFSET(routing_threads), opts_parse_uint32, NULL, 1 },
+	{ "bfs_lid_matrices", OPT_OFFSET(bfs_lid_matrices), opts_parse_charp, NULL, 1 },
 	{ "max_reverse_hops", OPT_OFFSET(max_reverse_hops), opts_parse_uint16, NULL, 0 },
 	{ "ids_guid_file", OPT_OFFSET(ids_guid_file), opts_parse_charp, NULL, 0 },
 	{ "guid_routing_order_file", OPT_OFFSET(guid_routing_order_file), opts_parse_charp, NULL, 0 },
 	{ "sa_db_file", OPT_OFFSET(sa_db_file), opts_parse_charp, NULL, 0 },
 	{ "sa_db_dump", OPT_OFFSET(sa_db_dump), opts_parse_boolean, NULL, 1 },
+	{ "sa_pr_cache_size", OPT_OFFSET(sa_pr_cache_size), opts_parse_uint32, NULL, 0 },
+	{ "sa_path_table", OPT_OFFSET(sa_path_table), opts_parse_boolean, NULL, 1 },
+	{ "sa_snapshot", OPT_OFFSET(sa_snapshot), opts_parse_boolean, NULL, 1 },
 	{ "torus_config", OPT_OFFSET(torus_conf_file), opts_parse_charp, NULL, 1 },
 	{ "do_mesh_analysis", OPT_OFFSET(do_mesh_analysis), opts_parse_boolean, NULL, 1 },
 	{ "exit_on_fatal", OPT_OFFSET(exit_on_fatal), opts_parse_boolean, NULL, 1 },
@@ -381,6 +391,12 @@ static const opt_rec_t opt_tbl[] = {
 	{ "perfmgr_ignore_cas", OPT_OFFSET(perfmgr_ignore_cas), opts_parse_boolean, NULL, 0 },
 	{ "event_db_dump_file", OPT_OFFSET(event_db_dump_file), opts_parse_charp, NULL, 0 },
 	{ "perfmgr_rm_nodes", OPT_OFFSET(perfmgr_rm_nodes), opts_parse_boolean, NULL, 0 },
+	{ "perfmgr_all_port_select", OPT_OFFSET(perfmgr_all_port_select), opts_parse_boolean, NULL, 0 },
+	{ "perfmgr_all_port_full_sweeps", OPT_OFFSET(perfmgr_all_port_full_sweeps), opts_parse_uint16, NULL, 0 },
+	{ "perfmgr_pacing", OPT_OFFSET(perfmgr_pacing), opts_parse_boolean, NULL, 0 },
+	{ "perfmgr_history_file", OPT_OFFSET(perfmgr_history_file), opts_parse_charp, NULL, 0 },
+	{ "perfmgr_history_retention_s", OPT_OFFSET(perfmgr_history_retention_s), opts_parse_uint32, NULL, 0 },
+	{ "perfmgr_history_ports", OPT_OFFSET(perfmgr_history_ports), opts_parse_uint32, NULL, 0 },
 #endif				/* ENABLE_OSM_PERF_MGR */
 	{ "event_plugin_name", OPT_OFFSET(event_plugin_name), opts_parse_charp, NULL, 0 },
 	{ "event_plugin_options", OPT_OFFSET(event_plugin_options), opts_parse_charp, NULL, 0 },
@@ -730,6 +746,8 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 	p_opt->transaction_retries = OSM_DEFAULT_RETRY_COUNT;
 	p_opt->max_smps_timeout = 1000 * p_opt->transaction_timeout *
 				  p_opt->transaction_retries;
+	p_opt->adaptive_wire_smps = FALSE;
+	p_opt->vl15_threads = OSM_DEFAULT_VL15_THREADS;
 	/* by default we will consider waiting for 50x transaction timeout normal */
 	p_opt->max_msg_fifo_timeout = 50 * OSM_DEFAULT_TRANS_TIMEOUT_MILLISEC;
 	p_opt->sm_priority = OSM_DEFAULT_SM_PRIORITY;
@@ -774,6 +792,14 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 	p_opt->perfmgr_ignore_cas = FALSE;
 	p_opt->event_db_dump_file = NULL; /* use default */
 	p_opt->perfmgr_rm_nodes = TRUE;
+	p_opt->perfmgr_all_port_select = FALSE;
+	p_opt->perfmgr_all_port_full_sweeps =
+	    OSM_PERFMGR_DEFAULT_ALL_PORT_FULL_SWEEPS;
+	p_opt->perfmgr_pacing = FALSE;
+	p_opt->perfmgr_history_file = NULL;
+	p_opt->perfmgr_history_retention_s =
+	    OSM_PERFMGR_DEFAULT_HISTORY_RETENTION_S;
+	p_opt->perfmgr_history_ports = OSM_PERFMGR_DEFAULT_HISTORY_PORTS;
 #endif				/* ENABLE_OSM_PERF_MGR */
 
 	p_opt->event_plugin_name = NULL;
@@ -791,6 +817,9 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 	p_opt->qos = FALSE;
 	p_opt->qos_policy_file = strdup(OSM_DEFAULT_QOS_POLICY_FILE);
 	p_opt->accum_log_file = TRUE;
+	p_opt->log_async = FALSE;
+	p_opt->trace_file = NULL;
+	p_opt->trace_size = OSM_DEFAULT_TRACE_SIZE;
 	p_opt->port_prof_ignore_file = NULL;
 	p_opt->hop_weights_file = NULL;
 	p_opt->port_search_ordering_file = NULL;
@@ -807,11 +836,16 @@ void osm_subn_set_default_opt(IN osm_subn_opt_t * p_opt)
 	p_opt->port_shifting = FALSE;
 	p_opt->remote_guid_sorting = FALSE;
 	p_opt->scatter_ports = OSM_DEFAULT_SCATTER_PORTS;
+	p_opt->routing_threads = OSM_DEFAULT_ROUTING_THREADS;
+	p_opt->bfs_lid_matrices = NULL;
 	p_opt->max_reverse_hops = 0;
 	p_opt->ids_guid_file = NULL;
 	p_opt->guid_routing_order_file = NULL;
 	p_opt->sa_db_file = NULL;
 	p_opt->sa_db_dump = FALSE;
+	p_opt->sa_pr_cache_size = OSM_DEFAULT_SA_PR_CACHE_SIZE;
+	p_opt->sa_path_table = FALSE;
+	p_opt->sa_snapshot = FALSE;
 	p_opt->torus_conf_file = strdup(OSM_DEFAULT_TORUS_CONF_FILE);
 	p_opt->do_mesh_analysis = FALSE;
 	p_opt->exit_on_fatal = TRUE;
@@ -1255,6 +1289,30 @@ int osm_subn_verify_config(IN osm_subn_opt_t * p_opts)
 		p_opts->perfmgr_max_outstanding_queries =
 		    OSM_PERFMGR_DEFAULT_MAX_OUTSTANDING_QUERIES;
 	}
+	if (p_opts->perfmgr_all_port_full_sweeps < 1) {
+		log_report(" Invalid Cached Option Value:"
+			   "perfmgr_all_port_full_sweeps = %u"
+			   " Using Default:%u\n",
+			   p_opts->perfmgr_all_port_full_sweeps,
+			   OSM_PERFMGR_DEFAULT_ALL_PORT_FULL_SWEEPS);
+		p_opts->perfmgr_all_port_full_sweeps =
+		    OSM_PERFMGR_DEFAULT_ALL_PORT_FULL_SWEEPS;
+	}
+	/* the summed reads would leave the rate samples unevenly spaced */
+	if (p_opts->perfmgr_pacing && p_opts->perfmgr_all_port_select) {
+		log_report(" perfmgr_all_port_select is not supported"
+			   " with perfmgr_pacing, disabling it\n");
+		p_opts->perfmgr_all_port_select = FALSE;
+	}
+	if (p_opts->perfmgr_history_ports < 1) {
+		log_report(" Invalid Cached Option Value:"
+			   "perfmgr_history_ports = %u"
+			   " Using Default:%u\n",
+			   p_opts->perfmgr_history_ports,
+			   OSM_PERFMGR_DEFAULT_HISTORY_PORTS);
+		p_opts->perfmgr_history_ports =
+		    OSM_PERFMGR_DEFAULT_HISTORY_PORTS;
+	}
 #endif
 
 	return 0;
@@ -1629,6 +1687,20 @@ int osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"scatter_ports %d\n\n",
 		p_opts->scatter_ports);
 
+	fprintf(out,
+		"# Number of threads used to build the min hop tables and LFTs\n"
+		"# (1 keeps it serial, 0 uses one thread per processor)\n"
+		"routing_threads %u\n\n",
+		p_opts->routing_threads);
+
+	fprintf(out,
+		"# Comma separated list of the routing engines (minhop, dor,\n"
+		"# updn, ...) whose min hop tables are built with one BFS per\n"
+		"# destination switch instead of iterative neighbor relaxation\n"
+		"bfs_lid_matrices %s\n\n",
+		p_opts->bfs_lid_matrices ?
+		p_opts->bfs_lid_matrices : null_str);
+
 	fprintf(out,
 		"# SA database file name\nsa_db_file %s\n\n",
 		p_opts->sa_db_file ? p_opts->sa_db_file : null_str);
@@ -1639,6 +1711,26 @@ int osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"sa_db_dump %s\n\n",
 		p_opts->sa_db_dump ? "TRUE" : "FALSE");
 
+	fprintf(out,
+		"# Number of entries in the SA PathRecord path parameters cache\n"
+		"# (0 disables the cache)\n"
+		"sa_pr_cache_size %u\n\n",
+		p_opts->sa_pr_cache_size);
+
+	fprintf(out,
+		"# Precompute the path parameters of every switch to LID pair\n"
+		"# after each heavy sweep or reroute for PathRecord queries\n"
+		"sa_path_table %s\n\n",
+		p_opts->sa_path_table ? "TRUE" : "FALSE");
+
+	fprintf(out,
+		"# Answer NodeRecord, LFTRecord and PortInfoRecord queries from\n"
+		"# a snapshot of the subnet taken after each heavy sweep or\n"
+		"# reroute, so they are not blocked by a running sweep. Other\n"
+		"# SA queries, PathRecord included, still wait for the sweep\n"
+		"sa_snapshot %s\n\n",
+		p_opts->sa_snapshot ? "TRUE" : "FALSE");
+
 	fprintf(out,
 		"# Torus-2QoS configuration file name\ntorus_config %s\n\n",
 		p_opts->torus_conf_file ? p_opts->torus_conf_file : null_str);
@@ -1672,6 +1764,12 @@ int osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"max_wire_smps2 %u\n\n"
 		"# The timeout in [usec] used for sending SMPs above max_wire_smps limit and below max_wire_smps2 limit\n"
 		"max_smps_timeout %u\n\n"
+		"# Adapt the number of SMPs sent in parallel per port to the\n"
+		"# response times, between 1 and max_wire_smps2\n"
+		"adaptive_wire_smps %s\n\n"
+		"# Number of threads sending SMPs (1 to 16), SMPs to the\n"
+		"# same destination are always sent by the same thread\n"
+		"vl15_threads %u\n\n"
 		"# The maximum time in [msec] allowed for a transaction to complete\n"
 		"transaction_timeout %u\n\n"
 		"# The maximum number of retries allowed for a transaction to complete\n"
@@ -1686,6 +1784,8 @@ int osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		p_opts->max_wire_smps,
 		p_opts->max_wire_smps2,
 		p_opts->max_smps_timeout,
+		p_opts->adaptive_wire_smps ? "TRUE" : "FALSE",
+		p_opts->vl15_threads,
 		p_opts->transaction_timeout,
 		p_opts->transaction_retries,
 		p_opts->max_msg_fifo_timeout,
@@ -1719,13 +1819,34 @@ int osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"perfmgr_max_outstanding_queries %u\n"
 		"perfmgr_ignore_cas %s\n\n"
 		"# Remove missing nodes from DB\n"
-		"perfmgr_rm_nodes %s\n",
+		"perfmgr_rm_nodes %s\n\n"
+		"# Use the summed counters of switches supporting AllPortSelect\n"
+		"# to skip querying their ports while no errors are counted\n"
+		"perfmgr_all_port_select %s\n\n"
+		"# Query the ports of such switches at least every N sweeps\n"
+		"perfmgr_all_port_full_sweeps %u\n\n"
+		"# Spread the queries of each sweep over the sweep time\n"
+		"# (disables perfmgr_all_port_select)\n"
+		"perfmgr_pacing %s\n\n"
+		"# Counter history file (null disables the history)\n"
+		"perfmgr_history_file %s\n\n"
+		"# Seconds of history kept per port\n"
+		"perfmgr_history_retention_s %u\n\n"
+		"# Number of ports kept in the history file\n"
+		"perfmgr_history_ports %u\n",
 		p_opts->perfmgr ? "TRUE" : "FALSE",
 		p_opts->perfmgr_redir ? "TRUE" : "FALSE",
 		p_opts->perfmgr_sweep_time_s,
 		p_opts->perfmgr_max_outstanding_queries,
 		p_opts->perfmgr_ignore_cas ? "TRUE" : "FALSE",
-		p_opts->perfmgr_rm_nodes ? "TRUE" : "FALSE");
+		p_opts->perfmgr_rm_nodes ? "TRUE" : "FALSE",
+		p_opts->perfmgr_all_port_select ? "TRUE" : "FALSE",
+		p_opts->perfmgr_all_port_full_sweeps,
+		p_opts->perfmgr_pacing ? "TRUE" : "FALSE",
+		p_opts->perfmgr_history_file ?
+		p_opts->perfmgr_history_file : null_str,
+		p_opts->perfmgr_history_retention_s,
+		p_opts->perfmgr_history_ports);
 
 	fprintf(out,
 		"#\n# Event DB Options\n#\n"
@@ -1763,6 +1884,8 @@ int osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		"log_max_size %lu\n\n"
 		"# If TRUE will accumulate the log over multiple OpenSM sessions\n"
 		"accum_log_file %s\n\n"
+		"# If TRUE log messages are written by a separate thread\n"
+		"log_async %s\n\n"
 		"# The directory to hold the file OpenSM dumps\n"
 		"dump_files_dir %s\n\n"
 		"# If TRUE enables new high risk options and hardware specific quirks\n"
@@ -1790,6 +1913,7 @@ int osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		p_opts->log_file,
 		p_opts->log_max_size,
 		p_opts->accum_log_file ? "TRUE" : "FALSE",
+		p_opts->log_async ? "TRUE" : "FALSE",
 		p_opts->dump_files_dir,
 		p_opts->enable_quirks ? "TRUE" : "FALSE",
 		p_opts->no_clients_rereg ? "TRUE" : "FALSE",
@@ -1798,6 +1922,14 @@ int osm_subn_output_conf(FILE *out, IN osm_subn_opt_t * p_opts)
 		p_opts->console,
 		OSM_DEFAULT_CONSOLE_PORT, p_opts->console_port);
 
+	fprintf(out,
+		"# Binary MAD trace file (null disables MAD tracing)\n"
+		"trace_file %s\n\n"
+		"# Number of records kept in the MAD trace file\n"
+		"trace_size %u\n\n",
+		p_opts->trace_file ? p_opts->trace_file : null_str,
+		p_opts->trace_size);
+
 	fprintf(out,
 		"#\n# QoS OPTIONS\n#\n"
 		"# Enable QoS setup\n"
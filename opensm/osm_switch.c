@@ -52,7 +52,9 @@
 #include <iba/ib_types.h>
 #include <opensm/osm_switch.h>
 #include <opensm/osm_qlogic_ar.h>
-
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 struct switch_port_path {
 	uint8_t port_num;
@@ -66,18 +68,36 @@ struct switch_port_path {
 cl_status_t osm_switch_set_hops(IN osm_switch_t * p_sw, IN uint16_t lid_ho,
 				IN uint8_t port_num, IN uint8_t num_hops)
 {
+	uint8_t *row;
+
 	if (!lid_ho || lid_ho > p_sw->max_lid_ho)
 		return -1;
-	if (!p_sw->hops[lid_ho]) {
-		p_sw->hops[lid_ho] = malloc(p_sw->num_ports);
-		if (!p_sw->hops[lid_ho])
-			return -1;
-		memset(p_sw->hops[lid_ho], OSM_NO_PATH, p_sw->num_ports);
-	}
-
-	p_sw->hops[lid_ho][port_num] = num_hops;
-	if (p_sw->hops[lid_ho][0] > num_hops)
-		p_sw->hops[lid_ho][0] = num_hops;
+	if (!p_sw->hops_row[lid_ho]) {
+		if (p_sw->num_hops_rows == p_sw->max_hops_rows) {
+			unsigned max_rows = p_sw->max_hops_rows ?
+			    2 * p_sw->max_hops_rows : 64;
+			uint8_t *hops;
+
+			if (max_rows > p_sw->num_hops)
+				max_rows = p_sw->num_hops;
+			hops = realloc(p_sw->hops, max_rows * p_sw->num_ports);
+			if (!hops)
+				return -1;
+			p_sw->hops = hops;
+			p_sw->max_hops_rows = max_rows;
+		}
+		row = p_sw->hops + p_sw->num_hops_rows * p_sw->num_ports;
+		memset(row, OSM_NO_PATH, p_sw->num_ports);
+		p_sw->hops_row[lid_ho] = ++p_sw->num_hops_rows;
+	} else
+		row = p_sw->hops +
+		    (p_sw->hops_row[lid_ho] - 1) * p_sw->num_ports;
+
+	row[port_num] = num_hops;
+	if (row[0] > num_hops)
+		row[0] = num_hops;
+	if (p_sw->least_hops[lid_ho] > num_hops)
+		p_sw->least_hops[lid_ho] = num_hops;
 
 	return 0;
 }
@@ -85,7 +105,6 @@ cl_status_t osm_switch_set_hops(IN osm_switch_t * p_sw, IN uint16_t lid_ho,
 void osm_switch_delete(IN OUT osm_switch_t ** pp_sw)
 {
 	osm_switch_t *p_sw = *pp_sw;
-	unsigned i;
 
 	osm_mcast_tbl_destroy(&p_sw->mcast_tbl);
 	if (p_sw->p_prof)
@@ -96,12 +115,12 @@ void osm_switch_delete(IN OUT osm_switch_t ** pp_sw)
 		free(p_sw->lft);
 	if (p_sw->new_lft)
 		free(p_sw->new_lft);
-	if (p_sw->hops) {
-		for (i = 0; i < p_sw->num_hops; i++)
-			if (p_sw->hops[i])
-				free(p_sw->hops[i]);
+	if (p_sw->hops)
 		free(p_sw->hops);
-	}
+	if (p_sw->hops_row)
+		free(p_sw->hops_row);
+	if (p_sw->least_hops)
+		free(p_sw->least_hops);
 
 	if (p_sw->vendor_data) {
 		if (is_qlogic_switch(p_sw->p_node))
@@ -247,6 +266,166 @@ switch_find_node_guid_count(IN const osm_switch_t * p_sw,
 	return switch_find_guid_common(p_sw, r, port_num, 0, 1);
 }
 
+/*
+ * Plain min hop / least loaded port selection (no LMC tracking, DOR,
+ * port shifting, GUID sorting or scatter) only needs the hop row of the
+ * target LID and the per port path counts.  Both are packed per port
+ * arrays, so the candidate filtering and the least loaded search are
+ * done with SIMD compares and reductions where available.
+ */
+#define SWITCH_PORT_KEY_NONE 0xFFFFFFFF
+
+/* key[port] = path count of port if it is a least hop port, else NONE */
+static void switch_build_port_keys(IN const uint8_t * hops,
+				   IN const osm_port_profile_t * p_prof,
+				   IN uint8_t least_hops,
+				   IN unsigned num_ports, OUT uint32_t * key)
+{
+	unsigned p = 0;
+#ifdef __SSE2__
+	const __m128i least = _mm_set1_epi8((char)least_hops);
+	const __m128i ones = _mm_set1_epi32(-1);
+	__m128i eq, eq16, mask[4];
+	unsigned j;
+
+	for (; p + 16 <= num_ports; p += 16) {
+		eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(hops + p)),
+				    least);
+		/* widen the byte mask to 32 bit lanes */
+		eq16 = _mm_unpacklo_epi8(eq, eq);
+		mask[0] = _mm_unpacklo_epi16(eq16, eq16);
+		mask[1] = _mm_unpackhi_epi16(eq16, eq16);
+		eq16 = _mm_unpackhi_epi8(eq, eq);
+		mask[2] = _mm_unpacklo_epi16(eq16, eq16);
+		mask[3] = _mm_unpackhi_epi16(eq16, eq16);
+		for (j = 0; j < 4; j++)
+			_mm_storeu_si128((__m128i *) (key + p + 4 * j),
+					 _mm_or_si128(_mm_loadu_si128((const __m128i *)
+								      (p_prof + p + 4 * j)),
+						      _mm_xor_si128(mask[j], ones)));
+	}
+#endif
+	for (; p < num_ports; p++)
+		key[p] = hops[p] == least_hops ?
+		    p_prof[p].num_paths : SWITCH_PORT_KEY_NONE;
+	/* port 0 is never a candidate */
+	key[0] = SWITCH_PORT_KEY_NONE;
+}
+
+static uint32_t switch_min_port_key(IN const uint32_t * key,
+				    IN unsigned num_ports)
+{
+	uint32_t min = SWITCH_PORT_KEY_NONE;
+	unsigned p = 0;
+#ifdef __SSE2__
+	/* SSE2 has no unsigned 32 bit compare - bias into signed range */
+	const __m128i bias = _mm_set1_epi32((int)0x80000000);
+	__m128i k, lt, vmin = _mm_set1_epi32(0x7FFFFFFF);
+	uint32_t lanes[4];
+	unsigned j;
+
+	for (; p + 4 <= num_ports; p += 4) {
+		k = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(key + p)),
+				  bias);
+		lt = _mm_cmplt_epi32(k, vmin);
+		vmin = _mm_or_si128(_mm_and_si128(lt, k),
+				    _mm_andnot_si128(lt, vmin));
+	}
+	_mm_storeu_si128((__m128i *) lanes, _mm_xor_si128(vmin, bias));
+	for (j = 0; j < 4; j++)
+		if (lanes[j] < min)
+			min = lanes[j];
+#endif
+	for (; p < num_ports; p++)
+		if (key[p] < min)
+			min = key[p];
+	return min;
+}
+
+static inline unsigned switch_lowest_bit(IN uint64_t bits)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(bits);
+#else
+	unsigned i = 0;
+
+	while (!(bits & 1)) {
+		bits >>= 1;
+		i++;
+	}
+	return i;
+#endif
+}
+
+/* First port with key == val, scanning from start and wrapping around */
+static unsigned switch_find_port_key(IN const uint32_t * key,
+				     IN unsigned num_ports, IN uint32_t val,
+				     IN unsigned start)
+{
+	uint64_t match[4] = { 0, 0, 0, 0 };
+	uint64_t bits;
+	unsigned p = 0, w, i;
+#ifdef __SSE2__
+	const __m128i v = _mm_set1_epi32((int)val);
+	__m128i eq;
+
+	for (; p + 4 <= num_ports; p += 4) {
+		eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(key + p)),
+				     v);
+		match[p / 64] |= (uint64_t)
+		    _mm_movemask_ps(_mm_castsi128_ps(eq)) << (p % 64);
+	}
+#endif
+	for (; p < num_ports; p++)
+		if (key[p] == val)
+			match[p / 64] |= 1ULL << (p % 64);
+
+	w = start / 64;
+	bits = match[w] & (~0ULL << (start % 64));
+	for (i = 0; i <= 4; i++) {
+		if (bits)
+			return w * 64 + switch_lowest_bit(bits);
+		w = (w + 1) % 4;
+		bits = match[w];
+	}
+	return 0;
+}
+
+/*
+ * Same selection as the generic loop in osm_switch_recommend_path for the
+ * plain case: the least loaded healthy and linked least hop port, ties
+ * going to the first one at or after start_from (modulo num_ports).
+ */
+static uint8_t switch_recommend_path_fast(IN const osm_switch_t * p_sw,
+					  IN uint16_t base_lid,
+					  IN uint8_t least_hops,
+					  IN unsigned start_from)
+{
+	uint32_t key[IB_NODE_NUM_PORTS_MAX + 1];
+	unsigned num_ports = p_sw->num_ports;
+	unsigned start = start_from % num_ports;
+	const uint8_t *hops;
+	osm_physp_t *p_physp;
+	uint32_t least_paths;
+	unsigned port;
+
+	hops = p_sw->hops + (p_sw->hops_row[base_lid] - 1) * num_ports;
+	switch_build_port_keys(hops, p_sw->p_prof, least_hops, num_ports, key);
+
+	for (;;) {
+		least_paths = switch_min_port_key(key, num_ports);
+		if (least_paths == SWITCH_PORT_KEY_NONE)
+			return OSM_NO_PATH;
+		port = switch_find_port_key(key, num_ports, least_paths, start);
+		p_physp = osm_node_get_physp_ptr(p_sw->p_node, port);
+		if (p_physp && osm_physp_is_healthy(p_physp) &&
+		    osm_physp_get_remote(p_physp))
+			return (uint8_t) port;
+		/* down or unhealthy - drop it and retry with the rest */
+		key[port] = SWITCH_PORT_KEY_NONE;
+	}
+}
+
 uint8_t osm_switch_recommend_path(IN const osm_switch_t * p_sw,
 				  IN osm_port_t * p_port, IN uint16_t lid_ho,
 				  IN unsigned start_from,
@@ -398,6 +577,12 @@ uint8_t osm_switch_recommend_path(IN const osm_switch_t * p_sw,
 	   So we must abort if not least hops.
 	 */
 
+	if (!routing_for_lmc && !dor && !port_shifting &&
+	    !remote_guid_sorting && !scatter_ports &&
+	    !p_sw->search_ordering_ports)
+		return switch_recommend_path_fast(p_sw, base_lid, least_hops,
+						  start_from);
+
 	/* port number starts with one and num_ports is 1 + num phys ports */
 	for (i = start_from; i < start_from + num_ports; i++) {
 		port_num = osm_switch_get_dimn_port(p_sw, i % num_ports);
@@ -632,11 +817,31 @@ uint8_t osm_switch_recommend_path(IN const osm_switch_t * p_sw,
 
 void osm_switch_clear_hops(IN osm_switch_t * p_sw)
 {
-	unsigned i;
+	if (!p_sw->num_hops)
+		return;
+
+	memset(p_sw->hops_row, 0, p_sw->num_hops * sizeof(p_sw->hops_row[0]));
+	memset(p_sw->least_hops, OSM_NO_PATH, p_sw->num_hops);
+	p_sw->num_hops_rows = 0;
+}
 
-	for (i = 0; i < p_sw->num_hops; i++)
-		if (p_sw->hops[i])
-			memset(p_sw->hops[i], OSM_NO_PATH, p_sw->num_ports);
+void osm_switch_clear_lid_hops(IN osm_switch_t * p_sw, IN uint16_t lid_ho)
+{
+	uint16_t row;
+
+	if (lid_ho >= p_sw->num_hops || !(row = p_sw->hops_row[lid_ho]))
+		return;
+
+	memset(p_sw->hops + (row - 1) * p_sw->num_ports, OSM_NO_PATH,
+	       p_sw->num_ports);
+	p_sw->least_hops[lid_ho] = OSM_NO_PATH;
+}
+
+size_t osm_switch_get_hops_mem_size(IN const osm_switch_t * p_sw)
+{
+	return p_sw->num_hops * (sizeof(p_sw->hops_row[0]) +
+				 sizeof(p_sw->least_hops[0])) +
+	    p_sw->max_hops_rows * p_sw->num_ports;
 }
 
 static int alloc_lft(IN osm_switch_t * p_sw, uint16_t lids)
@@ -660,7 +865,8 @@ static int alloc_lft(IN osm_switch_t * p_sw, uint16_t lids)
 
 int osm_switch_prepare_path_rebuild(IN osm_switch_t * p_sw, IN uint16_t max_lids)
 {
-	uint8_t **hops;
+	uint16_t *hops_row;
+	uint8_t *least_hops;
 	unsigned i;
 
 	if (alloc_lft(p_sw, max_lids))
@@ -669,29 +875,25 @@ int osm_switch_prepare_path_rebuild(IN osm_switch_t * p_sw, IN uint16_t max_lids
 	for (i = 0; i < p_sw->num_ports; i++)
 		osm_port_prof_construct(&p_sw->p_prof[i]);
 
-	osm_switch_clear_hops(p_sw);
-
 	if (!(p_sw->new_lft = realloc(p_sw->new_lft, p_sw->lft_size)))
 		return -1;
 
 	memset(p_sw->new_lft, OSM_NO_PATH, p_sw->lft_size);
 
-	if (!p_sw->hops) {
-		hops = malloc((max_lids + 1) * sizeof(hops[0]));
-		if (!hops)
+	if (max_lids + 1 > p_sw->num_hops) {
+		hops_row = realloc(p_sw->hops_row,
+				   (max_lids + 1) * sizeof(hops_row[0]));
+		if (!hops_row)
 			return -1;
-		memset(hops, 0, (max_lids + 1) * sizeof(hops[0]));
-		p_sw->hops = hops;
-		p_sw->num_hops = max_lids + 1;
-	} else if (max_lids + 1 > p_sw->num_hops) {
-		hops = realloc(p_sw->hops, (max_lids + 1) * sizeof(hops[0]));
-		if (!hops)
+		p_sw->hops_row = hops_row;
+		least_hops = realloc(p_sw->least_hops, max_lids + 1);
+		if (!least_hops)
 			return -1;
-		memset(hops + p_sw->num_hops, 0,
-		       (max_lids + 1 - p_sw->num_hops) * sizeof(hops[0]));
-		p_sw->hops = hops;
+		p_sw->least_hops = least_hops;
 		p_sw->num_hops = max_lids + 1;
 	}
+
+	osm_switch_clear_hops(p_sw);
 	p_sw->max_lid_ho = max_lids;
 
 	return 0;
@@ -800,3 +1002,170 @@ uint8_t osm_switch_recommend_mcast_path(IN osm_switch_t * p_sw,
 	CL_ASSERT(port_num < num_ports);
 	return port_num;
 }
+
+#ifdef TEST_OSM_SWITCH_RECOMMEND_PATH
+/*
+ * Checks that the fast path of osm_switch_recommend_path picks the same
+ * ports as the generic loop, forced with an identity port search order,
+ * and reports the time per call of both on random switch fabrics.
+ * Build against libopensm, libosmcomp and libosmvendor with
+ * -DTEST_OSM_SWITCH_RECOMMEND_PATH and run as:
+ *	test_switch [num_switches [num_ports [seed]]]
+ */
+#include <stdio.h>
+#include <sys/time.h>
+#include <opensm/osm_madw.h>
+#include <opensm/osm_port.h>
+
+static osm_node_t *test_new_switch(IN unsigned num_ports, IN uint16_t lid)
+{
+	uint8_t ni_buf[256], si_buf[256];
+	ib_smp_t *p_smp = (ib_smp_t *) ni_buf;
+	ib_node_info_t *p_ni = ib_smp_get_payload_ptr(p_smp);
+	ib_switch_info_t *p_si;
+	osm_madw_t madw;
+	osm_node_t *p_node;
+	osm_port_t *p_port;
+	unsigned i;
+
+	memset(ni_buf, 0, sizeof(ni_buf));
+	memset(&madw, 0, sizeof(madw));
+	madw.p_mad = (ib_mad_t *) ni_buf;
+	p_ni->node_type = IB_NODE_TYPE_SWITCH;
+	p_ni->num_ports = (uint8_t) num_ports;
+	p_ni->node_guid = p_ni->port_guid = p_ni->sys_guid =
+	    cl_hton64(0x1000 + lid);
+	p_node = osm_node_new(&madw);
+	if (!p_node)
+		return NULL;
+	for (i = 0; i <= num_ports; i++) {
+		osm_physp_t *p_physp = osm_node_get_physp_ptr(p_node, i);
+
+		if (!p_physp)
+			continue;
+		p_physp->port_info.base_lid = cl_hton16(lid);
+		p_physp->healthy = TRUE;
+	}
+	p_port = osm_port_new(p_ni, p_node);
+
+	memset(si_buf, 0, sizeof(si_buf));
+	p_smp = (ib_smp_t *) si_buf;
+	p_smp->attr_id = IB_MAD_ATTR_SWITCH_INFO;
+	p_si = ib_smp_get_payload_ptr(p_smp);
+	p_si->lin_cap = cl_hton16(0xbfff);
+	madw.p_mad = (ib_mad_t *) si_buf;
+	p_node->sw = osm_switch_new(p_node, &madw);
+	if (!p_port || !p_node->sw)
+		return NULL;
+	p_node->sw->priv = p_port;
+	return p_node;
+}
+
+static double test_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned num_sw = argc > 1 ? atoi(argv[1]) : 200;
+	unsigned num_ports = argc > 2 ? atoi(argv[2]) : 36;
+	unsigned seed = argc > 3 ? atoi(argv[3]) : 1;
+	uint8_t ident[IB_NODE_NUM_PORTS_MAX + 1];
+	osm_node_t **nodes;
+	osm_switch_t *p_sw;
+	uint8_t *fast;
+	unsigned s, d, p, r, mode, used;
+	unsigned long calls, diff = 0;
+	double t[2] = { 0, 0 }, t0;
+
+	if (num_sw < 2 || num_ports < 2 || num_ports >= IB_NODE_NUM_PORTS_MAX) {
+		printf("bad arguments\n");
+		return 1;
+	}
+	srandom(seed);
+	for (p = 0; p <= IB_NODE_NUM_PORTS_MAX; p++)
+		ident[p] = (uint8_t) p;
+
+	nodes = calloc(num_sw, sizeof(*nodes));
+	fast = malloc(num_sw * num_sw);
+	if (!nodes || !fast)
+		return 1;
+	for (s = 0; s < num_sw; s++)
+		if (!(nodes[s] = test_new_switch(num_ports, s + 1)) ||
+		    osm_switch_prepare_path_rebuild(nodes[s]->sw, num_sw)) {
+			printf("cannot create switch %u\n", s);
+			return 1;
+		}
+
+	/* random links, some unhealthy, and random loads */
+	for (s = 0; s < num_sw; s++)
+		for (p = 1; p <= num_ports; p++) {
+			osm_physp_t *p_physp = osm_node_get_physp_ptr(nodes[s], p);
+
+			if (osm_physp_get_remote(p_physp) || random() % 8 == 0)
+				continue;
+			d = random() % num_sw;
+			for (r = 1; r <= num_ports; r++)
+				if (d != s && !osm_node_get_physp_ptr(nodes[d], r)->
+				    p_remote_physp)
+					break;
+			if (r > num_ports)
+				continue;
+			osm_node_link(nodes[s], (uint8_t) p, nodes[d], (uint8_t) r);
+			if (random() % 10 == 0)
+				p_physp->healthy = FALSE;
+		}
+
+	/* random hop counts, ties between ports are common */
+	for (s = 0; s < num_sw; s++) {
+		p_sw = nodes[s]->sw;
+		for (p = 0; p < p_sw->num_ports; p++)
+			p_sw->p_prof[p].num_paths = random() % 64;
+		osm_switch_set_hops(p_sw, s + 1, 0, 0);
+		for (d = 0; d < num_sw; d++)
+			for (p = 1; d != s && p <= num_ports; p++)
+				if (random() % 3)
+					osm_switch_set_hops(p_sw, d + 1, (uint8_t) p,
+							    1 + random() % 3);
+	}
+
+	for (r = 0; r < 5; r++)
+		for (mode = 0; mode < 2; mode++) {
+			t0 = test_now();
+			for (s = 0; s < num_sw; s++) {
+				p_sw = nodes[s]->sw;
+				p_sw->search_ordering_ports = mode ? ident : NULL;
+				for (d = 0; d < num_sw; d++) {
+					used = osm_switch_recommend_path(p_sw,
+									 nodes[d]->sw->priv,
+									 d + 1, d + r,
+									 TRUE, FALSE,
+									 FALSE, FALSE,
+									 FALSE, 0);
+					if (!mode)
+						fast[s * num_sw + d] = used;
+					else if (fast[s * num_sw + d] != used) {
+						if (diff++ < 10)
+							printf("switch %u LID %u: "
+							       "fast port %u, generic "
+							       "port %u\n", s, d + 1,
+							       fast[s * num_sw + d],
+							       used);
+					}
+				}
+				p_sw->search_ordering_ports = NULL;
+			}
+			t[mode] += test_now() - t0;
+		}
+
+	calls = 5UL * num_sw * num_sw;
+	printf("%lu calls: fast %.1f ns/call, generic %.1f ns/call, "
+	       "%lu different ports\n", calls, t[0] * 1e9 / calls,
+	       t[1] * 1e9 / calls, diff);
+	return diff != 0;
+}
+#endif				/* TEST_OSM_SWITCH_RECOMMEND_PATH */
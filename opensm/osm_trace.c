@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2004-2009 Voltaire, Inc. All rights reserved.
+ * Copyright (c) 2002-2006 Mellanox Technologies LTD. All rights reserved.
+ * Copyright (c) 1996-2003 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *    Implementation of osm_trace_t.
+ * This object represents the binary MAD trace ring file.
+ * This object is part of the opensm family of objects.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <complib/cl_timer.h>
+#include <opensm/osm_trace.h>
+
+void osm_trace_construct(IN osm_trace_t * p_trace)
+{
+	memset(p_trace, 0, sizeof(*p_trace));
+	p_trace->fd = -1;
+	cl_spinlock_construct(&p_trace->lock);
+}
+
+ib_api_status_t osm_trace_init(IN osm_trace_t * p_trace,
+			       IN osm_log_t * p_log,
+			       IN const char *file_name,
+			       IN uint32_t num_recs)
+{
+	void *map;
+	size_t size;
+
+	p_trace->p_log = p_log;
+
+	if (!num_recs) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5601: "
+			"Invalid trace size 0\n");
+		return IB_INVALID_PARAMETER;
+	}
+
+	if (cl_spinlock_init(&p_trace->lock) != CL_SUCCESS)
+		return IB_ERROR;
+
+	size = sizeof(osm_trace_hdr_t) + (size_t) num_recs *
+	    sizeof(osm_trace_rec_t);
+
+	p_trace->fd = open(file_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (p_trace->fd < 0) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5602: "
+			"Cannot open trace file \'%s\': %s\n",
+			file_name, strerror(errno));
+		return IB_ERROR;
+	}
+
+	if (ftruncate(p_trace->fd, size) < 0) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5603: "
+			"Cannot size trace file \'%s\' to %zu bytes: %s\n",
+			file_name, size, strerror(errno));
+		goto Error;
+	}
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   p_trace->fd, 0);
+	if (map == MAP_FAILED) {
+		OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 5604: "
+			"Cannot map trace file \'%s\': %s\n",
+			file_name, strerror(errno));
+		goto Error;
+	}
+
+	p_trace->map_size = size;
+	p_trace->recs = (osm_trace_rec_t *) ((osm_trace_hdr_t *) map + 1);
+	((osm_trace_hdr_t *) map)->magic = OSM_TRACE_MAGIC;
+	((osm_trace_hdr_t *) map)->version = OSM_TRACE_VERSION;
+	((osm_trace_hdr_t *) map)->rec_size = sizeof(osm_trace_rec_t);
+	((osm_trace_hdr_t *) map)->num_recs = num_recs;
+	((osm_trace_hdr_t *) map)->start_time = cl_get_time_stamp();
+	p_trace->p_hdr = map;
+
+	OSM_LOG(p_log, OSM_LOG_VERBOSE,
+		"Tracing MADs to \'%s\' (%u records)\n", file_name, num_recs);
+	return IB_SUCCESS;
+
+Error:
+	close(p_trace->fd);
+	p_trace->fd = -1;
+	return IB_ERROR;
+}
+
+void osm_trace_destroy(IN osm_trace_t * p_trace)
+{
+	if (p_trace->p_hdr) {
+		msync(p_trace->p_hdr, p_trace->map_size, MS_ASYNC);
+		munmap(p_trace->p_hdr, p_trace->map_size);
+		p_trace->p_hdr = NULL;
+		p_trace->recs = NULL;
+	}
+	if (p_trace->fd >= 0) {
+		close(p_trace->fd);
+		p_trace->fd = -1;
+	}
+	cl_spinlock_destroy(&p_trace->lock);
+}
+
+uint64_t osm_trace_mad(IN osm_trace_t * p_trace, IN osm_trace_event_t event,
+		       IN const osm_madw_t * p_madw,
+		       IN const osm_madw_t * p_req_madw)
+{
+	const ib_mad_t *p_mad = p_madw->p_mad;
+	const ib_smp_t *p_smp;
+	osm_trace_rec_t rec;
+	uint8_t hops;
+
+	CL_ASSERT(p_trace->p_hdr);
+
+	rec.time = cl_get_time_stamp();
+	rec.trans_id = p_mad->trans_id;
+	rec.attr_mod = p_mad->attr_mod;
+	rec.latency = p_req_madw && p_req_madw->send_time ?
+	    (uint32_t) (rec.time - p_req_madw->send_time) : 0;
+	rec.attr_id = p_mad->attr_id;
+	rec.lid = p_madw->mad_addr.dest_lid;
+	rec.event = (uint8_t) event;
+	rec.mgmt_class = p_mad->mgmt_class;
+	rec.method = p_mad->method;
+
+	if (p_mad->mgmt_class == IB_MCLASS_SUBN_DIR) {
+		p_smp = (const ib_smp_t *)p_mad;
+		rec.status = ib_smp_get_status(p_smp);
+		rec.hop_count = p_smp->hop_count;
+		hops = p_smp->hop_count + 1;
+		if (hops > OSM_TRACE_MAX_HOPS)
+			hops = OSM_TRACE_MAX_HOPS;
+		memcpy(rec.path, p_smp->initial_path, hops);
+		memset(rec.path + hops, 0, OSM_TRACE_MAX_HOPS - hops);
+	} else {
+		rec.status = p_mad->status;
+		rec.hop_count = 0;
+		memset(rec.path, 0, sizeof(rec.path));
+	}
+
+	cl_spinlock_acquire(&p_trace->lock);
+	p_trace->recs[p_trace->p_hdr->head % p_trace->p_hdr->num_recs] = rec;
+	p_trace->p_hdr->head++;
+	cl_spinlock_release(&p_trace->lock);
+
+	return rec.time;
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2004-2009 Voltaire, Inc. All rights reserved.
+ * Copyright (c) 2002-2006 Mellanox Technologies LTD. All rights reserved.
+ * Copyright (c) 1996-2003 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Abstract:
+ *    osmtracedump - decodes the binary MAD trace file written by
+ *    OpenSM when the trace_file option is set.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif				/* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <iba/ib_types.h>
+#include <opensm/osm_trace.h>
+#include <opensm/osm_helper.h>
+
+static const char *event_str[] = {
+	"NONE", "SMP_SEND", "SMP_RCV", "SA_RCV"
+};
+
+static void show_usage(const char *prog)
+{
+	printf("Usage: %s [-n <count>] [-a] <trace file>\n"
+	       "  -n <count>  print only the last <count> records\n"
+	       "  -a          print absolute time stamps\n", prog);
+}
+
+static void dump_rec(const osm_trace_rec_t * p_rec, uint64_t base)
+{
+	const char *method, *attr;
+	uint64_t t = p_rec->time - base;
+	unsigned i, hops;
+
+	if (p_rec->mgmt_class == IB_MCLASS_SUBN_ADM) {
+		method = ib_get_sa_method_str(p_rec->method);
+		attr = ib_get_sa_attr_str(p_rec->attr_id);
+	} else {
+		method = ib_get_sm_method_str(p_rec->method);
+		attr = ib_get_sm_attr_str(p_rec->attr_id);
+	}
+
+	printf("%" PRIu64 ".%06u %-8s class 0x%02x %-16s %-20s mod 0x%08x"
+	       " tid 0x%016" PRIx64 " status 0x%04x lat %u",
+	       t / 1000000, (unsigned)(t % 1000000),
+	       p_rec->event < OSM_TRACE_EVENT_MAX ?
+	       event_str[p_rec->event] : "UNKNOWN", p_rec->mgmt_class,
+	       method, attr, cl_ntoh32(p_rec->attr_mod),
+	       cl_ntoh64(p_rec->trans_id), cl_ntoh16(p_rec->status),
+	       p_rec->latency);
+
+	if (p_rec->mgmt_class != IB_MCLASS_SUBN_DIR) {
+		printf(" lid %u\n", cl_ntoh16(p_rec->lid));
+		return;
+	}
+
+	hops = p_rec->hop_count;
+	if (hops >= OSM_TRACE_MAX_HOPS)
+		hops = OSM_TRACE_MAX_HOPS - 1;
+	printf(" path 0");
+	for (i = 1; i <= hops; i++)
+		printf(",%u", p_rec->path[i]);
+	printf("%s\n", hops < p_rec->hop_count ? ",..." : "");
+}
+
+int main(int argc, char *argv[])
+{
+	const osm_trace_hdr_t *p_hdr;
+	const osm_trace_rec_t *recs;
+	uint64_t count = 0, total, first, i, base;
+	int absolute = 0, fd, ch;
+	struct stat st;
+	void *map;
+
+	while ((ch = getopt(argc, argv, "n:ah")) != -1) {
+		switch (ch) {
+		case 'n':
+			count = strtoull(optarg, NULL, 0);
+			break;
+		case 'a':
+			absolute = 1;
+			break;
+		default:
+			show_usage(argv[0]);
+			return ch == 'h' ? 0 : 1;
+		}
+	}
+	if (optind != argc - 1) {
+		show_usage(argv[0]);
+		return 1;
+	}
+
+	fd = open(argv[optind], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "cannot open %s: %s\n", argv[optind],
+			strerror(errno));
+		return 1;
+	}
+	if ((size_t) st.st_size < sizeof(*p_hdr)) {
+		fprintf(stderr, "%s: file too short\n", argv[optind]);
+		return 1;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "cannot map %s: %s\n", argv[optind],
+			strerror(errno));
+		return 1;
+	}
+
+	p_hdr = map;
+	if (p_hdr->magic != OSM_TRACE_MAGIC) {
+		fprintf(stderr, "%s: not an OpenSM MAD trace file%s\n",
+			argv[optind], p_hdr->magic == cl_hton32(OSM_TRACE_MAGIC) ?
+			" for this byte order" : "");
+		return 1;
+	}
+	if (p_hdr->version != OSM_TRACE_VERSION ||
+	    p_hdr->rec_size != sizeof(osm_trace_rec_t) ||
+	    sizeof(*p_hdr) + (uint64_t) p_hdr->num_recs * p_hdr->rec_size >
+	    (uint64_t) st.st_size || !p_hdr->num_recs) {
+		fprintf(stderr, "%s: unsupported trace version %u or "
+			"corrupted header\n", argv[optind], p_hdr->version);
+		return 1;
+	}
+
+	recs = (const osm_trace_rec_t *)(p_hdr + 1);
+	total = p_hdr->head < p_hdr->num_recs ? p_hdr->head : p_hdr->num_recs;
+	if (count && count < total)
+		total = count;
+	first = p_hdr->head - total;
+	base = absolute ? 0 : p_hdr->start_time;
+
+	printf("# %" PRIu64 " MADs traced, %u record ring, showing %" PRIu64
+	       "\n", p_hdr->head, p_hdr->num_recs, total);
+
+	for (i = first; i < p_hdr->head; i++)
+		dump_rec(&recs[i % p_hdr->num_recs], base);
+
+	munmap(map, st.st_size);
+	close(fd);
+	return 0;
+}
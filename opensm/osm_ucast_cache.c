@@ -70,7 +70,11 @@ typedef struct cache_switch {
 	boolean_t dropped;
 	uint16_t max_lid_ho;
 	uint16_t num_hops;
-	uint8_t **hops;
+	uint16_t num_hops_rows;
+	uint16_t max_hops_rows;
+	uint16_t *hops_row;
+	uint8_t *least_hops;
+	uint8_t *hops;
 	uint8_t *lft;
 	uint8_t num_ports;
 	cache_port_t ports[0];
@@ -119,6 +123,10 @@ static void cache_sw_destroy(cache_switch_t * p_sw)
 		free(p_sw->lft);
 	if (p_sw->hops)
 		free(p_sw->hops);
+	if (p_sw->hops_row)
+		free(p_sw->hops_row);
+	if (p_sw->least_hops)
+		free(p_sw->least_hops);
 	free(p_sw);
 }
 
@@ -319,10 +327,20 @@ cache_restore_ucast_info(osm_ucast_mgr_t * p_mgr,
 
 	p_sw->num_hops = p_cache_sw->num_hops;
 	p_cache_sw->num_hops = 0;
+	p_sw->num_hops_rows = p_cache_sw->num_hops_rows;
+	p_sw->max_hops_rows = p_cache_sw->max_hops_rows;
 	if (p_sw->hops)
 		free(p_sw->hops);
 	p_sw->hops = p_cache_sw->hops;
 	p_cache_sw->hops = NULL;
+	if (p_sw->hops_row)
+		free(p_sw->hops_row);
+	p_sw->hops_row = p_cache_sw->hops_row;
+	p_cache_sw->hops_row = NULL;
+	if (p_sw->least_hops)
+		free(p_sw->least_hops);
+	p_sw->least_hops = p_cache_sw->least_hops;
+	p_cache_sw->least_hops = NULL;
 }
 
 static void ucast_cache_dump(osm_ucast_mgr_t * p_mgr)
@@ -952,8 +970,15 @@ void osm_ucast_cache_add_node(osm_ucast_mgr_t * p_mgr, osm_node_t * p_node)
 
 		p_cache_sw->num_hops = p_node->sw->num_hops;
 		p_node->sw->num_hops = 0;
+		p_cache_sw->num_hops_rows = p_node->sw->num_hops_rows;
+		p_cache_sw->max_hops_rows = p_node->sw->max_hops_rows;
+		p_node->sw->num_hops_rows = p_node->sw->max_hops_rows = 0;
 		p_cache_sw->hops = p_node->sw->hops;
 		p_node->sw->hops = NULL;
+		p_cache_sw->hops_row = p_node->sw->hops_row;
+		p_node->sw->hops_row = NULL;
+		p_cache_sw->least_hops = p_node->sw->least_hops;
+		p_node->sw->least_hops = NULL;
 
 		/* linear forwarding table */
 
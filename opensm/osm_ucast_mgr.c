@@ -48,10 +48,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <pthread.h>
 #include <iba/ib_types.h>
 #include <complib/cl_qmap.h>
 #include <complib/cl_debug.h>
 #include <complib/cl_qlist.h>
+#include <complib/cl_thread.h>
+#include <complib/cl_atomic.h>
 #include <opensm/osm_ucast_mgr.h>
 #include <opensm/osm_sm.h>
 #include <opensm/osm_log.h>
@@ -354,15 +357,11 @@ static void free_ports_priv(osm_ucast_mgr_t * mgr)
 	}
 }
 
-static void ucast_mgr_process_tbl(IN cl_map_item_t * p_map_item,
-				  IN void *context)
+static void ucast_mgr_process_sw(IN osm_ucast_mgr_t * p_mgr,
+				 IN osm_switch_t * p_sw)
 {
-	osm_ucast_mgr_t *p_mgr = context;
-	osm_switch_t * p_sw = (osm_switch_t *) p_map_item;
 	unsigned i, lids_per_port;
 
-	OSM_LOG_ENTER(p_mgr->p_log);
-
 	CL_ASSERT(p_sw && p_sw->p_node);
 
 	OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
@@ -372,8 +371,6 @@ static void ucast_mgr_process_tbl(IN cl_map_item_t * p_map_item,
 	/* Initialize LIDs in buffer to invalid port number. */
 	memset(p_sw->new_lft, OSM_NO_PATH, p_sw->max_lid_ho + 1);
 
-	alloc_ports_priv(p_mgr);
-
 	/*
 	   Iterate through every port setting LID routes for each
 	   port based on base LID and LMC value.
@@ -388,12 +385,103 @@ static void ucast_mgr_process_tbl(IN cl_map_item_t * p_map_item,
 			ucast_mgr_process_port(p_mgr, p_sw, port, i);
 		}
 	}
+}
 
+static void ucast_mgr_process_tbl(IN cl_map_item_t * p_map_item,
+				  IN void *context)
+{
+	osm_ucast_mgr_t *p_mgr = context;
+	osm_switch_t * p_sw = (osm_switch_t *) p_map_item;
+
+	OSM_LOG_ENTER(p_mgr->p_log);
+
+	alloc_ports_priv(p_mgr);
+	ucast_mgr_process_sw(p_mgr, p_sw);
 	free_ports_priv(p_mgr);
 
 	OSM_LOG_EXIT(p_mgr->p_log);
 }
 
+/**********************************************************************
+ Parallel LFT calculation.
+
+ Each switch's new LFT depends only on its own hop table, its own port
+ path counters and the (read only) port order list, so whole switches
+ are handed out to the workers.  The only state shared between switches
+ is the remote system tracking hung off p_port->priv, which is consulted
+ for LMC aware routing only; with LMC 0 it is not needed and the
+ workers run without it, producing the same LFTs as the serial path
+ (scatter_ports aside, which is random by definition).
+**********************************************************************/
+struct lft_workers {
+	osm_ucast_mgr_t *p_mgr;
+	osm_switch_t **sw;
+	unsigned num_sw;
+	atomic32_t next;
+};
+
+static void lft_worker(void *context)
+{
+	struct lft_workers *lw = context;
+	int32_t i;
+
+	while ((i = cl_atomic_inc(&lw->next) - 1) < (int32_t) lw->num_sw)
+		ucast_mgr_process_sw(lw->p_mgr, lw->sw[i]);
+}
+
+static int ucast_mgr_process_tbls_mt(IN osm_ucast_mgr_t * p_mgr,
+				     IN unsigned num_workers)
+{
+	cl_qmap_t *tbl = &p_mgr->p_subn->sw_guid_tbl;
+	struct lft_workers lw;
+	cl_map_item_t *item;
+	cl_thread_t *threads;
+	unsigned i;
+
+	lw.p_mgr = p_mgr;
+	lw.num_sw = cl_qmap_count(tbl);
+	lw.next = 0;
+	if (num_workers > lw.num_sw)
+		num_workers = lw.num_sw;
+	if (num_workers < 2)
+		return -1;
+
+	lw.sw = malloc(lw.num_sw * sizeof(*lw.sw));
+	threads = malloc(num_workers * sizeof(*threads));
+	if (!lw.sw || !threads) {
+		OSM_LOG(p_mgr->p_log, OSM_LOG_ERROR, "ERR 3A0F: "
+			"cannot allocate memory for parallel LFT calculation, "
+			"falling back to serial\n");
+		free(lw.sw);
+		free(threads);
+		return -1;
+	}
+
+	for (i = 0, item = cl_qmap_head(tbl); item != cl_qmap_end(tbl);
+	     item = cl_qmap_next(item))
+		lw.sw[i++] = (osm_switch_t *) item;
+	for (i = 0; i < num_workers; i++)
+		cl_thread_construct(&threads[i]);
+
+	OSM_LOG(p_mgr->p_log, OSM_LOG_VERBOSE,
+		"Calculating LFTs of %u switches with %u threads\n",
+		lw.num_sw, num_workers);
+
+	/* the calling thread is one of the workers */
+	for (i = 0; i < num_workers - 1; i++)
+		if (cl_thread_init(&threads[i], lft_worker, &lw,
+				   "opensm lfts") != CL_SUCCESS)
+			break;
+	lft_worker(&lw);
+
+	for (i = 0; i < num_workers - 1; i++)
+		cl_thread_destroy(&threads[i]);
+
+	free(threads);
+	free(lw.sw);
+	return 0;
+}
+
 static void ucast_mgr_process_neighbors(IN cl_map_item_t * p_map_item,
 					IN void *context)
 {
@@ -593,10 +681,486 @@ static int set_search_ordering_ports(void *ctx, uint64_t guid, char *p)
 	return 0;
 }
 
+/**********************************************************************
+ Min hop tables construction helpers.
+
+ The switch to switch links are collected once into a compact adjacency
+ array indexed by switch. Two engines use it:
+
+ - the multi-threaded relaxation splits the switches between the
+   workers, each worker only writes the hop tables of the switches it
+   owns. Neighbors' least hops are read from a snapshot matrix taken at
+   the end of the previous iteration (double buffered), so it converges
+   to the same tables as the serial ucast_mgr_process_neighbors() path.
+
+ - the BFS engine runs one shortest path search per destination switch
+   over the reversed links, which gives the exact least hops matrix,
+   then a single relaxation pass writes every switch's hop table.
+**********************************************************************/
+struct hop_link {
+	unsigned remote;
+	uint8_t port_num;
+	uint8_t hop_wf;
+	uint8_t healthy;
+};
+
+struct hop_matrix {
+	osm_ucast_mgr_t *p_mgr;
+	unsigned num_sw;
+	unsigned num_workers;
+	osm_switch_t **sw;
+	uint16_t *lids;
+	unsigned *link_start;
+	struct hop_link *links;
+	unsigned *rlink_start;
+	struct hop_link *rlinks;
+	uint8_t *cur;
+	uint8_t *next;
+	void (*fn) (void *);
+	boolean_t synced;
+	pthread_mutex_t start_lock;
+	pthread_barrier_t barrier;
+};
+
+struct hop_worker {
+	struct hop_matrix *m;
+	unsigned id;
+	boolean_t changed;
+	unsigned *dist;
+	unsigned *queue;
+	uint8_t *queued;
+	cl_thread_t thread;
+};
+
+static void hop_matrix_destroy(struct hop_matrix *m)
+{
+	free(m->sw);
+	free(m->lids);
+	free(m->link_start);
+	free(m->links);
+	free(m->rlink_start);
+	free(m->rlinks);
+	free(m->cur);
+	free(m->next);
+}
+
+static int hop_matrix_init(struct hop_matrix *m, osm_ucast_mgr_t * p_mgr)
+{
+	cl_qmap_t *tbl = &p_mgr->p_subn->sw_guid_tbl;
+	cl_map_item_t *item;
+	unsigned *lid_to_idx = NULL;
+	unsigned i, n, num_links = 0, max_lid;
+	int ret = -1;
+
+	memset(m, 0, sizeof(*m));
+	m->p_mgr = p_mgr;
+	m->num_sw = n = cl_qmap_count(tbl);
+
+	max_lid = cl_ptr_vector_get_size(&p_mgr->p_subn->port_lid_tbl);
+	lid_to_idx = malloc((max_lid + 1) * sizeof(*lid_to_idx));
+	m->sw = malloc(n * sizeof(*m->sw));
+	m->lids = malloc(n * sizeof(*m->lids));
+	m->link_start = malloc((n + 1) * sizeof(*m->link_start));
+	if (!lid_to_idx || !m->sw || !m->lids || !m->link_start)
+		goto Exit;
+
+	memset(lid_to_idx, 0xff, (max_lid + 1) * sizeof(*lid_to_idx));
+	for (i = 0, item = cl_qmap_head(tbl); item != cl_qmap_end(tbl);
+	     i++, item = cl_qmap_next(item)) {
+		osm_switch_t *p_sw = (osm_switch_t *) item;
+		m->sw[i] = p_sw;
+		m->lids[i] = cl_ntoh16(osm_node_get_base_lid(p_sw->p_node, 0));
+		if (m->lids[i] <= max_lid)
+			lid_to_idx[m->lids[i]] = i;
+		num_links += p_sw->num_ports;
+	}
+
+	m->links = malloc((num_links + 1) * sizeof(*m->links));
+	if (!m->links)
+		goto Exit;
+
+	/* same switch to switch links ucast_mgr_process_hop_0_1() sets
+	   and ucast_mgr_process_neighbors() propagates through (healthy) */
+	for (i = 0, num_links = 0; i < n; i++) {
+		osm_node_t *p_node = m->sw[i]->p_node;
+		unsigned num_ports = osm_node_get_num_physp(p_node);
+		unsigned port_num;
+
+		m->link_start[i] = num_links;
+		for (port_num = 1; port_num < num_ports; port_num++) {
+			osm_node_t *p_remote_node;
+			osm_physp_t *p_physp;
+			uint8_t remote_port_num;
+			uint16_t remote_lid;
+
+			p_remote_node = osm_node_get_remote_node(p_node,
+								 (uint8_t)
+								 port_num,
+								 &remote_port_num);
+			if (!p_remote_node || !p_remote_node->sw ||
+			    p_remote_node == p_node)
+				continue;
+			p_physp = osm_node_get_physp_ptr(p_node, port_num);
+			if (!p_physp)
+				continue;
+			remote_lid =
+			    cl_ntoh16(osm_node_get_base_lid(p_remote_node, 0));
+			if (remote_lid > max_lid ||
+			    lid_to_idx[remote_lid] >= n ||
+			    m->sw[lid_to_idx[remote_lid]] != p_remote_node->sw)
+				continue;
+			m->links[num_links].remote = lid_to_idx[remote_lid];
+			m->links[num_links].port_num = (uint8_t) port_num;
+			m->links[num_links].hop_wf = p_physp->hop_wf;
+			m->links[num_links].healthy =
+			    osm_link_is_healthy(p_physp) ? 1 : 0;
+			num_links++;
+		}
+	}
+	m->link_start[n] = num_links;
+
+	ret = 0;
+Exit:
+	free(lid_to_idx);
+	if (ret)
+		hop_matrix_destroy(m);
+	return ret;
+}
+
+/*
+ * The worker threads live for one build of the matrices and meet at the
+ * barrier before and after each step; m->fn is the step to run, NULL
+ * makes them exit.
+ */
+static void hop_worker_thread(void *context)
+{
+	struct hop_worker *w = context;
+	struct hop_matrix *m = w->m;
+
+	/* held by hop_matrix_start() until the barrier is set up */
+	pthread_mutex_lock(&m->start_lock);
+	pthread_mutex_unlock(&m->start_lock);
+	if (!m->synced)
+		return;
+
+	for (;;) {
+		pthread_barrier_wait(&m->barrier);
+		if (!m->fn)
+			break;
+		m->fn(w);
+		pthread_barrier_wait(&m->barrier);
+	}
+}
+
+static int hop_matrix_start(struct hop_matrix *m, struct hop_worker *workers)
+{
+	unsigned w;
+
+	for (w = 0; w < m->num_workers; w++)
+		cl_thread_construct(&workers[w].thread);
+
+	if (pthread_mutex_init(&m->start_lock, NULL))
+		return -1;
+
+	/* the calling thread takes the last share, the barrier counts
+	   the threads that could be started */
+	pthread_mutex_lock(&m->start_lock);
+	for (w = 0; w < m->num_workers - 1; w++)
+		if (cl_thread_init(&workers[w].thread, hop_worker_thread,
+				   &workers[w], "opensm hops") != CL_SUCCESS)
+			break;
+	m->num_workers = w + 1;
+	m->fn = NULL;
+	m->synced = !pthread_barrier_init(&m->barrier, NULL, m->num_workers);
+	pthread_mutex_unlock(&m->start_lock);
+
+	if (!m->synced) {
+		for (w = 0; w < m->num_workers - 1; w++)
+			cl_thread_destroy(&workers[w].thread);
+		pthread_mutex_destroy(&m->start_lock);
+		return -1;
+	}
+	return 0;
+}
+
+static void hop_matrix_run(struct hop_matrix *m, struct hop_worker *workers,
+			   void (*fn) (void *))
+{
+	unsigned w;
+
+	for (w = 0; w < m->num_workers; w++)
+		workers[w].changed = FALSE;
+
+	m->fn = fn;
+	pthread_barrier_wait(&m->barrier);
+	fn(&workers[m->num_workers - 1]);
+	pthread_barrier_wait(&m->barrier);
+}
+
+static void hop_matrix_stop(struct hop_matrix *m, struct hop_worker *workers)
+{
+	unsigned w;
+
+	m->fn = NULL;
+	pthread_barrier_wait(&m->barrier);
+	for (w = 0; w < m->num_workers - 1; w++)
+		cl_thread_destroy(&workers[w].thread);
+	pthread_barrier_destroy(&m->barrier);
+	pthread_mutex_destroy(&m->start_lock);
+}
+
+static void hop_worker_relax(void *context)
+{
+	struct hop_worker *w = context;
+	struct hop_matrix *m = w->m;
+	osm_log_t *p_log = m->p_mgr->p_log;
+	unsigned n = m->num_sw;
+	unsigned s, d, l;
+
+	for (s = w->id; s < n; s += m->num_workers) {
+		osm_switch_t *p_sw = m->sw[s];
+		uint8_t *row;
+
+		for (l = m->link_start[s]; l < m->link_start[s + 1]; l++) {
+			struct hop_link *link = &m->links[l];
+			const uint8_t *remote_row = m->cur + link->remote * n;
+
+			if (!link->healthy)
+				continue;
+
+			for (d = 0; d < n; d++) {
+				uint8_t hops = remote_row[d];
+
+				if (hops == OSM_NO_PATH)
+					continue;
+				hops += link->hop_wf;
+				if (hops >=
+				    osm_switch_get_hop_count(p_sw, m->lids[d],
+							     link->port_num))
+					continue;
+				if (osm_switch_set_hops(p_sw, m->lids[d],
+							link->port_num, hops))
+					OSM_LOG(p_log, OSM_LOG_ERROR, "ERR 3A03: "
+						"cannot set hops for lid %u at "
+						"switch 0x%" PRIx64 "\n",
+						m->lids[d],
+						cl_ntoh64(osm_node_get_node_guid
+							  (p_sw->p_node)));
+				w->changed = TRUE;
+			}
+		}
+
+		if (!m->next)
+			continue;
+		row = m->next + s * n;
+		for (d = 0; d < n; d++)
+			row[d] = osm_switch_get_least_hops(p_sw, m->lids[d]);
+	}
+}
+
+static int ucast_mgr_build_lid_matrices_mt(IN osm_ucast_mgr_t * p_mgr,
+					   IN unsigned num_workers,
+					   IN uint32_t iteration_max)
+{
+	struct hop_matrix m;
+	struct hop_worker *workers;
+	boolean_t changed = TRUE;
+	uint8_t *tmp;
+	uint32_t i;
+	unsigned n, s, d, w;
+
+	if (hop_matrix_init(&m, p_mgr))
+		return -1;
+
+	n = m.num_sw;
+	m.num_workers = num_workers > n ? n : num_workers;
+	m.cur = malloc(n * n);
+	m.next = malloc(n * n);
+	workers = malloc(m.num_workers * sizeof(*workers));
+	if (!m.cur || !m.next || !workers) {
+		free(workers);
+		hop_matrix_destroy(&m);
+		return -1;
+	}
+	memset(workers, 0, m.num_workers * sizeof(*workers));
+	for (w = 0; w < m.num_workers; w++) {
+		workers[w].m = &m;
+		workers[w].id = w;
+	}
+	if (hop_matrix_start(&m, workers)) {
+		free(workers);
+		hop_matrix_destroy(&m);
+		return -1;
+	}
+
+	for (s = 0; s < n; s++)
+		for (d = 0; d < n; d++)
+			m.cur[s * n + d] =
+			    osm_switch_get_least_hops(m.sw[s], m.lids[d]);
+
+	for (i = 0; i < iteration_max && changed; i++) {
+		hop_matrix_run(&m, workers, hop_worker_relax);
+
+		changed = FALSE;
+		for (w = 0; w < m.num_workers; w++)
+			changed |= workers[w].changed;
+
+		tmp = m.cur;
+		m.cur = m.next;
+		m.next = tmp;
+	}
+	hop_matrix_stop(&m, workers);
+
+	OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
+		"Min-hop propagated in %u steps by %u threads\n", i,
+		m.num_workers);
+
+	free(workers);
+	hop_matrix_destroy(&m);
+	return 0;
+}
+
+/*
+ * Shortest path search from destination switch d over the reversed
+ * links, the result is stored in column d of the least hops matrix.
+ * A link to the destination itself counts even when unhealthy (it is
+ * set up by ucast_mgr_process_hop_0_1()), other links must be healthy
+ * to propagate hops, as in ucast_mgr_process_neighbors().
+ * Hop weights may differ from 1, so this is a FIFO label correcting
+ * search, which degenerates to a plain BFS with the default weights.
+ */
+static void hop_bfs_by_dest(struct hop_worker *w, unsigned d)
+{
+	struct hop_matrix *m = w->m;
+	unsigned n = m->num_sw;
+	unsigned head = 0, count = 0;
+	unsigned s, r, l, hops;
+
+	for (s = 0; s < n; s++) {
+		w->dist[s] = OSM_NO_PATH;
+		w->queued[s] = 0;
+	}
+
+	w->dist[d] = 0;
+	w->queue[0] = d;
+	w->queued[d] = 1;
+	count = 1;
+
+	while (count) {
+		r = w->queue[head];
+		head = (head + 1) % n;
+		count--;
+		w->queued[r] = 0;
+
+		for (l = m->rlink_start[r]; l < m->rlink_start[r + 1]; l++) {
+			struct hop_link *link = &m->rlinks[l];
+
+			/* for the reversed links, 'remote' is the source */
+			s = link->remote;
+			if (!link->healthy && r != d)
+				continue;
+			hops = w->dist[r] + link->hop_wf;
+			if (hops >= w->dist[s])
+				continue;
+			w->dist[s] = hops;
+			if (!w->queued[s]) {
+				w->queue[(head + count) % n] = s;
+				w->queued[s] = 1;
+				count++;
+			}
+		}
+	}
+
+	for (s = 0; s < n; s++)
+		m->cur[s * n + d] = (uint8_t) w->dist[s];
+}
+
+static void hop_worker_bfs(void *context)
+{
+	struct hop_worker *w = context;
+	unsigned d;
+
+	for (d = w->id; d < w->m->num_sw; d += w->m->num_workers)
+		hop_bfs_by_dest(w, d);
+}
+
+static int ucast_mgr_build_lid_matrices_bfs(IN osm_ucast_mgr_t * p_mgr,
+					    IN unsigned num_workers)
+{
+	struct hop_matrix m;
+	struct hop_worker *workers;
+	unsigned n, s, l, w;
+	int ret = -1;
+
+	if (hop_matrix_init(&m, p_mgr))
+		return -1;
+
+	n = m.num_sw;
+	m.num_workers = num_workers > n ? n : num_workers;
+	workers = malloc(m.num_workers * sizeof(*workers));
+	m.rlink_start = malloc((n + 1) * sizeof(*m.rlink_start));
+	m.rlinks = malloc((m.link_start[n] + 1) * sizeof(*m.rlinks));
+	m.cur = malloc(n * n);
+	if (!workers || !m.rlink_start || !m.rlinks || !m.cur)
+		goto Exit;
+	memset(workers, 0, m.num_workers * sizeof(*workers));
+
+	/* reversed links: the links entering each switch */
+	memset(m.rlink_start, 0, (n + 1) * sizeof(*m.rlink_start));
+	for (l = 0; l < m.link_start[n]; l++)
+		m.rlink_start[m.links[l].remote + 1]++;
+	for (s = 0; s < n; s++)
+		m.rlink_start[s + 1] += m.rlink_start[s];
+	for (s = 0; s < n; s++)
+		for (l = m.link_start[s]; l < m.link_start[s + 1]; l++) {
+			unsigned pos = m.rlink_start[m.links[l].remote]++;
+			m.rlinks[pos] = m.links[l];
+			m.rlinks[pos].remote = s;
+		}
+	for (s = n; s > 0; s--)
+		m.rlink_start[s] = m.rlink_start[s - 1];
+	m.rlink_start[0] = 0;
+
+	for (w = 0; w < m.num_workers; w++) {
+		workers[w].m = &m;
+		workers[w].id = w;
+		workers[w].dist = malloc(n * sizeof(*workers[w].dist));
+		workers[w].queue = malloc(n * sizeof(*workers[w].queue));
+		workers[w].queued = malloc(n);
+		if (!workers[w].dist || !workers[w].queue ||
+		    !workers[w].queued)
+			goto Exit;
+	}
+
+	/* the searches fill the least hops matrix by destination, then
+	   each worker writes the hop tables of the switches it owns */
+	if (hop_matrix_start(&m, workers))
+		goto Exit;
+	hop_matrix_run(&m, workers, hop_worker_bfs);
+	hop_matrix_run(&m, workers, hop_worker_relax);
+	hop_matrix_stop(&m, workers);
+
+	OSM_LOG(p_mgr->p_log, OSM_LOG_DEBUG,
+		"Min-hop computed by %u BFS searches on %u threads\n", n,
+		m.num_workers);
+	ret = 0;
+Exit:
+	if (workers)
+		for (w = 0; w < m.num_workers; w++) {
+			free(workers[w].dist);
+			free(workers[w].queue);
+			free(workers[w].queued);
+		}
+	free(workers);
+	hop_matrix_destroy(&m);
+	return ret;
+}
+
 int osm_ucast_mgr_build_lid_matrices(IN osm_ucast_mgr_t * p_mgr)
 {
 	uint32_t i;
 	uint32_t iteration_max;
+	unsigned num_workers;
 	cl_qmap_t *p_sw_guid_tbl;
 
 	p_sw_guid_tbl = &p_mgr->p_subn->sw_guid_tbl;
@@ -653,6 +1217,17 @@ int osm_ucast_mgr_build_lid_matrices(IN osm_ucast_mgr_t * p_mgr)
 	if (iteration_max) {
 		iteration_max--;
 
+		num_workers = p_mgr->p_subn->opt.routing_threads;
+		if (!num_workers)
+			num_workers = cl_proc_count();
+		if (p_mgr->bfs_lid_matrices &&
+		    !ucast_mgr_build_lid_matrices_bfs(p_mgr, num_workers))
+			return 0;
+		if (num_workers > 1 &&
+		    !ucast_mgr_build_lid_matrices_mt(p_mgr, num_workers,
+						     iteration_max))
+			return 0;
+
 		/*
 		   we need to find out when the propagation of
 		   hop counts has relaxed. So this global variable
@@ -868,6 +1443,8 @@ static void sort_ports_by_switch_load(osm_ucast_mgr_t * m)
 
 static int ucast_mgr_build_lfts(osm_ucast_mgr_t * p_mgr)
 {
+	unsigned num_workers;
+
 	cl_qlist_init(&p_mgr->port_order_list);
 
 	if (p_mgr->p_subn->opt.guid_routing_order_file) {
@@ -897,8 +1474,13 @@ static int ucast_mgr_build_lfts(osm_ucast_mgr_t * p_mgr)
 	cl_qmap_apply_func(&p_mgr->p_subn->port_guid_tbl,
 			   add_port_to_order_list, p_mgr);
 
-	cl_qmap_apply_func(&p_mgr->p_subn->sw_guid_tbl, ucast_mgr_process_tbl,
-			   p_mgr);
+	num_workers = p_mgr->p_subn->opt.routing_threads;
+	if (!num_workers)
+		num_workers = cl_proc_count();
+	if (num_workers < 2 || p_mgr->p_subn->opt.lmc ||
+	    ucast_mgr_process_tbls_mt(p_mgr, num_workers))
+		cl_qmap_apply_func(&p_mgr->p_subn->sw_guid_tbl,
+				   ucast_mgr_process_tbl, p_mgr);
 
 	cl_qlist_remove_all(&p_mgr->port_order_list);
 
@@ -1056,6 +1638,27 @@ void osm_ucast_mgr_set_fwd_tables(osm_ucast_mgr_t * p_mgr)
 	ucast_mgr_pipeline_fwd_tbl(p_mgr);
 }
 
+/*
+ * Tells whether the routing engine is listed in the bfs_lid_matrices
+ * option.
+ */
+static boolean_t ucast_mgr_engine_bfs(IN osm_subn_t * p_subn,
+				      IN const char *name)
+{
+	const char *list = p_subn->opt.bfs_lid_matrices, *p;
+	size_t len = strlen(name);
+
+	if (!list)
+		return FALSE;
+
+	for (p = list; (p = strstr(p, name)) != NULL; p += len)
+		if ((p == list || p[-1] == ',') &&
+		    (p[len] == ',' || p[len] == '\0'))
+			return TRUE;
+
+	return FALSE;
+}
+
 static int ucast_mgr_route(struct osm_routing_engine *r, osm_opensm_t * osm)
 {
 	int ret;
@@ -1067,9 +1670,12 @@ static int ucast_mgr_route(struct osm_routing_engine *r, osm_opensm_t * osm)
 	if(osm->subn.opt.scatter_ports)
 		srandom(osm->subn.opt.scatter_ports);
 
+	osm->sm.ucast_mgr.bfs_lid_matrices =
+	    ucast_mgr_engine_bfs(&osm->subn, r->name);
 	if (!r->build_lid_matrices ||
 	    (ret = r->build_lid_matrices(r->context)) > 0)
 		ret = osm_ucast_mgr_build_lid_matrices(&osm->sm.ucast_mgr);
+	osm->sm.ucast_mgr.bfs_lid_matrices = FALSE;
 
 	if (ret < 0) {
 		OSM_LOG(&osm->log, OSM_LOG_ERROR,
@@ -1134,7 +1740,10 @@ int osm_ucast_mgr_process(IN osm_ucast_mgr_t * p_mgr)
 		/* If configured routing algorithm failed, use default MinHop */
 		struct osm_routing_engine *r = p_osm->default_routing_engine;
 
+		p_mgr->bfs_lid_matrices =
+		    ucast_mgr_engine_bfs(p_mgr->p_subn, r->name);
 		r->build_lid_matrices(r->context);
+		p_mgr->bfs_lid_matrices = FALSE;
 		failed = r->ucast_build_fwd_tables(r->context);
 		if (!failed) {
 			if (qlogic_adaptive_routing_enabled(p_mgr->p_subn)) {
@@ -286,12 +286,12 @@ static void updn_clear_non_root_hops(updn_t * updn, osm_switch_t * sw)
 	unsigned i;
 
 	for (i = 0; i < sw->num_hops; i++)
-		if (sw->hops[i]) {
+		if (sw->hops_row[i]) {
 			port = osm_get_port_by_lid_ho(&updn->p_osm->subn, i);
 			if (!port || !port->p_node->sw
 			    || ((struct updn_node *)port->p_node->sw->priv)->
 			    rank != 0)
-				memset(sw->hops[i], 0xff, sw->num_ports);
+				osm_switch_clear_lid_hops(sw, i);
 		}
 }
 
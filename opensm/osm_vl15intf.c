@@ -48,12 +48,158 @@
 #include <string.h>
 #include <iba/ib_types.h>
 #include <complib/cl_thread.h>
+#include <complib/cl_timer.h>
 #include <vendor/osm_vendor_api.h>
 #include <opensm/osm_vl15intf.h>
 #include <opensm/osm_madw.h>
 #include <opensm/osm_log.h>
 #include <opensm/osm_helper.h>
 
+/* Max number of MADs taken off the FIFOs per lock acquisition */
+#define VL15_SEND_BURST 32
+
+/* Max number of queued requests looked at for an open window */
+#define VL15_SCAN_LIMIT (4 * VL15_SEND_BURST)
+
+/* Responses measured before late responses start to count */
+#define VL15_RTT_WARMUP 8
+
+/*
+   Returns the adaptive window of the port the MAD is bound to.
+   Must be called with the VL15 lock held.
+ */
+static osm_vl15_window_t *vl15_window(osm_vl15_t * p_vl,
+				      const osm_madw_t * p_madw)
+{
+	osm_bind_handle_t h_bind = osm_madw_get_bind_handle(p_madw);
+	osm_vl15_window_t *p_win;
+	uint32_t i;
+
+	for (i = 0; i < p_vl->num_windows; i++)
+		if (p_vl->windows[i].h_bind == h_bind)
+			return &p_vl->windows[i];
+
+	if (p_vl->num_windows == OSM_VL15_MAX_PORTS)
+		return &p_vl->windows[0];
+
+	p_win = &p_vl->windows[p_vl->num_windows++];
+	memset(p_win, 0, sizeof(*p_win));
+	p_win->h_bind = h_bind;
+	p_win->cwnd = p_vl->max_wire_smps > 0 ? p_vl->max_wire_smps : 1;
+	return p_win;
+}
+
+static uint32_t vl15_window_max(osm_vl15_t * p_vl)
+{
+	int32_t max = p_vl->max_wire_smps2 > p_vl->max_wire_smps ?
+	    p_vl->max_wire_smps2 : p_vl->max_wire_smps;
+
+	return max > 0 ? max : 1;
+}
+
+static osm_vl15_rtt_t *vl15_rtt(osm_vl15_window_t * p_win,
+				const osm_madw_t * p_madw)
+{
+	const ib_smp_t *p_smp = osm_madw_get_smp_ptr(p_madw);
+	unsigned bucket = OSM_VL15_RTT_BUCKETS - 1;
+
+	if (p_smp->mgmt_class == IB_MCLASS_SUBN_DIR)
+		bucket = p_smp->hop_count * (OSM_VL15_RTT_BUCKETS - 1) /
+		    (IB_SUBNET_PATH_HOPS_MAX + 1);
+
+	return &p_win->rtt[bucket];
+}
+
+/*
+   Takes the requests whose port window is open off a request FIFO.
+   Must be called with the sender lock held.
+ */
+static unsigned vl15_take_windowed(osm_vl15_t * p_vl, cl_qlist_t * p_fifo,
+				   cl_qlist_t * p_burst, unsigned n)
+{
+	cl_list_item_t *p_item, *p_next;
+	osm_vl15_window_t *p_win;
+	unsigned scanned = 0;
+
+	cl_spinlock_acquire(&p_vl->lock);
+	for (p_item = cl_qlist_head(p_fifo);
+	     p_item != cl_qlist_end(p_fifo) && n < VL15_SEND_BURST &&
+	     scanned < VL15_SCAN_LIMIT; p_item = p_next, scanned++) {
+		p_next = cl_qlist_next(p_item);
+		p_win = vl15_window(p_vl, (osm_madw_t *) p_item);
+		if (p_win->on_wire >= (int32_t) p_win->cwnd)
+			continue;
+		p_win->on_wire++;
+		cl_qlist_remove_item(p_fifo, p_item);
+		cl_qlist_insert_tail(p_burst, p_item);
+		n++;
+	}
+	cl_spinlock_release(&p_vl->lock);
+
+	return n;
+}
+
+static osm_vl15_prio_t vl15_prio(const osm_madw_t * p_madw)
+{
+	const ib_smp_t *p_smp = osm_madw_get_smp_ptr(p_madw);
+
+	if (!p_madw->resp_expected)
+		return OSM_VL15_PRIO_TRAP_REPRESS;
+	if (p_smp->attr_id == IB_MAD_ATTR_SM_INFO)
+		return OSM_VL15_PRIO_SMINFO;
+	if (p_smp->method == IB_MAD_METHOD_SET &&
+	    (p_smp->attr_id == IB_MAD_ATTR_LIN_FWD_TBL ||
+	     p_smp->attr_id == IB_MAD_ATTR_MCAST_FWD_TBL))
+		return OSM_VL15_PRIO_FWD_TBL;
+	return OSM_VL15_PRIO_DISCOVERY;
+}
+
+/*
+   Picks the sender of a MAD by its destination, the LID it is routed
+   to followed by the directed route part, so MADs to the same
+   destination keep their order.
+ */
+static osm_vl15_sender_t *vl15_sender(osm_vl15_t * p_vl,
+				      const osm_madw_t * p_madw)
+{
+	const ib_smp_t *p_smp = osm_madw_get_smp_ptr(p_madw);
+	uint32_t hash;
+	unsigned i;
+
+	if (p_vl->num_senders == 1)
+		return &p_vl->senders[0];
+
+	hash = cl_ntoh16(p_madw->mad_addr.dest_lid);
+	if (p_smp->mgmt_class == IB_MCLASS_SUBN_DIR)
+		for (i = 1; i <= p_smp->hop_count &&
+		     i < IB_SUBNET_PATH_HOPS_MAX; i++)
+			hash = hash * 31 + p_smp->initial_path[i];
+
+	return &p_vl->senders[hash % p_vl->num_senders];
+}
+
+/*
+   Reserves room on the wire for up to want requests and returns the
+   room reserved.  The wire count is raised before the requests are
+   dequeued so the sender threads together stay within max_smps.
+ */
+static int32_t vl15_reserve_wire(osm_vl15_t * p_vl, int32_t want)
+{
+	atomic32_t *p_wire = &p_vl->p_stats->qp0_mads_outstanding_on_wire;
+	int32_t wire, room;
+
+	do {
+		wire = *p_wire;
+		room = p_vl->max_smps - wire;
+		if (room <= 0)
+			return 0;
+		if (room > want)
+			room = want;
+	} while (cl_atomic_comp_xchg(p_wire, wire, wire + room) != wire);
+
+	return room;
+}
+
 static void vl15_send_mad(osm_vl15_t * p_vl, osm_madw_t * p_madw)
 {
 	ib_api_status_t status;
@@ -64,20 +210,28 @@ static void vl15_send_mad(osm_vl15_t * p_vl, osm_madw_t * p_madw)
 	   since we can have no confirmation that they arrived
 	   at their destination.
 	 */
-	if (resp_expected)
+	if (!resp_expected)
+		cl_atomic_inc(&p_vl->p_stats->qp0_unicasts_sent);
+	else if (p_vl->adaptive)
 		/*
 		   Note that other threads may not see the response MAD
 		   arrive before send() even returns.
 		   In that case, the wire count would temporarily go negative.
 		   To avoid this confusion, preincrement the counts on the
-		   assumption that send() will succeed.
+		   assumption that send() will succeed.  Without adaptive
+		   windows the count was raised by vl15_reserve_wire.
 		 */
 		cl_atomic_inc(&p_vl->p_stats->qp0_mads_outstanding_on_wire);
-	else
-		cl_atomic_inc(&p_vl->p_stats->qp0_unicasts_sent);
 
 	cl_atomic_inc(&p_vl->p_stats->qp0_mads_sent);
 
+	if (osm_trace_is_active(p_vl->p_trace))
+		p_madw->send_time = osm_trace_mad(p_vl->p_trace,
+						  OSM_TRACE_EVENT_SMP_SEND,
+						  p_madw, NULL);
+	else
+		p_madw->send_time = cl_get_time_stamp();
+
 	status = osm_vendor_send(osm_madw_get_bind_handle(p_madw),
 				 p_madw, p_madw->resp_expected);
 
@@ -112,15 +266,18 @@ static void vl15_poller(IN void *p_ptr)
 {
 	ib_api_status_t status;
 	osm_madw_t *p_madw;
-	osm_vl15_t *p_vl = p_ptr;
-	cl_qlist_t *p_fifo;
-	int32_t max_smps = p_vl->max_wire_smps;
+	osm_vl15_sender_t *p_snd = p_ptr;
+	osm_vl15_t *p_vl = p_snd->p_vl;
+	cl_qlist_t burst;
 	int32_t max_smps2 = p_vl->max_wire_smps2;
+	int32_t limit, room, queued;
+	boolean_t wire_full;
+	unsigned n;
+	int prio;
 
 	OSM_LOG_ENTER(p_vl->p_log);
 
-	if (p_vl->thread_state == OSM_THREAD_STATE_NONE)
-		p_vl->thread_state = OSM_THREAD_STATE_RUN;
+	cl_qlist_init(&burst);
 
 	while (p_vl->thread_state == OSM_THREAD_STATE_RUN) {
 		/*
@@ -128,44 +285,95 @@ static void vl15_poller(IN void *p_ptr)
 		   and passing them to the transport interface.
 		   There are lots of corner cases here so tread carefully.
 
-		   The unicast FIFO has priority, since somebody is waiting
-		   for a timely response.
-		 */
-		cl_spinlock_acquire(&p_vl->lock);
+		   The FIFOs are served in priority order.  MADs that
+		   expect no response come first, since somebody is
+		   waiting for a timely response.
 
-		if (cl_qlist_count(&p_vl->ufifo) != 0)
-			p_fifo = &p_vl->ufifo;
-		else
-			p_fifo = &p_vl->rfifo;
-
-		p_madw = (osm_madw_t *) cl_qlist_remove_head(p_fifo);
-
-		cl_spinlock_release(&p_vl->lock);
-
-		if (p_madw != (osm_madw_t *) cl_qlist_end(p_fifo)) {
-			OSM_LOG(p_vl->p_log, OSM_LOG_DEBUG,
-				"Servicing p_madw = %p\n", p_madw);
-			if (osm_log_is_active(p_vl->p_log, OSM_LOG_FRAMES))
-				osm_dump_dr_smp(p_vl->p_log,
-						osm_madw_get_smp_ptr(p_madw),
-						OSM_LOG_FRAMES);
+		   Take a burst of MADs in one go: all queued unicasts and
+		   as many requests as the room reserved on the wire.
+		 */
+		room = 0;
+		wire_full = FALSE;
+
+		cl_spinlock_acquire(&p_snd->lock);
+
+		for (n = 0; n < VL15_SEND_BURST &&
+		     !cl_is_qlist_empty(&p_snd->fifo[OSM_VL15_PRIO_TRAP_REPRESS]);
+		     n++)
+			cl_qlist_insert_tail(&burst,
+					     cl_qlist_remove_head
+					     (&p_snd->fifo
+					      [OSM_VL15_PRIO_TRAP_REPRESS]));
+
+		if (!p_vl->adaptive) {
+			queued = 0;
+			for (prio = OSM_VL15_PRIO_TRAP_REPRESS + 1;
+			     prio < OSM_VL15_PRIO_MAX; prio++)
+				queued += cl_qlist_count(&p_snd->fifo[prio]);
+			if (queued > (int32_t) (VL15_SEND_BURST - n))
+				queued = VL15_SEND_BURST - n;
+			if (queued > 0) {
+				room = vl15_reserve_wire(p_vl, queued);
+				wire_full = room == 0;
+			}
+		}
+		for (prio = OSM_VL15_PRIO_TRAP_REPRESS + 1;
+		     prio < OSM_VL15_PRIO_MAX; prio++) {
+			if (p_vl->adaptive) {
+				n = vl15_take_windowed(p_vl,
+						       &p_snd->fifo[prio],
+						       &burst, n);
+				continue;
+			}
+			for (; room > 0 &&
+			     !cl_is_qlist_empty(&p_snd->fifo[prio]);
+			     n++, room--)
+				cl_qlist_insert_tail(&burst,
+						     cl_qlist_remove_head
+						     (&p_snd->fifo[prio]));
+		}
 
-			vl15_send_mad(p_vl, p_madw);
-		} else
+		cl_spinlock_release(&p_snd->lock);
+
+		if (n) {
+			while (!cl_is_qlist_empty(&burst)) {
+				p_madw = (osm_madw_t *)
+				    cl_qlist_remove_head(&burst);
+				OSM_LOG(p_vl->p_log, OSM_LOG_DEBUG,
+					"Servicing p_madw = %p\n", p_madw);
+				if (osm_log_is_active(p_vl->p_log,
+						      OSM_LOG_FRAMES))
+					osm_dump_dr_smp(p_vl->p_log,
+							osm_madw_get_smp_ptr
+							(p_madw),
+							OSM_LOG_FRAMES);
+
+				vl15_send_mad(p_vl, p_madw);
+			}
+		} else if (!wire_full)
 			/*
-			   The VL15 FIFO is empty, so we have nothing left to do.
+			   The VL15 FIFOs are empty, so we have nothing left
+			   to do.  With adaptive windows this also means all
+			   windows with queued requests are full;
+			   osm_vl15_poll signals us as they open.
 			 */
-			status = cl_event_wait_on(&p_vl->signal,
+			status = cl_event_wait_on(&p_snd->signal,
 						  EVENT_NO_TIMEOUT, TRUE);
 
-		while (p_vl->p_stats->qp0_mads_outstanding_on_wire >= max_smps &&
+		if (p_vl->adaptive)
+			continue;
+
+		limit = p_vl->max_smps;
+		while (p_vl->p_stats->qp0_mads_outstanding_on_wire >= limit &&
 		       p_vl->thread_state == OSM_THREAD_STATE_RUN) {
-			status = cl_event_wait_on(&p_vl->signal,
+			status = cl_event_wait_on(&p_snd->signal,
 						  p_vl->max_smps_timeout,
 						  TRUE);
 			if (status == CL_TIMEOUT) {
-				if (max_smps < max_smps2)
-					max_smps++;
+				/* senders timing out together raise it once */
+				if (limit < max_smps2)
+					cl_atomic_comp_xchg(&p_vl->max_smps,
+							    limit, limit + 1);
 				break;
 			} else if (status != CL_SUCCESS) {
 				OSM_LOG(p_vl->p_log, OSM_LOG_ERROR, "ERR 3E02: "
@@ -173,7 +381,8 @@ static void vl15_poller(IN void *p_ptr)
 					CL_STATUS_MSG(status));
 				break;
 			}
-			max_smps = p_vl->max_wire_smps;
+			p_vl->max_smps = p_vl->max_wire_smps;
+			limit = p_vl->max_smps;
 		}
 	}
 
@@ -186,21 +395,39 @@ static void vl15_poller(IN void *p_ptr)
 	OSM_LOG_EXIT(p_vl->p_log);
 }
 
+static void vl15_signal_all(IN osm_vl15_t * p_vl)
+{
+	unsigned i;
+
+	for (i = 0; i < p_vl->num_senders; i++)
+		cl_event_signal(&p_vl->senders[i].signal);
+}
+
 void osm_vl15_construct(IN osm_vl15_t * p_vl)
 {
+	osm_vl15_sender_t *p_snd;
+	int i, prio;
+
 	memset(p_vl, 0, sizeof(*p_vl));
 	p_vl->state = OSM_VL15_STATE_INIT;
 	p_vl->thread_state = OSM_THREAD_STATE_NONE;
-	cl_event_construct(&p_vl->signal);
+	for (i = 0; i < OSM_VL15_MAX_SENDERS; i++) {
+		p_snd = &p_vl->senders[i];
+		p_snd->p_vl = p_vl;
+		cl_event_construct(&p_snd->signal);
+		cl_spinlock_construct(&p_snd->lock);
+		for (prio = 0; prio < OSM_VL15_PRIO_MAX; prio++)
+			cl_qlist_init(&p_snd->fifo[prio]);
+		cl_thread_construct(&p_snd->thread);
+	}
 	cl_spinlock_construct(&p_vl->lock);
-	cl_qlist_init(&p_vl->rfifo);
-	cl_qlist_init(&p_vl->ufifo);
-	cl_thread_construct(&p_vl->poller);
 }
 
 void osm_vl15_destroy(IN osm_vl15_t * p_vl, IN struct osm_mad_pool *p_pool)
 {
+	osm_vl15_sender_t *p_snd;
 	osm_madw_t *p_madw;
+	int i, prio;
 
 	OSM_LOG_ENTER(p_vl->p_log);
 
@@ -210,32 +437,36 @@ void osm_vl15_destroy(IN osm_vl15_t * p_vl, IN struct osm_mad_pool *p_pool)
 	p_vl->thread_state = OSM_THREAD_STATE_EXIT;
 
 	/*
-	   Don't trigger unless event has been initialized.
-	   Destroy the thread before we tear down the other objects.
+	   Only initialized senders are signalled.
+	   Destroy the threads before we tear down the other objects.
 	 */
-	if (p_vl->state != OSM_VL15_STATE_INIT)
-		cl_event_signal(&p_vl->signal);
+	vl15_signal_all(p_vl);
 
-	cl_thread_destroy(&p_vl->poller);
+	for (i = 0; i < OSM_VL15_MAX_SENDERS; i++)
+		cl_thread_destroy(&p_vl->senders[i].thread);
 
 	/*
 	   Return the outstanding messages to the pool
 	 */
-
-	cl_spinlock_acquire(&p_vl->lock);
-
-	while (!cl_is_qlist_empty(&p_vl->rfifo)) {
-		p_madw = (osm_madw_t *) cl_qlist_remove_head(&p_vl->rfifo);
-		osm_mad_pool_put(p_pool, p_madw);
-	}
-	while (!cl_is_qlist_empty(&p_vl->ufifo)) {
-		p_madw = (osm_madw_t *) cl_qlist_remove_head(&p_vl->ufifo);
-		osm_mad_pool_put(p_pool, p_madw);
+	for (i = 0; i < p_vl->num_senders; i++) {
+		p_snd = &p_vl->senders[i];
+
+		cl_spinlock_acquire(&p_snd->lock);
+		for (prio = 0; prio < OSM_VL15_PRIO_MAX; prio++)
+			while (!cl_is_qlist_empty(&p_snd->fifo[prio])) {
+				p_madw = (osm_madw_t *)
+				    cl_qlist_remove_head(&p_snd->fifo[prio]);
+				osm_mad_pool_put(p_pool, p_madw);
+			}
+		cl_spinlock_release(&p_snd->lock);
 	}
 
-	cl_spinlock_release(&p_vl->lock);
+	for (i = 0; i < OSM_VL15_MAX_SENDERS; i++) {
+		cl_event_destroy(&p_vl->senders[i].signal);
+		cl_spinlock_destroy(&p_vl->senders[i].lock);
+	}
 
-	cl_event_destroy(&p_vl->signal);
+	p_vl->num_senders = 0;
 	p_vl->state = OSM_VL15_STATE_INIT;
 	cl_spinlock_destroy(&p_vl->lock);
 
@@ -244,10 +475,14 @@ void osm_vl15_destroy(IN osm_vl15_t * p_vl, IN struct osm_mad_pool *p_pool)
 
 ib_api_status_t osm_vl15_init(IN osm_vl15_t * p_vl, IN osm_vendor_t * p_vend,
 			      IN osm_log_t * p_log, IN osm_stats_t * p_stats,
+			      IN osm_trace_t * p_trace,
 			      IN int32_t max_wire_smps,
 			      IN int32_t max_wire_smps2,
-			      IN uint32_t max_smps_timeout)
+			      IN uint32_t max_smps_timeout,
+			      IN boolean_t adaptive,
+			      IN uint32_t num_senders)
 {
+	osm_vl15_sender_t *p_snd;
 	ib_api_status_t status = IB_SUCCESS;
 
 	OSM_LOG_ENTER(p_log);
@@ -255,27 +490,53 @@ ib_api_status_t osm_vl15_init(IN osm_vl15_t * p_vl, IN osm_vendor_t * p_vend,
 	p_vl->p_vend = p_vend;
 	p_vl->p_log = p_log;
 	p_vl->p_stats = p_stats;
+	p_vl->p_trace = p_trace;
 	p_vl->max_wire_smps = max_wire_smps;
 	p_vl->max_wire_smps2 = max_wire_smps2;
+	p_vl->max_smps = max_wire_smps;
 	p_vl->max_smps_timeout = max_wire_smps < max_wire_smps2 ?
 				 max_smps_timeout : EVENT_NO_TIMEOUT;
+	p_vl->adaptive = adaptive;
+	p_vl->num_windows = 0;
 
-	status = cl_event_init(&p_vl->signal, FALSE);
-	if (status != IB_SUCCESS)
-		goto Exit;
-
-	p_vl->state = OSM_VL15_STATE_READY;
+	if (num_senders < 1)
+		num_senders = 1;
+	else if (num_senders > OSM_VL15_MAX_SENDERS)
+		num_senders = OSM_VL15_MAX_SENDERS;
 
 	status = cl_spinlock_init(&p_vl->lock);
 	if (status != IB_SUCCESS)
 		goto Exit;
 
+	p_vl->state = OSM_VL15_STATE_READY;
+	p_vl->thread_state = OSM_THREAD_STATE_RUN;
+
 	/*
-	   Initialize the thread after all other dependent objects
-	   have been initialized.
+	   Initialize each thread after all other objects of its
+	   sender have been initialized.  A sender is counted once
+	   its event can be signalled.
 	 */
-	status = cl_thread_init(&p_vl->poller, vl15_poller, p_vl,
-				"opensm poller");
+	while (p_vl->num_senders < num_senders) {
+		p_snd = &p_vl->senders[p_vl->num_senders];
+
+		status = cl_spinlock_init(&p_snd->lock);
+		if (status != IB_SUCCESS)
+			goto Exit;
+
+		status = cl_event_init(&p_snd->signal, FALSE);
+		if (status != IB_SUCCESS)
+			goto Exit;
+
+		p_vl->num_senders++;
+
+		status = cl_thread_init(&p_snd->thread, vl15_poller, p_snd,
+					"opensm poller");
+		if (status != IB_SUCCESS)
+			goto Exit;
+	}
+
+	OSM_LOG(p_log, OSM_LOG_VERBOSE, "%u VL15 sender threads\n",
+		p_vl->num_senders);
 Exit:
 	OSM_LOG_EXIT(p_log);
 	return status;
@@ -289,91 +550,171 @@ void osm_vl15_poll(IN osm_vl15_t * p_vl)
 
 	/*
 	   If we have room for more VL15 MADs on the wire,
-	   then signal the poller thread.
+	   then signal the sender threads.
 
-	   This is not an airtight check, since the poller thread
+	   This is not an airtight check, since a sender thread
 	   could be just about to send another MAD as we signal
-	   the event here.  To cover this rare case, the poller
-	   thread checks for a spurious wake-up.
+	   the event here.  To cover this rare case, the sender
+	   threads check for a spurious wake-up.
 	 */
-	if (p_vl->p_stats->qp0_mads_outstanding_on_wire <
+	if (p_vl->adaptive || p_vl->p_stats->qp0_mads_outstanding_on_wire <
 	    (int32_t) p_vl->max_wire_smps) {
 		OSM_LOG(p_vl->p_log, OSM_LOG_DEBUG,
-			"Signalling poller thread\n");
-		cl_event_signal(&p_vl->signal);
+			"Signalling sender threads\n");
+		vl15_signal_all(p_vl);
 	}
 
 	OSM_LOG_EXIT(p_vl->p_log);
 }
 
+void osm_vl15_complete(IN osm_vl15_t * p_vl, IN const osm_madw_t * p_madw,
+		       IN boolean_t timed_out)
+{
+	osm_vl15_window_t *p_win;
+	osm_vl15_rtt_t *p_rtt;
+	uint64_t now;
+	int32_t rtt, err;
+
+	if (!p_vl->adaptive)
+		return;
+
+	now = cl_get_time_stamp();
+
+	cl_spinlock_acquire(&p_vl->lock);
+
+	p_win = vl15_window(p_vl, p_madw);
+	if (p_win->on_wire > 0)
+		p_win->on_wire--;
+
+	if (timed_out) {
+		p_win->timeouts++;
+		/*
+		   Back off once per window: requests sent before the
+		   last reduction time out because of the old window.
+		 */
+		if (p_madw->send_time >= p_win->last_backoff) {
+			p_win->cwnd = p_win->cwnd > 1 ? p_win->cwnd / 2 : 1;
+			p_win->acked = 0;
+			p_win->last_backoff = now;
+			OSM_LOG(p_vl->p_log, OSM_LOG_VERBOSE,
+				"SMP timed out, VL15 window reduced to %u\n",
+				p_win->cwnd);
+		}
+		goto Exit;
+	}
+
+	p_rtt = vl15_rtt(p_win, p_madw);
+	rtt = now > p_madw->send_time ?
+	    (int32_t) (now - p_madw->send_time) : 0;
+
+	if (p_rtt->samples < VL15_RTT_WARMUP ||
+	    rtt <= (int32_t) (p_rtt->srtt / 8 + p_rtt->rttvar)) {
+		if (++p_win->acked >= p_win->cwnd) {
+			p_win->acked = 0;
+			if (p_win->cwnd < vl15_window_max(p_vl))
+				p_win->cwnd++;
+		}
+	} else
+		p_win->late++;
+
+	/* Jacobson/Karels estimator, srtt scaled by 8 and rttvar by 4 */
+	if (p_rtt->samples++ == 0) {
+		p_rtt->srtt = rtt << 3;
+		p_rtt->rttvar = rtt << 1;
+	} else {
+		err = rtt - (int32_t) (p_rtt->srtt >> 3);
+		p_rtt->srtt += err;
+		if (err < 0)
+			err = -err;
+		p_rtt->rttvar += err - (int32_t) (p_rtt->rttvar >> 2);
+	}
+
+Exit:
+	cl_spinlock_release(&p_vl->lock);
+}
+
 void osm_vl15_post(IN osm_vl15_t * p_vl, IN osm_madw_t * p_madw)
 {
+	osm_vl15_sender_t *p_snd;
+	osm_vl15_prio_t prio;
+
 	OSM_LOG_ENTER(p_vl->p_log);
 
 	CL_ASSERT(p_vl->state == OSM_VL15_STATE_READY);
 
-	OSM_LOG(p_vl->p_log, OSM_LOG_DEBUG, "Posting p_madw = %p\n", p_madw);
+	prio = vl15_prio(p_madw);
+	p_snd = vl15_sender(p_vl, p_madw);
 
-	/*
-	   Determine in which fifo to place the pending madw.
-	 */
-	cl_spinlock_acquire(&p_vl->lock);
-	if (p_madw->resp_expected == TRUE) {
-		cl_qlist_insert_tail(&p_vl->rfifo, &p_madw->list_item);
+	OSM_LOG(p_vl->p_log, OSM_LOG_DEBUG,
+		"Posting p_madw = %p to sender %u class %d\n", p_madw,
+		(unsigned)(p_snd - p_vl->senders), prio);
+
+	cl_spinlock_acquire(&p_snd->lock);
+	cl_qlist_insert_tail(&p_snd->fifo[prio], &p_madw->list_item);
+	if (prio != OSM_VL15_PRIO_TRAP_REPRESS)
 		osm_stats_inc_qp0_outstanding(p_vl->p_stats);
-	} else
-		cl_qlist_insert_tail(&p_vl->ufifo, &p_madw->list_item);
-	cl_spinlock_release(&p_vl->lock);
+	cl_spinlock_release(&p_snd->lock);
 
 	OSM_LOG(p_vl->p_log, OSM_LOG_DEBUG,
 		"%u QP0 MADs on wire, %u QP0 MADs outstanding\n",
 		p_vl->p_stats->qp0_mads_outstanding_on_wire,
 		p_vl->p_stats->qp0_mads_outstanding);
 
-	osm_vl15_poll(p_vl);
+	/*
+	   Only the sender of this MAD has new work.  MADs without a
+	   response are not throttled, so wake it up regardless of
+	   the wire count.
+	 */
+	if (prio == OSM_VL15_PRIO_TRAP_REPRESS || p_vl->adaptive ||
+	    p_vl->p_stats->qp0_mads_outstanding_on_wire <
+	    (int32_t) p_vl->max_wire_smps)
+		cl_event_signal(&p_snd->signal);
 
 	OSM_LOG_EXIT(p_vl->p_log);
 }
 
 void osm_vl15_shutdown(IN osm_vl15_t * p_vl, IN osm_mad_pool_t * p_mad_pool)
 {
+	osm_vl15_sender_t *p_snd;
 	osm_madw_t *p_madw;
+	unsigned i;
+	int prio;
 
 	OSM_LOG_ENTER(p_vl->p_log);
 
 	/* we only should get here after the VL15 interface was initialized */
 	CL_ASSERT(p_vl->state == OSM_VL15_STATE_READY);
 
-	/* grap a lock on the object */
-	cl_spinlock_acquire(&p_vl->lock);
-
 	/* go over all outstanding MADs and retire their transactions */
+	for (i = 0; i < p_vl->num_senders; i++) {
+		p_snd = &p_vl->senders[i];
+
+		/* grap a lock on the sender */
+		cl_spinlock_acquire(&p_snd->lock);
+
+		for (prio = 0; prio < OSM_VL15_PRIO_MAX; prio++) {
+			p_madw = (osm_madw_t *)
+			    cl_qlist_remove_head(&p_snd->fifo[prio]);
+			while (p_madw !=
+			       (osm_madw_t *) cl_qlist_end(&p_snd->fifo[prio])) {
+				OSM_LOG(p_vl->p_log, OSM_LOG_DEBUG,
+					"Releasing %s p_madw = %p\n",
+					prio == OSM_VL15_PRIO_TRAP_REPRESS ?
+					"Response" : "Request", p_madw);
+
+				osm_mad_pool_put(p_mad_pool, p_madw);
+				if (prio != OSM_VL15_PRIO_TRAP_REPRESS)
+					osm_stats_dec_qp0_outstanding
+					    (p_vl->p_stats);
+
+				p_madw = (osm_madw_t *)
+				    cl_qlist_remove_head(&p_snd->fifo[prio]);
+			}
+		}
 
-	/* first we handle the list of response MADs */
-	p_madw = (osm_madw_t *) cl_qlist_remove_head(&p_vl->ufifo);
-	while (p_madw != (osm_madw_t *) cl_qlist_end(&p_vl->ufifo)) {
-		OSM_LOG(p_vl->p_log, OSM_LOG_DEBUG,
-			"Releasing Response p_madw = %p\n", p_madw);
-
-		osm_mad_pool_put(p_mad_pool, p_madw);
-
-		p_madw = (osm_madw_t *) cl_qlist_remove_head(&p_vl->ufifo);
-	}
-
-	/* Request MADs we send out */
-	p_madw = (osm_madw_t *) cl_qlist_remove_head(&p_vl->rfifo);
-	while (p_madw != (osm_madw_t *) cl_qlist_end(&p_vl->rfifo)) {
-		OSM_LOG(p_vl->p_log, OSM_LOG_DEBUG,
-			"Releasing Request p_madw = %p\n", p_madw);
-
-		osm_mad_pool_put(p_mad_pool, p_madw);
-		osm_stats_dec_qp0_outstanding(p_vl->p_stats);
-
-		p_madw = (osm_madw_t *) cl_qlist_remove_head(&p_vl->rfifo);
+		/* free the lock */
+		cl_spinlock_release(&p_snd->lock);
 	}
 
-	/* free the lock */
-	cl_spinlock_release(&p_vl->lock);
-
 	OSM_LOG_EXIT(p_vl->p_log);
 }